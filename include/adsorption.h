@@ -0,0 +1,86 @@
+/*************************************************************************
+ *
+ *  This file is part of v2c.
+ *
+ *  Author: Ivo Filot <i.a.w.filot@tue.nl>
+ *
+ *  v2c is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  v2c is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with v2c.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ************************************************************************/
+
+
+/*
+ * Adsorption sites of the adsorbates (H, C, N and O atoms) on a metal
+ * surface. For every adsorbate, the substrate atoms within the bonding
+ * distances of atom_constants.h are found with a cell list over the
+ * substrate only; their number is the coordination number. The site follows
+ * from the bonded substrate atoms whose distance is within a relative
+ * tolerance of the shortest bond: one atom is a top site, two a bridge
+ * site and four a fourfold hollow. A threefold hollow is an hcp site when a
+ * second-layer substrate atom lies below its center, and an fcc site
+ * otherwise. The direction "below" is taken from the adsorbate towards the
+ * center of its site, such that the orientation of the slab in the cell
+ * does not matter.
+ */
+
+#ifndef _ADSORPTION_H
+#define _ADSORPTION_H
+
+#include <vector>
+#include <string>
+#include <cmath>
+#include <algorithm>
+
+#include "state.h"
+#include "bonding.h"
+#include "celllist.h"
+#include "lexical_casts.h"
+
+#define ADSORPTION_SITE_NONE        0     // not bonded to the substrate
+#define ADSORPTION_SITE_TOP         1
+#define ADSORPTION_SITE_BRIDGE      2
+#define ADSORPTION_SITE_FCC         3
+#define ADSORPTION_SITE_HCP         4
+#define ADSORPTION_SITE_FOURFOLD    5
+#define ADSORPTION_SITE_MULTIFOLD   6     // five or more site atoms
+
+#define ADSORPTION_DEFAULT_TOLERANCE  0.15    // relative to the shortest bond
+#define ADSORPTION_DEFAULT_CUTOFF     2.5     // [A] pairs without a bonding distance
+#define ADSORPTION_SUBSURFACE_RANGE   4.5     // [A] search radius for second-layer atoms
+
+struct AdsorbateSite {
+  unsigned int atom;            // index in the state
+  unsigned int site;            // one of the ADSORPTION_SITE_* values
+  unsigned int coordination;    // number of bonded substrate atoms
+  float height;                 // distance to the center of the site [A]
+};
+
+class AdsorptionAnalysis {
+private:
+  double tolerance;
+
+public:
+  AdsorptionAnalysis(double _tolerance = ADSORPTION_DEFAULT_TOLERANCE);
+
+  std::vector<AdsorbateSite> analyse(const State &state) const;
+  void format(const State &state, const std::string &label, std::string &buffer) const;
+
+  static bool is_adsorbate(unsigned int elnr);
+  static const char* get_site_name(unsigned int site);
+
+private:
+  static float get_cutoff(unsigned int elnr1, unsigned int elnr2);
+};
+
+#endif // _ADSORPTION_H
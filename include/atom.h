@@ -27,6 +27,15 @@
 
 #include "mathfunc.h"
 
+/*
+ * Selective dynamics flags (selec_mode): every set bit fixes the atom along
+ * one of the lattice directions; 0 means the atom is free in all directions
+ */
+#define ATOM_SELEC_FIX_X    1
+#define ATOM_SELEC_FIX_Y    2
+#define ATOM_SELEC_FIX_Z    4
+#define ATOM_SELEC_FIX_ALL  7
+
 class Atom {
 public:
   unsigned int elnr;
@@ -38,34 +47,34 @@ public:
   // default constructor
   Atom();
   Atom(const unsigned int &_an,   // element (i.e. # of protons)
-       const float &_x,           // x position in [A]
-       const float &_y,           // y position in [A]
-       const float &_z);          // z position in [A]
+       const Real &_x,            // x position in [A]
+       const Real &_y,            // y position in [A]
+       const Real &_z);           // z position in [A]
 
   Atom(const unsigned int &_an,    // element (i.e. # of protons)
-       const float &_x,            // x position in [A]
-       const float &_y,            // y position in [A]
-       const float &_z,            // z position in [A]
-       const float &_fx,           // x force in [eV/A]
-       const float &_fy,           // y force in [eV/A]
-       const float &_fz);          // z force in [eV/A]
+       const Real &_x,             // x position in [A]
+       const Real &_y,             // y position in [A]
+       const Real &_z,             // z position in [A]
+       const Real &_fx,            // x force in [eV/A]
+       const Real &_fy,            // y force in [eV/A]
+       const Real &_fz);           // z force in [eV/A]
 
-  void set_force(const float &_fx,           // x force in [eV/A]
-                 const float &_fy,           // y force in [eV/A]
-                 const float &_fz);          // z force in [eV/A]
+  void set_force(const Real &_fx,            // x force in [eV/A]
+                 const Real &_fy,            // y force in [eV/A]
+                 const Real &_fz);           // z force in [eV/A]
 
-  const float get_x() const;
-  const float get_y() const;
-  const float get_z() const;
+  const Real get_x() const;
+  const Real get_y() const;
+  const Real get_z() const;
 
 private:
   void init(const unsigned int &_an,    // element (i.e. # of protons)
-            const float &_x,            // x position in [A]
-             const float &_y,            // y position in [A]
-             const float &_z,            // z position in [A]
-             const float &_fx,           // x force in [eV/A]
-             const float &_fy,           // y force in [eV/A]
-             const float &_fz);          // z force in [eV/A]
+            const Real &_x,             // x position in [A]
+             const Real &_y,             // y position in [A]
+             const Real &_z,             // z position in [A]
+             const Real &_fx,            // x force in [eV/A]
+             const Real &_fy,            // y force in [eV/A]
+             const Real &_fz);           // z force in [eV/A]
 
 };
 
@@ -0,0 +1,96 @@
+/*************************************************************************
+ *
+ *  This file is part of v2c.
+ *
+ *  Author: Ivo Filot <i.a.w.filot@tue.nl>
+ *
+ *  v2c is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  v2c is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with v2c.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ************************************************************************/
+
+
+/*
+ * Selection of a subset of the atoms of a structure, given as a list of
+ * terms separated by commas:
+ *
+ *     El            atoms of element El (e.g. O or Rh)
+ *     N or N-M      atom N, or atoms N up to and including M (1-based, in
+ *                   the order of the POSITION block)
+ *     z=LO:HI       atoms with LO <= z <= HI [A] in the first frame
+ *     zframe=LO:HI  atoms with LO <= z <= HI [A], evaluated in every frame
+ *
+ * An atom is selected when it matches any of the given elements, any of the
+ * given index ranges and the z-window; kinds of terms that are absent do not
+ * restrict the selection. For example, "C,O,z=10:20" selects the C and O
+ * atoms between 10 and 20 A.
+ *
+ * Everything but a per-frame window is resolved once into a mask over the
+ * atoms, such that the parser can skip the lines of the other atoms.
+ */
+
+#ifndef _ATOMSELECTION_H
+#define _ATOMSELECTION_H
+
+#include <string>
+#include <vector>
+#include <iostream>
+
+#include "atom.h"
+
+#define ATOM_SELECTION_Z_NONE          0
+#define ATOM_SELECTION_Z_FIRST_FRAME   1
+#define ATOM_SELECTION_Z_PER_FRAME     2
+
+class AtomSelection {
+private:
+  std::vector<std::string> elements;        // selected elements
+  std::vector<unsigned int> range_begin;    // selected index ranges (0-based)
+  std::vector<unsigned int> range_end;      // (exclusive)
+  unsigned int z_mode;                      // one of ATOM_SELECTION_Z_*
+  float z_min;
+  float z_max;
+
+  bool resolved;
+  std::vector<char> mask;                   // per atom, once resolved
+
+public:
+  AtomSelection();
+
+  bool parse(const std::string &spec);
+  void clear();
+
+  bool is_active() const;
+  bool is_resolved() const;
+  bool needs_positions() const;
+  bool is_per_frame() const;
+
+  void resolve(const std::vector<std::string> &_elements, const std::vector<unsigned int> &nr_atoms_per_elm,
+               const std::vector<Atom> &atoms);
+
+  /*
+   * Whether atom <i> passes the resolved mask
+   */
+  inline bool is_selected(unsigned int i) const {
+    return i < this->mask.size() && this->mask[i];
+  }
+
+  /*
+   * Whether <z> lies within the z-window
+   */
+  inline bool in_window(float z) const {
+    return z >= this->z_min && z <= this->z_max;
+  }
+};
+
+#endif // _ATOMSELECTION_H
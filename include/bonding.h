@@ -0,0 +1,38 @@
+/*************************************************************************
+ *
+ *  This file is part of v2c.
+ *
+ *  Author: Ivo Filot <i.a.w.filot@tue.nl>
+ *
+ *  v2c is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  v2c is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with v2c.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ************************************************************************/
+
+/*
+ * Lookup of the bonding distances defined in atom_constants.h. Two atoms are
+ * considered bonded when their distance is below the cutoff of their pair of
+ * elements; pairs without a defined cutoff are never bonded.
+ */
+
+#ifndef _BONDING_H
+#define _BONDING_H
+
+#include <vector>
+
+#include "atom_constants.h"
+
+float get_bond_cutoff(unsigned int elnr1, unsigned int elnr2);
+float get_max_bond_cutoff(const std::vector<unsigned int> &elnrs);
+
+#endif // _BONDING_H
@@ -0,0 +1,296 @@
+/*************************************************************************
+ *
+ *  This file is part of v2c.
+ *
+ *  Author: Ivo Filot <i.a.w.filot@tue.nl>
+ *
+ *  v2c is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  v2c is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with v2c.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ************************************************************************/
+
+/*
+ * Neighbor search in a periodic (triclinic) unit cell. All pairs of atoms
+ * (including periodic images) that are closer than a cutoff are enumerated.
+ *
+ * The atoms are wrapped into the unit cell in fractional coordinates and are
+ * binned (by a counting sort) into a grid of cells whose perpendicular
+ * widths are at least the cutoff. Each pair is then found by scanning the 27
+ * neighboring cells. When the unit cell is too small to hold three cells in
+ * every direction, the pairs are instead found by a direct search over all
+ * periodic images that can be within the cutoff. Either way, every pair
+ * (i, j, image) is reported exactly once.
+ */
+
+#ifndef _CELLLIST_H
+#define _CELLLIST_H
+
+#include <vector>
+#include <cmath>
+#include <algorithm>
+
+#include "mathfunc.h"
+
+class CellList {
+private:
+  double cutoff;
+  Eigen::Matrix3d lattice;          // lattice vectors as rows [A]
+  Eigen::Matrix3d to_frac;          // Cartesian to fractional coordinates
+  unsigned int nr_atoms;
+  int nr_cells[3];                  // number of cells in each direction
+  int nr_images[3];                 // range of images for the direct search
+  bool use_cells;
+
+  std::vector<double> frac;         // wrapped fractional coordinates, sorted by cell
+  std::vector<unsigned int> index;  // original index of each sorted atom
+  std::vector<unsigned int> cell_start;  // first sorted atom of each cell (+ end marker)
+
+public:
+  CellList(const Matrix3 &_dimensions, double _cutoff);
+
+  template<typename T>
+  void build(const T *x, const T *y, const T *z, unsigned int n, unsigned int stride);
+
+  unsigned int get_nr_atoms() const;
+  double get_cutoff() const;
+  bool is_using_cells() const;
+
+  /*
+   * Call func(i, j, r2) for every pair of atoms i <= j whose squared distance
+   * r2 (to any periodic image of j) is smaller than the squared cutoff; i == j
+   * only occurs for images of an atom with itself. When func takes six
+   * arguments, it is called as func(i, j, r2, dx, dy, dz) with (dx, dy, dz)
+   * the Cartesian vector pointing from atom i to the image of atom j.
+   */
+  template<typename F> void for_each_pair(F func) const {
+    if(this->use_cells) {
+      this->for_each_pair_cells(func);
+    } else {
+      this->for_each_pair_images(func);
+    }
+  }
+
+  /*
+   * Call func(j, r2, dx, dy, dz) for every atom j of which an image is closer
+   * than the cutoff to the point <r>, with (dx, dy, dz) the Cartesian vector
+   * pointing from <r> to that image. The point does not need to be one of
+   * the atoms, such that one group of atoms can be searched for the
+   * neighbors of another.
+   */
+  template<typename F> void for_each_neighbor(const Eigen::Vector3d &r, F func) const;
+
+private:
+  template<typename F> void for_each_pair_cells(F func) const;
+  template<typename F> void for_each_pair_images(F func) const;
+};
+
+/*
+ * Helper that calls func with either three or six arguments, depending on
+ * the signature of func
+ */
+namespace celllist_detail {
+  template<typename F>
+  auto invoke(F &func, unsigned int i, unsigned int j, double r2, double dx, double dy, double dz, int)
+    -> decltype(func(i, j, r2, dx, dy, dz), void()) {
+    func(i, j, r2, dx, dy, dz);
+  }
+
+  template<typename F>
+  auto invoke(F &func, unsigned int i, unsigned int j, double r2, double, double, double, long)
+    -> decltype(func(i, j, r2), void()) {
+    func(i, j, r2);
+  }
+}
+
+/*
+ * Scan the 27 neighboring cells of every cell. Pairs are reported from the
+ * cell of the atom with the lowest index, such that each pair is seen once.
+ */
+template<typename F> void CellList::for_each_pair_cells(F func) const {
+  const double cutoff2 = this->cutoff * this->cutoff;
+  const int nx = this->nr_cells[0];
+  const int ny = this->nr_cells[1];
+  const int nz = this->nr_cells[2];
+  const Eigen::Matrix3d &m = this->lattice;
+
+  for(int cx=0; cx<nx; cx++) {
+    for(int cy=0; cy<ny; cy++) {
+      for(int cz=0; cz<nz; cz++) {
+        const unsigned int c = (cx * ny + cy) * nz + cz;
+
+        for(int ox=-1; ox<=1; ox++) {
+          for(int oy=-1; oy<=1; oy++) {
+            for(int oz=-1; oz<=1; oz++) {
+              // neighboring cell and the lattice translation to reach it
+              int ncx = cx + ox, ncy = cy + oy, ncz = cz + oz;
+              double sx = 0.0, sy = 0.0, sz = 0.0;
+              if(ncx < 0) { ncx += nx; sx = -1.0; } else if(ncx >= nx) { ncx -= nx; sx = 1.0; }
+              if(ncy < 0) { ncy += ny; sy = -1.0; } else if(ncy >= ny) { ncy -= ny; sy = 1.0; }
+              if(ncz < 0) { ncz += nz; sz = -1.0; } else if(ncz >= nz) { ncz -= nz; sz = 1.0; }
+              const unsigned int nc = (ncx * ny + ncy) * nz + ncz;
+
+              for(unsigned int a=this->cell_start[c]; a<this->cell_start[c+1]; a++) {
+                const unsigned int i = this->index[a];
+                const double fx = sx - this->frac[a*3];
+                const double fy = sy - this->frac[a*3+1];
+                const double fz = sz - this->frac[a*3+2];
+
+                for(unsigned int b=this->cell_start[nc]; b<this->cell_start[nc+1]; b++) {
+                  const unsigned int j = this->index[b];
+                  if(j <= i) {
+                    continue;
+                  }
+
+                  const double u = this->frac[b*3] + fx;
+                  const double v = this->frac[b*3+1] + fy;
+                  const double w = this->frac[b*3+2] + fz;
+                  const double dx = u * m(0,0) + v * m(1,0) + w * m(2,0);
+                  const double dy = u * m(0,1) + v * m(1,1) + w * m(2,1);
+                  const double dz = u * m(0,2) + v * m(1,2) + w * m(2,2);
+                  const double r2 = dx * dx + dy * dy + dz * dz;
+
+                  if(r2 < cutoff2) {
+                    celllist_detail::invoke(func, i, j, r2, dx, dy, dz, 0);
+                  }
+                }
+              }
+            }
+          }
+        }
+      }
+    }
+  }
+}
+
+/*
+ * Direct search over all images within range. In this mode the atoms are
+ * not sorted, hence index[a] == a. For the pair of an atom with its own
+ * image, only the images in the "positive" half space are visited, such that
+ * each (i, j, image) is seen once.
+ */
+template<typename F> void CellList::for_each_pair_images(F func) const {
+  const double cutoff2 = this->cutoff * this->cutoff;
+  const Eigen::Matrix3d &m = this->lattice;
+  const unsigned int n = this->nr_atoms;
+
+  for(unsigned int a=0; a<n; a++) {
+    const unsigned int i = this->index[a];
+    for(unsigned int b=a; b<n; b++) {
+      const unsigned int j = this->index[b];
+      const double du = this->frac[b*3] - this->frac[a*3];
+      const double dv = this->frac[b*3+1] - this->frac[a*3+1];
+      const double dw = this->frac[b*3+2] - this->frac[a*3+2];
+
+      for(int ix=-this->nr_images[0]; ix<=this->nr_images[0]; ix++) {
+        for(int iy=-this->nr_images[1]; iy<=this->nr_images[1]; iy++) {
+          for(int iz=-this->nr_images[2]; iz<=this->nr_images[2]; iz++) {
+            if(a == b) {
+              // skip the atom itself and the mirror image of each translation
+              if(ix < 0 || (ix == 0 && iy < 0) || (ix == 0 && iy == 0 && iz <= 0)) {
+                continue;
+              }
+            }
+
+            const double u = du + ix;
+            const double v = dv + iy;
+            const double w = dw + iz;
+            const double dx = u * m(0,0) + v * m(1,0) + w * m(2,0);
+            const double dy = u * m(0,1) + v * m(1,1) + w * m(2,1);
+            const double dz = u * m(0,2) + v * m(1,2) + w * m(2,2);
+            const double r2 = dx * dx + dy * dy + dz * dz;
+
+            if(r2 < cutoff2) {
+              celllist_detail::invoke(func, i, j, r2, dx, dy, dz, 0);
+            }
+          }
+        }
+      }
+    }
+  }
+}
+
+/*
+ * Scan the cells around the cell of the point, or (in the direct search)
+ * all images of all atoms within range
+ */
+template<typename F> void CellList::for_each_neighbor(const Eigen::Vector3d &r, F func) const {
+  const double cutoff2 = this->cutoff * this->cutoff;
+  const Eigen::Matrix3d &m = this->lattice;
+
+  double p[3];
+  int pc[3];
+  const Eigen::Vector3d f = this->to_frac * r;
+  for(unsigned int k=0; k<3; k++) {
+    p[k] = f(k) - std::floor(f(k));
+    if(p[k] >= 1.0) {
+      p[k] = 0.0;
+    }
+    pc[k] = std::min((int)(p[k] * this->nr_cells[k]), this->nr_cells[k] - 1);
+  }
+
+  if(!this->use_cells) {
+    for(unsigned int a=0; a<this->nr_atoms; a++) {
+      const double du = this->frac[a*3] - p[0];
+      const double dv = this->frac[a*3+1] - p[1];
+      const double dw = this->frac[a*3+2] - p[2];
+      for(int ix=-this->nr_images[0]; ix<=this->nr_images[0]; ix++) {
+        for(int iy=-this->nr_images[1]; iy<=this->nr_images[1]; iy++) {
+          for(int iz=-this->nr_images[2]; iz<=this->nr_images[2]; iz++) {
+            const double u = du + ix;
+            const double v = dv + iy;
+            const double w = dw + iz;
+            const double dx = u * m(0,0) + v * m(1,0) + w * m(2,0);
+            const double dy = u * m(0,1) + v * m(1,1) + w * m(2,1);
+            const double dz = u * m(0,2) + v * m(1,2) + w * m(2,2);
+            const double r2 = dx * dx + dy * dy + dz * dz;
+            if(r2 < cutoff2) {
+              func(this->index[a], r2, dx, dy, dz);
+            }
+          }
+        }
+      }
+    }
+    return;
+  }
+
+  const int nx = this->nr_cells[0];
+  const int ny = this->nr_cells[1];
+  const int nz = this->nr_cells[2];
+  for(int ox=-1; ox<=1; ox++) {
+    for(int oy=-1; oy<=1; oy++) {
+      for(int oz=-1; oz<=1; oz++) {
+        int ncx = pc[0] + ox, ncy = pc[1] + oy, ncz = pc[2] + oz;
+        double sx = 0.0, sy = 0.0, sz = 0.0;
+        if(ncx < 0) { ncx += nx; sx = -1.0; } else if(ncx >= nx) { ncx -= nx; sx = 1.0; }
+        if(ncy < 0) { ncy += ny; sy = -1.0; } else if(ncy >= ny) { ncy -= ny; sy = 1.0; }
+        if(ncz < 0) { ncz += nz; sz = -1.0; } else if(ncz >= nz) { ncz -= nz; sz = 1.0; }
+        const unsigned int nc = (ncx * ny + ncy) * nz + ncz;
+
+        for(unsigned int b=this->cell_start[nc]; b<this->cell_start[nc+1]; b++) {
+          const double u = this->frac[b*3] + sx - p[0];
+          const double v = this->frac[b*3+1] + sy - p[1];
+          const double w = this->frac[b*3+2] + sz - p[2];
+          const double dx = u * m(0,0) + v * m(1,0) + w * m(2,0);
+          const double dy = u * m(0,1) + v * m(1,1) + w * m(2,1);
+          const double dz = u * m(0,2) + v * m(1,2) + w * m(2,2);
+          const double r2 = dx * dx + dy * dy + dz * dz;
+          if(r2 < cutoff2) {
+            func(this->index[b], r2, dx, dy, dz);
+          }
+        }
+      }
+    }
+  }
+}
+
+#endif // _CELLLIST_H
@@ -0,0 +1,61 @@
+/*************************************************************************
+ *
+ *  This file is part of v2c.
+ *
+ *  Author: Ivo Filot <i.a.w.filot@tue.nl>
+ *
+ *  v2c is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  v2c is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with v2c.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ************************************************************************/
+
+
+/*
+ * Periodic transformations of atomic coordinates: wrapping atoms into the
+ * unit cell, unwrapping a trajectory across the periodic boundaries and
+ * building supercells.
+ *
+ * The kernels work on whole coordinate matrices at once. The positions of
+ * a State are kept in homogeneous coordinates (rows x, y, z, 1 of the
+ * [atoms x 4] coordinate matrix), such that the conversion between
+ * Cartesian and fractional coordinates, including a translation, is a
+ * single product with a 4 x 4 affine matrix. The frames of a Trajectory
+ * ([atoms x 3], row-major) are mapped as [3 x atoms] matrices without
+ * copying.
+ */
+
+#ifndef _CELLTRANSFORM_H
+#define _CELLTRANSFORM_H
+
+#include <vector>
+#include <cmath>
+
+#include "mathfunc.h"
+#include "state.h"
+
+class CellTransform {
+public:
+  static Matrix4 get_fractional_transform(const Matrix3 &cell);
+  static Matrix4 get_cartesian_transform(const Matrix3 &cell);
+
+  static void wrap(State &state);
+  static void wrap(float *positions, unsigned int nr_atoms, const float *cell);
+  static void unwrap(float *positions, const float *cells, unsigned int nr_frames, unsigned int nr_atoms);
+
+  static State supercell(const State &state, unsigned int na, unsigned int nb, unsigned int nc);
+
+private:
+  static void store_coordinates(State &state);
+};
+
+#endif // _CELLTRANSFORM_H
@@ -0,0 +1,65 @@
+/*************************************************************************
+ *
+ *  This file is part of v2c.
+ *
+ *  Author: Ivo Filot <i.a.w.filot@tue.nl>
+ *
+ *  v2c is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  v2c is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with v2c.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ************************************************************************/
+
+/*
+ * Writes a state as CIF file in space group P1, i.e. with all atoms of the
+ * unit cell listed explicitly. With symmetry enabled, the symmetry
+ * operations of the structure are detected (see SymmetryFinder) and only
+ * the atoms of the asymmetric unit are listed, together with the operations,
+ * the point group and the crystal system. Supercells and centered cells are
+ * first reduced to their primitive cell, whose operations hold no pure
+ * translations; structures without symmetry are written in P1 (in the
+ * primitive cell, when that is smaller). Only the cell parameters are
+ * stored, hence the orientation of the cell is lost: a structure read back
+ * from the file has its first lattice vector along x and its second in the
+ * xy plane.
+ */
+
+#ifndef _CIFWRITER_H
+#define _CIFWRITER_H
+
+#include <string>
+#include <vector>
+#include <stdio.h>
+
+#include "state.h"
+#include "symmetry.h"
+#include "outputsink.h"
+
+class CifWriter {
+private:
+  bool symmetry;          // reduce to the asymmetric unit
+  double tolerance;       // symmetry tolerance [A]
+
+public:
+  CifWriter(bool _symmetry = false, double _tolerance = SYMMETRY_DEFAULT_TOLERANCE);
+
+  void format(const State &state, const std::string &name, std::string &buffer) const;
+  bool write(const State &state, const std::string &filename, const std::string &name,
+             unsigned int nr_threads = 1) const;
+
+private:
+  void format_cell(const State &state, std::string &buffer) const;
+  bool format_symmetry(const SymmetryFinder &finder, std::vector<char> &listed, std::string &buffer) const;
+  static std::string block_name(const std::string &name);
+};
+
+#endif // _CIFWRITER_H
@@ -23,6 +23,8 @@
 #define _COLOR_H
 
 #include <string>
+#include <algorithm>
+#include <stdlib.h>
 
 #include "lexical_casts.h"
 
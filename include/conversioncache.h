@@ -0,0 +1,94 @@
+/*************************************************************************
+ *
+ *  This file is part of v2c.
+ *
+ *  Author: Ivo Filot <i.a.w.filot@tue.nl>
+ *
+ *  v2c is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  v2c is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with v2c.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ************************************************************************/
+
+/*
+ * Persistent cache for batch conversions. For every input file, the cache
+ * stores its size, modification time and a hash of its first and last
+ * CONVERSION_CACHE_HASH_BLOCK bytes, together with the reader checkpoint
+ * after its last complete state. On a subsequent run, a file is
+ *
+ *   - skipped when size, modification time and both hashes are unchanged
+ *   - resumed from the checkpoint when it has grown while the bytes that
+ *     were hashed before are unchanged (i.e. data has been appended)
+ *   - parsed again from the start otherwise
+ *
+ * The cache file is a journal: an entry is appended as soon as a file has
+ * been converted and the last entry of a file wins, such that an
+ * interrupted batch continues with the first file it had not finished. The
+ * journal is compacted when it is opened.
+ */
+
+#ifndef _CONVERSION_CACHE_H
+#define _CONVERSION_CACHE_H
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <iostream>
+#include <unordered_map>
+#include <stdint.h>
+
+#include "vaspreader.h"
+
+#define CONVERSION_CACHE_PREFIX "# v2c conversion cache"
+#define CONVERSION_CACHE_HEADER CONVERSION_CACHE_PREFIX " 2"
+#define CONVERSION_CACHE_HASH_BLOCK 65536
+
+/*
+ * Result of a cache lookup
+ */
+#define CONVERSION_CACHE_NEW        0   // not in the cache or modified
+#define CONVERSION_CACHE_UNCHANGED  1   // identical to the cached file
+#define CONVERSION_CACHE_APPENDED   2   // cached file with data appended
+
+struct ConversionCacheEntry {
+  uint64_t size;
+  int64_t mtime;
+  uint64_t head_hash;
+  uint64_t tail_hash;
+  OutcarCheckpoint checkpoint;
+};
+
+class ConversionCache {
+private:
+  std::string filename;
+  std::unordered_map<std::string, ConversionCacheEntry> entries;
+  std::ofstream outfile;
+
+public:
+  ConversionCache();
+
+  bool open(const std::string &_filename);
+
+  unsigned int check(const std::string &path, OutcarCheckpoint *checkpoint) const;
+  bool update(const std::string &path, const OutcarCheckpoint &checkpoint);
+
+  size_t size() const;
+
+private:
+  bool stat_file(const std::string &path, ConversionCacheEntry *entry) const;
+  uint64_t hash_range(std::ifstream &infile, uint64_t start, uint64_t length) const;
+
+  std::string serialize(const std::string &path, const ConversionCacheEntry &entry) const;
+  bool deserialize(const std::string &line, std::string *path, ConversionCacheEntry *entry) const;
+};
+
+#endif // _CONVERSION_CACHE_H
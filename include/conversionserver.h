@@ -0,0 +1,141 @@
+/*************************************************************************
+ *
+ *  This file is part of v2c.
+ *
+ *  Author: Ivo Filot <i.a.w.filot@tue.nl>
+ *
+ *  v2c is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  v2c is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with v2c.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ************************************************************************/
+
+
+/*
+ * Resident server for v2c commands on a local (Unix domain) socket. A
+ * workflow that runs many small conversions connects with the client
+ * (v2c client SOCKET COMMAND ...) instead of starting v2c for every file,
+ * and saves the process start-up and the compilation of the OUTCAR
+ * patterns, which are compiled once per process.
+ *
+ * A request holds the working directory of the client and the command line;
+ * the server changes to that directory, runs the command and streams its
+ * standard output and error back as they are written, followed by the exit
+ * code. Requests are handled one at a time, in the order in which they
+ * connect, such that the commands can use all threads.
+ *
+ * The commands run with the rights of the user who started the server,
+ * hence the socket is only accessible to that user (mode 0600) and
+ * connections from processes of other users are refused.
+ *
+ * Wire format, both ways in host byte order (the socket is local):
+ *
+ *     request    uint32 n, followed by n NUL-terminated strings: the
+ *                working directory and the arguments (command first)
+ *     response   frames of a channel byte and an uint32 length, followed
+ *                by the data; channels 'o' (output), 'e' (errors) and
+ *                'x' (exit code as int32, ends the response)
+ */
+
+#ifndef _CONVERSIONSERVER_H
+#define _CONVERSIONSERVER_H
+
+#include <string>
+#include <vector>
+#include <streambuf>
+#include <iostream>
+#include <functional>
+#include <algorithm>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <unordered_map>
+#include <stdint.h>
+
+#define CONVERSION_SERVER_BACKLOG         64
+#define CONVERSION_SERVER_MAX_REQUEST     (1 << 20)   // bytes
+#define CONVERSION_SERVER_BUFFER_SIZE     4096        // bytes of output per frame
+
+#define CONVERSION_SERVER_CHANNEL_OUTPUT  'o'
+#define CONVERSION_SERVER_CHANNEL_ERROR   'e'
+#define CONVERSION_SERVER_CHANNEL_EXIT    'x'
+
+class ConversionServer {
+private:
+  std::string socket_path;
+  int listen_fd;
+  std::function<int(const std::vector<std::string>&)> handler;
+  unsigned int nr_requests;
+
+  static std::atomic<bool> handling;
+
+public:
+  ConversionServer(const std::function<int(const std::vector<std::string>&)> &_handler);
+  ~ConversionServer();
+
+  bool open(const std::string &_socket_path);
+  void run();
+  void close();
+
+  unsigned int get_nr_requests() const;
+
+  static bool is_handling();
+
+  static int request(const std::string &socket_path, const std::vector<std::string> &args);
+
+  static bool send_frame(int fd, char channel, const char *data, uint32_t length);
+
+private:
+  ConversionServer(const ConversionServer&);
+  ConversionServer& operator=(const ConversionServer&);
+
+  bool handle(int fd);
+  static bool is_own_user(int fd);
+  static bool read_request(int fd, std::vector<std::string> &strings);
+  static bool read_all(int fd, void *data, size_t length);
+  static bool write_all(int fd, const void *data, size_t length);
+};
+
+/*
+ * Output stream buffer that sends everything written to it as frames of
+ * one channel to a client socket. Commands also write from the workers of
+ * a ThreadPool, hence the buffer has no put area of its own: every write
+ * ends up in overflow or xsputn, which collect the text of every thread
+ * separately under a lock. Lines are sent as soon as they are complete; a
+ * partial line is only sent when BUFFER_SIZE bytes are pending or by
+ * flush_all, at the end of a command. All streams on a socket share the
+ * lock, such that frames never interleave.
+ */
+class SocketStreamBuf : public std::streambuf {
+private:
+  int fd;
+  char channel;
+  std::unordered_map<std::thread::id, std::string> pending;   // text of every thread
+
+  static std::mutex mutex;
+
+public:
+  SocketStreamBuf(int _fd, char _channel);
+  ~SocketStreamBuf();
+
+  bool flush_all();
+
+protected:
+  int_type overflow(int_type c);
+  std::streamsize xsputn(const char *s, std::streamsize n);
+  int sync();
+
+private:
+  bool send(std::string &text, bool whole_lines);
+};
+
+#endif // _CONVERSIONSERVER_H
@@ -0,0 +1,92 @@
+/*************************************************************************
+ *
+ *  This file is part of v2c.
+ *
+ *  Author: Ivo Filot <i.a.w.filot@tue.nl>
+ *
+ *  v2c is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  v2c is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with v2c.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ************************************************************************/
+
+/*
+ * Mean squared displacement (MSD) and velocity autocorrelation function
+ * (VACF) per element for molecular dynamics trajectories. Both quantities
+ * are averaged over all time origins. The positions of every atom are first
+ * unwrapped across the periodic boundaries, after which the multi-origin
+ * averages are evaluated in O(N log N) using FFT based autocorrelations
+ * (Calandrini et al., Collection SFN 12 (2011) 201-232) instead of the
+ * direct O(N^2) summation. The velocities are obtained from the unwrapped
+ * positions by central differences.
+ *
+ * The time series can also be gathered from a FrameStore for a block of
+ * atoms at a time, such that only the series of one block are in memory
+ * next to the frames held by the store; the MSD and VACF themselves, and
+ * the unit cells, remain proportional to the number of frames.
+ */
+
+#ifndef _CORRELATION_H
+#define _CORRELATION_H
+
+#include <vector>
+#include <string>
+#include <complex>
+#include <fstream>
+#include <iostream>
+#include <algorithm>
+#include <functional>
+
+#include <eigen3/unsupported/Eigen/FFT>
+
+#include "trajectory.h"
+#include "framestore.h"
+#include "threadpool.h"
+#include "lexical_casts.h"
+
+class CorrelationAnalysis {
+private:
+  /*
+   * Provides the positions of atoms first .. first + count - 1 in all
+   * frames ([count x frames x 3]) and the cells of all frames ([frames x 9])
+   */
+  typedef std::function<void(unsigned int first, unsigned int count,
+                             std::vector<float> &series, std::vector<float> &cells)> SeriesLoader;
+
+  double timestep;                          // time between frames [fs]
+  unsigned int nr_frames;
+  std::vector<std::string> elements;
+  std::vector<std::vector<double> > msd;    // per element [A^2]
+  std::vector<std::vector<double> > vacf;   // per element [A^2/fs^2]
+
+public:
+  CorrelationAnalysis(double _timestep);
+
+  bool calculate(const Trajectory &trajectory, ThreadPool &pool);
+  bool calculate(const FrameStore &states, size_t memory_budget, ThreadPool &pool);
+
+  unsigned int get_nr_elements() const;
+  const std::vector<std::string>& get_elements() const;
+  const std::vector<double>& get_msd(unsigned int element) const;
+  const std::vector<double>& get_vacf(unsigned int element) const;
+  double get_diffusion_coefficient(unsigned int element) const;
+
+  bool write(const std::string &filename) const;
+
+private:
+  bool calculate(unsigned int frames, unsigned int atoms, const std::vector<std::string> &_elements,
+                 const std::vector<unsigned int> &nr_atoms_per_elm, unsigned int block,
+                 const SeriesLoader &load, ThreadPool &pool);
+  void autocorrelation(const std::vector<double> &x, Eigen::FFT<double> &fft, std::vector<double> &result) const;
+};
+
+#endif // _CORRELATION_H
@@ -0,0 +1,102 @@
+/*************************************************************************
+ *
+ *  This file is part of v2c.
+ *
+ *  Author: Ivo Filot <i.a.w.filot@tue.nl>
+ *
+ *  v2c is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  v2c is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with v2c.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ************************************************************************/
+
+/*
+ * Content-addressed fingerprints of structures. The fingerprint of a State
+ * is a 64 bit FNV-1a hash that is invariant under permutations of the atoms,
+ * translations, rotations and changes of the unit cell basis. It is built
+ * from:
+ *
+ *   - the number of atoms of every element (sorted by element name)
+ *   - the lengths and the absolute angle cosines of the reduced unit cell
+ *   - for every atom, its element and the sorted list of (element, distance)
+ *     of the atoms it is bonded to, according to the bonding cutoffs in
+ *     atom_constants.h; these per-atom signatures are sorted as well
+ *
+ * All lengths are quantized to a tolerance before hashing, hence two
+ * structures that differ by less than the tolerance usually (but not
+ * always, when a value lies close to a bin edge) obtain the same
+ * fingerprint.
+ *
+ * The FingerprintIndex maps fingerprints to the file and the index of the
+ * first state seen with that fingerprint, and to the path the state was
+ * written to. It is kept as a text file with one entry per line, to which
+ * new entries are appended immediately, such that an interrupted batch
+ * conversion leaves a valid index.
+ */
+
+#ifndef _FINGERPRINT_H
+#define _FINGERPRINT_H
+
+#include <vector>
+#include <string>
+#include <fstream>
+#include <iostream>
+#include <unordered_map>
+#include <stdint.h>
+
+#include "state.h"
+
+#define FINGERPRINT_INDEX_HEADER "# v2c fingerprint index"
+
+class Fingerprint {
+private:
+  double distance_tolerance;    // bin width for distances [A]
+  double angle_tolerance;       // bin width for the cosines of the cell angles
+
+public:
+  Fingerprint(double _distance_tolerance = 0.05, double _angle_tolerance = 0.01);
+
+  uint64_t calculate(const State &state) const;
+
+  std::string get_parameters() const;
+  static std::string to_string(uint64_t fingerprint);
+
+private:
+  void reduce_cell(Eigen::Matrix3d &lattice) const;
+};
+
+struct FingerprintEntry {
+  std::string filename;
+  unsigned int state_id;
+  std::string path;             // output file of the state (empty in old indices)
+};
+
+class FingerprintIndex {
+private:
+  std::string filename;
+  std::string parameters;
+  std::unordered_map<uint64_t, FingerprintEntry> entries;
+  std::ofstream outfile;
+
+public:
+  FingerprintIndex(const Fingerprint &fingerprint);
+
+  bool open(const std::string &_filename);
+
+  const FingerprintEntry* find(uint64_t fingerprint) const;
+  bool insert(uint64_t fingerprint, const std::string &source, unsigned int state_id,
+              const std::string &path);
+
+  size_t size() const;
+};
+
+#endif // _FINGERPRINT_H
@@ -0,0 +1,109 @@
+/*************************************************************************
+ *
+ *  This file is part of v2c.
+ *
+ *  Author: Ivo Filot <i.a.w.filot@tue.nl>
+ *
+ *  v2c is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  v2c is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with v2c.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ************************************************************************/
+
+
+/*
+ * Container for the states (frames) of a trajectory with an optional memory
+ * budget. As long as the estimated size of the frames held in memory stays
+ * within the budget, the store behaves like a vector of states. When the
+ * budget is exceeded, the oldest frames are written to a spill file as
+ * compact binary records (energy, cell, optional quantities, and the
+ * element, position and force of every atom) and removed from memory.
+ * Accessing a spilled frame reads its record back and rebuilds the State,
+ * such that every frame is available through the same interface.
+ *
+ * Frames are returned by value through operator[]; get returns a frame in
+ * memory by reference and only rebuilds a spilled frame, in a buffer of the
+ * caller. Spilled frames are read with pread, such that frames can be
+ * requested concurrently from the workers of a ThreadPool (each with its
+ * own buffer) as long as no frames are added at the same time.
+ *
+ * The spill file is created in the given directory (default: $TMPDIR or
+ * /tmp) and unlinked right away; its space is released when the store is
+ * cleared or destroyed.
+ */
+
+#ifndef _FRAMESTORE_H
+#define _FRAMESTORE_H
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <iostream>
+#include <stdint.h>
+
+#include "state.h"
+
+#define FRAME_STORE_UNLIMITED 0
+
+class FrameStore {
+private:
+  /*
+   * Properties that are shared by many frames (usually all frames of a
+   * file); every spilled record refers to one of these
+   */
+  struct FrameHeader {
+    std::vector<std::string> elements;
+    std::vector<unsigned int> elements_uint;
+    std::vector<unsigned int> nr_atoms;
+    std::string filename;
+  };
+
+  size_t memory_budget;                 // bytes, FRAME_STORE_UNLIMITED for no limit
+  std::string spill_directory;
+  int spill_fd;                         // -1 as long as nothing has been spilled
+  uint64_t spill_size;                  // bytes written to the spill file
+
+  std::vector<FrameHeader> headers;
+  std::vector<uint64_t> offsets;        // record offset of every spilled frame
+  std::deque<State> resident;           // the frames after the spilled ones
+  size_t resident_bytes;
+
+public:
+  FrameStore();
+  ~FrameStore();
+
+  void set_memory_budget(size_t _bytes, const std::string &_directory = "");
+  size_t get_memory_budget() const;
+
+  void push_back(const State &state);
+  void clear();
+
+  size_t size() const;
+  bool empty() const;
+  size_t get_nr_spilled() const;
+  State operator[](size_t i) const;
+  const State& get(size_t i, State &buffer) const;
+  State back() const;
+
+  static size_t estimate_size(const State &state);
+
+private:
+  FrameStore(const FrameStore&);
+  FrameStore& operator=(const FrameStore&);
+
+  void spill_oldest();
+  unsigned int find_header(const State &state);
+  bool open_spill_file();
+  State read_record(size_t i) const;
+};
+
+#endif // _FRAMESTORE_H
@@ -0,0 +1,175 @@
+/*************************************************************************
+ *
+ *  This file is part of v2c.
+ *
+ *  Author: Ivo Filot <i.a.w.filot@tue.nl>
+ *
+ *  v2c is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  v2c is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with v2c.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ************************************************************************/
+
+
+/*
+ * Geometry kernels on the coordinates of a structure, templated on the
+ * scalar type, such that the same code is used by the single and the double
+ * precision build (see Real in mathfunc.h) and both can be compared within
+ * one binary.
+ *
+ * The coordinates are [atoms x 3] column-major blocks, as the first three
+ * columns of the coordinate matrix of a State: the x, y and z coordinates
+ * of all atoms are each contiguous. Every kernel is written as a sequence of
+ * operations on whole columns, which Eigen evaluates with packet (SIMD)
+ * instructions; in single precision, a packet holds twice as many atoms.
+ * The inverse of the lattice is always computed in double precision.
+ */
+
+#ifndef _GEOMETRY_H
+#define _GEOMETRY_H
+
+#include <cmath>
+#include <algorithm>
+
+#include "mathfunc.h"
+
+/*
+ * Number of atoms of which the coordinates are summed in the scalar type
+ * before the partial sum is accumulated in double precision
+ */
+#define GEOMETRY_BLOCK_SIZE 1024
+
+class Geometry {
+public:
+  /*
+   * Matrix mapping Cartesian onto fractional coordinates for a <cell> with
+   * the lattice vectors as rows: r = A^T f, hence f = A^-T r
+   */
+  template<typename T>
+  static Matrix3T<T> get_fractional_matrix(const Matrix3T<T> &cell) {
+    return cell.template cast<double>().inverse().transpose().template cast<T>();
+  }
+
+  template<typename Derived>
+  static void to_fractional(const Matrix3T<typename Derived::Scalar> &cell,
+                            const Eigen::MatrixBase<Derived> &cart,
+                            MatrixX3T<typename Derived::Scalar> &frac);
+
+  template<typename Derived>
+  static void to_cartesian(const Matrix3T<typename Derived::Scalar> &cell,
+                           const Eigen::MatrixBase<Derived> &frac,
+                           MatrixX3T<typename Derived::Scalar> &cart);
+
+  template<typename T>
+  static void wrap_fractional(MatrixX3T<T> &frac);
+
+  template<typename DerivedA, typename DerivedB>
+  static void minimum_image_distances(const Matrix3T<typename DerivedA::Scalar> &cell,
+                                      const Eigen::MatrixBase<DerivedA> &a,
+                                      const Eigen::MatrixBase<DerivedB> &b,
+                                      Eigen::Matrix<typename DerivedA::Scalar, Eigen::Dynamic, 1> &d2);
+
+  template<typename Derived>
+  static Vector3T<typename Derived::Scalar> centroid(const Eigen::MatrixBase<Derived> &cart);
+
+private:
+  /*
+   * out.col(k) = m(k,0) in.col(0) + m(k,1) in.col(1) + m(k,2) in.col(2)
+   */
+  template<typename T, typename Derived>
+  static void transform(const Matrix3T<T> &m, const Eigen::MatrixBase<Derived> &in, MatrixX3T<T> &out) {
+    out.resize(in.rows(), 3);
+    for(unsigned int k=0; k<3; k++) {
+      out.col(k).noalias() = m(k,0) * in.col(0) + m(k,1) * in.col(1) + m(k,2) * in.col(2);
+    }
+  }
+};
+
+/*
+ * Fractional coordinates <frac> of the Cartesian coordinates <cart> in
+ * the unit cell <cell> (lattice vectors as rows)
+ */
+template<typename Derived>
+void Geometry::to_fractional(const Matrix3T<typename Derived::Scalar> &cell,
+                             const Eigen::MatrixBase<Derived> &cart,
+                             MatrixX3T<typename Derived::Scalar> &frac) {
+  transform(get_fractional_matrix(cell), cart, frac);
+}
+
+/*
+ * Cartesian coordinates <cart> of the fractional coordinates <frac>
+ */
+template<typename Derived>
+void Geometry::to_cartesian(const Matrix3T<typename Derived::Scalar> &cell,
+                            const Eigen::MatrixBase<Derived> &frac,
+                            MatrixX3T<typename Derived::Scalar> &cart) {
+  const Matrix3T<typename Derived::Scalar> to_cart = cell.transpose();
+  transform(to_cart, frac, cart);
+}
+
+/*
+ * Move fractional coordinates into [0, 1)
+ */
+template<typename T>
+void Geometry::wrap_fractional(MatrixX3T<T> &frac) {
+  frac = frac.array() - frac.array().floor();
+  frac = (frac.array() >= T(1)).select(T(0), frac);  // rounding of tiny negative values
+}
+
+/*
+ * Squared distance <d2> between every atom of <a> and the closest periodic
+ * image of the same atom in <b>
+ */
+template<typename DerivedA, typename DerivedB>
+void Geometry::minimum_image_distances(const Matrix3T<typename DerivedA::Scalar> &cell,
+                                       const Eigen::MatrixBase<DerivedA> &a,
+                                       const Eigen::MatrixBase<DerivedB> &b,
+                                       Eigen::Matrix<typename DerivedA::Scalar, Eigen::Dynamic, 1> &d2) {
+  typedef typename DerivedA::Scalar T;
+
+  MatrixX3T<T> frac;
+  MatrixX3T<T> d;
+  transform(get_fractional_matrix(cell), b - a, frac);
+  frac = frac.array() - (frac.array() + T(0.5)).floor();
+  const Matrix3T<T> to_cart = cell.transpose();
+  transform(to_cart, frac, d);
+
+  d2 = d.col(0).array().square() + d.col(1).array().square() + d.col(2).array().square();
+}
+
+/*
+ * Mean of the coordinates <cart>. Blocks of GEOMETRY_BLOCK_SIZE atoms are
+ * summed with packet instructions in the scalar type; the partial sums are
+ * accumulated in double precision, which keeps float accurate for large
+ * cells.
+ */
+template<typename Derived>
+Vector3T<typename Derived::Scalar> Geometry::centroid(const Eigen::MatrixBase<Derived> &cart) {
+  typedef typename Derived::Scalar T;
+
+  const Eigen::Index n = cart.rows();
+  Eigen::Vector3d sum = Eigen::Vector3d::Zero();
+  for(Eigen::Index start=0; start<n; start+=GEOMETRY_BLOCK_SIZE) {
+    const Eigen::Index size = std::min<Eigen::Index>(GEOMETRY_BLOCK_SIZE, n - start);
+    for(unsigned int k=0; k<3; k++) {
+      sum(k) += (double)cart.col(k).segment(start, size).sum();
+    }
+  }
+
+  if(n > 0) {
+    sum /= (double)n;
+  }
+
+  return sum.template cast<T>();
+}
+
+#endif // _GEOMETRY_H
@@ -31,6 +31,7 @@ std::string int2str(const int &i);
 std::string float2str(const float &i);
 std::string float2str2(const float &i, const char* str);
 std::string double2str(const double &i);
+std::string double2str2(const double &i, const char* str);
 
 float str2float(const std::string &_str);
 int hex2int(const std::string &_str);
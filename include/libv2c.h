@@ -0,0 +1,88 @@
+/*************************************************************************
+ *
+ *  This file is part of v2c.
+ *
+ *  Author: Ivo Filot <i.a.w.filot@tue.nl>
+ *
+ *  v2c is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  v2c is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with v2c.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ************************************************************************/
+
+/*
+ * C interface to libv2c. A trajectory is opened from an OUTCAR, after which
+ * the frames can be iterated or accessed by index. All arrays returned by
+ * this interface point directly into the contiguous buffers held by the
+ * trajectory handle; they remain valid until v2c_close is called and can be
+ * wrapped by host languages (numpy, Julia arrays, ...) without copying.
+ *
+ * Layout of the arrays (C order, single precision unless stated otherwise):
+ *
+ *     positions   [atoms x 3]  per frame, [frames x atoms x 3] in total  [A]
+ *     forces      [atoms x 3]  per frame, [frames x atoms x 3] in total  [eV/A]
+ *     cell        [3 x 3]      per frame, lattice vectors as rows        [A]
+ *     energies    [frames]     double precision                          [eV]
+ */
+
+#ifndef _LIBV2C_H
+#define _LIBV2C_H
+
+/*
+ * The version of the interface is increased on every incompatible change
+ */
+#define V2C_API_VERSION 1
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct v2c_trajectory v2c_trajectory;
+
+/*
+ * View on a single frame, filled by v2c_next_frame and v2c_get_frame
+ */
+typedef struct v2c_frame {
+  unsigned int index;       // index of the frame in the trajectory
+  double energy;            // energy of the frame [eV]
+  const float *positions;   // [atoms x 3]
+  const float *forces;      // [atoms x 3]
+  const float *cell;        // [3 x 3]
+} v2c_frame;
+
+int v2c_api_version(void);
+const char* v2c_last_error(void);
+
+v2c_trajectory* v2c_open(const char *filename);
+void v2c_close(v2c_trajectory *trajectory);
+
+unsigned int v2c_get_nr_frames(const v2c_trajectory *trajectory);
+unsigned int v2c_get_nr_atoms(const v2c_trajectory *trajectory);
+unsigned int v2c_get_nr_elements(const v2c_trajectory *trajectory);
+const char* v2c_get_element(const v2c_trajectory *trajectory, unsigned int i);
+unsigned int v2c_get_atoms_for_element(const v2c_trajectory *trajectory, unsigned int i);
+const unsigned int* v2c_get_species(const v2c_trajectory *trajectory);
+
+int v2c_next_frame(v2c_trajectory *trajectory, v2c_frame *frame);
+void v2c_rewind(v2c_trajectory *trajectory);
+int v2c_get_frame(const v2c_trajectory *trajectory, unsigned int index, v2c_frame *frame);
+
+const float* v2c_get_positions(const v2c_trajectory *trajectory);
+const float* v2c_get_forces(const v2c_trajectory *trajectory);
+const float* v2c_get_cells(const v2c_trajectory *trajectory);
+const double* v2c_get_energies(const v2c_trajectory *trajectory);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _LIBV2C_H
@@ -24,17 +24,43 @@
 
 #include <eigen3/Eigen/Dense>
 
-typedef Eigen::Matrix<float, 3, 1> Vector3;
-typedef Eigen::Matrix<float, 3, 3> Matrix3;
+/*
+ * Scalar type of the geometry: atom positions, cells and the kernels working
+ * on them. The default build uses single precision, for which the kernels
+ * process twice as many atoms per SIMD register; building with
+ * V2C_DOUBLE_PRECISION (make PRECISION=double) gives a double precision
+ * build for reference accuracy. The npy files and the trajectory arrays
+ * remain float32; the spill records of a FrameStore follow Real.
+ */
+#ifdef V2C_DOUBLE_PRECISION
+typedef double Real;
+#else
+typedef float Real;
+#endif
 
-typedef Eigen::Matrix<float, 4, 1> Vector4;
-typedef Eigen::Matrix<float, 4, 4> Matrix4;
+template<typename T> using Vector3T = Eigen::Matrix<T, 3, 1>;
+template<typename T> using Matrix3T = Eigen::Matrix<T, 3, 3>;
+template<typename T> using Vector4T = Eigen::Matrix<T, 4, 1>;
+template<typename T> using Matrix4T = Eigen::Matrix<T, 4, 4>;
+template<typename T> using MatrixX3T = Eigen::Matrix<T, Eigen::Dynamic, 3>;
+template<typename T> using MatrixX4T = Eigen::Matrix<T, Eigen::Dynamic, 4>;
+template<typename T> using Matrix3XT = Eigen::Matrix<T, 3, Eigen::Dynamic>;
 
-typedef Eigen::Matrix<float, Eigen::Dynamic, 3> MatrixX3f;
-typedef Eigen::Matrix<float, Eigen::Dynamic, 4> MatrixX4f;
-typedef Eigen::Matrix<float, 3, Eigen::Dynamic> Matrix3Xf;
+typedef Vector3T<Real> Vector3;
+typedef Matrix3T<Real> Matrix3;
+
+typedef Vector4T<Real> Vector4;
+typedef Matrix4T<Real> Matrix4;
+
+typedef MatrixX3T<Real> MatrixX3;
+typedef MatrixX4T<Real> MatrixX4;
+
+// float32 buffers, as in the trajectory arrays and the npy files
+typedef MatrixX3T<float> MatrixX3f;
+typedef MatrixX4T<float> MatrixX4f;
+typedef Matrix3XT<float> Matrix3Xf;
 typedef Eigen::Matrix<float, 4, Eigen::Dynamic> Matrix4Xf;
 
-typedef Eigen::AngleAxis<float> AngleAxis;
+typedef Eigen::AngleAxis<Real> AngleAxis;
 
 #endif // _MATHFUNC_H
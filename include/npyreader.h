@@ -0,0 +1,63 @@
+/*************************************************************************
+ *
+ *  This file is part of v2c.
+ *
+ *  Author: Ivo Filot <i.a.w.filot@tue.nl>
+ *
+ *  v2c is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  v2c is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with v2c.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ************************************************************************/
+
+/*
+ * Reader for the .npy files written by NpyWriter. Only little-endian,
+ * C-ordered arrays of the types written by v2c are supported: float32
+ * ('<f4'), float64 ('<f8'), int32 ('<i4') and fixed-width unicode strings
+ * ('<U#').
+ */
+
+#ifndef _NPYREADER_H
+#define _NPYREADER_H
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <iostream>
+#include <stdint.h>
+#include <stdlib.h>
+
+class NpyReader {
+private:
+  std::string descr;
+  std::vector<size_t> shape;
+  std::vector<char> data;
+
+public:
+  NpyReader();
+
+  bool read(const std::string &filename);
+
+  const std::string& get_descr() const;
+  const std::vector<size_t>& get_shape() const;
+  size_t get_nr_elements() const;
+
+  bool get(std::vector<float> &result) const;
+  bool get(std::vector<double> &result) const;
+  bool get(std::vector<int32_t> &result) const;
+  bool get(std::vector<std::string> &result) const;
+
+private:
+  bool parse_header(const std::string &header);
+};
+
+#endif // _NPYREADER_H
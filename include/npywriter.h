@@ -0,0 +1,89 @@
+/*************************************************************************
+ *
+ *  This file is part of v2c.
+ *
+ *  Author: Ivo Filot <i.a.w.filot@tue.nl>
+ *
+ *  v2c is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  v2c is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with v2c.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ************************************************************************/
+
+/*
+ * Writer for NumPy .npy arrays and (uncompressed) .npz archives. Every array
+ * is written little-endian in C order with a header that is padded to a
+ * multiple of 64 bytes, such that the data block of a .npy file is properly
+ * aligned when the file is memory-mapped (numpy.load(..., mmap_mode='r')).
+ * A .npy file can also be opened with its final shape and filled in parts
+ * (open_npy), for arrays that are produced block by block.
+ */
+
+#ifndef _NPYWRITER_H
+#define _NPYWRITER_H
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <iostream>
+#include <stdint.h>
+
+#include "lexical_casts.h"
+
+#define NPY_HEADER_ALIGNMENT 64
+
+class NpyWriter {
+private:
+  /*
+   * Bookkeeping of the members of an open .npz archive, needed to write
+   * the central directory when the archive is closed.
+   */
+  struct NpzEntry {
+    std::string name;
+    uint32_t crc;
+    uint32_t size;
+    uint32_t offset;
+  };
+
+  std::ofstream npz_file;
+  std::vector<NpzEntry> npz_entries;
+
+public:
+  NpyWriter();
+
+  bool write(const std::string &filename, const float *data, const std::vector<size_t> &shape);
+  bool write(const std::string &filename, const double *data, const std::vector<size_t> &shape);
+  bool write(const std::string &filename, const int32_t *data, const std::vector<size_t> &shape);
+  bool write(const std::string &filename, const std::vector<std::string> &data);
+  bool open_npy(std::ofstream &outfile, const std::string &filename, const char *descr,
+                const std::vector<size_t> &shape) const;
+
+  bool open_npz(const std::string &filename);
+  bool add_to_npz(const std::string &name, const float *data, const std::vector<size_t> &shape);
+  bool add_to_npz(const std::string &name, const double *data, const std::vector<size_t> &shape);
+  bool add_to_npz(const std::string &name, const int32_t *data, const std::vector<size_t> &shape);
+  bool add_to_npz(const std::string &name, const std::vector<std::string> &data);
+  bool close_npz();
+
+private:
+  std::string build_header(const char *descr, const std::vector<size_t> &shape) const;
+  bool write_npy(const std::string &filename, const char *descr, const char *data,
+                 size_t element_size, const std::vector<size_t> &shape);
+  bool add_npy(const std::string &name, const char *descr, const char *data,
+               size_t element_size, const std::vector<size_t> &shape);
+  std::string encode_strings(const std::vector<std::string> &data, size_t *width) const;
+  uint32_t crc32(uint32_t crc, const char *data, size_t len) const;
+  void write_uint16(uint16_t val);
+  void write_uint32(uint32_t val);
+};
+
+#endif // _NPYWRITER_H
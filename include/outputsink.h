@@ -0,0 +1,93 @@
+/*************************************************************************
+ *
+ *  This file is part of v2c.
+ *
+ *  Author: Ivo Filot <i.a.w.filot@tue.nl>
+ *
+ *  v2c is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  v2c is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with v2c.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ************************************************************************/
+
+
+/*
+ * Output file that is written either as is or, when its name ends in .gz,
+ * gzip compressed. The writers of this library assemble their files in
+ * memory and hand them to a sink, such that every output format can be
+ * compressed on the fly.
+ *
+ * Compression is done in the style of pigz: the data is cut into blocks of
+ * OUTPUT_SINK_BLOCK_SIZE bytes, which are deflated independently (each
+ * primed with the last 32 KiB of the preceding block as dictionary, hence
+ * at nearly the ratio of a single stream) and ended with a sync flush, such
+ * that the compressed blocks can simply be concatenated. With more than one
+ * thread, batches of blocks are compressed in parallel on a ThreadPool;
+ * their checksums are combined afterwards. The result is a single gzip
+ * member that any gzip reader accepts.
+ */
+
+#ifndef _OUTPUTSINK_H
+#define _OUTPUTSINK_H
+
+#include <string>
+#include <vector>
+#include <iostream>
+#include <algorithm>
+#include <stdio.h>
+#include <stdint.h>
+#include <zlib.h>
+
+#include "threadpool.h"
+
+#define OUTPUT_SINK_BLOCK_SIZE    (128 * 1024)
+#define OUTPUT_SINK_WINDOW        32768         // deflate window (dictionary size)
+#define OUTPUT_SINK_LEVEL         6
+
+class OutputSink {
+private:
+  std::string filename;
+  FILE *file;
+  bool compressed;
+  bool failed;
+
+  // compression state
+  unsigned int nr_threads;
+  ThreadPool *pool;                   // only used with more than one thread
+  std::string pending;                // data of the block being filled
+  std::vector<std::string> blocks;    // full blocks awaiting compression
+  std::string dictionary;             // last input before the first block
+  uint32_t crc;                       // of all data written so far
+  uint64_t size;                      // number of uncompressed bytes
+
+public:
+  OutputSink();
+  ~OutputSink();
+
+  bool open(const std::string &_filename, unsigned int _nr_threads = 1);
+  bool write(const char *data, size_t length);
+  bool write(const std::string &data);
+  bool close();
+
+  static bool is_compressed_name(const std::string &filename);
+  static bool write_file(const std::string &filename, const std::string &buffer, unsigned int nr_threads = 1);
+
+private:
+  OutputSink(const OutputSink&);
+  OutputSink& operator=(const OutputSink&);
+
+  bool compress_blocks(bool final);
+  static bool compress_block(const char *dictionary, size_t dictionary_length, const std::string &input,
+                             bool last, std::string &output);
+};
+
+#endif // _OUTPUTSINK_H
@@ -0,0 +1,70 @@
+/*************************************************************************
+ *
+ *  This file is part of v2c.
+ *
+ *  Author: Ivo Filot <i.a.w.filot@tue.nl>
+ *
+ *  v2c is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  v2c is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with v2c.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ************************************************************************/
+
+/*
+ * Writes states as VASP POSCAR/CONTCAR files. The lines that are the same
+ * for every frame of a trajectory (species symbols and atom counts) are
+ * formatted once, when the writer is constructed from a reference state.
+ * Every file is assembled in memory and written with a single call, such
+ * that many frames can be written concurrently on a ThreadPool; files whose
+ * name ends in .gz are compressed (see OutputSink).
+ *
+ * The atoms are expected in blocks per element (as read from an OUTCAR).
+ * Selective dynamics flags are taken from Atom::selec_mode; the "Selective
+ * dynamics" line is only written when any atom of the reference state has
+ * a fixed direction.
+ */
+
+#ifndef _POSCARWRITER_H
+#define _POSCARWRITER_H
+
+#include <string>
+#include <vector>
+#include <stdio.h>
+
+#include "state.h"
+#include "framestore.h"
+#include "threadpool.h"
+#include "outputsink.h"
+
+class PoscarWriter {
+private:
+  bool is_vasp5;
+  bool selective;
+  unsigned int nr_atoms;
+  std::string species_line;         // element symbols (VASP5 only)
+  std::string counts_line;          // number of atoms of every element
+
+public:
+  PoscarWriter(const State &reference, bool _is_vasp5 = true);
+
+  void format(const State &state, const std::string &name, std::string &buffer) const;
+  bool write(const State &state, const std::string &filename, const std::string &name,
+             unsigned int nr_threads = 1) const;
+
+  unsigned int write_frames(const FrameStore &states, const std::vector<unsigned int> &frames,
+                            const std::string &prefix, const std::string &source, ThreadPool &pool,
+                            bool compress = false) const;
+
+  static std::string get_frame_filename(const std::string &prefix, unsigned int frame, bool compress = false);
+};
+
+#endif // _POSCARWRITER_H
@@ -0,0 +1,158 @@
+/*************************************************************************
+ *
+ *  This file is part of v2c.
+ *
+ *  Author: Ivo Filot <i.a.w.filot@tue.nl>
+ *
+ *  v2c is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  v2c is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with v2c.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ************************************************************************/
+
+/*
+ * Asynchronous, prefetching reader for a list of files that are consumed
+ * one after the other (such as the OUTCARs of a batch conversion). The files
+ * are cut into chunks and the reads of the next <queue_depth> - 1 chunks,
+ * which may belong to the current or to the following files, are in flight
+ * while the current chunk is being parsed. Since the chunks are consumed in
+ * the order in which they are requested, the buffers form a ring.
+ *
+ * On Linux the reads are submitted through io_uring (by means of the raw
+ * system calls, such that no liburing is needed). When io_uring is not
+ * available (old kernel, seccomp filters), the reader falls back to
+ * posix_fadvise(WILLNEED) to let the kernel read ahead the requested ranges
+ * and to pread when a chunk is consumed.
+ *
+ * The PrefetchStreamBuf exposes the chunks of the current file as an input
+ * stream for the VaspReader.
+ */
+
+#ifndef _PREFETCHREADER_H
+#define _PREFETCHREADER_H
+
+#include <string>
+#include <vector>
+#include <streambuf>
+#include <iostream>
+#include <stdint.h>
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#define PREFETCH_HAVE_IO_URING
+#endif
+#endif
+
+#define PREFETCH_DEFAULT_QUEUE_DEPTH 8
+#define PREFETCH_DEFAULT_CHUNK_SIZE (1 << 20)
+
+/*
+ * State of a buffer in the ring
+ */
+#define PREFETCH_SLOT_FREE      0
+#define PREFETCH_SLOT_PENDING   1   // read submitted
+#define PREFETCH_SLOT_READY     2   // data available
+
+class PrefetchReader {
+private:
+  struct Chunk {
+    unsigned int file;
+    uint64_t offset;
+    size_t length;
+  };
+
+  struct Slot {
+    std::vector<char> buffer;
+    unsigned int status;
+    size_t chunk;             // index in the chunk schedule
+    size_t length;            // bytes read
+    int result;               // result of the asynchronous read
+  };
+
+  std::vector<std::string> filenames;
+  std::vector<uint64_t> file_sizes;
+  std::vector<int> fds;
+  std::vector<size_t> first_chunk;   // first chunk of every file (+ end marker)
+  std::vector<Chunk> chunks;         // chunks of all files in reading order
+  std::vector<Slot> slots;
+  size_t chunk_size;
+
+  size_t next_submit;                // next chunk to be requested
+  size_t next_consume;               // next chunk to be handed out
+  int current_file;
+  bool holds_slot;                   // whether a chunk has been handed out
+
+  bool use_io_uring;
+#ifdef PREFETCH_HAVE_IO_URING
+  int ring_fd;
+  void *sq_ptr;
+  void *cq_ptr;
+  void *sqes_ptr;
+  size_t sq_size;
+  size_t cq_size;
+  size_t sqes_size;
+  unsigned int *sq_head;
+  unsigned int *sq_tail;
+  unsigned int *sq_mask;
+  unsigned int *sq_array;
+  unsigned int *cq_head;
+  unsigned int *cq_tail;
+  unsigned int *cq_mask;
+  void *cqes;
+#endif
+
+public:
+  PrefetchReader(const std::vector<std::string> &_filenames,
+                 unsigned int queue_depth = PREFETCH_DEFAULT_QUEUE_DEPTH,
+                 size_t _chunk_size = PREFETCH_DEFAULT_CHUNK_SIZE,
+                 bool allow_io_uring = true);
+  ~PrefetchReader();
+
+  bool next_file();
+  const std::string& get_filename() const;
+
+  bool get_chunk(const char **data, size_t *length, uint64_t *offset);
+
+  bool is_using_io_uring() const;
+
+private:
+  bool open_file(unsigned int file);
+  void close_file(unsigned int file);
+  void fill_queue();
+  void submit(size_t chunk);
+  bool wait(size_t chunk);
+  bool read_sync(Slot &slot);
+
+#ifdef PREFETCH_HAVE_IO_URING
+  bool setup_ring(unsigned int entries);
+  void destroy_ring();
+#endif
+
+  // non-copyable; the ring and the open files are owned by this object
+  PrefetchReader(const PrefetchReader&);
+  PrefetchReader& operator=(const PrefetchReader&);
+};
+
+class PrefetchStreamBuf : public std::streambuf {
+private:
+  PrefetchReader *reader;
+  uint64_t buffer_offset;           // file offset of the current chunk
+
+public:
+  PrefetchStreamBuf(PrefetchReader *_reader);
+
+protected:
+  int_type underflow();
+  pos_type seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which);
+};
+
+#endif // _PREFETCHREADER_H
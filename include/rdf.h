@@ -0,0 +1,86 @@
+/*************************************************************************
+ *
+ *  This file is part of v2c.
+ *
+ *  Author: Ivo Filot <i.a.w.filot@tue.nl>
+ *
+ *  v2c is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  v2c is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with v2c.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ************************************************************************/
+
+/*
+ * Species-resolved (partial) radial distribution functions g_ab(r) and pair
+ * distance histograms, accumulated over the frames of a trajectory. Frames
+ * can be added concurrently from different workers; every worker has its
+ * own histogram, which are only summed when the results are requested.
+ * The element pairs are set up from the first frame; every other frame
+ * needs to hold the same elements with the same number of atoms each.
+ */
+
+#ifndef _RDF_H
+#define _RDF_H
+
+#include <vector>
+#include <string>
+#include <fstream>
+#include <iostream>
+#include <cmath>
+
+#include "state.h"
+#include "celllist.h"
+#include "threadpool.h"
+#include "lexical_casts.h"
+
+class RadialDistribution {
+private:
+  double r_max;                         // largest distance in the histogram [A]
+  unsigned int nr_bins;
+  double bin_width;                     // [A]
+  bool initialized;
+
+  std::vector<std::string> elements;
+  std::vector<unsigned int> nr_atoms_per_elm;
+  std::vector<unsigned int> species;    // element index of each atom
+  std::vector<unsigned int> pair_index; // elements x elements -> pair number
+  unsigned int nr_pairs;
+
+  // per worker accumulators
+  std::vector<std::vector<double> > histograms;   // pairs x bins
+  std::vector<double> volumes;
+  std::vector<unsigned int> nr_frames;
+
+public:
+  RadialDistribution(double _r_max, unsigned int _nr_bins, unsigned int _nr_workers);
+
+  void initialize(const State &state);
+  bool is_initialized() const;
+  bool accepts(const State &state) const;
+
+  void add_frame(const State &state, unsigned int worker);
+  bool add_frames(const std::vector<State> &states, ThreadPool &pool);
+
+  unsigned int get_nr_frames() const;
+  unsigned int get_nr_pairs() const;
+  std::string get_pair_name(unsigned int pair) const;
+  std::vector<double> get_histogram(unsigned int pair) const;
+  std::vector<double> get_rdf(unsigned int pair) const;
+
+  bool write(const std::string &filename) const;
+
+private:
+  double get_average_volume() const;
+  double get_nr_atom_pairs(unsigned int pair) const;
+};
+
+#endif // _RDF_H
@@ -0,0 +1,69 @@
+/*************************************************************************
+ *
+ *  This file is part of v2c.
+ *
+ *  Author: Ivo Filot <i.a.w.filot@tue.nl>
+ *
+ *  v2c is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  v2c is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with v2c.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ************************************************************************/
+
+/*
+ * Root mean square deviation between frames after optimal superposition
+ * (Kabsch algorithm). Frames are taken from the contiguous [atoms x 3]
+ * arrays of a Trajectory; the atoms of both frames need to be in the same
+ * order. When periodic images are taken into account, every atom of the
+ * second frame is first moved to the periodic image closest to the same
+ * atom in the first frame, such that atoms that crossed a boundary do not
+ * show up as large deviations.
+ */
+
+#ifndef _RMSD_H
+#define _RMSD_H
+
+#include <vector>
+#include <cmath>
+
+#include "mathfunc.h"
+#include "trajectory.h"
+#include "threadpool.h"
+
+/*
+ * Alignment applied before the deviation is measured
+ */
+#define RMSD_ALIGN_NONE         0   // compare the coordinates as they are
+#define RMSD_ALIGN_TRANSLATION  1   // superimpose the centroids
+#define RMSD_ALIGN_KABSCH       2   // superimpose centroids and rotate
+
+class RmsdAnalysis {
+private:
+  unsigned int align;
+  bool periodic;
+
+public:
+  RmsdAnalysis(unsigned int _align, bool _periodic);
+
+  double rmsd(const float *ref, const float *pos, unsigned int n, const float *cell,
+              Eigen::Matrix3d *rotation = NULL) const;
+
+  std::vector<double> all_vs_reference(const Trajectory &trajectory, const float *ref,
+                                       ThreadPool &pool) const;
+  std::vector<unsigned int> deduplicate(const Trajectory &trajectory, double threshold,
+                                        ThreadPool &pool) const;
+  void deduplicate(const Trajectory &trajectory, unsigned int first, double threshold,
+                   std::vector<float> &representatives, std::vector<unsigned int> &kept,
+                   ThreadPool &pool) const;
+};
+
+#endif // _RMSD_H
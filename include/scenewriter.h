@@ -0,0 +1,96 @@
+/*************************************************************************
+ *
+ *  This file is part of v2c.
+ *
+ *  Author: Ivo Filot <i.a.w.filot@tue.nl>
+ *
+ *  v2c is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  v2c is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with v2c.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ************************************************************************/
+
+
+/*
+ * Binary scene export of structures for 3D viewers. Every species has a
+ * single sphere mesh (with the radius and color of atom_constants.h baked
+ * in), which is drawn at the position of every atom of that species by
+ * instancing; bonds are instanced cylinders, split into two halves that
+ * carry the colors of their atoms (unless both atoms are of the same
+ * species and the bond lies within the cell). This keeps the files of large cells
+ * proportional to the number of atoms rather than to the number of
+ * triangles.
+ *
+ * glTF files (.glb) use the EXT_mesh_gpu_instancing extension and draw the
+ * edges of the cell as lines. Multiple frames become one node per frame,
+ * shown in turn by a step animation of the node scales. PLY files hold a point cloud with a color and radius per
+ * atom, which viewers render as glyphs, and the bonds within the cell as
+ * edges; bonds across the cell boundary are left out.
+ */
+
+#ifndef _SCENEWRITER_H
+#define _SCENEWRITER_H
+
+#include <vector>
+#include <string>
+#include <cmath>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "state.h"
+#include "color.h"
+#include "bonding.h"
+#include "celllist.h"
+#include "atom_constants.h"
+#include "outputsink.h"
+
+#define SCENE_BOND_RADIUS           0.12      // [A]
+#define SCENE_DEFAULT_RADIUS        0.5       // [A] elements without a radius
+#define SCENE_DEFAULT_COLOR         "FF1493"  // elements without a color
+#define SCENE_SPHERE_SUBDIVISIONS   2         // of an icosahedron: 320 triangles
+#define SCENE_CYLINDER_SEGMENTS     12
+#define SCENE_DEFAULT_FPS           10.0
+
+/*
+ * Bond from atom i to the image of atom j at distance vector d
+ */
+struct SceneBond {
+  unsigned int i;
+  unsigned int j;
+  Eigen::Vector3f d;
+  bool periodic;          // the image of j is not j itself
+};
+
+class SceneWriter {
+private:
+  bool bonds;             // include the bonds
+  double fps;             // frames per second of the animation
+
+public:
+  SceneWriter(bool _bonds = true, double _fps = SCENE_DEFAULT_FPS);
+
+  bool write_gltf(const std::vector<State> &frames, const std::string &filename) const;
+  bool write_ply(const State &state, const std::string &filename) const;
+
+  static float get_atom_radius(unsigned int elnr);
+  static Color get_atom_color(unsigned int elnr);
+
+private:
+  void find_bonds(const State &state, std::vector<SceneBond> &result) const;
+  static void get_species(const State &state, std::vector<std::string> &names,
+                          std::vector<unsigned int> &elnrs, std::vector<unsigned int> &species);
+  static void build_sphere(std::vector<float> &vertices, std::vector<uint16_t> &indices);
+  static void build_cylinder(std::vector<float> &vertices, std::vector<float> &normals,
+                             std::vector<uint16_t> &indices);
+};
+
+#endif // _SCENEWRITER_H
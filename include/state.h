@@ -31,6 +31,32 @@
 #include "atom.h"
 #include "mathfunc.h"
 
+/*
+ * Optional per-step quantities that are collected on request (see
+ * VaspReader::set_observables) in the same pass as the positions
+ */
+#define STATE_OBSERVABLE_STRESS         1   // stress tensor [kB]
+#define STATE_OBSERVABLE_MAGNETIZATION  2   // total magnetization [mu_B]
+#define STATE_OBSERVABLE_KINETIC        4   // kinetic energy [eV] and temperature [K] (MD)
+#define STATE_OBSERVABLE_TIMING         8   // cpu and real time of the ionic step [s]
+#define STATE_OBSERVABLE_FORCES         16  // largest and RMS force [eV/A], also per element
+#define STATE_OBSERVABLE_ALL            31
+
+struct StateObservables {
+  unsigned int available;         // STATE_OBSERVABLE_* flags of the values that were found
+  double stress[6];               // xx, yy, zz, xy, yz, zx
+  double magnetization;
+  double kinetic_energy;
+  double temperature;
+  double cpu_time;
+  double real_time;
+  double max_force;                       // largest force norm
+  double rms_force;                       // root mean square force norm
+  std::vector<double> max_force_element;  // largest force norm per element
+
+  StateObservables();
+};
+
 class State {
 private:
   double energy;                  // energy of the system [eV]
@@ -39,11 +65,12 @@ private:
   std::vector<unsigned int> nr_atoms;
   std::string filename;
   unsigned int state_id_in_file;
+  StateObservables observables;
 
 public:
   State(
     const double &_energy,
-    const std::vector<float> &_dimensions,
+    const std::vector<Real> &_dimensions,
     const std::vector<Atom> &_atoms,
     const std::vector<std::string> &_elements,
     const std::vector<unsigned int> &_elements_uint,
@@ -54,7 +81,7 @@ public:
 
   State(
     const double &_energy,
-    const std::vector<float> &_dimensions
+    const std::vector<Real> &_dimensions
   );
 
   State(
@@ -67,21 +94,27 @@ public:
 
   std::vector<Atom> atoms;        // atoms in the unit cell
   Matrix3 dimensions;             // dimension of the unit cell [A]
-  MatrixX4f coordinates;           // 3xN matrix holding the atom positions
+  MatrixX4 coordinates;            // 3xN matrix holding the atom positions
 
   Vector3 get_center();
   const std::string& get_filename() const;
+  unsigned int get_state_id() const;
+  void set_state_id(unsigned int _id);
   unsigned int get_total_nr_atoms() const;
   unsigned int get_atoms_for_element(unsigned int i) const;
   unsigned int get_nr_elements() const;
   const double& get_energy() const;
-  std::vector<float> get_atom_position(unsigned int i) const;
+  const StateObservables& get_observables() const;
+  void set_observables(const StateObservables &_observables);
+  std::vector<Real> get_atom_position(unsigned int i) const;
+  MatrixX3 get_cartesian_coordinates() const;
   const std::vector<std::string>& get_elements() const;
+  const std::vector<unsigned int>& get_elements_uint() const;
+  const std::vector<unsigned int>& get_nr_atoms_per_element() const;
   void allocate_coordinate_matrix();
 
   std::string output_atoms_line();
-  std::string output_atom_coordinates();
-  void save_to_poscar(const char* filename, const char* name, bool is_vasp5);
+  bool save_to_poscar(const char* filename, const char* name, bool is_vasp5);
 
 private:
 
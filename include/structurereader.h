@@ -0,0 +1,80 @@
+/*************************************************************************
+ *
+ *  This file is part of v2c.
+ *
+ *  Author: Ivo Filot <i.a.w.filot@tue.nl>
+ *
+ *  v2c is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  v2c is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with v2c.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ************************************************************************/
+
+/*
+ * Readers for single structures: VASP POSCAR/CONTCAR files (VASP4 and VASP5
+ * style, Direct and Cartesian coordinates, selective dynamics) and CIF
+ * files. The files are read into memory as a whole and scanned with the
+ * Tokenizer. Every structure yields a State (energy 0) whose atoms are
+ * stored in blocks per element. Many files can be read concurrently on a
+ * ThreadPool.
+ *
+ * In a VASP4 POSCAR the element symbols are taken from the title line when
+ * it holds one symbol for every element; otherwise the elements are named
+ * X1, X2, ... . The CIF reader takes the cell from the cell parameters (a
+ * along x, b in the xy plane) and expands the asymmetric unit with the
+ * listed symmetry operations; coinciding images are merged by a lookup in
+ * a grid over the fractional coordinates. The sites of a file with only
+ * the identity operation (P1) are taken as they are.
+ */
+
+#ifndef _STRUCTUREREADER_H
+#define _STRUCTUREREADER_H
+
+#include <string>
+#include <vector>
+#include <iostream>
+
+#include "state.h"
+#include "tokenizer.h"
+#include "threadpool.h"
+
+#define STRUCTURE_FORMAT_UNKNOWN    0
+#define STRUCTURE_FORMAT_POSCAR     1
+#define STRUCTURE_FORMAT_CIF        2
+
+// sites of the same element closer than this (fractional) are merged
+#define STRUCTURE_CIF_SITE_TOLERANCE 1e-3
+
+class StructureReader {
+public:
+  StructureReader();
+
+  bool read(const std::string &filename, std::vector<State> &states,
+            unsigned int format = STRUCTURE_FORMAT_UNKNOWN) const;
+  unsigned int read_files(const std::vector<std::string> &filenames, std::vector<State> &states,
+                          ThreadPool &pool, unsigned int format = STRUCTURE_FORMAT_UNKNOWN) const;
+
+  static unsigned int detect_format(const std::string &filename);
+  static bool parse_symmetry_operation(const std::string &str, Eigen::Matrix3d &rotation,
+                                       Eigen::Vector3d &translation);
+
+private:
+  bool parse_poscar(Tokenizer &tokenizer, const std::string &filename, std::vector<State> &states) const;
+  bool parse_cif(Tokenizer &tokenizer, const std::string &filename, std::vector<State> &states) const;
+  bool build_cif_state(const std::vector<double> &cell_parameters,
+                       const std::vector<std::string> &site_elements,
+                       const std::vector<Eigen::Vector3d> &site_positions,
+                       const std::vector<std::string> &operations,
+                       const std::string &filename, unsigned int id, std::vector<State> &states) const;
+};
+
+#endif // _STRUCTUREREADER_H
@@ -0,0 +1,114 @@
+/*************************************************************************
+ *
+ *  This file is part of v2c.
+ *
+ *  Author: Ivo Filot <i.a.w.filot@tue.nl>
+ *
+ *  v2c is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  v2c is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with v2c.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ************************************************************************/
+
+
+/*
+ * Symmetry operations of a periodic structure in the setting of its unit
+ * cell. The lattice is first reduced, such that the rotations that leave
+ * the lattice invariant can be enumerated from short lattice vectors. For
+ * every lattice rotation, the translations that map the atoms onto atoms of
+ * the same element are searched with a hashed lookup of the fractional
+ * positions (a grid whose bins are at least the tolerance wide). The
+ * pure translations (present in centered cells and supercells) are found
+ * first; they form a group, such that per rotation only a single valid
+ * translation needs to be found.
+ *
+ * A cell with pure translations other than the identity is not primitive;
+ * primitive_cell gives the primitive cell with one atom of every set of
+ * translation-equivalent atoms, which has far fewer operations.
+ *
+ * From the operations follow the point group (classified by the number of
+ * rotations of every type), the crystal system and the asymmetric unit.
+ * The space group is described by its operations; the cell is not
+ * transformed to a standard setting, hence no Hermann-Mauguin symbol or
+ * number is assigned.
+ */
+
+#ifndef _SYMMETRY_H
+#define _SYMMETRY_H
+
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <cmath>
+
+#include "mathfunc.h"
+#include "state.h"
+
+#define SYMMETRY_DEFAULT_TOLERANCE 0.01   // [A]
+
+/*
+ * Fractional coordinates transform as x' = rotation * x + translation
+ */
+struct SymmetryOperation {
+  Eigen::Matrix3i rotation;
+  Eigen::Vector3d translation;      // in [0, 1)
+};
+
+class SymmetryFinder {
+private:
+  double tolerance;                                 // [A]
+  Eigen::Matrix3d lattice;                          // lattice vectors as rows
+  std::vector<Eigen::Vector3d> frac;                // wrapped fractional coordinates
+  std::vector<unsigned int> species;                // element block of every atom
+  std::vector<SymmetryOperation> operations;
+  std::vector<unsigned int> asymmetric_unit;        // representative atoms
+  std::vector<Eigen::Vector3d> translations;        // pure translations (incl. identity)
+  unsigned int nr_translations;
+  std::string point_group;
+
+  // position lookup: the atoms of bin b are bin_atoms[bin_start[b]] up to
+  // bin_atoms[bin_start[b+1]]
+  std::vector<unsigned int> bin_start;
+  std::vector<unsigned int> bin_atoms;
+  int nr_bins[3];
+  double margin[3];                                 // tolerance in fractional units
+
+public:
+  SymmetryFinder(double _tolerance = SYMMETRY_DEFAULT_TOLERANCE);
+
+  bool analyse(const State &state);
+
+  const std::vector<SymmetryOperation>& get_operations() const;
+  const std::vector<unsigned int>& get_asymmetric_unit() const;
+  unsigned int get_nr_translations() const;
+  const std::string& get_point_group() const;
+  std::string get_crystal_system() const;
+
+  bool primitive_cell(const State &state, State &primitive) const;
+
+  static std::string format_operation(const SymmetryOperation &op);
+
+private:
+  static Eigen::Matrix3d reduce_lattice(const Eigen::Matrix3d &lattice);
+  std::vector<Eigen::Matrix3i> find_lattice_rotations() const;
+
+  void build_lookup();
+  unsigned int get_bin(const Eigen::Vector3d &f, int *bin) const;
+  int find_atom(const Eigen::Vector3d &f, unsigned int element) const;
+  bool is_symmetry(const Eigen::Matrix3i &rotation, const Eigen::Vector3d &translation) const;
+
+  void find_translations(unsigned int reference, const std::vector<unsigned int> &candidates);
+  void find_asymmetric_unit();
+  void classify_point_group();
+};
+
+#endif // _SYMMETRY_H
@@ -0,0 +1,64 @@
+/*************************************************************************
+ *
+ *  This file is part of v2c.
+ *
+ *  Author: Ivo Filot <i.a.w.filot@tue.nl>
+ *
+ *  v2c is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  v2c is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with v2c.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ************************************************************************/
+
+/*
+ * Fixed-size pool of worker threads. Every task receives the index of the
+ * worker that executes it (0 <= index < get_nr_threads()), which allows the
+ * caller to keep per-worker (thread-local) accumulators that are reduced
+ * after the work has finished, without any locking inside the tasks.
+ */
+
+#ifndef _THREADPOOL_H
+#define _THREADPOOL_H
+
+#include <vector>
+#include <queue>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+class ThreadPool {
+private:
+  std::vector<std::thread> workers;
+  std::queue<std::function<void(unsigned int)> > tasks;
+  std::mutex mtx;
+  std::condition_variable cv_task;      // signals workers that a task is available
+  std::condition_variable cv_done;      // signals waiters that a task has finished
+  unsigned int nr_active;
+  bool stop;
+
+public:
+  ThreadPool(unsigned int nr_threads = 0);
+  ~ThreadPool();
+
+  unsigned int get_nr_threads() const;
+
+  void submit(const std::function<void(unsigned int)> &task);
+  void wait();
+  void wait_for_slot(size_t max_pending);
+  void parallel_for(size_t n, const std::function<void(size_t, unsigned int)> &func);
+
+private:
+  void run(unsigned int worker);
+};
+
+#endif // _THREADPOOL_H
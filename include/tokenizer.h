@@ -0,0 +1,80 @@
+/*************************************************************************
+ *
+ *  This file is part of v2c.
+ *
+ *  Author: Ivo Filot <i.a.w.filot@tue.nl>
+ *
+ *  v2c is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  v2c is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with v2c.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ************************************************************************/
+
+/*
+ * Line and whitespace tokenizer over a file that has been read into memory
+ * as a whole. Tokens are views into the buffer, such that no strings are
+ * allocated while scanning; numbers are converted directly from the
+ * buffer. Quoted tokens ('...' or "...", as used in CIF files) are returned
+ * without their quotes.
+ */
+
+#ifndef _TOKENIZER_H
+#define _TOKENIZER_H
+
+#include <string>
+#include <vector>
+#include <stdio.h>
+
+struct Token {
+  const char *begin;
+  const char *end;
+
+  size_t size() const {
+    return this->end - this->begin;
+  }
+
+  std::string str() const {
+    return std::string(this->begin, this->end);
+  }
+
+  bool equals(const char *str) const;
+  bool starts_with_nocase(const char *str) const;
+};
+
+class Tokenizer {
+private:
+  const char *ptr;          // start of the next line
+  const char *end;
+  const char *line_begin;   // current line
+  const char *line_end;
+  const char *cursor;       // next token on the current line
+  unsigned int line_number;
+
+public:
+  Tokenizer(const char *_begin, const char *_end);
+
+  bool next_line();
+  bool next_token(Token *token);
+  bool next_double(double *value);
+  bool next_int(long *value);
+  bool peek_token(Token *token) const;
+
+  Token get_line() const;
+  unsigned int get_line_number() const;
+  bool at_end() const;
+
+  static bool to_double(const Token &token, double *value);
+  static bool to_int(const Token &token, long *value);
+  static bool read_file(const std::string &filename, std::vector<char> &buffer);
+};
+
+#endif // _TOKENIZER_H
@@ -0,0 +1,106 @@
+/*************************************************************************
+ *
+ *  This file is part of v2c.
+ *
+ *  Author: Ivo Filot <i.a.w.filot@tue.nl>
+ *
+ *  v2c is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  v2c is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with v2c.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ************************************************************************/
+
+/*
+ * A Trajectory holds the per-frame quantities of a series of States in
+ * contiguous, frame-major arrays (i.e. [frames x atoms x 3] for positions and
+ * forces, [frames x 3 x 3] for the unit cells). This is the layout in which
+ * the data is handed to the columnar writers and to the analysis routines.
+ * An atom-major copy ([atoms x frames x 3]) can be produced on request by a
+ * cache-blocked transpose.
+ *
+ * The frames of a FrameStore with a memory budget can be taken in blocks
+ * (see frames_per_block), such that the arrays of the whole trajectory never
+ * need to be in memory at once.
+ */
+
+#ifndef _TRAJECTORY_H
+#define _TRAJECTORY_H
+
+#include <vector>
+#include <string>
+#include <iostream>
+#include <algorithm>
+
+#include "state.h"
+#include "framestore.h"
+#include "npywriter.h"
+#include "npyreader.h"
+
+/*
+ * Edge length (in atoms and in frames) of the tiles used by the blocked
+ * transpose. A tile of 64 x 64 xyz-triplets (48 kB) fits comfortably in L2.
+ */
+#define TRAJECTORY_TRANSPOSE_BLOCK 64
+
+class Trajectory {
+private:
+  unsigned int nr_atoms;
+  unsigned int nr_frames;
+  std::vector<float> positions;         // frames x atoms x 3 [A]
+  std::vector<float> forces;            // frames x atoms x 3 [eV/A]
+  std::vector<double> energies;         // frames [eV]
+  std::vector<float> cells;             // frames x 3 x 3 [A], lattice vectors as rows
+  std::vector<unsigned int> species;    // atoms, element number of each atom
+  std::vector<std::string> elements;
+  std::vector<unsigned int> nr_atoms_per_elm;
+
+public:
+  Trajectory();
+  Trajectory(const std::vector<State> &_states);
+  Trajectory(const FrameStore &_states);
+
+  bool append(const State &_state);
+  bool append(const FrameStore &_states, size_t first, size_t count);
+  void clear();
+
+  unsigned int get_nr_frames() const;
+  unsigned int get_nr_atoms() const;
+  const std::vector<std::string>& get_elements() const;
+  const std::vector<unsigned int>& get_nr_atoms_per_element() const;
+  const std::vector<unsigned int>& get_species() const;
+
+  const float* get_positions() const;
+  const float* get_positions(unsigned int frame) const;
+  const float* get_forces() const;
+  const float* get_forces(unsigned int frame) const;
+  const double* get_energies() const;
+  const float* get_cells() const;
+  const float* get_cell(unsigned int frame) const;
+
+  void wrap();
+  void unwrap();
+
+  std::vector<float> get_positions_atom_major() const;
+  std::vector<float> get_forces_atom_major() const;
+
+  bool save_to_npy(const std::string &prefix, bool atom_major);
+  bool save_to_npy(const FrameStore &_states, const std::string &prefix, size_t memory_budget, bool wrap);
+  bool save_to_npz(const std::string &filename, bool atom_major);
+  bool load_from_npy(const std::string &prefix);
+
+  static size_t frames_per_block(size_t memory_budget, unsigned int nr_atoms);
+
+private:
+  void transpose_blocked(const std::vector<float> &src, std::vector<float> &dest) const;
+};
+
+#endif // _TRAJECTORY_H
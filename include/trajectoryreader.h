@@ -0,0 +1,106 @@
+/*************************************************************************
+ *
+ *  This file is part of v2c.
+ *
+ *  Author: Ivo Filot <i.a.w.filot@tue.nl>
+ *
+ *  v2c is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  v2c is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with v2c.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ************************************************************************/
+
+
+/*
+ * Reader for a trajectory that is split over several OUTCARs, such as the
+ * pieces of a long molecular dynamics run that was restarted (OUTCAR_1,
+ * OUTCAR_2, ...). The pieces need to hold the same elements with the same
+ * numbers of atoms. Their frames are numbered globally and handed out as
+ * one continuous stream, through a callback and/or the states store, just
+ * as VaspReader does for a single file.
+ *
+ * A piece that continues from the last frame of the previous piece starts
+ * with that same structure; this duplicated seam frame is detected by
+ * comparing the positions (within the seam tolerance, taking the periodic
+ * boundaries into account) and dropped.
+ *
+ * With more than one thread, the pieces are read in parallel in batches of
+ * one piece per thread; the frames of a batch are handed out in order once
+ * the batch has been read. The pieces of a batch share the memory budget,
+ * hence they add at most the budget to the frames that are kept. With a
+ * single thread, every piece is streamed and no frames are held unless they
+ * are kept.
+ *
+ * An atom selection is applied to all pieces alike: a first-frame z-window
+ * is resolved on the first frame of the first piece, anew for every read.
+ */
+
+#ifndef _TRAJECTORYREADER_H
+#define _TRAJECTORYREADER_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <iostream>
+#include <functional>
+
+#include "vaspreader.h"
+#include "threadpool.h"
+
+#define TRAJECTORY_READER_SEAM_TOLERANCE 1e-3   // [A], OUTCARs hold the positions with five decimals
+
+class TrajectoryReader {
+private:
+  double seam_tolerance;
+  std::function<void(const State&)> state_callback;
+  bool keep_states;
+  unsigned int observables_mask;
+  AtomSelection selection;
+  size_t memory_budget;
+  std::string spill_directory;
+
+  std::vector<std::string> elements;
+  std::vector<unsigned int> nr_atoms_per_elm;
+  bool consistent;                    // all pieces so far hold the same atoms
+  unsigned int nr_frames;             // frames handed out
+  unsigned int nr_seams;              // duplicated seam frames dropped
+  MatrixX3 last_positions;            // of the last frame handed out
+  Matrix3 last_cell;
+
+public:
+  TrajectoryReader(double _seam_tolerance = TRAJECTORY_READER_SEAM_TOLERANCE);
+
+  bool read(const std::vector<std::string> &files, unsigned int nr_threads = 0);
+  void clear();
+  void set_state_callback(const std::function<void(const State&)> &_callback, bool _keep_states);
+  void set_observables(unsigned int _mask);
+  void set_selection(const AtomSelection &_selection);
+  void set_memory_budget(size_t _bytes, const std::string &_directory = "");
+
+  unsigned int get_nr_frames() const;
+  unsigned int get_nr_seams() const;
+  const std::vector<std::string>& get_elements() const;
+
+  static std::vector<std::string> split_pieces(const std::string &argument);
+
+  FrameStore states;
+
+private:
+  TrajectoryReader(const TrajectoryReader&);
+  TrajectoryReader& operator=(const TrajectoryReader&);
+
+  bool read_piece(const std::string &filename, AtomSelection &_selection);
+  void add_frame(const State &state, bool first_of_piece);
+  bool is_seam(const State &state) const;
+};
+
+#endif // _TRAJECTORYREADER_H
@@ -39,12 +39,17 @@
 #include <iostream>
 #include <vector>
 #include <sstream>
+#include <functional>
+#include <algorithm>
+#include <cmath>
 #include <pcre.h>
 
 #include "lexical_casts.h"
 #include "atom.h"
 #include "state.h"
+#include "framestore.h"
 #include "atom_constants.h"
+#include "atomselection.h"
 
 /*
  * The program has several operational states, in short called state. These
@@ -60,10 +65,54 @@
 #define VASP_OUTCAR_READ_STATE_OPEN 5
 #define VASP_OUTCAR_READ_STATE_FINISHED 6
 
+/*
+ * Layouts of the ionic steps in an OUTCAR; each has its own frame parser,
+ * except VASP 6, which is an alias of the VASP 5 layout
+ */
+#define VASP_OUTCAR_LAYOUT_UNKNOWN 0
+#define VASP_OUTCAR_LAYOUT_VASP4 4
+#define VASP_OUTCAR_LAYOUT_VASP5 5
+#define VASP_OUTCAR_LAYOUT_VASP6 6
+#define VASP_OUTCAR_LAYOUT_ML_FF 7
+
+/*
+ * Kinds of damage found while reading an OUTCAR; the damaged ionic step is
+ * left out of the states
+ */
+#define VASP_OUTCAR_DIAGNOSTIC_INCOMPLETE_POSITIONS 1   // fewer atoms than "ions per type"
+#define VASP_OUTCAR_DIAGNOSTIC_MISSING_ENERGY 2         // positions without an energy
+#define VASP_OUTCAR_DIAGNOSTIC_MISSING_POSITIONS 3      // energy without positions
+#define VASP_OUTCAR_DIAGNOSTIC_TRUNCATED 4              // file ends within an ionic step
+
+struct OutcarDiagnostic {
+  unsigned int type;              // one of VASP_OUTCAR_DIAGNOSTIC_*
+  size_t line;                    // line at which the damage was detected
+  unsigned int nr_states;         // number of states read before the damage
+  std::string message;
+};
+
+struct OutcarPatterns;
+
+/*
+ * Everything needed to continue parsing an OUTCAR after the last complete
+ * state, e.g. when more ionic steps have been appended to the file
+ */
+struct OutcarCheckpoint {
+  std::streamoff offset;          // byte offset just after the last complete state
+  unsigned int vasp_version;
+  unsigned int layout;            // one of VASP_OUTCAR_LAYOUT_*
+  std::vector<std::string> elements;
+  std::vector<unsigned int> nr_atoms_per_elm;
+  std::vector<Real> dimensions;
+  unsigned int nr_states;
+  unsigned int nr_energies;
+};
 
 class VaspReader {
 private:
   unsigned int vasp_version;
+  unsigned int layout;            // layout of the ionic steps
+  bool ml_ff;                     // machine-learned force field enabled
   unsigned int state;   // read state
   std::vector<unsigned int> nr_atoms_per_elm;
   unsigned int nr_atoms_total;
@@ -71,22 +120,64 @@ private:
   std::vector<unsigned int> elements_uint;
   unsigned int nr_states;
   std::vector<Atom> atoms;
-  std::vector<float> dimensions;
+  std::vector<Real> dimensions;
   std::vector<double> energies;
+  std::function<void(const State&)> state_callback;
+  bool keep_states;
+  unsigned int observables_mask;              // STATE_OBSERVABLE_* flags to collect
+  StateObservables pending_observables;       // quantities of the current ionic step
+  MatrixX3 forces;                            // forces of the current ionic step, one column per direction
+  Eigen::Array<Real, Eigen::Dynamic, 1> force_norms; // squared force norms of the current ionic step
+  std::vector<char> excluded_atoms;           // atoms left out of the force statistics
+  AtomSelection selection;                    // atoms kept in the states
+  std::vector<unsigned int> atom_indices;     // index in the POSITION block of every kept atom
+  std::vector<std::string> frame_elements;    // elements of the kept atoms of the current step
+  std::vector<unsigned int> frame_elements_uint;
+  std::vector<unsigned int> frame_atoms_per_elm;
+  std::streamoff checkpoint_offset;
+  unsigned int checkpoint_nr_states;
+  unsigned int checkpoint_nr_energies;
+  size_t line_number;                         // lines read since the start (or resume offset)
+  std::vector<OutcarDiagnostic> diagnostics;
 
 public:
   VaspReader();
   bool read(const char*);
+  bool read(std::istream &infile, const char* filename);
+  bool resume(const char* filename, const OutcarCheckpoint &checkpoint);
+  OutcarCheckpoint get_checkpoint() const;
   void clear(); //removes all information from VaspReader
+  void set_state_callback(const std::function<void(const State&)> &_callback, bool _keep_states);
+  void set_observables(unsigned int _mask);
+  void set_excluded_atoms(const std::vector<char> &_excluded);
+  void set_selection(const AtomSelection &_selection);
+  const AtomSelection& get_selection() const;
+  void set_memory_budget(size_t _bytes, const std::string &_directory = "");
 
   const unsigned int& get_number_of_states() const;
   const std::vector<std::string>& get_elements() const;
+  const std::vector<OutcarDiagnostic>& get_diagnostics() const;
+
+  static unsigned int get_element_number_from_name(const std::string &name);
 
-  std::vector<State> states;
+  FrameStore states;
 
 private:
+  bool parse(const char* filename, std::streamoff offset);
+  bool parse(std::istream &infile, const char* filename, std::streamoff offset);
+  unsigned int select_layout(const char* filename) const;
+  template<unsigned int layout>
+  void parse_frames(std::istream &infile, const char* filename, const OutcarPatterns &patterns);
+  unsigned int read_positions(std::istream &infile, std::string &line, const OutcarPatterns &patterns, int *ovector);
+  void reduce_forces();
+  bool read_line(std::istream &infile, std::string &line);
+  void pair_frame(double energy);
+  void discard_frame();
+  void report(unsigned int type, const std::string &message);
+  void finish_frame(std::istream &infile, const char* filename);
+  bool match_observables(const std::string &line, const OutcarPatterns &patterns, int *ovector);
+  void store_state(const char* filename);
   std::vector<std::string> explode(std::string const & s, std::string delim);
-  unsigned int get_element_number_from_name(const std::string &name);
 };
 
 #endif // _VASPREADER_H
@@ -0,0 +1,214 @@
+/*************************************************************************
+ *
+ *  This file is part of v2c.
+ *
+ *  Author: Ivo Filot <i.a.w.filot@tue.nl>
+ *
+ *  v2c is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  v2c is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with v2c.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ************************************************************************/
+
+
+#include "adsorption.h"
+
+/*
+ * Constructor; <_tolerance> is the largest relative difference between the
+ * bonds to the atoms of one site
+ */
+AdsorptionAnalysis::AdsorptionAnalysis(double _tolerance) {
+    this->tolerance = _tolerance;
+}
+
+/*
+ * Find the site and the coordination number of every adsorbate of <state>
+ */
+std::vector<AdsorbateSite> AdsorptionAnalysis::analyse(const State &state) const {
+    std::vector<AdsorbateSite> result;
+
+    std::vector<unsigned int> adsorbates;
+    std::vector<unsigned int> substrate;
+    std::vector<float> coordinates;
+    std::vector<unsigned int> adsorbate_elnrs;
+    std::vector<unsigned int> substrate_elnrs;
+    for(unsigned int i=0; i<state.atoms.size(); i++) {
+        const unsigned int elnr = state.atoms[i].elnr;
+        if(is_adsorbate(elnr)) {
+            adsorbates.push_back(i);
+            if(std::find(adsorbate_elnrs.begin(), adsorbate_elnrs.end(), elnr) == adsorbate_elnrs.end()) {
+                adsorbate_elnrs.push_back(elnr);
+            }
+        } else {
+            substrate.push_back(i);
+            for(unsigned int k=0; k<3; k++) {
+                coordinates.push_back(state.atoms[i].pos(k));
+            }
+            if(std::find(substrate_elnrs.begin(), substrate_elnrs.end(), elnr) == substrate_elnrs.end()) {
+                substrate_elnrs.push_back(elnr);
+            }
+        }
+    }
+    if(adsorbates.empty()) {
+        return result;
+    }
+
+    // only adsorbate-substrate pairs are searched, hence the cell list
+    // holds the substrate atoms only
+    double range = ADSORPTION_SUBSURFACE_RANGE;
+    for(unsigned int a=0; a<adsorbate_elnrs.size(); a++) {
+        for(unsigned int s=0; s<substrate_elnrs.size(); s++) {
+            range = std::max(range, (double)get_cutoff(adsorbate_elnrs[a], substrate_elnrs[s]));
+        }
+    }
+    CellList cells(state.dimensions, range);
+    if(!substrate.empty()) {
+        cells.build(&coordinates[0], &coordinates[1], &coordinates[2], substrate.size(), 3);
+    }
+
+    std::vector<std::pair<unsigned int, Eigen::Vector3d> > neighbors;     // substrate atom, vector
+    std::vector<unsigned int> bonded;
+    for(unsigned int a=0; a<adsorbates.size(); a++) {
+        const Atom &atom = state.atoms[adsorbates[a]];
+        AdsorbateSite site;
+        site.atom = adsorbates[a];
+        site.site = ADSORPTION_SITE_NONE;
+        site.coordination = 0;
+        site.height = 0.0f;
+
+        neighbors.clear();
+        bonded.clear();
+        if(!substrate.empty()) {
+            cells.for_each_neighbor(atom.pos.cast<double>(), [&](unsigned int j, double r2, double dx, double dy, double dz) {
+                neighbors.push_back(std::make_pair(substrate[j], Eigen::Vector3d(dx, dy, dz)));
+            });
+        }
+
+        double shortest = range;
+        for(unsigned int n=0; n<neighbors.size(); n++) {
+            const double r = neighbors[n].second.norm();
+            if(r < get_cutoff(atom.elnr, state.atoms[neighbors[n].first].elnr)) {
+                bonded.push_back(n);
+                shortest = std::min(shortest, r);
+            }
+        }
+        site.coordination = bonded.size();
+
+        // the atoms of the site and its center, relative to the adsorbate
+        std::vector<unsigned int> members;
+        Eigen::Vector3d center = Eigen::Vector3d::Zero();
+        for(unsigned int b=0; b<bonded.size(); b++) {
+            if(neighbors[bonded[b]].second.norm() <= shortest * (1.0 + this->tolerance)) {
+                members.push_back(bonded[b]);
+                center += neighbors[bonded[b]].second;
+            }
+        }
+
+        switch(members.size()) {
+            case 0:
+                break;
+            case 1:
+                site.site = ADSORPTION_SITE_TOP;
+                break;
+            case 2:
+                site.site = ADSORPTION_SITE_BRIDGE;
+                break;
+            case 3:
+                site.site = ADSORPTION_SITE_FCC;
+                break;
+            case 4:
+                site.site = ADSORPTION_SITE_FOURFOLD;
+                break;
+            default:
+                site.site = ADSORPTION_SITE_MULTIFOLD;
+                break;
+        }
+        if(members.empty()) {
+            result.push_back(site);
+            continue;
+        }
+        center /= (double)members.size();
+        site.height = center.norm();
+
+        // an hcp hollow has a second-layer atom below its center, whereas the
+        // nearest second-layer atoms of an fcc hollow are a third of a
+        // nearest neighbor distance away from the axis through the center
+        if(site.site == ADSORPTION_SITE_FCC && site.height > 0.0f) {
+            const Eigen::Vector3d down = center / center.norm();
+            const double spacing = ((neighbors[members[0]].second - neighbors[members[1]].second).norm() +
+                                    (neighbors[members[0]].second - neighbors[members[2]].second).norm() +
+                                    (neighbors[members[1]].second - neighbors[members[2]].second).norm()) / 3.0;
+            const double max_offset = spacing / (2.0 * std::sqrt(3.0));
+            for(unsigned int n=0; n<neighbors.size(); n++) {
+                const Eigen::Vector3d v = neighbors[n].second - center;
+                const double axial = v.dot(down);
+                if(axial > max_offset && axial < 1.5 * spacing && (v - axial * down).norm() < max_offset) {
+                    site.site = ADSORPTION_SITE_HCP;
+                    break;
+                }
+            }
+        }
+
+        result.push_back(site);
+    }
+
+    return result;
+}
+
+/*
+ * Append a line per adsorbate of <state> to <buffer>: <label>, atom number
+ * (1-based), element, site, coordination number and height
+ */
+void AdsorptionAnalysis::format(const State &state, const std::string &label, std::string &buffer) const {
+    const std::vector<AdsorbateSite> sites = this->analyse(state);
+
+    // element of every atom from the blocks per element
+    std::vector<unsigned int> element(state.atoms.size(), 0);
+    unsigned int atom = 0;
+    for(unsigned int e=0; e<state.get_nr_elements(); e++) {
+        for(unsigned int i=0; i<state.get_atoms_for_element(e) && atom<element.size(); i++, atom++) {
+            element[atom] = e;
+        }
+    }
+
+    char line[160];
+    for(unsigned int s=0; s<sites.size(); s++) {
+        const AdsorbateSite &site = sites[s];
+        const std::string name = element[site.atom] < state.get_nr_elements() ? state.get_elements()[element[site.atom]] : "?";
+        snprintf(line, sizeof(line), "  %5u  %-3s  %-7s  %2u  %7.4f\n", site.atom + 1, name.c_str(),
+                 get_site_name(site.site), site.coordination, site.height);
+        buffer += label;
+        buffer += line;
+    }
+}
+
+/*
+ * The adsorbates are the H, C, N and O atoms; all other atoms belong to the
+ * substrate
+ */
+bool AdsorptionAnalysis::is_adsorbate(unsigned int elnr) {
+    return elnr == ATOM_H || elnr == ATOM_C || elnr == ATOM_N || elnr == ATOM_O;
+}
+
+const char* AdsorptionAnalysis::get_site_name(unsigned int site) {
+    static const char *names[7] = {"none", "top", "bridge", "fcc", "hcp", "4-fold", "n-fold"};
+    return site < 7 ? names[site] : "?";
+}
+
+/*
+ * Bonding distance of an adsorbate-substrate pair; pairs for which
+ * atom_constants.h defines no distance get ADSORPTION_DEFAULT_CUTOFF
+ */
+float AdsorptionAnalysis::get_cutoff(unsigned int elnr1, unsigned int elnr2) {
+    const float cutoff = get_bond_cutoff(elnr1, elnr2);
+    return cutoff > 0.0f ? cutoff : ADSORPTION_DEFAULT_CUTOFF;
+}
@@ -35,9 +35,9 @@ Atom::Atom() {
  *
  */
 Atom::Atom(const unsigned int &_an,   // element (i.e. # of protons)
-         const float &_x,             // x position in [A]
-         const float &_y,             // y position in [A]
-         const float &_z) {           // z position in [A]
+         const Real &_x,              // x position in [A]
+         const Real &_y,              // y position in [A]
+         const Real &_z) {            // z position in [A]
   this->init(_an, _x, _y, _z, 0.0f, 0.0f, 0.0f);
 }
 
@@ -48,12 +48,12 @@ Atom::Atom(const unsigned int &_an,   // element (i.e. # of protons)
  *
  */
 Atom::Atom(const unsigned int &_an,   // element (i.e. # of protons)
-         const float &_x,             // x position in [A]
-         const float &_y,             // y position in [A]
-         const float &_z,            // z position in [A]
-         const float &_fx,           // x force in [eV/A]
-         const float &_fy,           // y force in [eV/A]
-         const float &_fz) {         // z force in [eV/A]
+         const Real &_x,              // x position in [A]
+         const Real &_y,              // y position in [A]
+         const Real &_z,             // z position in [A]
+         const Real &_fx,            // x force in [eV/A]
+         const Real &_fy,            // y force in [eV/A]
+         const Real &_fz) {          // z force in [eV/A]
   this->init(_an, _x, _y, _z, _fx, _fy, _fz);
 
 }
@@ -64,9 +64,9 @@ Atom::Atom(const unsigned int &_an,   // element (i.e. # of protons)
  * Modify the forces on the atom
  *
  */
-void Atom::set_force(const float &_fx,           // x force in [eV/A]
-                     const float &_fy,           // y force in [eV/A]
-                     const float &_fz) {         // z force in [eV/A]
+void Atom::set_force(const Real &_fx,            // x force in [eV/A]
+                     const Real &_fy,            // y force in [eV/A]
+                     const Real &_fz) {          // z force in [eV/A]
   this->force = Vector3(_fx, _fy, _fz);
 }
 
@@ -76,7 +76,7 @@ void Atom::set_force(const float &_fx,           // x force in [eV/A]
  * return the x position
  *
  */
-const float Atom::get_x() const {
+const Real Atom::get_x() const {
   return this->pos(0);
 }
 
@@ -86,7 +86,7 @@ const float Atom::get_x() const {
  * return the y position
  *
  */
-const float Atom::get_y() const {
+const Real Atom::get_y() const {
   return this->pos(1);
 }
 
@@ -96,7 +96,7 @@ const float Atom::get_y() const {
  * return the z position
  *
  */
-const float Atom::get_z() const {
+const Real Atom::get_z() const {
   return this->pos(2);
 }
 
@@ -107,12 +107,12 @@ const float Atom::get_z() const {
  *
  */
 void Atom::init(const unsigned int &_an,    // element (i.e. # of protons)
-                           const float &_x,            // x position in [A]
-                           const float &_y,            // y position in [A]
-                           const float &_z,            // z position in [A]
-                           const float &_fx,           // x force in [eV/A]
-                           const float &_fy,           // y force in [eV/A]
-                           const float &_fz) {         // z force in [eV/A]
+                           const Real &_x,             // x position in [A]
+                           const Real &_y,             // y position in [A]
+                           const Real &_z,             // z position in [A]
+                           const Real &_fx,            // x force in [eV/A]
+                           const Real &_fy,            // y force in [eV/A]
+                           const Real &_fz) {          // z force in [eV/A]
   this->elnr = _an;
   this->pos = Vector3(_x, _y, _z);
   this->force = Vector3(_fx, _fy, _fz);
@@ -0,0 +1,165 @@
+/*************************************************************************
+ *
+ *  This file is part of v2c.
+ *
+ *  Author: Ivo Filot <i.a.w.filot@tue.nl>
+ *
+ *  v2c is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  v2c is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with v2c.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ************************************************************************/
+
+
+#include "atomselection.h"
+
+#include <stdlib.h>
+#include <ctype.h>
+
+AtomSelection::AtomSelection() {
+    this->clear();
+}
+
+/*
+ * Parse the selection <spec> (see the header); prints a message and returns
+ * false for an invalid term
+ */
+bool AtomSelection::parse(const std::string &spec) {
+    this->clear();
+
+    size_t start = 0;
+    while(start <= spec.size()) {
+        size_t end = spec.find(',', start);
+        if(end == std::string::npos) {
+            end = spec.size();
+        }
+        const std::string term = spec.substr(start, end - start);
+        start = end + 1;
+        if(term.empty()) {
+            continue;
+        }
+
+        if(term.compare(0, 2, "z=") == 0 || term.compare(0, 7, "zframe=") == 0) {
+            const size_t eq = term.find('=');
+            const size_t colon = term.find(':', eq);
+            char *endptr = NULL;
+            if(colon != std::string::npos) {
+                this->z_min = strtof(term.c_str() + eq + 1, &endptr);
+            }
+            if(colon == std::string::npos || endptr != term.c_str() + colon) {
+                std::cerr << "Invalid z-window in selection: " << term << std::endl;
+                return false;
+            }
+            this->z_max = strtof(term.c_str() + colon + 1, &endptr);
+            if(*endptr != '\0' || colon + 1 == term.size() || this->z_max < this->z_min) {
+                std::cerr << "Invalid z-window in selection: " << term << std::endl;
+                return false;
+            }
+            this->z_mode = term[1] == '=' ? ATOM_SELECTION_Z_FIRST_FRAME : ATOM_SELECTION_Z_PER_FRAME;
+        } else if(isdigit((unsigned char)term[0])) {
+            char *endptr = NULL;
+            const long first = strtol(term.c_str(), &endptr, 10);
+            long last = first;
+            if(*endptr == '-') {
+                last = strtol(endptr + 1, &endptr, 10);
+            }
+            if(*endptr != '\0' || first < 1 || last < first) {
+                std::cerr << "Invalid index range in selection: " << term << std::endl;
+                return false;
+            }
+            this->range_begin.push_back(first - 1);
+            this->range_end.push_back(last);
+        } else if(isalpha((unsigned char)term[0])) {
+            this->elements.push_back(term);
+        } else {
+            std::cerr << "Invalid term in selection: " << term << std::endl;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/*
+ * Select all atoms
+ */
+void AtomSelection::clear() {
+    this->elements.clear();
+    this->range_begin.clear();
+    this->range_end.clear();
+    this->z_mode = ATOM_SELECTION_Z_NONE;
+    this->z_min = 0.0f;
+    this->z_max = 0.0f;
+    this->resolved = false;
+    this->mask.clear();
+}
+
+/*
+ * Whether any term restricts the selection
+ */
+bool AtomSelection::is_active() const {
+    return !this->elements.empty() || !this->range_begin.empty() || this->z_mode != ATOM_SELECTION_Z_NONE;
+}
+
+bool AtomSelection::is_resolved() const {
+    return this->resolved;
+}
+
+/*
+ * Whether the mask can only be resolved on the positions of the first frame
+ */
+bool AtomSelection::needs_positions() const {
+    return this->z_mode == ATOM_SELECTION_Z_FIRST_FRAME && !this->resolved;
+}
+
+/*
+ * Whether the z-window is applied to every frame on top of the mask
+ */
+bool AtomSelection::is_per_frame() const {
+    return this->z_mode == ATOM_SELECTION_Z_PER_FRAME;
+}
+
+/*
+ * Resolve the elements, index ranges and the first-frame z-window into the
+ * mask, for atoms ordered in blocks of <_elements> with <nr_atoms_per_elm>
+ * atoms each; <atoms> holds the first frame when its positions are needed
+ */
+void AtomSelection::resolve(const std::vector<std::string> &_elements, const std::vector<unsigned int> &nr_atoms_per_elm,
+                            const std::vector<Atom> &atoms) {
+    unsigned int nr_atoms = 0;
+    for(unsigned int i=0; i<nr_atoms_per_elm.size(); i++) {
+        nr_atoms += nr_atoms_per_elm[i];
+    }
+    this->mask.assign(nr_atoms, 1);
+
+    unsigned int index = 0;
+    for(unsigned int i=0; i<nr_atoms_per_elm.size(); i++) {
+        bool element = this->elements.empty();
+        for(unsigned int e=0; e<this->elements.size() && i < _elements.size(); e++) {
+            element |= this->elements[e] == _elements[i];
+        }
+
+        for(unsigned int j=0; j<nr_atoms_per_elm[i]; j++, index++) {
+            bool range = this->range_begin.empty();
+            for(unsigned int r=0; r<this->range_begin.size(); r++) {
+                range |= index >= this->range_begin[r] && index < this->range_end[r];
+            }
+            bool window = true;
+            if(this->z_mode == ATOM_SELECTION_Z_FIRST_FRAME) {
+                window = index < atoms.size() && this->in_window(atoms[index].pos(2));
+            }
+            this->mask[index] = element && range && window;
+        }
+    }
+
+    this->resolved = true;
+}
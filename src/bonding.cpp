@@ -0,0 +1,67 @@
+/*************************************************************************
+ *
+ *  This file is part of v2c.
+ *
+ *  Author: Ivo Filot <i.a.w.filot@tue.nl>
+ *
+ *  v2c is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  v2c is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with v2c.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ************************************************************************/
+
+#include "bonding.h"
+
+/*
+ * Returns the bonding cutoff [A] for a pair of elements (given by their
+ * atom numbers), or 0 when no cutoff is defined for the pair
+ */
+float get_bond_cutoff(unsigned int elnr1, unsigned int elnr2) {
+    if(elnr1 > elnr2) {
+        unsigned int tmp = elnr1;
+        elnr1 = elnr2;
+        elnr2 = tmp;
+    }
+
+    if(elnr1 == ATOM_RH && elnr2 == ATOM_RH) return ATOM_DISTANCE_RH_RH;
+    if(elnr1 == ATOM_O && elnr2 == ATOM_RH) return ATOM_DISTANCE_RH_O;
+    if(elnr1 == ATOM_C && elnr2 == ATOM_RH) return ATOM_DISTANCE_RH_C;
+    if(elnr1 == ATOM_H && elnr2 == ATOM_RH) return ATOM_DISTANCE_RH_H;
+    if(elnr1 == ATOM_FE && elnr2 == ATOM_RH) return ATOM_DISTANCE_RH_FE;
+    if(elnr1 == ATOM_FE && elnr2 == ATOM_FE) return ATOM_DISTANCE_FE_FE;
+    if(elnr1 == ATOM_C && elnr2 == ATOM_FE) return ATOM_DISTANCE_FE_C;
+    if(elnr1 == ATOM_C && elnr2 == ATOM_O) return ATOM_DISTANCE_O_C;
+    if(elnr1 == ATOM_H && elnr2 == ATOM_O) return ATOM_DISTANCE_O_H;
+    if(elnr1 == ATOM_C && elnr2 == ATOM_N) return ATOM_DISTANCE_N_C;
+    if(elnr1 == ATOM_H && elnr2 == ATOM_N) return ATOM_DISTANCE_N_H;
+    if(elnr1 == ATOM_C && elnr2 == ATOM_C) return ATOM_DISTANCE_C_C;
+    if(elnr1 == ATOM_H && elnr2 == ATOM_C) return ATOM_DISTANCE_C_H;
+
+    return 0.0f;
+}
+
+/*
+ * Returns the largest bonding cutoff [A] among all pairs of the given
+ * elements
+ */
+float get_max_bond_cutoff(const std::vector<unsigned int> &elnrs) {
+    float result = 0.0f;
+    for(unsigned int i=0; i<elnrs.size(); i++) {
+        for(unsigned int j=i; j<elnrs.size(); j++) {
+            const float cutoff = get_bond_cutoff(elnrs[i], elnrs[j]);
+            if(cutoff > result) {
+                result = cutoff;
+            }
+        }
+    }
+    return result;
+}
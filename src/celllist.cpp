@@ -0,0 +1,128 @@
+/*************************************************************************
+ *
+ *  This file is part of v2c.
+ *
+ *  Author: Ivo Filot <i.a.w.filot@tue.nl>
+ *
+ *  v2c is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  v2c is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with v2c.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ************************************************************************/
+
+#include "celllist.h"
+
+#include <algorithm>
+
+/*
+ * Set up the grid for a unit cell <_dimensions> (lattice vectors as rows)
+ * and a cutoff distance <_cutoff>
+ */
+CellList::CellList(const Matrix3 &_dimensions, double _cutoff) {
+    this->cutoff = _cutoff;
+    this->lattice = _dimensions.cast<double>();
+    this->to_frac = this->lattice.inverse().transpose();
+    this->nr_atoms = 0;
+
+    // the perpendicular width of the cell along each lattice direction
+    // equals the volume divided by the area of the opposing face
+    const Eigen::Vector3d a = this->lattice.row(0);
+    const Eigen::Vector3d b = this->lattice.row(1);
+    const Eigen::Vector3d c = this->lattice.row(2);
+    const double volume = std::fabs(a.dot(b.cross(c)));
+    const double widths[3] = {
+        volume / b.cross(c).norm(),
+        volume / c.cross(a).norm(),
+        volume / a.cross(b).norm()
+    };
+
+    this->use_cells = true;
+    for(unsigned int i=0; i<3; i++) {
+        this->nr_cells[i] = (int)std::floor(widths[i] / this->cutoff);
+        this->nr_images[i] = (int)std::ceil(this->cutoff / widths[i]) + 1;
+        if(this->nr_cells[i] < 3) {
+            this->use_cells = false;
+        }
+    }
+
+    if(!this->use_cells) {
+        for(unsigned int i=0; i<3; i++) {
+            this->nr_cells[i] = 1;
+        }
+    }
+}
+
+/*
+ * Bin the atoms. The coordinates of atom i are read from x[i * stride],
+ * y[i * stride] and z[i * stride], such that both interleaved (xyz) and
+ * separate (x..., y..., z...) arrays can be used, in either precision.
+ */
+template<typename T>
+void CellList::build(const T *x, const T *y, const T *z, unsigned int n, unsigned int stride) {
+    this->nr_atoms = n;
+
+    const Eigen::Matrix3d inverse = this->lattice.inverse();
+    const unsigned int nr_cells_total = this->nr_cells[0] * this->nr_cells[1] * this->nr_cells[2];
+
+    // wrapped fractional coordinates and the cell of each atom
+    std::vector<double> unsorted(n * 3);
+    std::vector<unsigned int> cell_of_atom(n);
+    for(unsigned int i=0; i<n; i++) {
+        const Eigen::Vector3d r(x[i * stride], y[i * stride], z[i * stride]);
+        const Eigen::Vector3d f = inverse.transpose() * r;
+        int ci[3];
+        for(unsigned int k=0; k<3; k++) {
+            double u = f(k) - std::floor(f(k));
+            if(u >= 1.0) {
+                u = 0.0;
+            }
+            unsorted[i*3+k] = u;
+            ci[k] = std::min((int)(u * this->nr_cells[k]), this->nr_cells[k] - 1);
+        }
+        cell_of_atom[i] = (ci[0] * this->nr_cells[1] + ci[1]) * this->nr_cells[2] + ci[2];
+    }
+
+    // counting sort of the atoms by cell
+    this->cell_start.assign(nr_cells_total + 1, 0);
+    for(unsigned int i=0; i<n; i++) {
+        this->cell_start[cell_of_atom[i] + 1]++;
+    }
+    for(unsigned int c=0; c<nr_cells_total; c++) {
+        this->cell_start[c+1] += this->cell_start[c];
+    }
+
+    std::vector<unsigned int> fill(this->cell_start.begin(), this->cell_start.end() - 1);
+    this->frac.resize(n * 3);
+    this->index.resize(n);
+    for(unsigned int i=0; i<n; i++) {
+        const unsigned int a = fill[cell_of_atom[i]]++;
+        this->index[a] = i;
+        this->frac[a*3] = unsorted[i*3];
+        this->frac[a*3+1] = unsorted[i*3+1];
+        this->frac[a*3+2] = unsorted[i*3+2];
+    }
+}
+
+template void CellList::build<float>(const float*, const float*, const float*, unsigned int, unsigned int);
+template void CellList::build<double>(const double*, const double*, const double*, unsigned int, unsigned int);
+
+unsigned int CellList::get_nr_atoms() const {
+    return this->nr_atoms;
+}
+
+double CellList::get_cutoff() const {
+    return this->cutoff;
+}
+
+bool CellList::is_using_cells() const {
+    return this->use_cells;
+}
@@ -0,0 +1,174 @@
+/*************************************************************************
+ *
+ *  This file is part of v2c.
+ *
+ *  Author: Ivo Filot <i.a.w.filot@tue.nl>
+ *
+ *  v2c is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  v2c is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with v2c.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ************************************************************************/
+
+
+#include "celltransform.h"
+#include "geometry.h"
+
+/*
+ * Affine transform (acting on homogeneous column vectors) from Cartesian to
+ * fractional coordinates. With the lattice vectors as the rows of A, a
+ * position is r = A^T f, hence f = A^-T r.
+ */
+Matrix4 CellTransform::get_fractional_transform(const Matrix3 &cell) {
+    Matrix4 transform = Matrix4::Identity();
+    transform.topLeftCorner<3,3>() = Geometry::get_fractional_matrix(cell);
+    return transform;
+}
+
+/*
+ * Affine transform from fractional to Cartesian coordinates
+ */
+Matrix4 CellTransform::get_cartesian_transform(const Matrix3 &cell) {
+    Matrix4 transform = Matrix4::Identity();
+    transform.topLeftCorner<3,3>() = cell.transpose();
+    return transform;
+}
+
+/*
+ * Move every atom of <state> into the unit cell, i.e. to fractional
+ * coordinates in [0, 1)
+ */
+void CellTransform::wrap(State &state) {
+    if((size_t)state.coordinates.rows() != state.atoms.size()) {
+        state.allocate_coordinate_matrix();
+    }
+
+    // the rows of the coordinate matrix are homogeneous row vectors
+    MatrixX4 frac = state.coordinates * get_fractional_transform(state.dimensions).transpose();
+    frac.leftCols<3>() = frac.leftCols<3>().array() - frac.leftCols<3>().array().floor();
+    frac.leftCols<3>() = (frac.leftCols<3>().array() >= Real(1)).select(Real(0), frac.leftCols<3>());  // rounding of tiny negative values
+
+    state.coordinates.noalias() = frac * get_cartesian_transform(state.dimensions).transpose();
+    store_coordinates(state);
+}
+
+/*
+ * Move the <nr_atoms> atoms of a frame ([atoms x 3], row-major) into the
+ * unit cell <cell> (lattice vectors as rows)
+ */
+void CellTransform::wrap(float *positions, unsigned int nr_atoms, const float *cell) {
+    const Eigen::Map<const Eigen::Matrix<float, 3, 3, Eigen::RowMajor> > lattice(cell);
+    const Eigen::Matrix3f to_frac = lattice.cast<double>().inverse().transpose().cast<float>();
+
+    Eigen::Map<Matrix3Xf> pos(positions, 3, nr_atoms);
+    Matrix3Xf frac = to_frac * pos;
+    frac = frac.array() - frac.array().floor();
+    frac = (frac.array() >= 1.0f).select(0.0f, frac);
+    pos.noalias() = lattice.transpose() * frac;
+}
+
+/*
+ * Unwrap a trajectory ([frames x atoms x 3], cells [frames x 3 x 3]) in
+ * place and in a single pass: the displacement of every atom between two
+ * consecutive frames is reduced to its minimum image and added to the
+ * unwrapped position in the previous frame. This assumes that no atom moves
+ * more than half a cell between two frames.
+ */
+void CellTransform::unwrap(float *positions, const float *cells, unsigned int nr_frames, unsigned int nr_atoms) {
+    if(nr_frames < 2 || nr_atoms == 0) {
+        return;
+    }
+
+    const size_t frame_size = (size_t)nr_atoms * 3;
+
+    // the wrapped positions of the previous frame, before unwrapping
+    Matrix3Xf previous = Eigen::Map<Matrix3Xf>(positions, 3, nr_atoms);
+    Matrix3Xf d(3, nr_atoms);
+
+    for(unsigned int f=1; f<nr_frames; f++) {
+        const Eigen::Map<const Eigen::Matrix<float, 3, 3, Eigen::RowMajor> > lattice(cells + (size_t)f * 9);
+        const Eigen::Matrix3f to_frac = lattice.cast<double>().inverse().transpose().cast<float>();
+
+        Eigen::Map<Matrix3Xf> current(positions + f * frame_size, 3, nr_atoms);
+        const Eigen::Map<const Matrix3Xf> unwrapped(positions + (f - 1) * frame_size, 3, nr_atoms);
+
+        d.noalias() = to_frac * (current - previous);
+        d = d.array() - (d.array() + 0.5f).floor();
+
+        previous = current;
+        current = unwrapped;
+        current.noalias() += lattice.transpose() * d;
+    }
+}
+
+/*
+ * Build a na x nb x nc supercell of <state>. The atoms remain in blocks per
+ * element (in the order of the original state), such that the result can be
+ * written as POSCAR or CIF; within a block, all atoms of the first image
+ * come first. The energy is scaled with the number of images.
+ */
+State CellTransform::supercell(const State &state, unsigned int na, unsigned int nb, unsigned int nc) {
+    const unsigned int nr_images = na * nb * nc;
+    const Matrix3 &cell = state.dimensions;
+
+    std::vector<Real> dimensions(9);
+    const unsigned int repeat[3] = {na, nb, nc};
+    for(unsigned int i=0; i<3; i++) {
+        for(unsigned int j=0; j<3; j++) {
+            dimensions[i*3+j] = cell(i,j) * repeat[i];
+        }
+    }
+
+    // element blocks; states without element information form a single block
+    std::vector<unsigned int> blocks = state.get_nr_atoms_per_element();
+    unsigned int nr_in_blocks = 0;
+    for(unsigned int i=0; i<blocks.size(); i++) {
+        nr_in_blocks += blocks[i];
+    }
+    if(nr_in_blocks != state.atoms.size()) {
+        blocks.assign(1, state.atoms.size());
+    }
+
+    std::vector<Atom> atoms;
+    atoms.reserve(state.atoms.size() * nr_images);
+    std::vector<unsigned int> nr_atoms;
+
+    unsigned int start = 0;
+    for(unsigned int b=0; b<blocks.size(); b++) {
+        for(unsigned int i=0; i<na; i++) {
+            for(unsigned int j=0; j<nb; j++) {
+                for(unsigned int k=0; k<nc; k++) {
+                    const Vector3 t = (float)i * cell.row(0).transpose() + (float)j * cell.row(1).transpose() +
+                                      (float)k * cell.row(2).transpose();
+                    for(unsigned int a=start; a<start + blocks[b]; a++) {
+                        atoms.push_back(state.atoms[a]);
+                        atoms.back().pos += t;
+                    }
+                }
+            }
+        }
+        nr_atoms.push_back(blocks[b] * nr_images);
+        start += blocks[b];
+    }
+
+    return State(state.get_energy() * nr_images, dimensions, atoms, state.get_elements(),
+                 state.get_elements_uint(), nr_atoms, state.get_filename(), state.get_state_id());
+}
+
+/*
+ * Copy the positions in the coordinate matrix back to the atoms
+ */
+void CellTransform::store_coordinates(State &state) {
+    for(unsigned int i=0; i<state.atoms.size(); i++) {
+        state.atoms[i].pos = state.coordinates.row(i).head<3>().transpose();
+    }
+}
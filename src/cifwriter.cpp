@@ -0,0 +1,163 @@
+/*************************************************************************
+ *
+ *  This file is part of v2c.
+ *
+ *  Author: Ivo Filot <i.a.w.filot@tue.nl>
+ *
+ *  v2c is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  v2c is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with v2c.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ************************************************************************/
+
+#include "cifwriter.h"
+
+#include <cmath>
+#include <ctype.h>
+
+/*
+ * Constructor; with <_symmetry> only the asymmetric unit is written, using
+ * <_tolerance> [A] to detect the symmetry
+ */
+CifWriter::CifWriter(bool _symmetry, double _tolerance) {
+    this->symmetry = _symmetry;
+    this->tolerance = _tolerance;
+}
+
+/*
+ * Assemble the CIF file of <state> in <buffer>; <name> becomes the name of
+ * the data block. With symmetry, a cell that is not primitive (a supercell
+ * or a centered cell) is written as its primitive cell.
+ */
+void CifWriter::format(const State &state, const std::string &name, std::string &buffer) const {
+    char line[160];
+
+    SymmetryFinder finder(this->tolerance);
+    State primitive(0.0, Matrix3::Zero());
+    const State *cell = &state;
+    bool found = false;
+    if(this->symmetry && finder.analyse(state)) {
+        found = true;
+        if(finder.primitive_cell(state, primitive)) {
+            cell = &primitive;
+            found = finder.analyse(primitive);
+        }
+    }
+
+    buffer.clear();
+    buffer += "data_" + block_name(name) + "\n";
+    this->format_cell(*cell, buffer);
+
+    std::vector<char> listed(cell->atoms.size(), 1);
+    if(!found || !this->format_symmetry(finder, listed, buffer)) {
+        buffer += "_symmetry_space_group_name_H-M   'P 1'\n";
+        buffer += "_symmetry_Int_Tables_number      1\n";
+        buffer += "loop_\n_symmetry_equiv_pos_as_xyz\n  'x, y, z'\n";
+    }
+
+    buffer += "loop_\n_atom_site_label\n_atom_site_type_symbol\n";
+    buffer += "_atom_site_fract_x\n_atom_site_fract_y\n_atom_site_fract_z\n_atom_site_occupancy\n";
+
+    const Eigen::Matrix3d to_frac = cell->dimensions.cast<double>().inverse().transpose();
+    unsigned int atom = 0;
+    for(unsigned int e=0; e<cell->get_nr_elements(); e++) {
+        const std::string &element = cell->get_elements()[e];
+        unsigned int label = 0;
+        for(unsigned int i=0; i<cell->get_atoms_for_element(e) && atom<cell->atoms.size(); i++, atom++) {
+            if(!listed[atom]) {
+                continue;
+            }
+            Eigen::Vector3d f = to_frac * cell->atoms[atom].pos.cast<double>();
+            for(unsigned int k=0; k<3; k++) {
+                f(k) -= std::floor(f(k));
+            }
+            snprintf(line, sizeof(line), "  %-6s %-3s %10.6f %10.6f %10.6f  1.0\n",
+                     (element + int2str(++label)).c_str(), element.c_str(), f(0), f(1), f(2));
+            buffer += line;
+        }
+    }
+}
+
+/*
+ * Write <state> as CIF file <filename>, compressed with <nr_threads>
+ * threads when the name ends in .gz
+ */
+bool CifWriter::write(const State &state, const std::string &filename, const std::string &name,
+                      unsigned int nr_threads) const {
+    std::string buffer;
+    this->format(state, name, buffer);
+
+    return OutputSink::write_file(filename, buffer, nr_threads);
+}
+
+/*
+ * Write the symmetry operations found by <finder>; only the atoms of the
+ * asymmetric unit are flagged in <listed>. Returns false (and writes
+ * nothing) when the structure has no symmetry beyond the identity.
+ */
+bool CifWriter::format_symmetry(const SymmetryFinder &finder, std::vector<char> &listed, std::string &buffer) const {
+    const std::vector<SymmetryOperation> &operations = finder.get_operations();
+    const std::vector<unsigned int> &unit = finder.get_asymmetric_unit();
+    // operations that do not form a group (tolerance too tight for the
+    // noise on the positions) are not classified
+    if(operations.size() < 2 || finder.get_point_group().empty()) {
+        return false;
+    }
+
+    buffer += "_space_group_crystal_system      " + finder.get_crystal_system() + "\n";
+    buffer += "_space_group_point_group_H-M     '" + finder.get_point_group() + "'\n";
+    buffer += "loop_\n_symmetry_equiv_pos_as_xyz\n";
+    for(unsigned int i=0; i<operations.size(); i++) {
+        buffer += "  '" + SymmetryFinder::format_operation(operations[i]) + "'\n";
+    }
+
+    std::fill(listed.begin(), listed.end(), 0);
+    for(unsigned int i=0; i<unit.size(); i++) {
+        listed[unit[i]] = 1;
+    }
+
+    return true;
+}
+
+/*
+ * Cell lengths [A] and angles [degrees] of the lattice vectors
+ */
+void CifWriter::format_cell(const State &state, std::string &buffer) const {
+    char line[80];
+    const Eigen::Matrix3d lattice = state.dimensions.cast<double>();
+    const Eigen::Vector3d a = lattice.row(0), b = lattice.row(1), c = lattice.row(2);
+    const double rad = 180.0 / M_PI;
+
+    snprintf(line, sizeof(line), "_cell_length_a    %.6f\n", a.norm());
+    buffer += line;
+    snprintf(line, sizeof(line), "_cell_length_b    %.6f\n", b.norm());
+    buffer += line;
+    snprintf(line, sizeof(line), "_cell_length_c    %.6f\n", c.norm());
+    buffer += line;
+    snprintf(line, sizeof(line), "_cell_angle_alpha %.6f\n", std::acos(b.dot(c) / (b.norm() * c.norm())) * rad);
+    buffer += line;
+    snprintf(line, sizeof(line), "_cell_angle_beta  %.6f\n", std::acos(a.dot(c) / (a.norm() * c.norm())) * rad);
+    buffer += line;
+    snprintf(line, sizeof(line), "_cell_angle_gamma %.6f\n", std::acos(a.dot(b) / (a.norm() * b.norm())) * rad);
+    buffer += line;
+}
+
+/*
+ * Data block names cannot contain whitespace
+ */
+std::string CifWriter::block_name(const std::string &name) {
+    std::string result;
+    for(unsigned int i=0; i<name.size(); i++) {
+        result += isspace((unsigned char)name[i]) ? '_' : name[i];
+    }
+    return result.empty() ? std::string("v2c") : result;
+}
@@ -0,0 +1,62 @@
+/*************************************************************************
+ *
+ *  This file is part of VeeVee.
+ *
+ *  Author: Ivo Filot <ivo@ivofilot.nl>
+ *
+ *  VeeVee is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  VeeVee is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with VeeVee.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ************************************************************************/
+
+#include "color.h"
+
+/*
+ * Default constructor; black
+ */
+Color::Color() {
+    this->r = 0.0f;
+    this->g = 0.0f;
+    this->b = 0.0f;
+}
+
+/*
+ * Construct from a hexadecimal RRGGBB string (as the ATOM_COLOR_* values),
+ * optionally preceded by '#'; the components are scaled to [0, 1]
+ */
+Color::Color(const std::string &rgb) {
+    const std::string hex = (!rgb.empty() && rgb[0] == '#') ? rgb.substr(1) : rgb;
+    float *components[3] = {&this->r, &this->g, &this->b};
+
+    for(unsigned int i=0; i<3; i++) {
+        *components[i] = 0.0f;
+        if(hex.size() >= 2 * i + 2) {
+            const std::string digits = hex.substr(2 * i, 2);
+            char *end;
+            const long value = strtol(digits.c_str(), &end, 16);
+            if(*end == '\0') {
+                *components[i] = value / 255.0f;
+            }
+        }
+    }
+}
+
+/*
+ * Move the color towards white by <percentage> (0 - 100) percent
+ */
+void Color::lighten(float percentage) {
+    const float f = std::max(0.0f, std::min(1.0f, percentage / 100.0f));
+    this->r += (1.0f - this->r) * f;
+    this->g += (1.0f - this->g) * f;
+    this->b += (1.0f - this->b) * f;
+}
@@ -0,0 +1,288 @@
+/*************************************************************************
+ *
+ *  This file is part of v2c.
+ *
+ *  Author: Ivo Filot <i.a.w.filot@tue.nl>
+ *
+ *  v2c is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  v2c is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with v2c.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ************************************************************************/
+
+#include "conversioncache.h"
+
+#include <algorithm>
+#include <sstream>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+/*
+ * Default constructor
+ */
+ConversionCache::ConversionCache() {}
+
+/*
+ * Load the cache file and open it for appending. A file that does not exist
+ * yet is created; a journal that holds superseded entries is rewritten with
+ * only the most recent entry of every file.
+ */
+bool ConversionCache::open(const std::string &_filename) {
+    this->filename = _filename;
+
+    unsigned int nr_lines = 0;
+    bool is_new = true;
+    bool is_outdated = false;
+    std::ifstream infile(this->filename.c_str());
+    if(infile.is_open()) {
+        std::string line;
+        if(std::getline(infile, line)) {
+            is_new = false;
+            // entries of an older format are dropped; their files are converted again
+            if(line != CONVERSION_CACHE_HEADER && line.compare(0, strlen(CONVERSION_CACHE_PREFIX), CONVERSION_CACHE_PREFIX) == 0) {
+                std::cerr << "Discarding the entries of " << this->filename << " (older cache format)." << std::endl;
+                is_outdated = true;
+            } else if(line != CONVERSION_CACHE_HEADER) {
+                std::cerr << this->filename << " is not a conversion cache." << std::endl;
+                return false;
+            }
+        }
+
+        while(!is_outdated && std::getline(infile, line)) {
+            std::string path;
+            ConversionCacheEntry entry;
+            if(line.empty() || line[0] == '#') {
+                continue;
+            }
+            // an incomplete last line is left behind by an interrupted run
+            if(!this->deserialize(line, &path, &entry)) {
+                continue;
+            }
+            this->entries[path] = entry;
+            nr_lines++;
+        }
+        infile.close();
+    }
+
+    if(!is_new && (is_outdated || nr_lines > this->entries.size())) {
+        const std::string tmpname = this->filename + ".tmp";
+        std::ofstream tmpfile(tmpname.c_str());
+        if(tmpfile.is_open()) {
+            tmpfile << CONVERSION_CACHE_HEADER << std::endl;
+            for(std::unordered_map<std::string, ConversionCacheEntry>::const_iterator it = this->entries.begin();
+                it != this->entries.end(); ++it) {
+                tmpfile << this->serialize(it->first, it->second) << std::endl;
+            }
+            tmpfile.close();
+            if(tmpfile.good()) {
+                rename(tmpname.c_str(), this->filename.c_str());
+            }
+        }
+    }
+
+    this->outfile.open(this->filename.c_str(), std::ios::app);
+    if(!this->outfile.is_open()) {
+        std::cerr << "Cannot open " << this->filename << " for writing." << std::endl;
+        return false;
+    }
+
+    if(is_new) {
+        this->outfile << CONVERSION_CACHE_HEADER << std::endl;
+    }
+
+    return true;
+}
+
+/*
+ * Compare a file against its cache entry (one of the CONVERSION_CACHE_*
+ * values). When the file can be resumed, <checkpoint> receives the
+ * checkpoint to resume from.
+ */
+unsigned int ConversionCache::check(const std::string &path, OutcarCheckpoint *checkpoint) const {
+    std::unordered_map<std::string, ConversionCacheEntry>::const_iterator it = this->entries.find(path);
+    if(it == this->entries.end()) {
+        return CONVERSION_CACHE_NEW;
+    }
+    const ConversionCacheEntry &cached = it->second;
+
+    ConversionCacheEntry current;
+    if(!this->stat_file(path, &current) || current.size < cached.size) {
+        return CONVERSION_CACHE_NEW;
+    }
+
+    if(current.size == cached.size) {
+        if(current.head_hash == cached.head_hash && current.mtime == cached.mtime &&
+           current.tail_hash == cached.tail_hash) {
+            return CONVERSION_CACHE_UNCHANGED;
+        }
+        return CONVERSION_CACHE_NEW;
+    }
+
+    // the file has grown: the blocks that were the head and the tail before
+    // must still be in place, otherwise the file has been rewritten. A file
+    // shorter than a block had a shorter head, which is hashed over the same
+    // length again.
+    std::ifstream infile(path.c_str(), std::ios::binary);
+    const uint64_t length = std::min<uint64_t>(cached.size, CONVERSION_CACHE_HASH_BLOCK);
+    if(this->hash_range(infile, 0, length) != cached.head_hash ||
+       this->hash_range(infile, cached.size - length, length) != cached.tail_hash) {
+        return CONVERSION_CACHE_NEW;
+    }
+
+    *checkpoint = cached.checkpoint;
+    return CONVERSION_CACHE_APPENDED;
+}
+
+/*
+ * Record the current size, modification time and hashes of a file together
+ * with the reader checkpoint after its last complete state
+ */
+bool ConversionCache::update(const std::string &path, const OutcarCheckpoint &checkpoint) {
+    ConversionCacheEntry entry;
+    if(!this->stat_file(path, &entry)) {
+        return false;
+    }
+    entry.checkpoint = checkpoint;
+    this->entries[path] = entry;
+
+    if(this->outfile.is_open()) {
+        this->outfile << this->serialize(path, entry) << std::endl;
+    }
+
+    return true;
+}
+
+size_t ConversionCache::size() const {
+    return this->entries.size();
+}
+
+/*
+ * Fill in size, modification time and hashes of a file
+ */
+bool ConversionCache::stat_file(const std::string &path, ConversionCacheEntry *entry) const {
+    struct stat info;
+    if(stat(path.c_str(), &info) != 0) {
+        return false;
+    }
+
+    std::ifstream infile(path.c_str(), std::ios::binary);
+    if(!infile.is_open()) {
+        return false;
+    }
+
+    entry->size = info.st_size;
+    entry->mtime = info.st_mtime;
+    const uint64_t length = std::min<uint64_t>(entry->size, CONVERSION_CACHE_HASH_BLOCK);
+    entry->head_hash = this->hash_range(infile, 0, length);
+    entry->tail_hash = this->hash_range(infile, entry->size - length, length);
+
+    return true;
+}
+
+/*
+ * FNV-1a hash of <length> bytes starting at <start>
+ */
+uint64_t ConversionCache::hash_range(std::ifstream &infile, uint64_t start, uint64_t length) const {
+    std::vector<char> buffer(length);
+    infile.clear();
+    infile.seekg(start);
+    infile.read(buffer.data(), length);
+
+    uint64_t hash = 14695981039346656037ULL;
+    for(std::streamsize i=0; i<infile.gcount(); i++) {
+        hash ^= (unsigned char)buffer[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash ^ (uint64_t)infile.gcount();
+}
+
+/*
+ * Entries are stored as tab separated fields: path, size, mtime, head hash,
+ * tail hash, and the checkpoint (offset, vasp version, layout, number of states,
+ * number of energies, elements, atoms per element, nine cell components)
+ */
+std::string ConversionCache::serialize(const std::string &path, const ConversionCacheEntry &entry) const {
+    const OutcarCheckpoint &c = entry.checkpoint;
+    std::ostringstream str;
+    char hex[40];
+    snprintf(hex, sizeof(hex), "%016llx\t%016llx", (unsigned long long)entry.head_hash,
+             (unsigned long long)entry.tail_hash);
+
+    str << path << "\t" << entry.size << "\t" << entry.mtime << "\t" << hex << "\t"
+        << c.offset << "\t" << c.vasp_version << "\t" << c.layout << "\t" << c.nr_states << "\t" << c.nr_energies << "\t";
+    for(unsigned int i=0; i<c.elements.size(); i++) {
+        str << (i > 0 ? "," : "") << c.elements[i];
+    }
+    str << "\t";
+    for(unsigned int i=0; i<c.nr_atoms_per_elm.size(); i++) {
+        str << (i > 0 ? "," : "") << c.nr_atoms_per_elm[i];
+    }
+    str << "\t";
+    // enough digits to read back the same cell in either precision
+    const char *format = sizeof(Real) == sizeof(float) ? "%.9g" : "%.17g";
+    for(unsigned int i=0; i<c.dimensions.size(); i++) {
+        str << (i > 0 ? "," : "") << double2str2(c.dimensions[i], format);
+    }
+    str << "\t.";   // end marker, absent in a partially written line
+
+    return str.str();
+}
+
+bool ConversionCache::deserialize(const std::string &line, std::string *path, ConversionCacheEntry *entry) const {
+    std::vector<std::string> fields;
+    size_t start = 0;
+    while(true) {
+        size_t end = line.find('\t', start);
+        fields.push_back(line.substr(start, end == std::string::npos ? std::string::npos : end - start));
+        if(end == std::string::npos) {
+            break;
+        }
+        start = end + 1;
+    }
+
+    if(fields.size() != 14 || fields[13] != ".") {
+        return false;
+    }
+
+    OutcarCheckpoint &c = entry->checkpoint;
+    *path = fields[0];
+    entry->size = strtoull(fields[1].c_str(), NULL, 10);
+    entry->mtime = strtoll(fields[2].c_str(), NULL, 10);
+    entry->head_hash = strtoull(fields[3].c_str(), NULL, 16);
+    entry->tail_hash = strtoull(fields[4].c_str(), NULL, 16);
+    c.offset = strtoll(fields[5].c_str(), NULL, 10);
+    c.vasp_version = atoi(fields[6].c_str());
+    c.layout = atoi(fields[7].c_str());
+    c.nr_states = atoi(fields[8].c_str());
+    c.nr_energies = atoi(fields[9].c_str());
+
+    c.elements.clear();
+    c.nr_atoms_per_elm.clear();
+    c.dimensions.clear();
+    std::string token;
+    std::istringstream elements(fields[10]);
+    while(std::getline(elements, token, ',')) {
+        c.elements.push_back(token);
+    }
+    std::istringstream counts(fields[11]);
+    while(std::getline(counts, token, ',')) {
+        c.nr_atoms_per_elm.push_back(atoi(token.c_str()));
+    }
+    std::istringstream dimensions(fields[12]);
+    while(std::getline(dimensions, token, ',')) {
+        c.dimensions.push_back(atof(token.c_str()));
+    }
+
+    return c.elements.size() == c.nr_atoms_per_elm.size() && c.dimensions.size() == 9;
+}
@@ -0,0 +1,463 @@
+/*************************************************************************
+ *
+ *  This file is part of v2c.
+ *
+ *  Author: Ivo Filot <i.a.w.filot@tue.nl>
+ *
+ *  v2c is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  v2c is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with v2c.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ************************************************************************/
+
+
+#include "conversionserver.h"
+
+#include <stdexcept>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+/*
+ * Constructor; every request is passed to <_handler> as command line
+ * (command first), which returns the exit code
+ */
+std::atomic<bool> ConversionServer::handling(false);
+
+ConversionServer::ConversionServer(const std::function<int(const std::vector<std::string>&)> &_handler) {
+    this->handler = _handler;
+    this->listen_fd = -1;
+    this->nr_requests = 0;
+}
+
+ConversionServer::~ConversionServer() {
+    this->close();
+}
+
+/*
+ * Listen on the socket <_socket_path>. A socket file that is left over from
+ * a server that was killed is replaced; a socket with a live server is not.
+ */
+bool ConversionServer::open(const std::string &_socket_path) {
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if(_socket_path.size() >= sizeof(address.sun_path)) {
+        std::cerr << "The socket path " << _socket_path << " is too long." << std::endl;
+        return false;
+    }
+    strcpy(address.sun_path, _socket_path.c_str());
+
+    struct stat status;
+    if(stat(_socket_path.c_str(), &status) == 0) {
+        if(!S_ISSOCK(status.st_mode)) {
+            std::cerr << _socket_path << " exists and is not a socket." << std::endl;
+            return false;
+        }
+        const int probe = socket(AF_UNIX, SOCK_STREAM, 0);
+        const bool live = probe >= 0 && connect(probe, (struct sockaddr*)&address, sizeof(address)) == 0;
+        if(probe >= 0) {
+            ::close(probe);
+        }
+        if(live) {
+            std::cerr << "A server is already listening on " << _socket_path << std::endl;
+            return false;
+        }
+        unlink(_socket_path.c_str());
+    }
+
+    // the socket is created accessible to the own user only
+    this->listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    const mode_t mask = umask(0177);
+    const bool bound = this->listen_fd >= 0 &&
+                       bind(this->listen_fd, (struct sockaddr*)&address, sizeof(address)) == 0;
+    umask(mask);
+    if(!bound || chmod(_socket_path.c_str(), S_IRUSR | S_IWUSR) != 0 ||
+       listen(this->listen_fd, CONVERSION_SERVER_BACKLOG) != 0) {
+        std::cerr << "Cannot listen on " << _socket_path << ": " << strerror(errno) << std::endl;
+        if(bound) {
+            unlink(_socket_path.c_str());
+        }
+        if(this->listen_fd >= 0) {
+            ::close(this->listen_fd);
+            this->listen_fd = -1;
+        }
+        return false;
+    }
+
+    this->socket_path = _socket_path;
+    return true;
+}
+
+/*
+ * Handle requests until a client sends the shutdown command
+ */
+void ConversionServer::run() {
+    // a client that goes away must not take the server with it
+    signal(SIGPIPE, SIG_IGN);
+
+    while(this->listen_fd >= 0) {
+        const int fd = accept(this->listen_fd, NULL, NULL);
+        if(fd < 0) {
+            if(errno == EINTR || errno == ECONNABORTED) {
+                continue;
+            }
+            std::cerr << "Cannot accept connections on " << this->socket_path << ": " << strerror(errno) << std::endl;
+            break;
+        }
+
+        if(!is_own_user(fd)) {
+            ::close(fd);
+            continue;
+        }
+
+        const bool proceed = this->handle(fd);
+        ::close(fd);
+        if(!proceed) {
+            break;
+        }
+    }
+}
+
+/*
+ * Stop listening and remove the socket file
+ */
+void ConversionServer::close() {
+    if(this->listen_fd >= 0) {
+        ::close(this->listen_fd);
+        unlink(this->socket_path.c_str());
+        this->listen_fd = -1;
+    }
+}
+
+unsigned int ConversionServer::get_nr_requests() const {
+    return this->nr_requests;
+}
+
+/*
+ * Whether the calling command runs as the request of a server; the command
+ * dispatcher refuses to start a nested server or client then, which would
+ * wait for itself
+ */
+bool ConversionServer::is_handling() {
+    return handling;
+}
+
+/*
+ * Client side: send the command line <args> (command first) to the server
+ * on <socket_path>, copy the output and errors of the command to the own
+ * standard output and error as they arrive, and return its exit code
+ */
+int ConversionServer::request(const std::string &socket_path, const std::vector<std::string> &args) {
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if(socket_path.size() >= sizeof(address.sun_path)) {
+        std::cerr << "The socket path " << socket_path << " is too long." << std::endl;
+        return -1;
+    }
+    strcpy(address.sun_path, socket_path.c_str());
+
+    const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if(fd < 0 || connect(fd, (struct sockaddr*)&address, sizeof(address)) != 0) {
+        std::cerr << "Cannot connect to " << socket_path << ": " << strerror(errno) << std::endl;
+        if(fd >= 0) {
+            ::close(fd);
+        }
+        return -1;
+    }
+
+    char cwd[PATH_MAX];
+    if(getcwd(cwd, sizeof(cwd)) == NULL) {
+        std::cerr << "Cannot determine the working directory." << std::endl;
+        ::close(fd);
+        return -1;
+    }
+
+    std::string message;
+    const uint32_t n = args.size() + 1;
+    message.append((const char*)&n, sizeof(n));
+    message.append(cwd, strlen(cwd) + 1);
+    for(unsigned int i=0; i<args.size(); i++) {
+        message.append(args[i].c_str(), args[i].size() + 1);
+    }
+
+    int32_t code = -1;
+    bool finished = false;
+    if(write_all(fd, message.data(), message.size())) {
+        std::vector<char> data;
+        char channel;
+        uint32_t length;
+        while(read_all(fd, &channel, 1) && read_all(fd, &length, sizeof(length))) {
+            data.resize(length);
+            if(length > 0 && !read_all(fd, data.data(), length)) {
+                break;
+            }
+            if(channel == CONVERSION_SERVER_CHANNEL_OUTPUT) {
+                std::cout.write(data.data(), length).flush();
+            } else if(channel == CONVERSION_SERVER_CHANNEL_ERROR) {
+                std::cerr.write(data.data(), length).flush();
+            } else if(channel == CONVERSION_SERVER_CHANNEL_EXIT && length == sizeof(code)) {
+                memcpy(&code, data.data(), sizeof(code));
+                finished = true;
+                break;
+            }
+        }
+    }
+    ::close(fd);
+
+    if(!finished) {
+        std::cerr << "The connection to " << socket_path << " was lost." << std::endl;
+        return -1;
+    }
+    return code;
+}
+
+/*
+ * Send a frame of <length> bytes on <channel>
+ */
+bool ConversionServer::send_frame(int fd, char channel, const char *data, uint32_t length) {
+    char header[1 + sizeof(uint32_t)];
+    header[0] = channel;
+    memcpy(header + 1, &length, sizeof(length));
+    return write_all(fd, header, sizeof(header)) && write_all(fd, data, length);
+}
+
+/*
+ * Whether the peer on connection <fd> runs as the same user as the server
+ */
+bool ConversionServer::is_own_user(int fd) {
+    struct ucred credentials;
+    socklen_t length = sizeof(credentials);
+    if(getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &credentials, &length) != 0) {
+        std::cerr << "Cannot determine the user of a connection: " << strerror(errno) << std::endl;
+        return false;
+    }
+    if(credentials.uid != getuid()) {
+        std::cerr << "Refused a connection from user " << credentials.uid << std::endl;
+        return false;
+    }
+    return true;
+}
+
+/*
+ * Run the request on connection <fd> in the working directory of the
+ * client, with the standard output and error streamed to the client.
+ * Returns false for the shutdown command.
+ */
+bool ConversionServer::handle(int fd) {
+    std::vector<std::string> strings;
+    if(!read_request(fd, strings) || strings.size() < 2) {
+        return true;
+    }
+    const std::vector<std::string> args(strings.begin() + 1, strings.end());
+
+    int32_t code = 0;
+    if(args[0] == "shutdown") {
+        send_frame(fd, CONVERSION_SERVER_CHANNEL_EXIT, (const char*)&code, sizeof(code));
+        return false;
+    }
+
+    char cwd[PATH_MAX];
+    const bool has_cwd = getcwd(cwd, sizeof(cwd)) != NULL;
+
+    SocketStreamBuf output(fd, CONVERSION_SERVER_CHANNEL_OUTPUT);
+    SocketStreamBuf errors(fd, CONVERSION_SERVER_CHANNEL_ERROR);
+    std::streambuf *cout_buffer = std::cout.rdbuf(&output);
+    std::streambuf *cerr_buffer = std::cerr.rdbuf(&errors);
+
+    if(chdir(strings[0].c_str()) != 0) {
+        std::cerr << "Cannot change to " << strings[0] << std::endl;
+        code = -1;
+    } else {
+        // the streams and the working directory are restored whatever
+        // happens in the command
+        handling = true;
+        try {
+            code = this->handler(args);
+        } catch(const std::exception &e) {
+            std::cerr << "The " << args[0] << " command failed: " << e.what() << std::endl;
+            code = -1;
+        } catch(...) {
+            std::cerr << "The " << args[0] << " command failed." << std::endl;
+            code = -1;
+        }
+        handling = false;
+    }
+
+    std::cout.flush();
+    std::cerr.flush();
+    output.flush_all();
+    errors.flush_all();
+    std::cout.rdbuf(cout_buffer);
+    std::cerr.rdbuf(cerr_buffer);
+    std::cout.clear();
+    std::cerr.clear();
+    if(has_cwd && chdir(cwd) != 0) {
+        std::cerr << "Cannot change back to " << cwd << std::endl;
+    }
+
+    send_frame(fd, CONVERSION_SERVER_CHANNEL_EXIT, (const char*)&code, sizeof(code));
+    this->nr_requests++;
+
+    return true;
+}
+
+/*
+ * Read a request: the number of strings followed by the NUL-terminated
+ * strings themselves
+ */
+bool ConversionServer::read_request(int fd, std::vector<std::string> &strings) {
+    uint32_t n = 0;
+    if(!read_all(fd, &n, sizeof(n)) || n == 0 || n > CONVERSION_SERVER_MAX_REQUEST / 2) {
+        return false;
+    }
+
+    std::string data;
+    char chunk[CONVERSION_SERVER_BUFFER_SIZE];
+    size_t nr_strings = 0;
+    while(nr_strings < n) {
+        const ssize_t result = read(fd, chunk, sizeof(chunk));
+        if(result < 0 && errno == EINTR) {
+            continue;
+        }
+        if(result <= 0 || data.size() + result > CONVERSION_SERVER_MAX_REQUEST) {
+            return false;
+        }
+        data.append(chunk, result);
+        nr_strings += std::count(chunk, chunk + result, '\0');
+    }
+
+    size_t start = 0;
+    for(uint32_t i=0; i<n; i++) {
+        const size_t end = data.find('\0', start);
+        strings.push_back(data.substr(start, end - start));
+        start = end + 1;
+    }
+
+    return true;
+}
+
+bool ConversionServer::read_all(int fd, void *data, size_t length) {
+    char *ptr = (char*)data;
+    while(length > 0) {
+        const ssize_t result = read(fd, ptr, length);
+        if(result < 0 && errno == EINTR) {
+            continue;
+        }
+        if(result <= 0) {
+            return false;
+        }
+        ptr += result;
+        length -= result;
+    }
+    return true;
+}
+
+bool ConversionServer::write_all(int fd, const void *data, size_t length) {
+    const char *ptr = (const char*)data;
+    while(length > 0) {
+        const ssize_t result = write(fd, ptr, length);
+        if(result < 0 && errno == EINTR) {
+            continue;
+        }
+        if(result <= 0) {
+            return false;
+        }
+        ptr += result;
+        length -= result;
+    }
+    return true;
+}
+
+std::mutex SocketStreamBuf::mutex;
+
+SocketStreamBuf::SocketStreamBuf(int _fd, char _channel) {
+    this->fd = _fd;
+    this->channel = _channel;
+    this->setp(NULL, NULL);
+}
+
+SocketStreamBuf::~SocketStreamBuf() {
+    this->flush_all();
+}
+
+/*
+ * Send the text that is still pending for any of the threads
+ */
+bool SocketStreamBuf::flush_all() {
+    std::lock_guard<std::mutex> lock(SocketStreamBuf::mutex);
+    bool result = true;
+    for(auto it = this->pending.begin(); it != this->pending.end(); ++it) {
+        result = this->send(it->second, false) && result;
+    }
+    this->pending.clear();
+    return result;
+}
+
+/*
+ * Store a single character <c>
+ */
+SocketStreamBuf::int_type SocketStreamBuf::overflow(int_type c) {
+    if(traits_type::eq_int_type(c, traits_type::eof())) {
+        return traits_type::not_eof(c);
+    }
+    const char ch = traits_type::to_char_type(c);
+    return this->xsputn(&ch, 1) == 1 ? c : traits_type::eof();
+}
+
+/*
+ * Store <n> characters and send the lines that are complete
+ */
+std::streamsize SocketStreamBuf::xsputn(const char *s, std::streamsize n) {
+    std::lock_guard<std::mutex> lock(SocketStreamBuf::mutex);
+    std::string &text = this->pending[std::this_thread::get_id()];
+    text.append(s, n);
+    const bool full = text.size() >= CONVERSION_SERVER_BUFFER_SIZE;
+    if((full || memchr(s, '\n', n) != NULL) && !this->send(text, !full)) {
+        return 0;
+    }
+    return n;
+}
+
+/*
+ * Send the complete lines the calling thread has written. std::cerr is
+ * flushed after every insertion, hence a partial line is kept until it is
+ * complete, such that the lines of different threads do not mix.
+ */
+int SocketStreamBuf::sync() {
+    std::lock_guard<std::mutex> lock(SocketStreamBuf::mutex);
+    std::unordered_map<std::thread::id, std::string>::iterator it = this->pending.find(std::this_thread::get_id());
+    if(it == this->pending.end()) {
+        return 0;
+    }
+    return this->send(it->second, true) ? 0 : -1;
+}
+
+/*
+ * Send <text> as one frame, or with <whole_lines> only up to and including
+ * its last newline, and remove what was sent; the lock must be held
+ */
+bool SocketStreamBuf::send(std::string &text, bool whole_lines) {
+    const size_t length = whole_lines ? text.rfind('\n') + 1 : text.size();
+    if(length == 0) {
+        return true;
+    }
+    const bool result = ConversionServer::send_frame(this->fd, this->channel, text.data(), length);
+    text.erase(0, length);
+    return result;
+}
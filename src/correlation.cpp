@@ -0,0 +1,373 @@
+/*************************************************************************
+ *
+ *  This file is part of v2c.
+ *
+ *  Author: Ivo Filot <i.a.w.filot@tue.nl>
+ *
+ *  v2c is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  v2c is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with v2c.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ************************************************************************/
+
+#include "correlation.h"
+
+/*
+ * Constructor; <_timestep> is the time between two frames in fs
+ */
+CorrelationAnalysis::CorrelationAnalysis(double _timestep) {
+    this->timestep = _timestep;
+    this->nr_frames = 0;
+}
+
+/*
+ * Calculate the MSD and VACF of every element of <trajectory>
+ */
+bool CorrelationAnalysis::calculate(const Trajectory &trajectory, ThreadPool &pool) {
+    const unsigned int frames = trajectory.get_nr_frames();
+
+    return this->calculate(frames, trajectory.get_nr_atoms(), trajectory.get_elements(),
+                           trajectory.get_nr_atoms_per_element(), trajectory.get_nr_atoms(),
+        [&](unsigned int first, unsigned int count, std::vector<float> &series, std::vector<float> &cells) {
+            series = trajectory.get_positions_atom_major();
+            cells.assign(trajectory.get_cells(), trajectory.get_cells() + (size_t)frames * 9);
+        }, pool);
+}
+
+/*
+ * Calculate the MSD and VACF of every element of the frames in <states>. The
+ * time series are gathered for as many atoms at a time as fit in
+ * <memory_budget>, reading every frame once per block of atoms.
+ */
+bool CorrelationAnalysis::calculate(const FrameStore &states, size_t memory_budget, ThreadPool &pool) {
+    const unsigned int frames = states.size();
+    if(frames == 0) {
+        return this->calculate(Trajectory(), pool);
+    }
+
+    State buffer(0.0, Matrix3::Zero());
+    const State &state = states.get(0, buffer);
+    const unsigned int atoms = state.get_total_nr_atoms();
+    const std::vector<std::string> elements = state.get_elements();
+    const std::vector<unsigned int> nr_atoms_per_elm = state.get_nr_atoms_per_element();
+
+    unsigned int block = atoms;
+    if(memory_budget != FRAME_STORE_UNLIMITED) {
+        block = std::max(std::min(memory_budget / ((size_t)frames * 3 * sizeof(float)), (size_t)atoms), (size_t)1);
+    }
+
+    std::vector<State> buffers(pool.get_nr_threads(), State(0.0, Matrix3::Zero()));
+    return this->calculate(frames, atoms, elements, nr_atoms_per_elm, block,
+        [&](unsigned int first, unsigned int count, std::vector<float> &series, std::vector<float> &cells) {
+            series.resize((size_t)count * frames * 3);
+            cells.resize((size_t)frames * 9);
+            pool.parallel_for(frames, [&](size_t f, unsigned int worker) {
+                const State &s = states.get(f, buffers[worker]);
+                for(unsigned int a=0; a<count; a++) {
+                    for(unsigned int k=0; k<3; k++) {
+                        series[((size_t)a * frames + f) * 3 + k] = s.atoms[first + a].pos(k);
+                    }
+                }
+                for(unsigned int i=0; i<3; i++) {
+                    for(unsigned int j=0; j<3; j++) {
+                        cells[f * 9 + i * 3 + j] = s.dimensions(i,j);
+                    }
+                }
+            });
+        }, pool);
+}
+
+/*
+ * Calculate the MSD and VACF of every element for <atoms> atoms in blocks of
+ * <block> atoms; <load> provides the time series of a block in atom-major
+ * order ([count x frames x 3]) and the cells of all frames. Within a block,
+ * the atoms are distributed over the workers of <pool>; every worker
+ * accumulates the sums of its atoms per element, which are combined
+ * afterwards.
+ */
+bool CorrelationAnalysis::calculate(unsigned int frames, unsigned int atoms,
+                                    const std::vector<std::string> &_elements,
+                                    const std::vector<unsigned int> &nr_atoms_per_elm,
+                                    unsigned int block, const SeriesLoader &load, ThreadPool &pool) {
+    if(frames < 3) {
+        std::cerr << "At least three frames are needed for the MSD and VACF." << std::endl;
+        return false;
+    }
+
+    this->nr_frames = frames;
+    this->elements = _elements;
+    const unsigned int ne = this->elements.size();
+
+    // element index of every atom
+    std::vector<unsigned int> element_of_atom;
+    for(unsigned int i=0; i<ne; i++) {
+        element_of_atom.insert(element_of_atom.end(), nr_atoms_per_elm[i], i);
+    }
+
+    const unsigned int nr_workers = pool.get_nr_threads();
+    std::vector<std::vector<double> > msd_sum(nr_workers * ne, std::vector<double>(frames, 0.0));
+    std::vector<std::vector<double> > vacf_sum(nr_workers * ne, std::vector<double>(frames, 0.0));
+    std::vector<Eigen::FFT<double> > ffts(nr_workers);
+
+    std::vector<Eigen::Matrix3d> cells(frames);
+    std::vector<Eigen::Matrix3d> inverse_cells(frames);
+    std::vector<float> series;
+    std::vector<float> cell_data;
+
+    for(unsigned int first=0; first<atoms; first += block) {
+        const unsigned int count = std::min(block, atoms - first);
+
+        // the time series of every atom is contiguous in atom-major order
+        load(first, count, series, cell_data);
+
+        // unit cells and their inverses for every frame
+        if(first == 0) {
+            for(unsigned int f=0; f<frames; f++) {
+                for(unsigned int i=0; i<3; i++) {
+                    for(unsigned int j=0; j<3; j++) {
+                        cells[f](i,j) = cell_data[f*9 + i*3 + j];
+                    }
+                }
+                inverse_cells[f] = cells[f].inverse();
+            }
+        }
+
+        pool.parallel_for(count, [&](size_t c, unsigned int worker) {
+            const unsigned int atom = first + c;
+            Eigen::FFT<double> &fft = ffts[worker];
+            std::vector<double> r(frames * 3);
+            std::vector<double> v(frames * 3);
+            std::vector<double> s2;
+            std::vector<double> cv;
+
+            // unwrap the trajectory of this atom: every displacement between two
+            // consecutive frames is reduced to its minimum image
+            const float *p = &series[c * frames * 3];
+            for(unsigned int k=0; k<3; k++) {
+                r[k] = p[k];
+            }
+            for(unsigned int f=1; f<frames; f++) {
+                Eigen::Vector3d d(p[f*3] - p[(f-1)*3], p[f*3+1] - p[(f-1)*3+1], p[f*3+2] - p[(f-1)*3+2]);
+                Eigen::Vector3d frac = inverse_cells[f].transpose() * d;
+                for(unsigned int k=0; k<3; k++) {
+                    frac(k) -= std::floor(frac(k) + 0.5);
+                }
+                d = cells[f].transpose() * frac;
+                for(unsigned int k=0; k<3; k++) {
+                    r[f*3+k] = r[(f-1)*3+k] + d(k);
+                }
+            }
+
+            // the MSD does not depend on the origin; subtracting the mean
+            // position reduces the cancellation in S1 - 2 S2
+            for(unsigned int k=0; k<3; k++) {
+                double mean = 0.0;
+                for(unsigned int f=0; f<frames; f++) {
+                    mean += r[f*3+k];
+                }
+                mean /= (double)frames;
+                for(unsigned int f=0; f<frames; f++) {
+                    r[f*3+k] -= mean;
+                }
+            }
+
+            // MSD(m) = S1(m) - 2 S2(m), where S2 is the position autocorrelation
+            // and S1 follows from a recursion over the squared positions
+            this->autocorrelation(r, fft, s2);
+            std::vector<double> &msd_acc = msd_sum[worker * ne + element_of_atom[atom]];
+            double q = 0.0;
+            std::vector<double> d2(frames + 1, 0.0);
+            for(unsigned int f=0; f<frames; f++) {
+                d2[f] = r[f*3] * r[f*3] + r[f*3+1] * r[f*3+1] + r[f*3+2] * r[f*3+2];
+                q += 2.0 * d2[f];
+            }
+            for(unsigned int m=0; m<frames; m++) {
+                if(m > 0) {
+                    q -= d2[m-1] + d2[frames - m];
+                }
+                msd_acc[m] += q / (double)(frames - m) - 2.0 * s2[m];
+            }
+
+            // velocities by central differences (one-sided at the ends)
+            const double inv_dt = 1.0 / this->timestep;
+            for(unsigned int k=0; k<3; k++) {
+                v[k] = (r[3+k] - r[k]) * inv_dt;
+                v[(frames-1)*3+k] = (r[(frames-1)*3+k] - r[(frames-2)*3+k]) * inv_dt;
+            }
+            for(unsigned int f=1; f<frames-1; f++) {
+                for(unsigned int k=0; k<3; k++) {
+                    v[f*3+k] = 0.5 * (r[(f+1)*3+k] - r[(f-1)*3+k]) * inv_dt;
+                }
+            }
+
+            this->autocorrelation(v, fft, cv);
+            std::vector<double> &vacf_acc = vacf_sum[worker * ne + element_of_atom[atom]];
+            for(unsigned int m=0; m<frames; m++) {
+                vacf_acc[m] += cv[m];
+            }
+        });
+    }
+
+    // combine the workers and average over the atoms of each element
+    this->msd.assign(ne, std::vector<double>(frames, 0.0));
+    this->vacf.assign(ne, std::vector<double>(frames, 0.0));
+    for(unsigned int e=0; e<ne; e++) {
+        const double n = nr_atoms_per_elm[e];
+        for(unsigned int w=0; w<nr_workers; w++) {
+            for(unsigned int m=0; m<frames; m++) {
+                this->msd[e][m] += msd_sum[w * ne + e][m] / n;
+                this->vacf[e][m] += vacf_sum[w * ne + e][m] / n;
+            }
+        }
+    }
+
+    return true;
+}
+
+unsigned int CorrelationAnalysis::get_nr_elements() const {
+    return this->elements.size();
+}
+
+const std::vector<std::string>& CorrelationAnalysis::get_elements() const {
+    return this->elements;
+}
+
+const std::vector<double>& CorrelationAnalysis::get_msd(unsigned int element) const {
+    return this->msd[element];
+}
+
+const std::vector<double>& CorrelationAnalysis::get_vacf(unsigned int element) const {
+    return this->vacf[element];
+}
+
+/*
+ * Self-diffusion coefficient [cm^2/s] from the Einstein relation, using a
+ * least-squares fit of MSD = 6 D t over the lag times between 10% and 50% of
+ * the trajectory length (short lags are ballistic, long lags are noisy)
+ */
+double CorrelationAnalysis::get_diffusion_coefficient(unsigned int element) const {
+    const unsigned int start = this->nr_frames / 10;
+    const unsigned int stop = std::max(start + 2, this->nr_frames / 2);
+
+    double st = 0.0, sm = 0.0, stt = 0.0, stm = 0.0;
+    unsigned int n = 0;
+    for(unsigned int m=start; m<stop && m<this->nr_frames; m++) {
+        const double t = m * this->timestep;
+        st += t;
+        sm += this->msd[element][m];
+        stt += t * t;
+        stm += t * this->msd[element][m];
+        n++;
+    }
+
+    const double denom = n * stt - st * st;
+    if(n < 2 || denom == 0.0) {
+        return 0.0;
+    }
+
+    const double slope = (n * stm - st * sm) / denom;   // [A^2/fs]
+
+    // 1 A^2/fs = 1e-16 cm^2 / 1e-15 s = 0.1 cm^2/s
+    return slope / 6.0 * 0.1;
+}
+
+/*
+ * Write the MSD and the VACF (both absolute and normalized to the value at
+ * zero lag) of every element as columns to a text file
+ */
+bool CorrelationAnalysis::write(const std::string &filename) const {
+    std::ofstream outfile(filename.c_str());
+
+    if(!outfile.is_open()) {
+        std::cerr << "Cannot open " << filename << " for writing." << std::endl;
+        return false;
+    }
+
+    const unsigned int ne = this->elements.size();
+
+    outfile << "# frames: " << this->nr_frames << ", timestep: " << this->timestep << " fs" << std::endl;
+    for(unsigned int e=0; e<ne; e++) {
+        outfile << "# D(" << this->elements[e] << ") = "
+                << double2str(this->get_diffusion_coefficient(e)) << " cm^2/s" << std::endl;
+    }
+    outfile << "# t[fs]";
+    for(unsigned int e=0; e<ne; e++) {
+        outfile << "  msd_" << this->elements[e];
+    }
+    for(unsigned int e=0; e<ne; e++) {
+        outfile << "  vacf_" << this->elements[e];
+    }
+    for(unsigned int e=0; e<ne; e++) {
+        outfile << "  nvacf_" << this->elements[e];
+    }
+    outfile << std::endl;
+
+    for(unsigned int m=0; m<this->nr_frames; m++) {
+        outfile << float2str2(m * this->timestep, "%10.3f");
+        for(unsigned int e=0; e<ne; e++) {
+            outfile << "  " << float2str2(this->msd[e][m], "%12.6f");
+        }
+        for(unsigned int e=0; e<ne; e++) {
+            outfile << "  " << float2str2(this->vacf[e][m], "%12.6e");
+        }
+        for(unsigned int e=0; e<ne; e++) {
+            const double norm = this->vacf[e][0] != 0.0 ? this->vacf[e][m] / this->vacf[e][0] : 0.0;
+            outfile << "  " << float2str2(norm, "%9.6f");
+        }
+        outfile << std::endl;
+    }
+
+    outfile.close();
+
+    return true;
+}
+
+/*
+ * Multi-origin autocorrelation of a [n x 3] series x, summed over the three
+ * components: result(m) = sum_k x(k) . x(k+m) / (n - m). The series is zero
+ * padded to a power of two of at least 2n, such that the circular
+ * correlation of the FFT equals the linear one.
+ */
+void CorrelationAnalysis::autocorrelation(const std::vector<double> &x, Eigen::FFT<double> &fft,
+                                          std::vector<double> &result) const {
+    const size_t n = x.size() / 3;
+    size_t size = 1;
+    while(size < 2 * n) {
+        size <<= 1;
+    }
+
+    std::vector<double> signal(size);
+    std::vector<std::complex<double> > spectrum;
+    std::vector<double> corr;
+
+    result.assign(n, 0.0);
+    for(unsigned int k=0; k<3; k++) {
+        std::fill(signal.begin(), signal.end(), 0.0);
+        for(size_t i=0; i<n; i++) {
+            signal[i] = x[i*3+k];
+        }
+
+        fft.fwd(spectrum, signal);
+        for(size_t i=0; i<spectrum.size(); i++) {
+            spectrum[i] = std::norm(spectrum[i]);
+        }
+        fft.inv(corr, spectrum);
+
+        for(size_t m=0; m<n; m++) {
+            result[m] += corr[m];
+        }
+    }
+
+    for(size_t m=0; m<n; m++) {
+        result[m] /= (double)(n - m);
+    }
+}
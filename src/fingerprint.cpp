@@ -0,0 +1,331 @@
+/*************************************************************************
+ *
+ *  This file is part of v2c.
+ *
+ *  Author: Ivo Filot <i.a.w.filot@tue.nl>
+ *
+ *  v2c is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  v2c is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with v2c.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ************************************************************************/
+
+#include "fingerprint.h"
+#include "bonding.h"
+#include "celllist.h"
+
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+#include <stdio.h>
+
+#define FNV_OFFSET_BASIS 14695981039346656037ULL
+#define FNV_PRIME 1099511628211ULL
+
+/*
+ * Feed the eight bytes of <value> into the FNV-1a hash <hash>
+ */
+static inline uint64_t fnv1a(uint64_t hash, uint64_t value) {
+    for(unsigned int i=0; i<8; i++) {
+        hash ^= (value >> (i * 8)) & 0xFF;
+        hash *= FNV_PRIME;
+    }
+    return hash;
+}
+
+static inline uint64_t fnv1a(uint64_t hash, const std::string &str) {
+    for(unsigned int i=0; i<str.size(); i++) {
+        hash ^= (unsigned char)str[i];
+        hash *= FNV_PRIME;
+    }
+    return fnv1a(hash, (uint64_t)str.size());
+}
+
+/*
+ * Constructor
+ *
+ * <_distance_tolerance>    bin width for distances and cell lengths [A]
+ * <_angle_tolerance>       bin width for the cosines of the cell angles
+ */
+Fingerprint::Fingerprint(double _distance_tolerance, double _angle_tolerance) {
+    this->distance_tolerance = _distance_tolerance;
+    this->angle_tolerance = _angle_tolerance;
+}
+
+/*
+ * Calculate the fingerprint of a state
+ */
+uint64_t Fingerprint::calculate(const State &state) const {
+    const unsigned int n = state.get_total_nr_atoms();
+    const double inv_dtol = 1.0 / this->distance_tolerance;
+    const double inv_atol = 1.0 / this->angle_tolerance;
+
+    // species: elements sorted by name with their number of atoms; every
+    // atom is labelled by the hash of its element name
+    std::vector<std::pair<std::string, unsigned int> > counts;
+    std::vector<uint64_t> label;
+    for(unsigned int e=0; e<state.get_nr_elements(); e++) {
+        counts.push_back(std::make_pair(state.get_elements()[e], state.get_atoms_for_element(e)));
+        label.insert(label.end(), state.get_atoms_for_element(e), fnv1a(FNV_OFFSET_BASIS, state.get_elements()[e]));
+    }
+    std::sort(counts.begin(), counts.end());
+
+    uint64_t hash = FNV_OFFSET_BASIS;
+    for(unsigned int e=0; e<counts.size(); e++) {
+        hash = fnv1a(hash, counts[e].first);
+        hash = fnv1a(hash, (uint64_t)counts[e].second);
+    }
+
+    // cell: lengths and absolute cosines of the reduced basis
+    Eigen::Matrix3d lattice = state.dimensions.cast<double>();
+    this->reduce_cell(lattice);
+    for(unsigned int i=0; i<3; i++) {
+        hash = fnv1a(hash, (uint64_t)llround(lattice.row(i).norm() * inv_dtol));
+    }
+    const unsigned int pairs[3][2] = {{0,1}, {0,2}, {1,2}};
+    for(unsigned int p=0; p<3; p++) {
+        const Eigen::Vector3d a = lattice.row(pairs[p][0]);
+        const Eigen::Vector3d b = lattice.row(pairs[p][1]);
+        hash = fnv1a(hash, (uint64_t)llround(std::fabs(a.dot(b)) / (a.norm() * b.norm()) * inv_atol));
+    }
+
+    if(n == 0 || n != state.atoms.size() || n != label.size()) {
+        return hash;
+    }
+
+    // bonded neighbors of every atom as (element label, quantized distance)
+    std::vector<unsigned int> elnrs;
+    for(unsigned int i=0; i<n; i++) {
+        elnrs.push_back(state.atoms[i].elnr);
+    }
+    std::sort(elnrs.begin(), elnrs.end());
+    elnrs.erase(std::unique(elnrs.begin(), elnrs.end()), elnrs.end());
+    const float max_cutoff = get_max_bond_cutoff(elnrs);
+
+    std::vector<std::vector<std::pair<uint64_t, uint64_t> > > neighbors(n);
+    if(max_cutoff > 0.0f) {
+        CellList cells(state.dimensions, max_cutoff);
+        cells.build(state.coordinates.col(0).data(),
+                    state.coordinates.col(1).data(),
+                    state.coordinates.col(2).data(), n, 1);
+
+        cells.for_each_pair([&](unsigned int i, unsigned int j, double r2) {
+            const float cutoff = get_bond_cutoff(state.atoms[i].elnr, state.atoms[j].elnr);
+            if(r2 < cutoff * cutoff) {
+                const uint64_t q = llround(std::sqrt(r2) * inv_dtol);
+                neighbors[i].push_back(std::make_pair(label[j], q));
+                neighbors[j].push_back(std::make_pair(label[i], q));
+            }
+        });
+    }
+
+    std::vector<uint64_t> signatures(n);
+    for(unsigned int i=0; i<n; i++) {
+        std::sort(neighbors[i].begin(), neighbors[i].end());
+        uint64_t s = fnv1a(FNV_OFFSET_BASIS, label[i]);
+        s = fnv1a(s, (uint64_t)neighbors[i].size());
+        for(unsigned int k=0; k<neighbors[i].size(); k++) {
+            s = fnv1a(s, neighbors[i][k].first);
+            s = fnv1a(s, neighbors[i][k].second);
+        }
+        signatures[i] = s;
+    }
+    std::sort(signatures.begin(), signatures.end());
+
+    for(unsigned int i=0; i<n; i++) {
+        hash = fnv1a(hash, signatures[i]);
+    }
+
+    return hash;
+}
+
+/*
+ * Returns the tolerances as a string, which is stored in the index such that
+ * fingerprints obtained with other tolerances are not mixed
+ */
+std::string Fingerprint::get_parameters() const {
+    std::ostringstream str;
+    str << "distance " << this->distance_tolerance << " angle " << this->angle_tolerance;
+    return str.str();
+}
+
+/*
+ * Returns the fingerprint as 16 hexadecimal digits
+ */
+std::string Fingerprint::to_string(uint64_t fingerprint) {
+    char buffer[17];
+    snprintf(buffer, sizeof(buffer), "%016llx", (unsigned long long)fingerprint);
+    return std::string(buffer);
+}
+
+/*
+ * Reduce the lattice vectors (rows) to a short, nearly orthogonal basis of
+ * the same lattice: the vectors are sorted by length and every vector is
+ * reduced by integer multiples of the shorter ones until no vector becomes
+ * shorter. Equivalent bases of the same lattice give the same lengths and
+ * angles.
+ */
+void Fingerprint::reduce_cell(Eigen::Matrix3d &lattice) const {
+    for(unsigned int iter=0; iter<100; iter++) {
+        // sort by length
+        for(unsigned int i=0; i<2; i++) {
+            for(unsigned int j=0; j<2-i; j++) {
+                if(lattice.row(j).squaredNorm() > lattice.row(j+1).squaredNorm()) {
+                    const Eigen::RowVector3d tmp = lattice.row(j);
+                    lattice.row(j) = lattice.row(j+1);
+                    lattice.row(j+1) = tmp;
+                }
+            }
+        }
+
+        bool changed = false;
+        for(unsigned int i=1; i<3; i++) {
+            for(unsigned int j=0; j<i; j++) {
+                const double m = std::floor(lattice.row(i).dot(lattice.row(j)) /
+                                            lattice.row(j).squaredNorm() + 0.5);
+                if(m != 0.0) {
+                    const Eigen::RowVector3d reduced = lattice.row(i) - m * lattice.row(j);
+                    if(reduced.squaredNorm() < lattice.row(i).squaredNorm() * (1.0 - 1e-10)) {
+                        lattice.row(i) = reduced;
+                        changed = true;
+                    }
+                }
+            }
+        }
+
+        // also try the combinations c +/- a +/- b
+        for(int sa=-1; sa<=1; sa+=2) {
+            for(int sb=-1; sb<=1; sb+=2) {
+                const Eigen::RowVector3d reduced = lattice.row(2) + sa * lattice.row(0) + sb * lattice.row(1);
+                if(reduced.squaredNorm() < lattice.row(2).squaredNorm() * (1.0 - 1e-10)) {
+                    lattice.row(2) = reduced;
+                    changed = true;
+                }
+            }
+        }
+
+        if(!changed) {
+            break;
+        }
+    }
+}
+
+/*
+ * Constructor; the tolerances of <fingerprint> are stored in the header of
+ * the index file
+ */
+FingerprintIndex::FingerprintIndex(const Fingerprint &fingerprint) {
+    this->parameters = fingerprint.get_parameters();
+}
+
+/*
+ * Load the entries of an index file and open it for appending new entries.
+ * A file that does not exist yet is created.
+ */
+bool FingerprintIndex::open(const std::string &_filename) {
+    this->filename = _filename;
+    const std::string header = std::string(FINGERPRINT_INDEX_HEADER) + " (" + this->parameters + ")";
+
+    bool is_new = true;
+    std::ifstream infile(this->filename.c_str());
+    if(infile.is_open()) {
+        std::string line;
+        if(std::getline(infile, line)) {
+            is_new = false;
+            if(line != header) {
+                std::cerr << this->filename << " is not a fingerprint index created with the same tolerances." << std::endl;
+                return false;
+            }
+        }
+
+        // entries: <fingerprint> <state id> <file>[<tab><path>]
+        unsigned int lineno = 1;
+        while(std::getline(infile, line)) {
+            lineno++;
+            if(line.empty() || line[0] == '#') {
+                continue;
+            }
+
+            std::istringstream str(line);
+            std::string hex;
+            FingerprintEntry entry;
+            if(!(str >> hex >> entry.state_id) || !std::getline(str >> std::ws, entry.filename)) {
+                std::cerr << "Skipping malformed line " << lineno << " of " << this->filename << std::endl;
+                continue;
+            }
+            const size_t tab = entry.filename.find('\t');
+            if(tab != std::string::npos) {
+                entry.path = entry.filename.substr(tab + 1);
+                entry.filename.erase(tab);
+            }
+
+            const uint64_t fingerprint = strtoull(hex.c_str(), NULL, 16);
+            if(this->entries.find(fingerprint) == this->entries.end()) {
+                this->entries[fingerprint] = entry;
+            }
+        }
+        infile.close();
+    }
+
+    this->outfile.open(this->filename.c_str(), std::ios::app);
+    if(!this->outfile.is_open()) {
+        std::cerr << "Cannot open " << this->filename << " for writing." << std::endl;
+        return false;
+    }
+
+    if(is_new) {
+        this->outfile << header << std::endl;
+    }
+
+    return true;
+}
+
+/*
+ * Returns the entry with the given fingerprint, or NULL when the fingerprint
+ * is not in the index
+ */
+const FingerprintEntry* FingerprintIndex::find(uint64_t fingerprint) const {
+    std::unordered_map<uint64_t, FingerprintEntry>::const_iterator it = this->entries.find(fingerprint);
+    if(it == this->entries.end()) {
+        return NULL;
+    }
+    return &it->second;
+}
+
+/*
+ * Add a fingerprint to the index (and to the index file when one is open),
+ * with the <path> that state <state_id> of <source> was written to; returns
+ * false when the fingerprint was already present
+ */
+bool FingerprintIndex::insert(uint64_t fingerprint, const std::string &source, unsigned int state_id,
+                              const std::string &path) {
+    if(this->entries.find(fingerprint) != this->entries.end()) {
+        return false;
+    }
+
+    FingerprintEntry entry;
+    entry.filename = source;
+    entry.state_id = state_id;
+    entry.path = path;
+    this->entries[fingerprint] = entry;
+
+    if(this->outfile.is_open()) {
+        this->outfile << Fingerprint::to_string(fingerprint) << " " << state_id << " " << source
+                      << "\t" << path << std::endl;
+    }
+
+    return true;
+}
+
+size_t FingerprintIndex::size() const {
+    return this->entries.size();
+}
@@ -0,0 +1,344 @@
+/*************************************************************************
+ *
+ *  This file is part of v2c.
+ *
+ *  Author: Ivo Filot <i.a.w.filot@tue.nl>
+ *
+ *  v2c is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  v2c is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with v2c.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ************************************************************************/
+
+
+#include "framestore.h"
+
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+/*
+ * Number of 32 bit integers, doubles and geometry scalars (Real, as in the
+ * build) at the start of a record: header index, state id, number of atoms,
+ * available observables and number of per-element force maxima; the energy
+ * and the thirteen observable values; the nine cell components. The
+ * per-element force maxima (doubles) and the atoms follow.
+ */
+#define FRAME_RECORD_NR_INTS     5
+#define FRAME_RECORD_NR_DOUBLES  14
+#define FRAME_RECORD_NR_REALS    9
+#define FRAME_RECORD_FIXED_SIZE  (FRAME_RECORD_NR_INTS * 4 + FRAME_RECORD_NR_DOUBLES * 8 + FRAME_RECORD_NR_REALS * sizeof(Real))
+#define FRAME_RECORD_ATOM_SIZE   (4 + 6 * sizeof(Real))   // element, position and force
+
+FrameStore::FrameStore() {
+    this->memory_budget = FRAME_STORE_UNLIMITED;
+    this->spill_fd = -1;
+    this->spill_size = 0;
+    this->resident_bytes = 0;
+}
+
+FrameStore::~FrameStore() {
+    this->clear();
+}
+
+/*
+ * Limit the memory taken by the frames to <_bytes>; frames beyond that are
+ * spilled to a file in <_directory>. Frames that are already stored are
+ * spilled when the new budget demands so.
+ */
+void FrameStore::set_memory_budget(size_t _bytes, const std::string &_directory) {
+    this->memory_budget = _bytes;
+    this->spill_directory = _directory;
+
+    while(this->memory_budget != FRAME_STORE_UNLIMITED && this->resident_bytes > this->memory_budget &&
+          this->resident.size() > 1 && (this->spill_fd >= 0 || this->open_spill_file())) {
+        this->spill_oldest();
+    }
+}
+
+size_t FrameStore::get_memory_budget() const {
+    return this->memory_budget;
+}
+
+/*
+ * Append a frame; when the frames in memory exceed the budget, the oldest
+ * ones are spilled. The newest frame always stays in memory. When no spill
+ * file can be created, all frames are kept in memory.
+ */
+void FrameStore::push_back(const State &state) {
+    this->resident.push_back(state);
+    this->resident_bytes += estimate_size(state);
+
+    if(this->memory_budget == FRAME_STORE_UNLIMITED || this->resident_bytes <= this->memory_budget) {
+        return;
+    }
+
+    if(this->spill_fd < 0 && !this->open_spill_file()) {
+        this->memory_budget = FRAME_STORE_UNLIMITED;
+        return;
+    }
+
+    while(this->memory_budget != FRAME_STORE_UNLIMITED && this->resident_bytes > this->memory_budget &&
+          this->resident.size() > 1) {
+        this->spill_oldest();
+    }
+}
+
+/*
+ * Remove all frames and release the spill file
+ */
+void FrameStore::clear() {
+    this->resident.clear();
+    this->resident_bytes = 0;
+    this->headers.clear();
+    this->offsets.clear();
+    this->spill_size = 0;
+
+    if(this->spill_fd >= 0) {
+        close(this->spill_fd);
+        this->spill_fd = -1;
+    }
+}
+
+size_t FrameStore::size() const {
+    return this->offsets.size() + this->resident.size();
+}
+
+bool FrameStore::empty() const {
+    return this->size() == 0;
+}
+
+size_t FrameStore::get_nr_spilled() const {
+    return this->offsets.size();
+}
+
+/*
+ * Returns (a copy of) frame <i>; spilled frames are read from the spill file
+ */
+State FrameStore::operator[](size_t i) const {
+    if(i < this->offsets.size()) {
+        return this->read_record(i);
+    }
+    return this->resident[i - this->offsets.size()];
+}
+
+/*
+ * Returns frame <i> without copying it when it is in memory; a spilled
+ * frame is read into <buffer>. The reference is valid until the next frame
+ * is added or the store is cleared.
+ */
+const State& FrameStore::get(size_t i, State &buffer) const {
+    if(i < this->offsets.size()) {
+        buffer = this->read_record(i);
+        return buffer;
+    }
+    return this->resident[i - this->offsets.size()];
+}
+
+State FrameStore::back() const {
+    return (*this)[this->size() - 1];
+}
+
+/*
+ * Estimate of the heap memory taken by a state [bytes]
+ */
+size_t FrameStore::estimate_size(const State &state) {
+    size_t size = sizeof(State) + state.atoms.capacity() * sizeof(Atom) +
+                  state.coordinates.size() * sizeof(Real) + state.get_filename().capacity() +
+                  state.get_observables().max_force_element.capacity() * sizeof(double);
+
+    const std::vector<std::string> &elements = state.get_elements();
+    for(unsigned int i=0; i<elements.size(); i++) {
+        size += sizeof(std::string) + elements[i].capacity() + 2 * sizeof(unsigned int);
+    }
+
+    return size;
+}
+
+/*
+ * Write the oldest frame in memory to the end of the spill file
+ */
+void FrameStore::spill_oldest() {
+    const State &state = this->resident.front();
+    const size_t nr_atoms = state.atoms.size();
+    const StateObservables &obs = state.get_observables();
+    const size_t nr_maxima = obs.max_force_element.size();
+    std::vector<char> record(FRAME_RECORD_FIXED_SIZE + nr_maxima * sizeof(double) + nr_atoms * FRAME_RECORD_ATOM_SIZE);
+    char *ptr = record.data();
+
+    const uint32_t ints[FRAME_RECORD_NR_INTS] = {this->find_header(state), state.get_state_id(),
+                                                 (uint32_t)nr_atoms, obs.available, (uint32_t)nr_maxima};
+    const double doubles[FRAME_RECORD_NR_DOUBLES] = {state.get_energy(),
+        obs.stress[0], obs.stress[1], obs.stress[2], obs.stress[3], obs.stress[4], obs.stress[5],
+        obs.magnetization, obs.kinetic_energy, obs.temperature, obs.cpu_time, obs.real_time,
+        obs.max_force, obs.rms_force};
+    Real cell[FRAME_RECORD_NR_REALS];
+    for(unsigned int i=0; i<3; i++) {
+        for(unsigned int j=0; j<3; j++) {
+            cell[i*3+j] = state.dimensions(i,j);
+        }
+    }
+
+    memcpy(ptr, ints, sizeof(ints));
+    ptr += sizeof(ints);
+    memcpy(ptr, doubles, sizeof(doubles));
+    ptr += sizeof(doubles);
+    memcpy(ptr, cell, sizeof(cell));
+    ptr += sizeof(cell);
+    if(nr_maxima > 0) {
+        memcpy(ptr, obs.max_force_element.data(), nr_maxima * sizeof(double));
+        ptr += nr_maxima * sizeof(double);
+    }
+
+    for(size_t i=0; i<nr_atoms; i++) {
+        const Atom &atom = state.atoms[i];
+        const uint32_t elnr = atom.elnr;
+        const Real values[6] = {atom.pos[0], atom.pos[1], atom.pos[2],
+                                atom.force[0], atom.force[1], atom.force[2]};
+        memcpy(ptr, &elnr, sizeof(elnr));
+        memcpy(ptr + sizeof(elnr), values, sizeof(values));
+        ptr += FRAME_RECORD_ATOM_SIZE;
+    }
+
+    size_t written = 0;
+    while(written < record.size()) {
+        const ssize_t result = pwrite(this->spill_fd, record.data() + written, record.size() - written,
+                                      this->spill_size + written);
+        if(result <= 0) {
+            std::cerr << "Cannot write to the frame spill file; keeping the frames in memory." << std::endl;
+            this->memory_budget = FRAME_STORE_UNLIMITED;
+            return;
+        }
+        written += result;
+    }
+
+    this->offsets.push_back(this->spill_size);
+    this->spill_size += record.size();
+    this->resident_bytes -= std::min(this->resident_bytes, estimate_size(state));
+    this->resident.pop_front();
+}
+
+/*
+ * Index of the shared properties of <state>; consecutive frames usually
+ * share them, such that only the last entry needs to be compared
+ */
+unsigned int FrameStore::find_header(const State &state) {
+    if(!this->headers.empty()) {
+        const FrameHeader &last = this->headers.back();
+        if(last.filename == state.get_filename() && last.elements == state.get_elements() &&
+           last.elements_uint == state.get_elements_uint() && last.nr_atoms == state.get_nr_atoms_per_element()) {
+            return this->headers.size() - 1;
+        }
+    }
+
+    FrameHeader header;
+    header.elements = state.get_elements();
+    header.elements_uint = state.get_elements_uint();
+    header.nr_atoms = state.get_nr_atoms_per_element();
+    header.filename = state.get_filename();
+    this->headers.push_back(header);
+
+    return this->headers.size() - 1;
+}
+
+/*
+ * Create the (anonymous) spill file
+ */
+bool FrameStore::open_spill_file() {
+    std::string directory = this->spill_directory;
+    if(directory.empty()) {
+        const char *tmpdir = getenv("TMPDIR");
+        directory = (tmpdir != NULL && tmpdir[0] != '\0') ? tmpdir : "/tmp";
+    }
+
+    std::string path = directory + "/v2c-frames-XXXXXX";
+    std::vector<char> name(path.begin(), path.end());
+    name.push_back('\0');
+
+    this->spill_fd = mkstemp(name.data());
+    if(this->spill_fd < 0) {
+        std::cerr << "Cannot create a frame spill file in " << directory
+                  << "; keeping the frames in memory." << std::endl;
+        return false;
+    }
+    unlink(name.data());
+
+    return true;
+}
+
+/*
+ * Rebuild spilled frame <i> from its record
+ */
+State FrameStore::read_record(size_t i) const {
+    const uint64_t end = (i + 1 < this->offsets.size()) ? this->offsets[i+1] : this->spill_size;
+    std::vector<char> record(end - this->offsets[i]);
+
+    size_t nread = 0;
+    while(nread < record.size()) {
+        const ssize_t result = pread(this->spill_fd, record.data() + nread, record.size() - nread,
+                                     this->offsets[i] + nread);
+        if(result <= 0) {
+            std::cerr << "Cannot read frame " << (i + 1) << " from the frame spill file." << std::endl;
+            return State(0.0, Matrix3::Zero());
+        }
+        nread += result;
+    }
+
+    uint32_t ints[FRAME_RECORD_NR_INTS];
+    double doubles[FRAME_RECORD_NR_DOUBLES];
+    std::vector<Real> cell(FRAME_RECORD_NR_REALS);
+    const char *ptr = record.data();
+    memcpy(ints, ptr, sizeof(ints));
+    ptr += sizeof(ints);
+    memcpy(doubles, ptr, sizeof(doubles));
+    ptr += sizeof(doubles);
+    memcpy(cell.data(), ptr, FRAME_RECORD_NR_REALS * sizeof(Real));
+    ptr += FRAME_RECORD_NR_REALS * sizeof(Real);
+
+    StateObservables obs;
+    obs.max_force_element.resize(ints[4]);
+    if(ints[4] > 0) {
+        memcpy(obs.max_force_element.data(), ptr, ints[4] * sizeof(double));
+        ptr += ints[4] * sizeof(double);
+    }
+
+    std::vector<Atom> atoms;
+    atoms.reserve(ints[2]);
+    for(uint32_t a=0; a<ints[2]; a++) {
+        uint32_t elnr;
+        Real values[6];
+        memcpy(&elnr, ptr, sizeof(elnr));
+        memcpy(values, ptr + sizeof(elnr), sizeof(values));
+        atoms.push_back(Atom(elnr, values[0], values[1], values[2], values[3], values[4], values[5]));
+        ptr += FRAME_RECORD_ATOM_SIZE;
+    }
+
+    const FrameHeader &header = this->headers[ints[0]];
+    State state(doubles[0], cell, atoms, header.elements, header.elements_uint, header.nr_atoms,
+                header.filename, ints[1]);
+
+    obs.available = ints[3];
+    for(unsigned int k=0; k<6; k++) {
+        obs.stress[k] = doubles[1+k];
+    }
+    obs.magnetization = doubles[7];
+    obs.kinetic_energy = doubles[8];
+    obs.temperature = doubles[9];
+    obs.cpu_time = doubles[10];
+    obs.real_time = doubles[11];
+    obs.max_force = doubles[12];
+    obs.rms_force = doubles[13];
+    state.set_observables(obs);
+
+    return state;
+}
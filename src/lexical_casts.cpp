@@ -49,6 +49,16 @@ std::string double2str(const double &i) {
   return std::string(ss.str());
 }
 
+std::string double2str2(const double &i, const char* str) {
+    char buffer [100];
+	#ifdef WIN32
+		_snprintf_s(buffer, 100, str, i);
+	#else
+		snprintf(buffer, 100, str, i);
+	#endif
+    return std::string(buffer);
+}
+
 float str2float(const std::string &_str) {
     float result = (float)atof(_str.c_str());
     return result;
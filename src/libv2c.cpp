@@ -0,0 +1,197 @@
+/*************************************************************************
+ *
+ *  This file is part of v2c.
+ *
+ *  Author: Ivo Filot <i.a.w.filot@tue.nl>
+ *
+ *  v2c is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  v2c is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with v2c.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ************************************************************************/
+
+#include <string>
+#include <new>
+#include <memory>
+#include <cstdio>
+
+#include "libv2c.h"
+#include "vaspreader.h"
+#include "trajectory.h"
+
+/*
+ * The handle handed out to the caller. The frames are held in a Trajectory,
+ * such that all quantities live in contiguous buffers.
+ */
+struct v2c_trajectory {
+    Trajectory trajectory;
+    unsigned int cursor;
+};
+
+/*
+ * Error message of the last failing call on this thread
+ */
+static __thread char last_error[256] = "";
+
+static void set_last_error(const std::string &msg) {
+    snprintf(last_error, sizeof(last_error), "%s", msg.c_str());
+}
+
+/*
+ * Fill a frame view for frame <index>
+ */
+static void fill_frame(const v2c_trajectory *trajectory, unsigned int index, v2c_frame *frame) {
+    frame->index = index;
+    frame->energy = trajectory->trajectory.get_energies()[index];
+    frame->positions = trajectory->trajectory.get_positions(index);
+    frame->forces = trajectory->trajectory.get_forces(index);
+    frame->cell = trajectory->trajectory.get_cell(index);
+}
+
+int v2c_api_version(void) {
+    return V2C_API_VERSION;
+}
+
+const char* v2c_last_error(void) {
+    return last_error;
+}
+
+/*
+ * Open an OUTCAR and parse all frames. The frames are appended to the
+ * Trajectory as they are parsed, without keeping the States. Returns NULL on
+ * failure, in which case the reason can be obtained via v2c_last_error.
+ */
+v2c_trajectory* v2c_open(const char *filename) {
+    if(filename == NULL) {
+        set_last_error("No filename given");
+        return NULL;
+    }
+
+    try {
+        std::unique_ptr<v2c_trajectory> trajectory(new v2c_trajectory);
+        trajectory->cursor = 0;
+
+        bool consistent = true;
+        VaspReader vr;
+        vr.set_state_callback([&](const State &state) {
+            consistent = consistent && trajectory->trajectory.append(state);
+        }, false);
+        if(!vr.read(filename)) {
+            set_last_error(std::string("Cannot read ") + filename);
+            return NULL;
+        }
+        if(!consistent) {
+            set_last_error(std::string("The number of atoms changes between the frames of ") + filename);
+            return NULL;
+        }
+
+        return trajectory.release();
+    } catch(const std::bad_alloc &e) {
+        set_last_error(std::string("Out of memory while reading ") + filename);
+    } catch(const std::exception &e) {
+        set_last_error(e.what());
+    }
+
+    return NULL;
+}
+
+/*
+ * Release the trajectory and all buffers handed out for it
+ */
+void v2c_close(v2c_trajectory *trajectory) {
+    delete trajectory;
+}
+
+unsigned int v2c_get_nr_frames(const v2c_trajectory *trajectory) {
+    return trajectory->trajectory.get_nr_frames();
+}
+
+unsigned int v2c_get_nr_atoms(const v2c_trajectory *trajectory) {
+    return trajectory->trajectory.get_nr_atoms();
+}
+
+unsigned int v2c_get_nr_elements(const v2c_trajectory *trajectory) {
+    return trajectory->trajectory.get_elements().size();
+}
+
+const char* v2c_get_element(const v2c_trajectory *trajectory, unsigned int i) {
+    if(i >= trajectory->trajectory.get_elements().size()) {
+        set_last_error("Element index out of range");
+        return NULL;
+    }
+    return trajectory->trajectory.get_elements()[i].c_str();
+}
+
+unsigned int v2c_get_atoms_for_element(const v2c_trajectory *trajectory, unsigned int i) {
+    if(i >= trajectory->trajectory.get_nr_atoms_per_element().size()) {
+        set_last_error("Element index out of range");
+        return 0;
+    }
+    return trajectory->trajectory.get_nr_atoms_per_element()[i];
+}
+
+const unsigned int* v2c_get_species(const v2c_trajectory *trajectory) {
+    return trajectory->trajectory.get_species().data();
+}
+
+/*
+ * Fill <frame> with the next frame of the trajectory. Returns 1 when a frame
+ * was retrieved and 0 when the end of the trajectory has been reached.
+ */
+int v2c_next_frame(v2c_trajectory *trajectory, v2c_frame *frame) {
+    if(trajectory->cursor >= trajectory->trajectory.get_nr_frames()) {
+        return 0;
+    }
+
+    fill_frame(trajectory, trajectory->cursor, frame);
+    trajectory->cursor++;
+
+    return 1;
+}
+
+/*
+ * Restart the iteration of v2c_next_frame at the first frame
+ */
+void v2c_rewind(v2c_trajectory *trajectory) {
+    trajectory->cursor = 0;
+}
+
+/*
+ * Fill <frame> with frame <index>. Returns 1 on success and 0 when the index
+ * is out of range.
+ */
+int v2c_get_frame(const v2c_trajectory *trajectory, unsigned int index, v2c_frame *frame) {
+    if(index >= trajectory->trajectory.get_nr_frames()) {
+        set_last_error("Frame index out of range");
+        return 0;
+    }
+
+    fill_frame(trajectory, index, frame);
+
+    return 1;
+}
+
+const float* v2c_get_positions(const v2c_trajectory *trajectory) {
+    return trajectory->trajectory.get_positions();
+}
+
+const float* v2c_get_forces(const v2c_trajectory *trajectory) {
+    return trajectory->trajectory.get_forces();
+}
+
+const float* v2c_get_cells(const v2c_trajectory *trajectory) {
+    return trajectory->trajectory.get_cells();
+}
+
+const double* v2c_get_energies(const v2c_trajectory *trajectory) {
+    return trajectory->trajectory.get_energies();
+}
@@ -0,0 +1,202 @@
+/*************************************************************************
+ *
+ *  This file is part of v2c.
+ *
+ *  Author: Ivo Filot <i.a.w.filot@tue.nl>
+ *
+ *  v2c is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  v2c is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with v2c.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ************************************************************************/
+
+#include "npyreader.h"
+
+#include <algorithm>
+
+/*
+ * Default constructor
+ */
+NpyReader::NpyReader() {}
+
+/*
+ * Read a complete .npy file
+ */
+bool NpyReader::read(const std::string &filename) {
+    std::ifstream infile(filename.c_str(), std::ios::binary);
+
+    if(!infile.is_open()) {
+        std::cerr << "Cannot open " << filename << std::endl;
+        return false;
+    }
+
+    char preamble[10];
+    infile.read(preamble, 10);
+    if(!infile || std::string(preamble, 6) != std::string("\x93NUMPY", 6)) {
+        std::cerr << filename << " is not a .npy file." << std::endl;
+        return false;
+    }
+
+    // version 1.0 uses a 16 bit header length, version 2.0 a 32 bit one
+    size_t header_length = (unsigned char)preamble[8] | ((unsigned char)preamble[9] << 8);
+    if(preamble[6] >= 2) {
+        char extra[2];
+        infile.read(extra, 2);
+        header_length |= ((size_t)(unsigned char)extra[0] << 16) | ((size_t)(unsigned char)extra[1] << 24);
+    }
+
+    std::string header(header_length, ' ');
+    infile.read(&header[0], header_length);
+    if(!infile || !this->parse_header(header)) {
+        std::cerr << "Cannot parse the header of " << filename << std::endl;
+        return false;
+    }
+
+    size_t element_size = atoi(this->descr.substr(2).c_str());
+    if(this->descr[1] == 'U') {
+        element_size *= 4;
+    }
+
+    this->data.resize(this->get_nr_elements() * element_size);
+    infile.read(this->data.data(), this->data.size());
+
+    if(!infile) {
+        std::cerr << filename << " is truncated." << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+const std::string& NpyReader::get_descr() const {
+    return this->descr;
+}
+
+const std::vector<size_t>& NpyReader::get_shape() const {
+    return this->shape;
+}
+
+size_t NpyReader::get_nr_elements() const {
+    size_t n = 1;
+    for(unsigned int i=0; i<this->shape.size(); i++) {
+        n *= this->shape[i];
+    }
+    return n;
+}
+
+/*
+ * Copy the data as float32 array; fails when the array holds another type
+ */
+bool NpyReader::get(std::vector<float> &result) const {
+    if(this->descr != "<f4") {
+        return false;
+    }
+    result.resize(this->get_nr_elements());
+    std::copy(this->data.begin(), this->data.end(), (char*)result.data());
+    return true;
+}
+
+/*
+ * Copy the data as float64 array; fails when the array holds another type
+ */
+bool NpyReader::get(std::vector<double> &result) const {
+    if(this->descr != "<f8") {
+        return false;
+    }
+    result.resize(this->get_nr_elements());
+    std::copy(this->data.begin(), this->data.end(), (char*)result.data());
+    return true;
+}
+
+/*
+ * Copy the data as int32 array; fails when the array holds another type
+ */
+bool NpyReader::get(std::vector<int32_t> &result) const {
+    if(this->descr != "<i4") {
+        return false;
+    }
+    result.resize(this->get_nr_elements());
+    std::copy(this->data.begin(), this->data.end(), (char*)result.data());
+    return true;
+}
+
+/*
+ * Copy the data as array of strings; only ASCII characters are retained
+ */
+bool NpyReader::get(std::vector<std::string> &result) const {
+    if(this->descr.size() < 3 || this->descr[1] != 'U') {
+        return false;
+    }
+
+    const size_t width = atoi(this->descr.substr(2).c_str());
+    result.clear();
+    for(size_t i=0; i<this->get_nr_elements(); i++) {
+        std::string str;
+        for(size_t j=0; j<width; j++) {
+            const char c = this->data[(i * width + j) * 4];
+            if(c == 0) {
+                break;
+            }
+            str += c;
+        }
+        result.push_back(str);
+    }
+
+    return true;
+}
+
+/*
+ * Extract the data type and the shape from the header dictionary, e.g.
+ * {'descr': '<f4', 'fortran_order': False, 'shape': (10, 3), }
+ */
+bool NpyReader::parse_header(const std::string &header) {
+    size_t pos = header.find("'descr'");
+    if(pos == std::string::npos) {
+        return false;
+    }
+    size_t start = header.find('\'', pos + 7);
+    size_t end = header.find('\'', start + 1);
+    if(start == std::string::npos || end == std::string::npos) {
+        return false;
+    }
+    this->descr = header.substr(start + 1, end - start - 1);
+
+    // only arrays in C order are written by NpyWriter
+    if(header.find("'fortran_order': False") == std::string::npos) {
+        return false;
+    }
+
+    pos = header.find("'shape'");
+    start = header.find('(', pos);
+    end = header.find(')', start);
+    if(pos == std::string::npos || start == std::string::npos || end == std::string::npos) {
+        return false;
+    }
+
+    this->shape.clear();
+    std::string dims = header.substr(start + 1, end - start - 1);
+    size_t i = 0;
+    while(i < dims.size()) {
+        size_t next = dims.find(',', i);
+        if(next == std::string::npos) {
+            next = dims.size();
+        }
+        std::string dim = dims.substr(i, next - i);
+        if(dim.find_first_of("0123456789") != std::string::npos) {
+            this->shape.push_back(strtoull(dim.c_str(), NULL, 10));
+        }
+        i = next + 1;
+    }
+
+    return this->descr == "<f4" || this->descr == "<f8" || this->descr == "<i4" ||
+           (this->descr.size() > 2 && this->descr[1] == 'U');
+}
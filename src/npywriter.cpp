@@ -0,0 +1,350 @@
+/*************************************************************************
+ *
+ *  This file is part of v2c.
+ *
+ *  Author: Ivo Filot <i.a.w.filot@tue.nl>
+ *
+ *  v2c is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  v2c is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with v2c.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ************************************************************************/
+
+#include "npywriter.h"
+
+#include <algorithm>
+
+/*
+ * Construct the lookup table for the (reflected) CRC-32 polynomial
+ */
+static std::vector<uint32_t> build_crc_table() {
+    std::vector<uint32_t> table(256);
+    for(uint32_t i=0; i<256; i++) {
+        uint32_t c = i;
+        for(unsigned int j=0; j<8; j++) {
+            c = (c & 1) ? (0xEDB88320 ^ (c >> 1)) : (c >> 1);
+        }
+        table[i] = c;
+    }
+    return table;
+}
+
+/*
+ * Default constructor
+ */
+NpyWriter::NpyWriter() {}
+
+/*
+ * Write a float array to a .npy file
+ */
+bool NpyWriter::write(const std::string &filename, const float *data, const std::vector<size_t> &shape) {
+    return this->write_npy(filename, "<f4", (const char*)data, sizeof(float), shape);
+}
+
+/*
+ * Write a double array to a .npy file
+ */
+bool NpyWriter::write(const std::string &filename, const double *data, const std::vector<size_t> &shape) {
+    return this->write_npy(filename, "<f8", (const char*)data, sizeof(double), shape);
+}
+
+/*
+ * Write an integer array to a .npy file
+ */
+bool NpyWriter::write(const std::string &filename, const int32_t *data, const std::vector<size_t> &shape) {
+    return this->write_npy(filename, "<i4", (const char*)data, sizeof(int32_t), shape);
+}
+
+/*
+ * Write an array of strings to a .npy file as fixed-width unicode strings
+ */
+bool NpyWriter::write(const std::string &filename, const std::vector<std::string> &data) {
+    size_t width = 0;
+    std::string buffer = this->encode_strings(data, &width);
+    std::string descr = "<U" + int2str(width);
+    return this->write_npy(filename, descr.c_str(), buffer.data(), 4 * width, std::vector<size_t>(1, data.size()));
+}
+
+/*
+ * Open <outfile> as .npy file for an array of type <descr> ("<f4", "<f8" or
+ * "<i4") and shape <shape> and write the header; the caller writes the
+ * data, in C order, after it
+ */
+bool NpyWriter::open_npy(std::ofstream &outfile, const std::string &filename, const char *descr,
+                         const std::vector<size_t> &shape) const {
+    outfile.open(filename.c_str(), std::ios::binary);
+
+    if(!outfile.is_open()) {
+        std::cerr << "Cannot open " << filename << " for writing." << std::endl;
+        return false;
+    }
+
+    const std::string header = this->build_header(descr, shape);
+    outfile.write(header.c_str(), header.size());
+
+    return !outfile.fail();
+}
+
+/*
+ * Start a new .npz archive. Arrays are added to the archive using add_to_npz
+ * and the archive is finalized by close_npz.
+ */
+bool NpyWriter::open_npz(const std::string &filename) {
+    this->npz_entries.clear();
+    this->npz_file.open(filename.c_str(), std::ios::binary);
+
+    if(!this->npz_file.is_open()) {
+        std::cerr << "Cannot open " << filename << " for writing." << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+/*
+ * Add a float array to the open .npz archive
+ */
+bool NpyWriter::add_to_npz(const std::string &name, const float *data, const std::vector<size_t> &shape) {
+    return this->add_npy(name, "<f4", (const char*)data, sizeof(float), shape);
+}
+
+/*
+ * Add a double array to the open .npz archive
+ */
+bool NpyWriter::add_to_npz(const std::string &name, const double *data, const std::vector<size_t> &shape) {
+    return this->add_npy(name, "<f8", (const char*)data, sizeof(double), shape);
+}
+
+/*
+ * Add an integer array to the open .npz archive
+ */
+bool NpyWriter::add_to_npz(const std::string &name, const int32_t *data, const std::vector<size_t> &shape) {
+    return this->add_npy(name, "<i4", (const char*)data, sizeof(int32_t), shape);
+}
+
+/*
+ * Add an array of strings to the open .npz archive
+ */
+bool NpyWriter::add_to_npz(const std::string &name, const std::vector<std::string> &data) {
+    size_t width = 0;
+    std::string buffer = this->encode_strings(data, &width);
+    std::string descr = "<U" + int2str(width);
+    return this->add_npy(name, descr.c_str(), buffer.data(), 4 * width, std::vector<size_t>(1, data.size()));
+}
+
+/*
+ * Write the central directory of the .npz archive and close the file
+ */
+bool NpyWriter::close_npz() {
+    if(!this->npz_file.is_open()) {
+        return false;
+    }
+
+    uint32_t cd_offset = (uint32_t)this->npz_file.tellp();
+    for(unsigned int i=0; i<this->npz_entries.size(); i++) {
+        const NpzEntry &entry = this->npz_entries[i];
+        this->write_uint32(0x02014b50);     // central file header signature
+        this->write_uint16(20);             // version made by
+        this->write_uint16(20);             // version needed to extract
+        this->write_uint16(0);              // general purpose flags
+        this->write_uint16(0);              // compression method (stored)
+        this->write_uint16(0);              // last modification time
+        this->write_uint16(0x21);           // last modification date (1980-01-01)
+        this->write_uint32(entry.crc);
+        this->write_uint32(entry.size);     // compressed size
+        this->write_uint32(entry.size);     // uncompressed size
+        this->write_uint16(entry.name.size());
+        this->write_uint16(0);              // extra field length
+        this->write_uint16(0);              // comment length
+        this->write_uint16(0);              // disk number
+        this->write_uint16(0);              // internal attributes
+        this->write_uint32(0);              // external attributes
+        this->write_uint32(entry.offset);
+        this->npz_file.write(entry.name.c_str(), entry.name.size());
+    }
+    uint32_t cd_size = (uint32_t)this->npz_file.tellp() - cd_offset;
+
+    this->write_uint32(0x06054b50);         // end of central directory signature
+    this->write_uint16(0);
+    this->write_uint16(0);
+    this->write_uint16(this->npz_entries.size());
+    this->write_uint16(this->npz_entries.size());
+    this->write_uint32(cd_size);
+    this->write_uint32(cd_offset);
+    this->write_uint16(0);
+
+    bool result = this->npz_file.good();
+    this->npz_file.close();
+    this->npz_entries.clear();
+
+    return result;
+}
+
+/*
+ * Construct the .npy (version 1.0) header. The header is padded with spaces
+ * such that the data block starts at a multiple of NPY_HEADER_ALIGNMENT.
+ */
+std::string NpyWriter::build_header(const char *descr, const std::vector<size_t> &shape) const {
+    std::string dict = std::string("{'descr': '") + descr + "', 'fortran_order': False, 'shape': (";
+    for(unsigned int i=0; i<shape.size(); i++) {
+        dict += int2str(shape[i]);
+        if(shape.size() == 1 || i != shape.size() - 1) {
+            dict += ",";
+        }
+        if(i != shape.size() - 1) {
+            dict += " ";
+        }
+    }
+    dict += "), }";
+
+    // magic string (6) + version (2) + header length (2) + dict + newline
+    size_t total = 10 + dict.size() + 1;
+    size_t padding = (NPY_HEADER_ALIGNMENT - total % NPY_HEADER_ALIGNMENT) % NPY_HEADER_ALIGNMENT;
+    dict += std::string(padding, ' ') + "\n";
+
+    std::string header("\x93NUMPY\x01\x00", 8);
+    header += (char)(dict.size() & 0xFF);
+    header += (char)((dict.size() >> 8) & 0xFF);
+    header += dict;
+
+    return header;
+}
+
+/*
+ * Write a complete .npy file
+ */
+bool NpyWriter::write_npy(const std::string &filename, const char *descr, const char *data,
+                          size_t element_size, const std::vector<size_t> &shape) {
+    std::ofstream outfile(filename.c_str(), std::ios::binary);
+
+    if(!outfile.is_open()) {
+        std::cerr << "Cannot open " << filename << " for writing." << std::endl;
+        return false;
+    }
+
+    size_t nr_elements = 1;
+    for(unsigned int i=0; i<shape.size(); i++) {
+        nr_elements *= shape[i];
+    }
+
+    std::string header = this->build_header(descr, shape);
+    outfile.write(header.c_str(), header.size());
+    outfile.write(data, nr_elements * element_size);
+    outfile.close();
+
+    return !outfile.fail();
+}
+
+/*
+ * Add a .npy member to the open .npz archive. The member is stored without
+ * compression, such that it can be read back directly from the archive.
+ */
+bool NpyWriter::add_npy(const std::string &name, const char *descr, const char *data,
+                        size_t element_size, const std::vector<size_t> &shape) {
+    if(!this->npz_file.is_open()) {
+        return false;
+    }
+
+    size_t nr_elements = 1;
+    for(unsigned int i=0; i<shape.size(); i++) {
+        nr_elements *= shape[i];
+    }
+
+    std::string header = this->build_header(descr, shape);
+    size_t size = header.size() + nr_elements * element_size;
+    size_t offset = (size_t)this->npz_file.tellp();
+
+    // plain zip archives (no zip64 extension) are limited to 4 GB
+    if(size > 0xFFFFFFFFUL || offset + size > 0xFFFFFFFFUL) {
+        std::cerr << "Array " << name << " is too large for a .npz archive; use separate .npy files." << std::endl;
+        return false;
+    }
+
+    NpzEntry entry;
+    entry.name = name + ".npy";
+    entry.size = (uint32_t)size;
+    entry.offset = (uint32_t)offset;
+    entry.crc = this->crc32(0, header.c_str(), header.size());
+    entry.crc = this->crc32(entry.crc, data, nr_elements * element_size);
+
+    this->write_uint32(0x04034b50);         // local file header signature
+    this->write_uint16(20);                 // version needed to extract
+    this->write_uint16(0);                  // general purpose flags
+    this->write_uint16(0);                  // compression method (stored)
+    this->write_uint16(0);                  // last modification time
+    this->write_uint16(0x21);               // last modification date (1980-01-01)
+    this->write_uint32(entry.crc);
+    this->write_uint32(entry.size);         // compressed size
+    this->write_uint32(entry.size);         // uncompressed size
+    this->write_uint16(entry.name.size());
+    this->write_uint16(0);                  // extra field length
+    this->npz_file.write(entry.name.c_str(), entry.name.size());
+    this->npz_file.write(header.c_str(), header.size());
+    this->npz_file.write(data, nr_elements * element_size);
+
+    this->npz_entries.push_back(entry);
+
+    return this->npz_file.good();
+}
+
+/*
+ * Encode (ASCII) strings as zero-padded UTF-32LE strings of equal width, the
+ * representation of numpy's unicode string type
+ */
+std::string NpyWriter::encode_strings(const std::vector<std::string> &data, size_t *width) const {
+    *width = 1;
+    for(unsigned int i=0; i<data.size(); i++) {
+        *width = std::max(*width, data[i].size());
+    }
+
+    std::string buffer(data.size() * (*width) * 4, '\0');
+    for(unsigned int i=0; i<data.size(); i++) {
+        for(unsigned int j=0; j<data[i].size(); j++) {
+            buffer[(i * (*width) + j) * 4] = data[i][j];
+        }
+    }
+
+    return buffer;
+}
+
+/*
+ * Calculate the CRC-32 checksum (as used by zip) of a block of data. The
+ * checksum can be updated incrementally by passing the previous value.
+ */
+uint32_t NpyWriter::crc32(uint32_t crc, const char *data, size_t len) const {
+    // function-local statics are initialized exactly once, also when threaded
+    static const std::vector<uint32_t> table = build_crc_table();
+
+    crc = ~crc;
+    for(size_t i=0; i<len; i++) {
+        crc = table[(crc ^ (unsigned char)data[i]) & 0xFF] ^ (crc >> 8);
+    }
+
+    return ~crc;
+}
+
+/*
+ * Write a little-endian 16 bit unsigned integer to the archive
+ */
+void NpyWriter::write_uint16(uint16_t val) {
+    char buf[2] = {(char)(val & 0xFF), (char)((val >> 8) & 0xFF)};
+    this->npz_file.write(buf, 2);
+}
+
+/*
+ * Write a little-endian 32 bit unsigned integer to the archive
+ */
+void NpyWriter::write_uint32(uint32_t val) {
+    char buf[4] = {(char)(val & 0xFF), (char)((val >> 8) & 0xFF),
+                   (char)((val >> 16) & 0xFF), (char)((val >> 24) & 0xFF)};
+    this->npz_file.write(buf, 4);
+}
@@ -0,0 +1,251 @@
+/*************************************************************************
+ *
+ *  This file is part of v2c.
+ *
+ *  Author: Ivo Filot <i.a.w.filot@tue.nl>
+ *
+ *  v2c is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  v2c is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with v2c.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ************************************************************************/
+
+
+#include "outputsink.h"
+
+#include <string.h>
+
+/*
+ * Default constructor
+ */
+OutputSink::OutputSink() {
+    this->file = NULL;
+    this->compressed = false;
+    this->failed = false;
+    this->nr_threads = 1;
+    this->pool = NULL;
+    this->crc = 0;
+    this->size = 0;
+}
+
+OutputSink::~OutputSink() {
+    if(this->file != NULL) {
+        this->close();
+    }
+    delete this->pool;
+}
+
+/*
+ * Open <_filename> for writing; names ending in .gz are compressed using
+ * <_nr_threads> threads (0: one per core, 1: on the calling thread)
+ */
+bool OutputSink::open(const std::string &_filename, unsigned int _nr_threads) {
+    if(this->file != NULL) {
+        this->close();
+    }
+
+    this->filename = _filename;
+    this->compressed = is_compressed_name(_filename);
+    this->failed = false;
+    this->pending.clear();
+    this->blocks.clear();
+    this->dictionary.clear();
+    this->crc = crc32(0L, Z_NULL, 0);
+    this->size = 0;
+
+    this->file = fopen(this->filename.c_str(), "wb");
+    if(this->file == NULL) {
+        std::cerr << "Cannot open " << this->filename << " for writing." << std::endl;
+        return false;
+    }
+
+    if(this->compressed) {
+        this->nr_threads = _nr_threads;
+        if(this->nr_threads != 1 && this->pool == NULL) {
+            this->pool = new ThreadPool(this->nr_threads);
+        }
+        if(this->pool != NULL) {
+            this->nr_threads = this->pool->get_nr_threads();
+        }
+
+        // gzip header: deflate, no flags, no time stamp, Unix
+        static const unsigned char header[10] = {0x1f, 0x8b, 8, 0, 0, 0, 0, 0, 0, 3};
+        this->failed = fwrite(header, 1, sizeof(header), this->file) != sizeof(header);
+    }
+
+    return !this->failed;
+}
+
+bool OutputSink::write(const std::string &data) {
+    return this->write(data.data(), data.size());
+}
+
+/*
+ * Append <length> bytes; compressed data is collected in blocks, which are
+ * compressed and written once there is a batch of them for every thread
+ */
+bool OutputSink::write(const char *data, size_t length) {
+    if(this->file == NULL || this->failed) {
+        return false;
+    }
+
+    if(!this->compressed) {
+        this->failed = fwrite(data, 1, length, this->file) != length;
+        return !this->failed;
+    }
+
+    while(length > 0) {
+        if(this->pending.capacity() < OUTPUT_SINK_BLOCK_SIZE) {
+            this->pending.reserve(OUTPUT_SINK_BLOCK_SIZE);
+        }
+        const size_t chunk = std::min(length, (size_t)OUTPUT_SINK_BLOCK_SIZE - this->pending.size());
+        this->pending.append(data, chunk);
+        data += chunk;
+        length -= chunk;
+
+        if(this->pending.size() == OUTPUT_SINK_BLOCK_SIZE) {
+            this->blocks.push_back(std::string());
+            this->blocks.back().swap(this->pending);
+            if(this->blocks.size() >= 2 * this->nr_threads && !this->compress_blocks(false)) {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+/*
+ * Write the remaining data (and for compressed files the gzip trailer) and
+ * close the file. Returns false when anything could not be written.
+ */
+bool OutputSink::close() {
+    if(this->file == NULL) {
+        return false;
+    }
+
+    if(this->compressed && !this->failed && this->compress_blocks(true)) {
+        unsigned char trailer[8];
+        for(unsigned int i=0; i<4; i++) {
+            trailer[i] = (this->crc >> (8 * i)) & 0xFF;
+            trailer[4 + i] = (this->size >> (8 * i)) & 0xFF;
+        }
+        this->failed = fwrite(trailer, 1, sizeof(trailer), this->file) != sizeof(trailer);
+    }
+
+    this->failed |= fclose(this->file) != 0;
+    this->file = NULL;
+    this->pending.clear();
+    this->blocks.clear();
+
+    if(this->failed) {
+        std::cerr << "Cannot write " << this->filename << std::endl;
+    }
+    return !this->failed;
+}
+
+/*
+ * Names ending in .gz are written compressed
+ */
+bool OutputSink::is_compressed_name(const std::string &filename) {
+    return filename.size() > 3 && filename.compare(filename.size() - 3, 3, ".gz") == 0;
+}
+
+/*
+ * Write <buffer> as file <filename>, compressed when the name ends in .gz
+ */
+bool OutputSink::write_file(const std::string &filename, const std::string &buffer, unsigned int nr_threads) {
+    OutputSink sink;
+    if(!sink.open(filename, nr_threads)) {
+        return false;
+    }
+    sink.write(buffer);
+    return sink.close();
+}
+
+/*
+ * Compress the collected blocks (in parallel when there is a pool) and write
+ * them in order. With <final>, the partially filled block is added as last
+ * block, which ends the deflate stream.
+ */
+bool OutputSink::compress_blocks(bool final) {
+    if(final) {
+        this->blocks.push_back(std::string());
+        this->blocks.back().swap(this->pending);
+    }
+
+    const size_t n = this->blocks.size();
+    std::vector<std::string> outputs(n);
+    std::vector<uint32_t> checksums(n);
+    std::vector<char> success(n, 0);
+
+    auto compress = [&](size_t i, unsigned int worker) {
+        // every block is primed with the end of the block before it
+        const std::string &before = i == 0 ? this->dictionary : this->blocks[i - 1];
+        const size_t length = std::min(before.size(), (size_t)OUTPUT_SINK_WINDOW);
+        success[i] = compress_block(before.data() + before.size() - length, length, this->blocks[i],
+                                    final && i + 1 == n, outputs[i]);
+        checksums[i] = crc32(0L, (const Bytef*)this->blocks[i].data(), this->blocks[i].size());
+    };
+    if(this->pool != NULL && n > 1) {
+        this->pool->parallel_for(n, compress);
+    } else {
+        for(size_t i=0; i<n; i++) {
+            compress(i, 0);
+        }
+    }
+
+    for(size_t i=0; i<n && !this->failed; i++) {
+        this->failed = !success[i] || fwrite(outputs[i].data(), 1, outputs[i].size(), this->file) != outputs[i].size();
+        this->crc = crc32_combine(this->crc, checksums[i], this->blocks[i].size());
+        this->size += this->blocks[i].size();
+
+        this->dictionary += this->blocks[i];
+        if(this->dictionary.size() > OUTPUT_SINK_WINDOW) {
+            this->dictionary.erase(0, this->dictionary.size() - OUTPUT_SINK_WINDOW);
+        }
+    }
+    this->blocks.clear();
+
+    return !this->failed;
+}
+
+/*
+ * Deflate <input> as raw deflate data, primed with <dictionary>. A block
+ * that is not the last one ends with a sync flush, i.e. on a byte boundary
+ * and without the final-block flag, such that the next block can follow.
+ */
+bool OutputSink::compress_block(const char *dictionary, size_t dictionary_length, const std::string &input,
+                                bool last, std::string &output) {
+    z_stream strm;
+    memset(&strm, 0, sizeof(strm));
+    if(deflateInit2(&strm, OUTPUT_SINK_LEVEL, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+        return false;
+    }
+    if(dictionary_length > 0) {
+        deflateSetDictionary(&strm, (const Bytef*)dictionary, dictionary_length);
+    }
+
+    // the bound covers the sync flush marker as well (plus some margin)
+    output.resize(deflateBound(&strm, input.size()) + 16);
+    strm.next_in = (Bytef*)input.data();
+    strm.avail_in = input.size();
+    strm.next_out = (Bytef*)&output[0];
+    strm.avail_out = output.size();
+
+    const int ret = deflate(&strm, last ? Z_FINISH : Z_SYNC_FLUSH);
+    const bool success = (last ? ret == Z_STREAM_END : ret == Z_OK) && strm.avail_in == 0 && strm.avail_out > 0;
+    output.resize(strm.total_out);
+    deflateEnd(&strm);
+
+    return success;
+}
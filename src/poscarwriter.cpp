@@ -0,0 +1,159 @@
+/*************************************************************************
+ *
+ *  This file is part of v2c.
+ *
+ *  Author: Ivo Filot <i.a.w.filot@tue.nl>
+ *
+ *  v2c is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  v2c is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with v2c.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ************************************************************************/
+
+#include "poscarwriter.h"
+#include "geometry.h"
+
+#include <string.h>
+
+/*
+ * Constructor; formats the header lines of <reference>
+ */
+PoscarWriter::PoscarWriter(const State &reference, bool _is_vasp5) {
+    this->is_vasp5 = _is_vasp5;
+    this->nr_atoms = reference.get_total_nr_atoms();
+
+    for(unsigned int i=0; i<reference.get_nr_elements(); i++) {
+        this->species_line += "  " + reference.get_elements()[i];
+        this->counts_line += "  " + int2str(reference.get_atoms_for_element(i));
+    }
+    this->species_line += "\n";
+    this->counts_line += "\n";
+
+    this->selective = false;
+    for(unsigned int i=0; i<reference.atoms.size(); i++) {
+        if(reference.atoms[i].selec_mode != 0) {
+            this->selective = true;
+            break;
+        }
+    }
+}
+
+/*
+ * Assemble the POSCAR of <state> with title <name> in <buffer>
+ */
+void PoscarWriter::format(const State &state, const std::string &name, std::string &buffer) const {
+    static const char *flags[8] = {
+        "   T   T   T", "   F   T   T", "   T   F   T", "   F   F   T",
+        "   T   T   F", "   F   T   F", "   T   F   F", "   F   F   F"
+    };
+
+    char line[128];
+    buffer.clear();
+    buffer.reserve(128 + this->species_line.size() + this->counts_line.size() + state.atoms.size() * 48);
+
+    buffer += name;
+    buffer += "\n1\n";
+
+    for(unsigned int i=0; i<3; i++) {
+        snprintf(line, sizeof(line), "%8.7f   %8.7f   %8.7f\n",
+                 state.dimensions(i,0), state.dimensions(i,1), state.dimensions(i,2));
+        buffer += line;
+    }
+
+    if(this->is_vasp5) {
+        buffer += this->species_line;
+    }
+    buffer += this->counts_line;
+
+    if(this->selective) {
+        buffer += "Selective dynamics\n";
+    }
+    buffer += "Direct\n";
+
+    MatrixX3 frac;
+    Geometry::to_fractional(state.dimensions, state.get_cartesian_coordinates(), frac);
+
+    for(unsigned int i=0; i<state.atoms.size(); i++) {
+        int n = snprintf(line, sizeof(line), "%6.5f  %6.5f  %6.5f  ", frac(i,0), frac(i,1), frac(i,2));
+        if(this->selective && n > 0 && n < (int)sizeof(line)) {
+            snprintf(line + n, sizeof(line) - n, "%s", flags[state.atoms[i].selec_mode & ATOM_SELEC_FIX_ALL]);
+        }
+        buffer += line;
+        buffer += "\n";
+    }
+}
+
+/*
+ * Write <state> as POSCAR file <filename> with title <name>; a compressed
+ * file is compressed with <nr_threads> threads
+ */
+bool PoscarWriter::write(const State &state, const std::string &filename, const std::string &name,
+                         unsigned int nr_threads) const {
+    if(state.get_total_nr_atoms() != this->nr_atoms) {
+        std::cerr << "Cannot write " << filename << ": the number of atoms differs from the reference." << std::endl;
+        return false;
+    }
+
+    std::string buffer;
+    this->format(state, name, buffer);
+
+    return OutputSink::write_file(filename, buffer, nr_threads);
+}
+
+/*
+ * Write the given <frames> (indices into <states>) as files named by
+ * get_frame_filename, distributed over the workers of <pool>; with
+ * <compress>, every worker compresses its own files. Every worker reuses its
+ * own buffers; spilled states are read back by the workers. Returns the
+ * number of files written.
+ */
+unsigned int PoscarWriter::write_frames(const FrameStore &states, const std::vector<unsigned int> &frames,
+                                        const std::string &prefix, const std::string &source,
+                                        ThreadPool &pool, bool compress) const {
+    std::vector<std::string> buffers(pool.get_nr_threads());
+    std::vector<State> spilled(pool.get_nr_threads(), State(0.0, Matrix3::Zero()));
+    std::vector<char> success(frames.size(), 0);
+
+    pool.parallel_for(frames.size(), [&](size_t i, unsigned int worker) {
+        const unsigned int frame = frames[i];
+        const std::string filename = get_frame_filename(prefix, frame, compress);
+        const std::string name = source + " frame " + int2str(frame + 1);
+        std::string &buffer = buffers[worker];
+
+        const State &state = states.get(frame, spilled[worker]);
+        if(state.get_total_nr_atoms() != this->nr_atoms) {
+            return;
+        }
+        this->format(state, name, buffer);
+
+        success[i] = OutputSink::write_file(filename, buffer);
+    });
+
+    unsigned int count = 0;
+    for(unsigned int i=0; i<frames.size(); i++) {
+        if(success[i]) {
+            count++;
+        } else {
+            std::cerr << "Cannot write " << get_frame_filename(prefix, frames[i], compress) << std::endl;
+        }
+    }
+
+    return count;
+}
+
+/*
+ * File name of a (0-based) frame: PREFIX_<frame + 1>.POSCAR, or
+ * PREFIX_<frame + 1>.POSCAR.gz when compressed
+ */
+std::string PoscarWriter::get_frame_filename(const std::string &prefix, unsigned int frame, bool compress) {
+    return prefix + "_" + int2str(frame + 1) + (compress ? ".POSCAR.gz" : ".POSCAR");
+}
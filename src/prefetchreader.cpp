@@ -0,0 +1,466 @@
+/*************************************************************************
+ *
+ *  This file is part of v2c.
+ *
+ *  Author: Ivo Filot <i.a.w.filot@tue.nl>
+ *
+ *  v2c is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  v2c is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with v2c.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ************************************************************************/
+
+#include "prefetchreader.h"
+
+#include <algorithm>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#ifdef PREFETCH_HAVE_IO_URING
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
+
+/*
+ * Constructor
+ *
+ * <_filenames>     files in the order in which they will be consumed
+ * <queue_depth>    number of buffers, i.e. at most queue_depth - 1 reads are
+ *                  in flight while a chunk is being parsed
+ * <_chunk_size>    size of every read [bytes]
+ * <allow_io_uring> whether io_uring may be used; otherwise the fallback is
+ *                  used
+ */
+PrefetchReader::PrefetchReader(const std::vector<std::string> &_filenames, unsigned int queue_depth,
+                               size_t _chunk_size, bool allow_io_uring) {
+    this->filenames = _filenames;
+    this->chunk_size = _chunk_size > 0 ? _chunk_size : PREFETCH_DEFAULT_CHUNK_SIZE;
+    this->next_submit = 0;
+    this->next_consume = 0;
+    this->current_file = -1;
+    this->holds_slot = false;
+    this->fds.assign(this->filenames.size(), -1);
+
+    // cut every file into chunks; files that cannot be accessed get none,
+    // their error is reported when they are opened
+    for(unsigned int i=0; i<this->filenames.size(); i++) {
+        struct stat info;
+        const uint64_t size = stat(this->filenames[i].c_str(), &info) == 0 ? info.st_size : 0;
+        this->file_sizes.push_back(size);
+        this->first_chunk.push_back(this->chunks.size());
+        for(uint64_t offset=0; offset<size; offset += this->chunk_size) {
+            Chunk chunk;
+            chunk.file = i;
+            chunk.offset = offset;
+            chunk.length = std::min<uint64_t>(this->chunk_size, size - offset);
+            this->chunks.push_back(chunk);
+        }
+    }
+    this->first_chunk.push_back(this->chunks.size());
+
+    this->slots.resize(std::max(2u, queue_depth));
+    for(unsigned int i=0; i<this->slots.size(); i++) {
+        this->slots[i].buffer.resize(this->chunk_size);
+        this->slots[i].status = PREFETCH_SLOT_FREE;
+        this->slots[i].chunk = 0;
+        this->slots[i].length = 0;
+        this->slots[i].result = 0;
+    }
+
+#ifdef PREFETCH_HAVE_IO_URING
+    this->use_io_uring = allow_io_uring && this->setup_ring(this->slots.size());
+#else
+    this->use_io_uring = false;
+#endif
+}
+
+/*
+ * Destructor; waits for the outstanding reads before the buffers are freed
+ */
+PrefetchReader::~PrefetchReader() {
+    for(size_t c=this->next_consume; c<this->next_submit; c++) {
+        this->wait(c);
+    }
+
+    for(unsigned int i=0; i<this->fds.size(); i++) {
+        this->close_file(i);
+    }
+
+#ifdef PREFETCH_HAVE_IO_URING
+    if(this->use_io_uring) {
+        this->destroy_ring();
+    }
+#endif
+}
+
+/*
+ * Advance to the next file; chunks of the current file that have not been
+ * consumed are discarded. Returns false when all files have been visited.
+ */
+bool PrefetchReader::next_file() {
+    if(this->holds_slot) {
+        this->slots[(this->next_consume - 1) % this->slots.size()].status = PREFETCH_SLOT_FREE;
+        this->holds_slot = false;
+    }
+
+    if(this->current_file >= 0) {
+        const size_t end = this->first_chunk[this->current_file + 1];
+        for(; this->next_consume < end; this->next_consume++) {
+            if(this->next_consume < this->next_submit) {
+                this->wait(this->next_consume);
+                this->slots[this->next_consume % this->slots.size()].status = PREFETCH_SLOT_FREE;
+            }
+        }
+        this->next_submit = std::max(this->next_submit, end);
+        this->close_file(this->current_file);
+    }
+
+    if(this->current_file + 1 >= (int)this->filenames.size()) {
+        this->current_file = this->filenames.size();
+        return false;
+    }
+
+    this->current_file++;
+    this->fill_queue();
+
+    return true;
+}
+
+const std::string& PrefetchReader::get_filename() const {
+    return this->filenames[this->current_file];
+}
+
+/*
+ * Hand out the next chunk of the current file. The data remains valid until
+ * the next call of get_chunk or next_file. Returns false at the end of the
+ * file or when the file cannot be read.
+ */
+bool PrefetchReader::get_chunk(const char **data, size_t *length, uint64_t *offset) {
+    if(this->current_file < 0 || this->current_file >= (int)this->filenames.size()) {
+        return false;
+    }
+
+    if(this->holds_slot) {
+        this->slots[(this->next_consume - 1) % this->slots.size()].status = PREFETCH_SLOT_FREE;
+        this->holds_slot = false;
+    }
+
+    if(this->next_consume >= this->first_chunk[this->current_file + 1]) {
+        return false;
+    }
+
+    this->fill_queue();
+
+    const size_t c = this->next_consume;
+    if(!this->wait(c)) {
+        return false;
+    }
+
+    Slot &slot = this->slots[c % this->slots.size()];
+    *data = slot.buffer.data();
+    *length = slot.length;
+    *offset = this->chunks[c].offset;
+    this->next_consume++;
+    this->holds_slot = true;
+
+    // the buffer of the previous chunk has become free
+    this->fill_queue();
+
+    return true;
+}
+
+bool PrefetchReader::is_using_io_uring() const {
+    return this->use_io_uring;
+}
+
+bool PrefetchReader::open_file(unsigned int file) {
+    if(this->fds[file] < 0) {
+        this->fds[file] = open(this->filenames[file].c_str(), O_RDONLY);
+        if(this->fds[file] < 0) {
+            std::cerr << "Cannot open " << this->filenames[file] << std::endl;
+            return false;
+        }
+        posix_fadvise(this->fds[file], 0, 0, POSIX_FADV_SEQUENTIAL);
+    }
+    return true;
+}
+
+void PrefetchReader::close_file(unsigned int file) {
+    if(this->fds[file] >= 0) {
+        close(this->fds[file]);
+        this->fds[file] = -1;
+    }
+}
+
+/*
+ * Request chunks in reading order as long as there are free buffers
+ */
+void PrefetchReader::fill_queue() {
+    while(this->next_submit < this->chunks.size() &&
+          this->slots[this->next_submit % this->slots.size()].status == PREFETCH_SLOT_FREE) {
+        this->submit(this->next_submit);
+        this->next_submit++;
+    }
+}
+
+/*
+ * Start reading a chunk into its buffer
+ */
+void PrefetchReader::submit(size_t chunk) {
+    const Chunk &c = this->chunks[chunk];
+    Slot &slot = this->slots[chunk % this->slots.size()];
+    slot.chunk = chunk;
+    slot.length = 0;
+    slot.status = PREFETCH_SLOT_PENDING;
+
+    if(!this->open_file(c.file)) {
+        slot.result = -EBADF;
+        slot.status = PREFETCH_SLOT_READY;
+        return;
+    }
+
+#ifdef PREFETCH_HAVE_IO_URING
+    if(this->use_io_uring) {
+        const unsigned int tail = *this->sq_tail;
+        const unsigned int index = tail & *this->sq_mask;
+        struct io_uring_sqe *sqe = &((struct io_uring_sqe*)this->sqes_ptr)[index];
+        memset(sqe, 0, sizeof(*sqe));
+        sqe->opcode = IORING_OP_READ;
+        sqe->fd = this->fds[c.file];
+        sqe->off = c.offset;
+        sqe->addr = (uint64_t)(uintptr_t)slot.buffer.data();
+        sqe->len = c.length;
+        sqe->user_data = chunk % this->slots.size();
+        this->sq_array[index] = index;
+        __atomic_store_n(this->sq_tail, tail + 1, __ATOMIC_RELEASE);
+
+        long submitted;
+        do {
+            submitted = syscall(__NR_io_uring_enter, this->ring_fd, 1, 0, 0, NULL, 0);
+        } while(submitted < 0 && errno == EINTR);
+
+        // without SQPOLL the kernel only takes entries during io_uring_enter:
+        // an entry that it did not take is withdrawn, such that it cannot be
+        // consumed later into a buffer that has been reused by then; an entry
+        // that it took completes through the completion ring
+        if(__atomic_load_n(this->sq_head, __ATOMIC_ACQUIRE) == tail) {
+            __atomic_store_n(this->sq_tail, tail, __ATOMIC_RELEASE);
+            slot.result = submitted < 0 ? -errno : -EAGAIN;
+            slot.status = PREFETCH_SLOT_READY;
+        }
+        return;
+    }
+#endif
+
+    // let the kernel read ahead, the data is copied when the chunk is used
+    posix_fadvise(this->fds[c.file], c.offset, c.length, POSIX_FADV_WILLNEED);
+}
+
+/*
+ * Wait until a chunk is available. Reads that failed or returned less data
+ * than requested are completed synchronously.
+ */
+bool PrefetchReader::wait(size_t chunk) {
+    Slot &slot = this->slots[chunk % this->slots.size()];
+
+    if(slot.status == PREFETCH_SLOT_PENDING) {
+#ifdef PREFETCH_HAVE_IO_URING
+        if(this->use_io_uring) {
+            while(slot.status == PREFETCH_SLOT_PENDING) {
+                unsigned int head = *this->cq_head;
+                if(head == __atomic_load_n(this->cq_tail, __ATOMIC_ACQUIRE)) {
+                    if(syscall(__NR_io_uring_enter, this->ring_fd, 0, 1, IORING_ENTER_GETEVENTS, NULL, 0) < 0 &&
+                       errno != EINTR) {
+                        slot.result = -errno;
+                        slot.status = PREFETCH_SLOT_READY;
+                    }
+                    continue;
+                }
+
+                const struct io_uring_cqe *cqe = &((const struct io_uring_cqe*)this->cqes)[head & *this->cq_mask];
+                Slot &done = this->slots[cqe->user_data];
+                done.result = cqe->res;
+                done.length = cqe->res > 0 ? cqe->res : 0;
+                done.status = PREFETCH_SLOT_READY;
+                __atomic_store_n(this->cq_head, head + 1, __ATOMIC_RELEASE);
+            }
+        } else {
+            slot.result = 0;
+            slot.status = PREFETCH_SLOT_READY;
+        }
+#else
+        slot.result = 0;
+        slot.status = PREFETCH_SLOT_READY;
+#endif
+    }
+
+    if(slot.length < this->chunks[chunk].length) {
+        if(!this->read_sync(slot)) {
+            std::cerr << "Cannot read " << this->filenames[this->chunks[chunk].file] << std::endl;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/*
+ * Read the remainder of the chunk of a buffer with pread
+ */
+bool PrefetchReader::read_sync(Slot &slot) {
+    const Chunk &c = this->chunks[slot.chunk];
+    const int fd = this->fds[c.file];
+    if(fd < 0) {
+        return false;
+    }
+
+    while(slot.length < c.length) {
+        const ssize_t n = pread(fd, slot.buffer.data() + slot.length, c.length - slot.length, c.offset + slot.length);
+        if(n < 0 && errno == EINTR) {
+            continue;
+        }
+        if(n <= 0) {
+            return false;
+        }
+        slot.length += n;
+    }
+
+    return true;
+}
+
+#ifdef PREFETCH_HAVE_IO_URING
+/*
+ * Create the submission and completion rings; returns false when io_uring is
+ * not available, in which case the fallback is used
+ */
+bool PrefetchReader::setup_ring(unsigned int entries) {
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+
+    this->ring_fd = syscall(__NR_io_uring_setup, entries, &params);
+    if(this->ring_fd < 0) {
+        return false;
+    }
+
+    // IORING_OP_READ needs kernel 5.6, which also introduced this feature flag
+    if(!(params.features & IORING_FEAT_NODROP)) {
+        close(this->ring_fd);
+        return false;
+    }
+
+    this->sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned int);
+    this->cq_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    if(params.features & IORING_FEAT_SINGLE_MMAP) {
+        this->sq_size = this->cq_size = std::max(this->sq_size, this->cq_size);
+    }
+    this->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+
+    this->sq_ptr = mmap(NULL, this->sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                        this->ring_fd, IORING_OFF_SQ_RING);
+    if(this->sq_ptr == MAP_FAILED) {
+        close(this->ring_fd);
+        return false;
+    }
+
+    if(params.features & IORING_FEAT_SINGLE_MMAP) {
+        this->cq_ptr = this->sq_ptr;
+    } else {
+        this->cq_ptr = mmap(NULL, this->cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                            this->ring_fd, IORING_OFF_CQ_RING);
+        if(this->cq_ptr == MAP_FAILED) {
+            munmap(this->sq_ptr, this->sq_size);
+            close(this->ring_fd);
+            return false;
+        }
+    }
+
+    this->sqes_ptr = mmap(NULL, this->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                          this->ring_fd, IORING_OFF_SQES);
+    if(this->sqes_ptr == MAP_FAILED) {
+        if(this->cq_ptr != this->sq_ptr) {
+            munmap(this->cq_ptr, this->cq_size);
+        }
+        munmap(this->sq_ptr, this->sq_size);
+        close(this->ring_fd);
+        return false;
+    }
+
+    char *sq = (char*)this->sq_ptr;
+    char *cq = (char*)this->cq_ptr;
+    this->sq_head = (unsigned int*)(sq + params.sq_off.head);
+    this->sq_tail = (unsigned int*)(sq + params.sq_off.tail);
+    this->sq_mask = (unsigned int*)(sq + params.sq_off.ring_mask);
+    this->sq_array = (unsigned int*)(sq + params.sq_off.array);
+    this->cq_head = (unsigned int*)(cq + params.cq_off.head);
+    this->cq_tail = (unsigned int*)(cq + params.cq_off.tail);
+    this->cq_mask = (unsigned int*)(cq + params.cq_off.ring_mask);
+    this->cqes = cq + params.cq_off.cqes;
+
+    return true;
+}
+
+void PrefetchReader::destroy_ring() {
+    munmap(this->sqes_ptr, this->sqes_size);
+    if(this->cq_ptr != this->sq_ptr) {
+        munmap(this->cq_ptr, this->cq_size);
+    }
+    munmap(this->sq_ptr, this->sq_size);
+    close(this->ring_fd);
+}
+#endif
+
+/*
+ * Stream buffer over the chunks of the current file of <_reader>
+ */
+PrefetchStreamBuf::PrefetchStreamBuf(PrefetchReader *_reader) {
+    this->reader = _reader;
+    this->buffer_offset = 0;
+}
+
+PrefetchStreamBuf::int_type PrefetchStreamBuf::underflow() {
+    if(this->gptr() < this->egptr()) {
+        return traits_type::to_int_type(*this->gptr());
+    }
+
+    // position just after the data that has been consumed
+    this->buffer_offset += this->egptr() - this->eback();
+
+    const char *data;
+    size_t length;
+    uint64_t offset;
+    if(!this->reader->get_chunk(&data, &length, &offset) || length == 0) {
+        this->setg(NULL, NULL, NULL);
+        return traits_type::eof();
+    }
+
+    // the stream only reads, hence the const cast is harmless
+    char *begin = const_cast<char*>(data);
+    this->setg(begin, begin, begin + length);
+    this->buffer_offset = offset;
+
+    return traits_type::to_int_type(*this->gptr());
+}
+
+/*
+ * Only reporting the current position (tellg) is supported
+ */
+PrefetchStreamBuf::pos_type PrefetchStreamBuf::seekoff(off_type off, std::ios_base::seekdir dir,
+                                                       std::ios_base::openmode which) {
+    if(off != 0 || dir != std::ios_base::cur || !(which & std::ios_base::in)) {
+        return pos_type(off_type(-1));
+    }
+    return pos_type(this->buffer_offset + (this->gptr() - this->eback()));
+}
@@ -0,0 +1,283 @@
+/*************************************************************************
+ *
+ *  This file is part of v2c.
+ *
+ *  Author: Ivo Filot <i.a.w.filot@tue.nl>
+ *
+ *  v2c is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  v2c is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with v2c.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ************************************************************************/
+
+#include "rdf.h"
+
+/*
+ * Construct an empty distribution with <_nr_bins> bins up to <_r_max> for
+ * <_nr_workers> concurrent workers
+ */
+RadialDistribution::RadialDistribution(double _r_max, unsigned int _nr_bins, unsigned int _nr_workers) {
+    this->r_max = _r_max;
+    this->nr_bins = _nr_bins;
+    this->bin_width = _r_max / (double)_nr_bins;
+    this->initialized = false;
+    this->nr_pairs = 0;
+
+    this->histograms.resize(_nr_workers);
+    this->volumes.assign(_nr_workers, 0.0);
+    this->nr_frames.assign(_nr_workers, 0);
+}
+
+/*
+ * Set up the element pairs from the first frame. All subsequent frames need
+ * to hold the same atoms (in the same order), see accepts.
+ */
+void RadialDistribution::initialize(const State &state) {
+    this->elements = state.get_elements();
+    this->nr_atoms_per_elm.clear();
+    this->species.clear();
+    for(unsigned int i=0; i<state.get_nr_elements(); i++) {
+        this->nr_atoms_per_elm.push_back(state.get_atoms_for_element(i));
+        this->species.insert(this->species.end(), state.get_atoms_for_element(i), i);
+    }
+
+    const unsigned int ne = this->elements.size();
+    this->pair_index.resize(ne * ne);
+    this->nr_pairs = 0;
+    for(unsigned int a=0; a<ne; a++) {
+        for(unsigned int b=a; b<ne; b++) {
+            this->pair_index[a * ne + b] = this->nr_pairs;
+            this->pair_index[b * ne + a] = this->nr_pairs;
+            this->nr_pairs++;
+        }
+    }
+
+    for(unsigned int i=0; i<this->histograms.size(); i++) {
+        this->histograms[i].assign(this->nr_pairs * this->nr_bins, 0.0);
+    }
+
+    this->initialized = true;
+}
+
+bool RadialDistribution::is_initialized() const {
+    return this->initialized;
+}
+
+/*
+ * Whether <state> holds the same elements, with the same number of atoms
+ * each, as the frame the distribution was initialized with
+ */
+bool RadialDistribution::accepts(const State &state) const {
+    return state.get_elements() == this->elements &&
+           state.get_nr_atoms_per_element() == this->nr_atoms_per_elm &&
+           state.get_total_nr_atoms() == this->species.size();
+}
+
+/*
+ * Add the pair distances of a single frame to the histogram of <worker>. The
+ * frame must be accepted (see accepts); this is checked by the caller, such
+ * that a mismatch is reported on the calling thread.
+ */
+void RadialDistribution::add_frame(const State &state, unsigned int worker) {
+    CellList cells(state.dimensions, this->r_max);
+    cells.build(state.coordinates.col(0).data(),
+                state.coordinates.col(1).data(),
+                state.coordinates.col(2).data(),
+                state.get_total_nr_atoms(), 1);
+
+    std::vector<double> &hist = this->histograms[worker];
+    const unsigned int ne = this->elements.size();
+    const double inv_bin_width = 1.0 / this->bin_width;
+    const unsigned int nr_bins = this->nr_bins;
+    const std::vector<unsigned int> &species = this->species;
+    const std::vector<unsigned int> &pair_index = this->pair_index;
+
+    cells.for_each_pair([&](unsigned int i, unsigned int j, double r2) {
+        const unsigned int bin = (unsigned int)(std::sqrt(r2) * inv_bin_width);
+        if(bin < nr_bins) {
+            hist[pair_index[species[i] * ne + species[j]] * nr_bins + bin] += 1.0;
+        }
+    });
+
+    this->volumes[worker] += std::fabs(state.dimensions.cast<double>().determinant());
+    this->nr_frames[worker]++;
+}
+
+/*
+ * Add a series of frames, distributing the frames over the workers of <pool>.
+ * Returns false (and adds nothing) when a frame holds other atoms than the
+ * first frame.
+ */
+bool RadialDistribution::add_frames(const std::vector<State> &states, ThreadPool &pool) {
+    if(states.size() == 0) {
+        return true;
+    }
+
+    if(!this->initialized) {
+        this->initialize(states[0]);
+    }
+    for(unsigned int i=0; i<states.size(); i++) {
+        if(!this->accepts(states[i])) {
+            std::cerr << "Frame " << (i + 1) << " holds other atoms than the first frame." << std::endl;
+            return false;
+        }
+    }
+
+    pool.parallel_for(states.size(), [&](size_t i, unsigned int worker) {
+        this->add_frame(states[i], worker);
+    });
+
+    return true;
+}
+
+unsigned int RadialDistribution::get_nr_frames() const {
+    unsigned int total = 0;
+    for(unsigned int i=0; i<this->nr_frames.size(); i++) {
+        total += this->nr_frames[i];
+    }
+    return total;
+}
+
+unsigned int RadialDistribution::get_nr_pairs() const {
+    return this->nr_pairs;
+}
+
+/*
+ * Return the name of an element pair, e.g. "Rh-C"
+ */
+std::string RadialDistribution::get_pair_name(unsigned int pair) const {
+    const unsigned int ne = this->elements.size();
+    for(unsigned int a=0; a<ne; a++) {
+        for(unsigned int b=a; b<ne; b++) {
+            if(this->pair_index[a * ne + b] == pair) {
+                return this->elements[a] + "-" + this->elements[b];
+            }
+        }
+    }
+    return std::string();
+}
+
+/*
+ * Return the number of atom pairs per frame found in each bin for an
+ * element pair, averaged over all frames
+ */
+std::vector<double> RadialDistribution::get_histogram(unsigned int pair) const {
+    std::vector<double> result(this->nr_bins, 0.0);
+    const unsigned int frames = this->get_nr_frames();
+
+    if(frames == 0) {
+        return result;
+    }
+
+    for(unsigned int w=0; w<this->histograms.size(); w++) {
+        for(unsigned int k=0; k<this->nr_bins; k++) {
+            result[k] += this->histograms[w][pair * this->nr_bins + k];
+        }
+    }
+
+    for(unsigned int k=0; k<this->nr_bins; k++) {
+        result[k] /= (double)frames;
+    }
+
+    return result;
+}
+
+/*
+ * Return g(r) for an element pair. The pair counts are normalized by the
+ * number expected for an ideal gas of the same density in each shell.
+ */
+std::vector<double> RadialDistribution::get_rdf(unsigned int pair) const {
+    std::vector<double> result = this->get_histogram(pair);
+    const double density = this->get_nr_atom_pairs(pair) / this->get_average_volume();
+
+    for(unsigned int k=0; k<this->nr_bins; k++) {
+        const double r_lo = k * this->bin_width;
+        const double r_hi = (k + 1) * this->bin_width;
+        const double shell = 4.0 / 3.0 * M_PI * (r_hi * r_hi * r_hi - r_lo * r_lo * r_lo);
+        const double ideal = density * shell;
+        result[k] = ideal > 0.0 ? result[k] / ideal : 0.0;
+    }
+
+    return result;
+}
+
+/*
+ * Write g(r) and the average pair counts of all element pairs as columns
+ * to a text file
+ */
+bool RadialDistribution::write(const std::string &filename) const {
+    std::ofstream outfile(filename.c_str());
+
+    if(!outfile.is_open()) {
+        std::cerr << "Cannot open " << filename << " for writing." << std::endl;
+        return false;
+    }
+
+    std::vector<std::vector<double> > rdfs;
+    std::vector<std::vector<double> > counts;
+    outfile << "# frames: " << this->get_nr_frames() << std::endl;
+    outfile << "# r";
+    for(unsigned int p=0; p<this->nr_pairs; p++) {
+        outfile << "  g_" << this->get_pair_name(p);
+        rdfs.push_back(this->get_rdf(p));
+    }
+    for(unsigned int p=0; p<this->nr_pairs; p++) {
+        outfile << "  n_" << this->get_pair_name(p);
+        counts.push_back(this->get_histogram(p));
+    }
+    outfile << std::endl;
+
+    for(unsigned int k=0; k<this->nr_bins; k++) {
+        outfile << float2str2((k + 0.5) * this->bin_width, "%8.4f");
+        for(unsigned int p=0; p<this->nr_pairs; p++) {
+            outfile << "  " << float2str2(rdfs[p][k], "%10.5f");
+        }
+        for(unsigned int p=0; p<this->nr_pairs; p++) {
+            outfile << "  " << float2str2(counts[p][k], "%10.5f");
+        }
+        outfile << std::endl;
+    }
+
+    outfile.close();
+
+    return true;
+}
+
+/*
+ * Average volume of the unit cell over all frames [A^3]
+ */
+double RadialDistribution::get_average_volume() const {
+    double total = 0.0;
+    for(unsigned int i=0; i<this->volumes.size(); i++) {
+        total += this->volumes[i];
+    }
+    return total / (double)this->get_nr_frames();
+}
+
+/*
+ * Number of atom pairs in a frame for an element pair. The periodic images
+ * of an atom sit on the lattice rather than being spread over the cell, so
+ * an element pair with itself holds N (N - 1) / 2 uniformly spread pairs.
+ */
+double RadialDistribution::get_nr_atom_pairs(unsigned int pair) const {
+    const unsigned int ne = this->elements.size();
+    for(unsigned int a=0; a<ne; a++) {
+        for(unsigned int b=a; b<ne; b++) {
+            if(this->pair_index[a * ne + b] == pair) {
+                const double na = this->nr_atoms_per_elm[a];
+                const double nb = this->nr_atoms_per_elm[b];
+                return a == b ? 0.5 * na * (na - 1.0) : na * nb;
+            }
+        }
+    }
+    return 0.0;
+}
@@ -0,0 +1,184 @@
+/*************************************************************************
+ *
+ *  This file is part of v2c.
+ *
+ *  Author: Ivo Filot <i.a.w.filot@tue.nl>
+ *
+ *  v2c is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  v2c is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with v2c.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ************************************************************************/
+
+#include "rmsd.h"
+
+#include <algorithm>
+
+/*
+ * Constructor
+ *
+ * <_align>     one of the RMSD_ALIGN_* modes
+ * <_periodic>  use the periodic image of each atom closest to the reference
+ */
+RmsdAnalysis::RmsdAnalysis(unsigned int _align, bool _periodic) {
+    this->align = _align;
+    this->periodic = _periodic;
+}
+
+/*
+ * RMSD [A] between two frames of <n> atoms given as [n x 3] arrays. <cell>
+ * (3 x 3, lattice vectors as rows) is only used when periodic images are
+ * enabled. When <rotation> is given, it receives the rotation that maps
+ * <pos> onto <ref>.
+ */
+double RmsdAnalysis::rmsd(const float *ref, const float *pos, unsigned int n, const float *cell,
+                          Eigen::Matrix3d *rotation) const {
+    if(n == 0) {
+        return 0.0;
+    }
+
+    Eigen::Matrix<double, 3, Eigen::Dynamic> a(3, n);
+    Eigen::Matrix<double, 3, Eigen::Dynamic> b(3, n);
+    for(unsigned int i=0; i<n; i++) {
+        a.col(i) << ref[i*3], ref[i*3+1], ref[i*3+2];
+        b.col(i) << pos[i*3], pos[i*3+1], pos[i*3+2];
+    }
+
+    // replace every atom of the frame by its image closest to the reference
+    if(this->periodic && cell != NULL) {
+        Eigen::Matrix3d lattice;
+        for(unsigned int i=0; i<3; i++) {
+            for(unsigned int j=0; j<3; j++) {
+                lattice(i,j) = cell[i*3+j];
+            }
+        }
+        const Eigen::Matrix3d to_frac = lattice.inverse().transpose();
+        const Eigen::Matrix3d to_cart = lattice.transpose();
+
+        Eigen::Matrix<double, 3, Eigen::Dynamic> frac = to_frac * (b - a);
+        frac = frac.array() - (frac.array() + 0.5).floor();
+        b = a + to_cart * frac;
+    }
+
+    if(this->align != RMSD_ALIGN_NONE) {
+        const Eigen::Vector3d ca = a.rowwise().mean();
+        const Eigen::Vector3d cb = b.rowwise().mean();
+        a.colwise() -= ca;
+        b.colwise() -= cb;
+    }
+
+    Eigen::Matrix3d r = Eigen::Matrix3d::Identity();
+    if(this->align == RMSD_ALIGN_KABSCH) {
+        // the optimal rotation follows from the SVD of the covariance matrix;
+        // the sign correction avoids returning a reflection
+        const Eigen::Matrix3d h = b * a.transpose();
+        Eigen::JacobiSVD<Eigen::Matrix3d> svd(h, Eigen::ComputeFullU | Eigen::ComputeFullV);
+        const double d = (svd.matrixV() * svd.matrixU().transpose()).determinant() < 0.0 ? -1.0 : 1.0;
+        Eigen::Matrix3d s = Eigen::Matrix3d::Identity();
+        s(2,2) = d;
+        r = svd.matrixV() * s * svd.matrixU().transpose();
+    }
+
+    if(rotation != NULL) {
+        *rotation = r;
+    }
+
+    return std::sqrt((r * b - a).squaredNorm() / (double)n);
+}
+
+/*
+ * RMSD of every frame of <trajectory> with respect to the reference frame
+ * <ref> ([atoms x 3]); the frames are distributed over the workers of <pool>
+ */
+std::vector<double> RmsdAnalysis::all_vs_reference(const Trajectory &trajectory, const float *ref,
+                                                   ThreadPool &pool) const {
+    std::vector<double> result(trajectory.get_nr_frames(), 0.0);
+
+    pool.parallel_for(trajectory.get_nr_frames(), [&](size_t f, unsigned int worker) {
+        result[f] = this->rmsd(ref, trajectory.get_positions(f), trajectory.get_nr_atoms(),
+                               trajectory.get_cell(f));
+    });
+
+    return result;
+}
+
+/*
+ * Greedy deduplication: a frame is retained when its RMSD to every frame
+ * retained before it is at least <threshold>. The frames are processed in
+ * blocks: all frames of a block are compared against the representatives of
+ * the previous blocks in parallel, after which the (few) remaining frames of
+ * the block are checked against each other in order. The result is the same
+ * as that of the sequential greedy algorithm. Returns the indices of the
+ * retained frames.
+ */
+std::vector<unsigned int> RmsdAnalysis::deduplicate(const Trajectory &trajectory, double threshold,
+                                                    ThreadPool &pool) const {
+    std::vector<float> representatives;
+    std::vector<unsigned int> kept;
+    this->deduplicate(trajectory, 0, threshold, representatives, kept, pool);
+    return kept;
+}
+
+/*
+ * Continue the greedy deduplication with the next part of a trajectory,
+ * whose first frame is frame <first> of the whole: the frames of
+ * <trajectory> are compared with the frames retained so far, whose
+ * positions are in <representatives> ([kept x atoms x 3]). The retained
+ * frames are added to <kept> (as indices into the whole trajectory) and to
+ * <representatives>.
+ */
+void RmsdAnalysis::deduplicate(const Trajectory &trajectory, unsigned int first, double threshold,
+                               std::vector<float> &representatives, std::vector<unsigned int> &kept,
+                               ThreadPool &pool) const {
+    const unsigned int frames = trajectory.get_nr_frames();
+    const unsigned int atoms = trajectory.get_nr_atoms();
+    const size_t frame_size = (size_t)atoms * 3;
+    const unsigned int block = 4 * pool.get_nr_threads();
+
+    for(unsigned int start=0; start<frames; start += block) {
+        const unsigned int stop = std::min(start + block, frames);
+        std::vector<char> duplicate(stop - start, 0);
+
+        pool.parallel_for(stop - start, [&](size_t c, unsigned int worker) {
+            const unsigned int f = start + c;
+            for(unsigned int k=0; k<kept.size(); k++) {
+                if(this->rmsd(&representatives[k * frame_size], trajectory.get_positions(f),
+                              atoms, trajectory.get_cell(f)) < threshold) {
+                    duplicate[c] = 1;
+                    break;
+                }
+            }
+        });
+
+        const size_t nr_kept_before = kept.size();
+        for(unsigned int f=start; f<stop; f++) {
+            if(duplicate[f - start]) {
+                continue;
+            }
+
+            bool unique = true;
+            for(size_t k=nr_kept_before; k<kept.size(); k++) {
+                if(this->rmsd(&representatives[k * frame_size], trajectory.get_positions(f),
+                              atoms, trajectory.get_cell(f)) < threshold) {
+                    unique = false;
+                    break;
+                }
+            }
+
+            if(unique) {
+                kept.push_back(first + f);
+                representatives.insert(representatives.end(), trajectory.get_positions(f),
+                                       trajectory.get_positions(f) + frame_size);
+            }
+        }
+    }
+}
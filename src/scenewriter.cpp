@@ -0,0 +1,628 @@
+/*************************************************************************
+ *
+ *  This file is part of v2c.
+ *
+ *  Author: Ivo Filot <i.a.w.filot@tue.nl>
+ *
+ *  v2c is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  v2c is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with v2c.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ************************************************************************/
+
+
+#include "scenewriter.h"
+
+#include <map>
+#include <sstream>
+#include <string.h>
+
+/*
+ * Assembles the binary buffer and the JSON descriptions of the buffer views
+ * and accessors of a glTF file
+ */
+class GltfBuilder {
+public:
+    std::string bin;
+    std::vector<std::string> views;
+    std::vector<std::string> accessors;
+
+    /*
+     * Append <size> bytes of <data> as buffer view (4-byte aligned); <target>
+     * is the buffer target, or 0 for none
+     */
+    unsigned int add_view(const void *data, size_t size, int target) {
+        while(this->bin.size() % 4 != 0) {
+            this->bin += '\0';
+        }
+
+        std::ostringstream str;
+        str << "{\"buffer\":0,\"byteOffset\":" << this->bin.size() << ",\"byteLength\":" << size;
+        if(target != 0) {
+            str << ",\"target\":" << target;
+        }
+        str << "}";
+
+        this->bin.append((const char*)data, size);
+        this->views.push_back(str.str());
+        return this->views.size() - 1;
+    }
+
+    /*
+     * Append the data of an accessor of <count> elements of <type> (SCALAR,
+     * VEC3, ...) with components of <component> type; <extra> holds
+     * additional properties such as the bounds
+     */
+    unsigned int add_accessor(const void *data, size_t size, int target, int component, size_t count,
+                              const char *type, const std::string &extra) {
+        const unsigned int view = this->add_view(data, size, target);
+
+        std::ostringstream str;
+        str << "{\"bufferView\":" << view << ",\"componentType\":" << component << ",\"count\":" << count
+            << ",\"type\":\"" << type << "\"" << extra << "}";
+
+        this->accessors.push_back(str.str());
+        return this->accessors.size() - 1;
+    }
+};
+
+#define GLTF_ARRAY_BUFFER           34962
+#define GLTF_ELEMENT_ARRAY_BUFFER   34963
+#define GLTF_SHORT                  5122
+#define GLTF_UNSIGNED_SHORT         5123
+#define GLTF_FLOAT                  5126
+
+/*
+ * The "min" and "max" properties of an accessor of floats with
+ * <nr_components> components
+ */
+static std::string get_bounds(const std::vector<float> &data, unsigned int nr_components) {
+    std::vector<float> lo(nr_components, 0.0f), hi(nr_components, 0.0f);
+    for(size_t i=0; i<data.size(); i++) {
+        const unsigned int k = i % nr_components;
+        if(i < nr_components || data[i] < lo[k]) {
+            lo[k] = data[i];
+        }
+        if(i < nr_components || data[i] > hi[k]) {
+            hi[k] = data[i];
+        }
+    }
+
+    std::string result = ",\"min\":[";
+    for(unsigned int k=0; k<nr_components; k++) {
+        result += (k > 0 ? "," : "") + float2str2(lo[k], "%.9g");
+    }
+    result += "],\"max\":[";
+    for(unsigned int k=0; k<nr_components; k++) {
+        result += (k > 0 ? "," : "") + float2str2(hi[k], "%.9g");
+    }
+    return result + "]";
+}
+
+/*
+ * Colors are given in sRGB, whereas glTF expects linear components
+ */
+static float srgb_to_linear(float c) {
+    return c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+}
+
+static void append_uint32(std::string &buffer, uint32_t val) {
+    const char buf[4] = {(char)(val & 0xFF), (char)((val >> 8) & 0xFF),
+                         (char)((val >> 16) & 0xFF), (char)((val >> 24) & 0xFF)};
+    buffer.append(buf, 4);
+}
+
+/*
+ * Constructor; without <_bonds> only the atoms are written, <_fps> sets the
+ * speed of the animation of multiple frames
+ */
+SceneWriter::SceneWriter(bool _bonds, double _fps) {
+    this->bonds = _bonds;
+    this->fps = _fps;
+}
+
+/*
+ * Write <frames> as binary glTF file. A single frame gives a static scene;
+ * more frames are shown one after another.
+ */
+bool SceneWriter::write_gltf(const std::vector<State> &frames, const std::string &filename) const {
+    if(frames.empty()) {
+        return false;
+    }
+
+    std::vector<std::string> names;
+    std::vector<unsigned int> elnrs;
+    std::vector<unsigned int> species;
+    get_species(frames[0], names, elnrs, species);
+
+    GltfBuilder gltf;
+    std::vector<std::string> materials;
+    std::vector<std::string> meshes;
+    std::vector<std::string> nodes;
+    std::ostringstream str;
+
+    // geometry: one sphere per species, a cylinder shared by all species
+    std::vector<float> sphere;
+    std::vector<uint16_t> sphere_indices;
+    build_sphere(sphere, sphere_indices);
+    const unsigned int sphere_normals = gltf.add_accessor(&sphere[0], sphere.size() * sizeof(float), GLTF_ARRAY_BUFFER,
+                                                          GLTF_FLOAT, sphere.size() / 3, "VEC3", "");
+    const unsigned int sphere_triangles = gltf.add_accessor(&sphere_indices[0], sphere_indices.size() * sizeof(uint16_t),
+                                                            GLTF_ELEMENT_ARRAY_BUFFER, GLTF_UNSIGNED_SHORT,
+                                                            sphere_indices.size(), "SCALAR", "");
+
+    std::vector<float> cylinder, cylinder_normals;
+    std::vector<uint16_t> cylinder_indices;
+    build_cylinder(cylinder, cylinder_normals, cylinder_indices);
+    const unsigned int cylinder_positions = gltf.add_accessor(&cylinder[0], cylinder.size() * sizeof(float), GLTF_ARRAY_BUFFER,
+                                                              GLTF_FLOAT, cylinder.size() / 3, "VEC3", get_bounds(cylinder, 3));
+    const unsigned int cylinder_normal_accessor = gltf.add_accessor(&cylinder_normals[0], cylinder_normals.size() * sizeof(float),
+                                                                    GLTF_ARRAY_BUFFER, GLTF_FLOAT, cylinder_normals.size() / 3, "VEC3", "");
+    const unsigned int cylinder_triangles = gltf.add_accessor(&cylinder_indices[0], cylinder_indices.size() * sizeof(uint16_t),
+                                                              GLTF_ELEMENT_ARRAY_BUFFER, GLTF_UNSIGNED_SHORT,
+                                                              cylinder_indices.size(), "SCALAR", "");
+
+    // the twelve edges between the corners a*i + b*j + c*k (corner i + 2j + 4k)
+    static const uint16_t cell_edges[24] = {0, 1, 0, 2, 0, 4, 1, 3, 1, 5, 2, 3, 2, 6, 3, 7, 4, 5, 4, 6, 5, 7, 6, 7};
+    const unsigned int cell_lines = gltf.add_accessor(cell_edges, sizeof(cell_edges), GLTF_ELEMENT_ARRAY_BUFFER,
+                                                      GLTF_UNSIGNED_SHORT, 24, "SCALAR", "");
+
+    for(unsigned int s=0; s<names.size(); s++) {
+        const Color color = get_atom_color(elnrs[s]);
+        str.str("");
+        str << "{\"name\":\"" << names[s] << "\",\"pbrMetallicRoughness\":{\"baseColorFactor\":["
+            << float2str2(srgb_to_linear(color.r), "%.5f") << "," << float2str2(srgb_to_linear(color.g), "%.5f") << ","
+            << float2str2(srgb_to_linear(color.b), "%.5f") << ",1.0],\"metallicFactor\":0.0,\"roughnessFactor\":0.5}}";
+        materials.push_back(str.str());
+
+        std::vector<float> positions(sphere);
+        for(unsigned int i=0; i<positions.size(); i++) {
+            positions[i] *= get_atom_radius(elnrs[s]);
+        }
+        const unsigned int accessor = gltf.add_accessor(&positions[0], positions.size() * sizeof(float), GLTF_ARRAY_BUFFER,
+                                                        GLTF_FLOAT, positions.size() / 3, "VEC3", get_bounds(positions, 3));
+
+        str.str("");
+        str << "{\"name\":\"" << names[s] << "\",\"primitives\":[{\"attributes\":{\"POSITION\":" << accessor
+            << ",\"NORMAL\":" << sphere_normals << "},\"indices\":" << sphere_triangles << ",\"material\":" << s << "}]}";
+        meshes.push_back(str.str());
+
+        str.str("");
+        str << "{\"name\":\"" << names[s] << " bond\",\"primitives\":[{\"attributes\":{\"POSITION\":" << cylinder_positions
+            << ",\"NORMAL\":" << cylinder_normal_accessor << "},\"indices\":" << cylinder_triangles << ",\"material\":" << s << "}]}";
+        meshes.push_back(str.str());
+    }
+
+    const unsigned int cell_material = materials.size();
+    materials.push_back("{\"name\":\"cell\",\"pbrMetallicRoughness\":{\"baseColorFactor\":[0.0,0.0,0.0,1.0],"
+                        "\"metallicFactor\":0.0,\"roughnessFactor\":1.0}}");
+
+    // instances: per frame a node with a child per species for the atoms
+    // and one for the half bonds, and a node with the edges of the cell
+    std::vector<unsigned int> frame_nodes;
+    std::vector<SceneBond> bond_list;
+    for(unsigned int f=0; f<frames.size(); f++) {
+        const State &state = frames[f];
+        std::vector<unsigned int> frame_species;
+        get_species(state, names, elnrs, frame_species);
+
+        std::vector<std::vector<float> > translations(names.size());
+        for(unsigned int i=0; i<state.atoms.size(); i++) {
+            for(unsigned int k=0; k<3; k++) {
+                translations[frame_species[i]].push_back(state.atoms[i].pos(k));
+            }
+        }
+
+        std::vector<std::vector<float> > bond_origins(names.size());
+        std::vector<std::vector<int16_t> > bond_rotations(names.size());
+        std::vector<std::vector<float> > bond_scales(names.size());
+        bond_list.clear();
+        if(this->bonds) {
+            this->find_bonds(state, bond_list);
+        }
+        for(unsigned int b=0; b<bond_list.size(); b++) {
+            // a bond within the cell between atoms of the same species is a
+            // single cylinder, all other bonds consist of two halves
+            const bool whole = !bond_list[b].periodic && frame_species[bond_list[b].i] == frame_species[bond_list[b].j];
+            for(unsigned int h=0; h<(whole ? 1 : 2); h++) {
+                // the cylinder points along y; rotate it onto the bond
+                const unsigned int atom = h == 0 ? bond_list[b].i : bond_list[b].j;
+                const Eigen::Vector3f u = (h == 0 ? bond_list[b].d : -bond_list[b].d).normalized();
+                Eigen::Vector4f q(u(2), 0.0f, -u(0), 1.0f + u(1));
+                if(q(3) < 1e-6f) {
+                    q = Eigen::Vector4f(1.0f, 0.0f, 0.0f, 0.0f);
+                }
+                q.normalize();
+
+                const unsigned int s = frame_species[atom];
+                for(unsigned int k=0; k<3; k++) {
+                    bond_origins[s].push_back(state.atoms[atom].pos(k));
+                }
+                for(unsigned int k=0; k<4; k++) {
+                    bond_rotations[s].push_back((int16_t)std::floor(q(k) * 32767.0f + 0.5f));
+                }
+                bond_scales[s].push_back(1.0f);
+                bond_scales[s].push_back(bond_list[b].d.norm() * (whole ? 1.0f : 0.5f));
+                bond_scales[s].push_back(1.0f);
+            }
+        }
+
+        std::string children;
+        for(unsigned int s=0; s<names.size(); s++) {
+            if(!translations[s].empty()) {
+                const unsigned int accessor = gltf.add_accessor(&translations[s][0], translations[s].size() * sizeof(float), 0,
+                                                                GLTF_FLOAT, translations[s].size() / 3, "VEC3", "");
+                str.str("");
+                str << "{\"name\":\"" << names[s] << "\",\"mesh\":" << 2 * s
+                    << ",\"extensions\":{\"EXT_mesh_gpu_instancing\":{\"attributes\":{\"TRANSLATION\":" << accessor << "}}}}";
+                nodes.push_back(str.str());
+                children += (children.empty() ? "" : ",") + int2str(nodes.size() - 1);
+            }
+            if(!bond_origins[s].empty()) {
+                const size_t count = bond_origins[s].size() / 3;
+                const unsigned int origins = gltf.add_accessor(&bond_origins[s][0], bond_origins[s].size() * sizeof(float), 0,
+                                                               GLTF_FLOAT, count, "VEC3", "");
+                const unsigned int rotations = gltf.add_accessor(&bond_rotations[s][0], bond_rotations[s].size() * sizeof(int16_t), 0,
+                                                                 GLTF_SHORT, count, "VEC4", ",\"normalized\":true");
+                const unsigned int scales = gltf.add_accessor(&bond_scales[s][0], bond_scales[s].size() * sizeof(float), 0,
+                                                              GLTF_FLOAT, count, "VEC3", "");
+                str.str("");
+                str << "{\"name\":\"" << names[s] << " bonds\",\"mesh\":" << 2 * s + 1
+                    << ",\"extensions\":{\"EXT_mesh_gpu_instancing\":{\"attributes\":{\"TRANSLATION\":" << origins
+                    << ",\"ROTATION\":" << rotations << ",\"SCALE\":" << scales << "}}}}";
+                nodes.push_back(str.str());
+                children += (children.empty() ? "" : ",") + int2str(nodes.size() - 1);
+            }
+        }
+
+        std::vector<float> corners;
+        for(unsigned int c=0; c<8; c++) {
+            const Vector3 corner = (Real)(c & 1) * state.dimensions.row(0) + (Real)((c >> 1) & 1) * state.dimensions.row(1) +
+                                   (Real)((c >> 2) & 1) * state.dimensions.row(2);
+            for(unsigned int k=0; k<3; k++) {
+                corners.push_back(corner(k));
+            }
+        }
+        const unsigned int cell_positions = gltf.add_accessor(&corners[0], corners.size() * sizeof(float), GLTF_ARRAY_BUFFER,
+                                                              GLTF_FLOAT, 8, "VEC3", get_bounds(corners, 3));
+        str.str("");
+        str << "{\"name\":\"cell\",\"primitives\":[{\"attributes\":{\"POSITION\":" << cell_positions
+            << "},\"indices\":" << cell_lines << ",\"material\":" << cell_material << ",\"mode\":1}]}";
+        meshes.push_back(str.str());
+        str.str("");
+        str << "{\"name\":\"cell\",\"mesh\":" << meshes.size() - 1 << "}";
+        nodes.push_back(str.str());
+        children += (children.empty() ? "" : ",") + int2str(nodes.size() - 1);
+
+        str.str("");
+        str << "{\"name\":\"frame " << f + 1 << "\",\"children\":[" << children << "]}";
+        nodes.push_back(str.str());
+        frame_nodes.push_back(nodes.size() - 1);
+    }
+
+    // frame f is visible (scale 1) from f / fps until (f + 1) / fps
+    std::string samplers, channels;
+    if(frames.size() > 1) {
+        for(unsigned int f=0; f<frames.size(); f++) {
+            std::vector<float> times;
+            std::vector<float> scales;
+            if(f > 0) {
+                times.push_back(0.0f);
+                scales.insert(scales.end(), 3, 0.0f);
+            }
+            times.push_back(f / this->fps);
+            scales.insert(scales.end(), 3, 1.0f);
+            if(f + 1 < frames.size()) {
+                times.push_back((f + 1) / this->fps);
+                scales.insert(scales.end(), 3, 0.0f);
+            }
+
+            const unsigned int input = gltf.add_accessor(&times[0], times.size() * sizeof(float), 0, GLTF_FLOAT,
+                                                         times.size(), "SCALAR", get_bounds(times, 1));
+            const unsigned int output = gltf.add_accessor(&scales[0], scales.size() * sizeof(float), 0, GLTF_FLOAT,
+                                                          times.size(), "VEC3", "");
+            str.str("");
+            str << (f > 0 ? "," : "") << "{\"input\":" << input << ",\"output\":" << output << ",\"interpolation\":\"STEP\"}";
+            samplers += str.str();
+            str.str("");
+            str << (f > 0 ? "," : "") << "{\"sampler\":" << f << ",\"target\":{\"node\":" << frame_nodes[f] << ",\"path\":\"scale\"}}";
+            channels += str.str();
+        }
+    }
+
+    while(gltf.bin.size() % 4 != 0) {
+        gltf.bin += '\0';
+    }
+
+    std::string json = "{\"asset\":{\"version\":\"2.0\",\"generator\":\"v2c\"},"
+                       "\"extensionsUsed\":[\"EXT_mesh_gpu_instancing\"],"
+                       "\"extensionsRequired\":[\"EXT_mesh_gpu_instancing\"],\"scene\":0,\"scenes\":[{\"nodes\":[";
+    for(unsigned int f=0; f<frame_nodes.size(); f++) {
+        json += (f > 0 ? "," : "") + int2str(frame_nodes[f]);
+    }
+    json += "]}],\"nodes\":[";
+    for(unsigned int i=0; i<nodes.size(); i++) {
+        json += (i > 0 ? "," : "") + nodes[i];
+    }
+    json += "],\"meshes\":[";
+    for(unsigned int i=0; i<meshes.size(); i++) {
+        json += (i > 0 ? "," : "") + meshes[i];
+    }
+    json += "],\"materials\":[";
+    for(unsigned int i=0; i<materials.size(); i++) {
+        json += (i > 0 ? "," : "") + materials[i];
+    }
+    json += "],\"accessors\":[";
+    for(unsigned int i=0; i<gltf.accessors.size(); i++) {
+        json += (i > 0 ? "," : "") + gltf.accessors[i];
+    }
+    json += "],\"bufferViews\":[";
+    for(unsigned int i=0; i<gltf.views.size(); i++) {
+        json += (i > 0 ? "," : "") + gltf.views[i];
+    }
+    json += "],\"buffers\":[{\"byteLength\":" + int2str(gltf.bin.size()) + "}]";
+    if(!samplers.empty()) {
+        json += ",\"animations\":[{\"name\":\"trajectory\",\"samplers\":[" + samplers + "],\"channels\":[" + channels + "]}]";
+    }
+    json += "}";
+    while(json.size() % 4 != 0) {
+        json += ' ';
+    }
+
+    // header, JSON chunk and binary chunk
+    std::string buffer;
+    buffer.reserve(28 + json.size() + gltf.bin.size());
+    append_uint32(buffer, 0x46546C67);      // "glTF"
+    append_uint32(buffer, 2);
+    append_uint32(buffer, 28 + json.size() + gltf.bin.size());
+    append_uint32(buffer, json.size());
+    append_uint32(buffer, 0x4E4F534A);      // "JSON"
+    buffer += json;
+    append_uint32(buffer, gltf.bin.size());
+    append_uint32(buffer, 0x004E4942);      // "BIN"
+    buffer += gltf.bin;
+
+    return OutputSink::write_file(filename, buffer);
+}
+
+/*
+ * Write <state> as binary PLY point cloud with a color and radius per atom
+ * and the bonds within the cell as edges
+ */
+bool SceneWriter::write_ply(const State &state, const std::string &filename) const {
+    std::vector<SceneBond> bond_list;
+    if(this->bonds) {
+        this->find_bonds(state, bond_list);
+    }
+    unsigned int nr_edges = 0;
+    for(unsigned int b=0; b<bond_list.size(); b++) {
+        nr_edges += bond_list[b].periodic ? 0 : 1;
+    }
+
+    std::string buffer = "ply\nformat binary_little_endian 1.0\ncomment v2c\n";
+    buffer += "element vertex " + int2str(state.atoms.size()) + "\n";
+    buffer += "property float x\nproperty float y\nproperty float z\n";
+    buffer += "property uchar red\nproperty uchar green\nproperty uchar blue\nproperty float radius\n";
+    buffer += "element edge " + int2str(nr_edges) + "\n";
+    buffer += "property int vertex1\nproperty int vertex2\nend_header\n";
+    buffer.reserve(buffer.size() + state.atoms.size() * 19 + nr_edges * 8);
+
+    for(unsigned int i=0; i<state.atoms.size(); i++) {
+        const Color color = get_atom_color(state.atoms[i].elnr);
+        const float radius = get_atom_radius(state.atoms[i].elnr);
+        for(unsigned int k=0; k<3; k++) {
+            const float x = state.atoms[i].pos(k);
+            buffer.append((const char*)&x, sizeof(float));
+        }
+        buffer += (char)(unsigned char)std::floor(color.r * 255.0f + 0.5f);
+        buffer += (char)(unsigned char)std::floor(color.g * 255.0f + 0.5f);
+        buffer += (char)(unsigned char)std::floor(color.b * 255.0f + 0.5f);
+        buffer.append((const char*)&radius, sizeof(float));
+    }
+
+    for(unsigned int b=0; b<bond_list.size(); b++) {
+        if(!bond_list[b].periodic) {
+            append_uint32(buffer, bond_list[b].i);
+            append_uint32(buffer, bond_list[b].j);
+        }
+    }
+
+    return OutputSink::write_file(filename, buffer);
+}
+
+/*
+ * Radius [A] of the sphere of an element
+ */
+float SceneWriter::get_atom_radius(unsigned int elnr) {
+    switch(elnr) {
+        case ATOM_H:  return ATOM_RADIUS_H;
+        case ATOM_C:  return ATOM_RADIUS_C;
+        case ATOM_N:  return ATOM_RADIUS_N;
+        case ATOM_O:  return ATOM_RADIUS_O;
+        case ATOM_RH: return ATOM_RADIUS_RH;
+        case ATOM_FE: return ATOM_RADIUS_FE;
+        default:      return SCENE_DEFAULT_RADIUS;
+    }
+}
+
+Color SceneWriter::get_atom_color(unsigned int elnr) {
+    switch(elnr) {
+        case ATOM_H:  return Color(ATOM_COLOR_H);
+        case ATOM_C:  return Color(ATOM_COLOR_C);
+        case ATOM_N:  return Color(ATOM_COLOR_N);
+        case ATOM_O:  return Color(ATOM_COLOR_O);
+        case ATOM_RH: return Color(ATOM_COLOR_RH);
+        case ATOM_FE: return Color(ATOM_COLOR_FE);
+        default:      return Color(SCENE_DEFAULT_COLOR);
+    }
+}
+
+/*
+ * Bonded pairs according to the cutoffs of atom_constants.h, each reported
+ * once, with the distance vector to the nearest bonded image
+ */
+void SceneWriter::find_bonds(const State &state, std::vector<SceneBond> &result) const {
+    const unsigned int n = state.atoms.size();
+    std::vector<unsigned int> elnrs;
+    std::vector<float> coordinates(n * 3);
+    for(unsigned int i=0; i<n; i++) {
+        elnrs.push_back(state.atoms[i].elnr);
+        for(unsigned int k=0; k<3; k++) {
+            coordinates[i * 3 + k] = state.atoms[i].pos(k);
+        }
+    }
+    std::sort(elnrs.begin(), elnrs.end());
+    elnrs.erase(std::unique(elnrs.begin(), elnrs.end()), elnrs.end());
+    const float max_cutoff = get_max_bond_cutoff(elnrs);
+    if(n == 0 || max_cutoff <= 0.0f) {
+        return;
+    }
+
+    CellList cells(state.dimensions, max_cutoff);
+    cells.build(&coordinates[0], &coordinates[1], &coordinates[2], n, 3);
+    cells.for_each_pair([&](unsigned int i, unsigned int j, double r2, double dx, double dy, double dz) {
+        const float cutoff = get_bond_cutoff(state.atoms[i].elnr, state.atoms[j].elnr);
+        if(i == j || r2 >= cutoff * cutoff) {
+            return;
+        }
+        SceneBond bond;
+        bond.i = i;
+        bond.j = j;
+        bond.d = Eigen::Vector3f(dx, dy, dz);
+        bond.periodic = ((state.atoms[j].pos - state.atoms[i].pos).cast<float>() - bond.d).norm() > 1e-3f;
+        result.push_back(bond);
+    });
+}
+
+/*
+ * Species (by element name, in order of appearance) and the species of
+ * every atom; the atoms are stored in blocks per element. <names> and
+ * <elnrs> are extended with new elements.
+ */
+void SceneWriter::get_species(const State &state, std::vector<std::string> &names,
+                              std::vector<unsigned int> &elnrs, std::vector<unsigned int> &species) {
+    species.assign(state.atoms.size(), 0);
+    unsigned int atom = 0;
+    for(unsigned int e=0; e<state.get_nr_elements(); e++) {
+        const std::string &name = state.get_elements()[e];
+        unsigned int s = std::find(names.begin(), names.end(), name) - names.begin();
+        if(s == names.size()) {
+            names.push_back(name);
+            elnrs.push_back(state.get_atoms_for_element(e) > 0 && atom < state.atoms.size() ? state.atoms[atom].elnr : 0);
+        }
+        for(unsigned int i=0; i<state.get_atoms_for_element(e) && atom<state.atoms.size(); i++, atom++) {
+            species[atom] = s;
+        }
+    }
+
+    // atoms beyond the element blocks
+    if(atom < state.atoms.size()) {
+        if(names.empty()) {
+            names.push_back("X");
+            elnrs.push_back(0);
+        }
+        for(; atom<state.atoms.size(); atom++) {
+            species[atom] = names.size() - 1;
+        }
+    }
+}
+
+/*
+ * Unit sphere as subdivided icosahedron; the vertices double as normals
+ */
+void SceneWriter::build_sphere(std::vector<float> &vertices, std::vector<uint16_t> &indices) {
+    const float t = (1.0f + std::sqrt(5.0f)) / 2.0f;
+    const float ico[12][3] = {
+        {-1, t, 0}, {1, t, 0}, {-1, -t, 0}, {1, -t, 0},
+        {0, -1, t}, {0, 1, t}, {0, -1, -t}, {0, 1, -t},
+        {t, 0, -1}, {t, 0, 1}, {-t, 0, -1}, {-t, 0, 1}
+    };
+    const uint16_t faces[20][3] = {
+        {0, 11, 5}, {0, 5, 1}, {0, 1, 7}, {0, 7, 10}, {0, 10, 11},
+        {1, 5, 9}, {5, 11, 4}, {11, 10, 2}, {10, 7, 6}, {7, 1, 8},
+        {3, 9, 4}, {3, 4, 2}, {3, 2, 6}, {3, 6, 8}, {3, 8, 9},
+        {4, 9, 5}, {2, 4, 11}, {6, 2, 10}, {8, 6, 7}, {9, 8, 1}
+    };
+
+    std::vector<Eigen::Vector3f> points;
+    for(unsigned int i=0; i<12; i++) {
+        points.push_back(Eigen::Vector3f(ico[i][0], ico[i][1], ico[i][2]).normalized());
+    }
+    indices.assign(&faces[0][0], &faces[0][0] + 60);
+
+    for(unsigned int level=0; level<SCENE_SPHERE_SUBDIVISIONS; level++) {
+        std::map<std::pair<uint16_t, uint16_t>, uint16_t> midpoints;
+        std::vector<uint16_t> refined;
+        for(unsigned int f=0; f<indices.size(); f+=3) {
+            uint16_t mid[3];
+            for(unsigned int e=0; e<3; e++) {
+                const uint16_t a = std::min(indices[f + e], indices[f + (e + 1) % 3]);
+                const uint16_t b = std::max(indices[f + e], indices[f + (e + 1) % 3]);
+                std::map<std::pair<uint16_t, uint16_t>, uint16_t>::const_iterator it = midpoints.find(std::make_pair(a, b));
+                if(it == midpoints.end()) {
+                    points.push_back((points[a] + points[b]).normalized());
+                    mid[e] = points.size() - 1;
+                    midpoints[std::make_pair(a, b)] = mid[e];
+                } else {
+                    mid[e] = it->second;
+                }
+            }
+            const uint16_t sub[12] = {
+                indices[f], mid[0], mid[2],
+                indices[f + 1], mid[1], mid[0],
+                indices[f + 2], mid[2], mid[1],
+                mid[0], mid[1], mid[2]
+            };
+            refined.insert(refined.end(), sub, sub + 12);
+        }
+        indices.swap(refined);
+    }
+
+    vertices.clear();
+    for(unsigned int i=0; i<points.size(); i++) {
+        for(unsigned int k=0; k<3; k++) {
+            vertices.push_back(points[i](k));
+        }
+    }
+}
+
+/*
+ * Open cylinder of radius SCENE_BOND_RADIUS from y = 0 to y = 1; its ends
+ * are hidden inside the spheres
+ */
+void SceneWriter::build_cylinder(std::vector<float> &vertices, std::vector<float> &normals,
+                                 std::vector<uint16_t> &indices) {
+    vertices.clear();
+    normals.clear();
+    indices.clear();
+
+    for(unsigned int s=0; s<SCENE_CYLINDER_SEGMENTS; s++) {
+        const float phi = 2.0f * M_PI * s / SCENE_CYLINDER_SEGMENTS;
+        const float x = std::cos(phi);
+        const float z = std::sin(phi);
+        for(unsigned int end=0; end<2; end++) {
+            vertices.push_back(x * SCENE_BOND_RADIUS);
+            vertices.push_back((float)end);
+            vertices.push_back(z * SCENE_BOND_RADIUS);
+            normals.push_back(x);
+            normals.push_back(0.0f);
+            normals.push_back(z);
+        }
+    }
+
+    for(unsigned int s=0; s<SCENE_CYLINDER_SEGMENTS; s++) {
+        const uint16_t a = 2 * s;
+        const uint16_t b = 2 * ((s + 1) % SCENE_CYLINDER_SEGMENTS);
+        const uint16_t quad[6] = {a, (uint16_t)(a + 1), b, b, (uint16_t)(a + 1), (uint16_t)(b + 1)};
+        indices.insert(indices.end(), quad, quad + 6);
+    }
+}
@@ -20,10 +20,26 @@
  ************************************************************************/
 
 #include "state.h"
+#include "poscarwriter.h"
+#include "geometry.h"
+
+StateObservables::StateObservables() {
+    this->available = 0;
+    for(unsigned int i=0; i<6; i++) {
+        this->stress[i] = 0.0;
+    }
+    this->magnetization = 0.0;
+    this->kinetic_energy = 0.0;
+    this->temperature = 0.0;
+    this->cpu_time = 0.0;
+    this->real_time = 0.0;
+    this->max_force = 0.0;
+    this->rms_force = 0.0;
+}
 
 State::State(
     const double &_energy,
-    const std::vector<float> &_dimensions,
+    const std::vector<Real> &_dimensions,
     const std::vector<Atom> &_atoms,
     const std::vector<std::string> &_elements,
     const std::vector<unsigned int> &_elements_uint,
@@ -51,7 +67,7 @@ State::State(
 
 State::State(
     const double &_energy,
-    const std::vector<float> &_dimensions
+    const std::vector<Real> &_dimensions
   ) {
     this->energy = _energy;
 
@@ -61,6 +77,7 @@ State::State(
         }
     }
 
+    this->state_id_in_file = 0;
     this->atom_cnt = this->atoms.size();
     this->allocate_coordinate_matrix();
 }
@@ -71,12 +88,28 @@ State::State(
   ) {
     this->energy = _energy;
     this->dimensions = _dimensions;
+    this->state_id_in_file = 0;
+    this->atom_cnt = 0;
 }
 
 const std::string& State::get_filename() const {
     return this->filename;
 }
 
+/*
+ * Returns the (1-based) index of this state in the file it was read from
+ */
+unsigned int State::get_state_id() const {
+    return this->state_id_in_file;
+}
+
+/*
+ * Renumber the state, e.g. within a trajectory of several files
+ */
+void State::set_state_id(unsigned int _id) {
+    this->state_id_in_file = _id;
+}
+
 unsigned int State::get_total_nr_atoms() const {
     return this->atom_cnt;
 }
@@ -93,8 +126,20 @@ const double& State::get_energy() const {
     return this->energy;
 }
 
-std::vector<float> State::get_atom_position(unsigned int i) const {
-    std::vector<float> pos;
+/*
+ * Returns the optional quantities of this ionic step; only those flagged in
+ * the available field were present in the file
+ */
+const StateObservables& State::get_observables() const {
+    return this->observables;
+}
+
+void State::set_observables(const StateObservables &_observables) {
+    this->observables = _observables;
+}
+
+std::vector<Real> State::get_atom_position(unsigned int i) const {
+    std::vector<Real> pos;
 
     pos.push_back(this->atoms[i].get_x());
     pos.push_back(this->atoms[i].get_y());
@@ -103,6 +148,10 @@ std::vector<float> State::get_atom_position(unsigned int i) const {
     return pos;
 }
 
+/*
+ * Returns the centroid of the atoms, or the center of the unit cell when
+ * there are no atoms
+ */
 Vector3 State::get_center() {
 
     if(this->atoms.size() == 0) {
@@ -111,119 +160,65 @@ Vector3 State::get_center() {
                this->dimensions.row(2) / 2;
     }
 
-    float x = 0;
-    float y = 0;
-    float z = 0;
-
-    for(unsigned int i=0; i<this->atoms.size(); i++) {
-        x += this->atoms[i].get_x();
-        y += this->atoms[i].get_y();
-        z += this->atoms[i].get_z();
-    }
-
-    return Vector3(x / (float)this->atoms.size(),
-                   y / (float)this->atoms.size(),
-                   z / (float)this->atoms.size());
+    return Geometry::centroid(this->get_cartesian_coordinates());
 }
 
 const std::vector<std::string>& State::get_elements() const {
     return this->elements;
 }
 
-void State::allocate_coordinate_matrix() {
-    this->coordinates = MatrixX4f(this->atoms.size(), 4);
-
-    for(unsigned int i=0; i<this->atoms.size(); i++) {
-        this->coordinates(i,0) = this->atoms[i].get_x();
-        this->coordinates(i,1) = this->atoms[i].get_y();
-        this->coordinates(i,2) = this->atoms[i].get_z();
-        this->coordinates(i,3) = 1.0f;
-    }
+const std::vector<unsigned int>& State::get_elements_uint() const {
+    return this->elements_uint;
 }
 
-void State::save_to_poscar(const char* filename, const char* name, bool is_vasp5) {
-    std::ofstream myfile (filename);
-
-    if (myfile.is_open()) {
-        myfile << name << std::endl;
-
-        myfile << 1.00 << std::endl;
-
-        for(unsigned int i=0; i<3; i++) {
-            for(unsigned int j=0; j<3; j++) {
-                if(j != 2) {
-                    myfile << float2str2(this->dimensions(i,j), "%8.7f") << "   ";
-                } else {
-                    myfile << float2str2(this->dimensions(i,j), "%8.7f");
-                }
-            }
-            myfile << std::endl;
-        }
-
-        if(is_vasp5) {
-
-        }
-
-        myfile << output_atoms_line() << std::endl;
-
-        myfile << "Direct" << std::endl;
-        myfile << output_atom_coordinates() << std::endl;
-
-        myfile.close();
-    }
+const std::vector<unsigned int>& State::get_nr_atoms_per_element() const {
+    return this->nr_atoms;
 }
 
-std::string State::output_atoms_line() {
-    std::vector<unsigned int> element_numbers;
-    std::vector<unsigned int> element_count;
-
-    for(unsigned int i=0; i<this->atom_cnt; i++) {
-        bool in_vector = false;
-        for(unsigned int j=0; j<element_numbers.size(); j++) {
-            if(element_numbers[j] == this->atoms[i].elnr) {
-                element_count[j]++;
-                in_vector = true;
-            }
-        }
-        if(!in_vector) {
-            element_numbers.push_back(this->atoms[i].elnr);
-            element_count.push_back(1);
-        }
+/*
+ * Returns the Cartesian positions of the atoms as rows; they are taken from
+ * the coordinate matrix when it matches the atoms and from the atoms
+ * otherwise (e.g. after the atoms have been changed)
+ */
+MatrixX3 State::get_cartesian_coordinates() const {
+    if((size_t)this->coordinates.rows() == this->atoms.size()) {
+        return this->coordinates.leftCols<3>();
     }
 
-    std::string result;
-    for(unsigned int i=0; i<element_numbers.size(); i++) {
-        result += int2str(element_count[i]) + std::string("  ");
+    MatrixX3 cartesian(this->atoms.size(), 3);
+    for(unsigned int i=0; i<this->atoms.size(); i++) {
+        cartesian.row(i) = this->atoms[i].pos.transpose();
     }
-
-    return result;
+    return cartesian;
 }
 
-std::string State::output_atom_coordinates() {
-    MatrixX3f cartesian_coordinates(this->atom_cnt, 3);
+void State::allocate_coordinate_matrix() {
+    this->coordinates = MatrixX4(this->atoms.size(), 4);
 
-    unsigned int counter = 0;
-    for(unsigned int i=0; i<this->nr_atoms.size(); i++) {
-        for(unsigned int j=0; j<this->atom_cnt; j++) {
-            if(this->atoms[j].elnr == this->elements_uint[i]) {
-                cartesian_coordinates(counter, 0) = this->atoms[j].get_x();
-                cartesian_coordinates(counter, 1) = this->atoms[j].get_y();
-                cartesian_coordinates(counter, 2) = this->atoms[j].get_z();
-                counter++;
-            }
-        }
+    for(unsigned int i=0; i<this->atoms.size(); i++) {
+        this->coordinates(i,0) = this->atoms[i].get_x();
+        this->coordinates(i,1) = this->atoms[i].get_y();
+        this->coordinates(i,2) = this->atoms[i].get_z();
+        this->coordinates(i,3) = 1.0;
     }
+}
 
-    Matrix3 inverse = this->dimensions.inverse();
-
-    Matrix3Xf direct_coordinates = inverse.transpose() * cartesian_coordinates.transpose();
+/*
+ * Write the state as POSCAR file; with <is_vasp5> the line with the element
+ * symbols is included. Returns false when the file cannot be written.
+ */
+bool State::save_to_poscar(const char* filename, const char* name, bool is_vasp5) {
+    PoscarWriter writer(*this, is_vasp5);
+    return writer.write(*this, filename, name);
+}
 
+/*
+ * Returns the number of atoms of every element, as on the POSCAR line
+ */
+std::string State::output_atoms_line() {
     std::string result;
-    for(unsigned int i=0; i<this->atom_cnt; i++) {
-        for(unsigned int j=0; j<3; j++) {
-            result += float2str2(direct_coordinates(j,i), "%6.5f") + std::string("  ");
-        }
-        result += std::string("\n");
+    for(unsigned int i=0; i<this->nr_atoms.size(); i++) {
+        result += int2str(this->nr_atoms[i]) + std::string("  ");
     }
 
     return result;
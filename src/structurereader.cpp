@@ -0,0 +1,687 @@
+/*************************************************************************
+ *
+ *  This file is part of v2c.
+ *
+ *  Author: Ivo Filot <i.a.w.filot@tue.nl>
+ *
+ *  v2c is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  v2c is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with v2c.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ************************************************************************/
+
+#include "structurereader.h"
+#include "vaspreader.h"
+
+#include <algorithm>
+#include <unordered_map>
+#include <cmath>
+#include <ctype.h>
+#include <stdlib.h>
+#include <stdint.h>
+
+/*
+ * Element symbol from a POTCAR name (Rh_pv, O_s/1a2b3c) or a CIF label or
+ * type symbol (Rh1, O2-): the leading letters, of which only the first may
+ * be a capital
+ */
+static std::string element_from_label(const std::string &label) {
+    std::string result;
+    for(unsigned int i=0; i<label.size() && result.size() < 2; i++) {
+        const char c = label[i];
+        if(!isalpha((unsigned char)c) || (i > 0 && isupper((unsigned char)c))) {
+            break;
+        }
+        result += (i == 0) ? toupper(c) : c;
+    }
+    return result;
+}
+
+/*
+ * CIF number, possibly followed by its uncertainty in parentheses
+ */
+static bool cif_number(const std::string &str, double *value) {
+    const size_t paren = str.find('(');
+    Token token;
+    token.begin = str.data();
+    token.end = str.data() + (paren == std::string::npos ? str.size() : paren);
+    return Tokenizer::to_double(token, value);
+}
+
+/*
+ * A CIF text field is delimited by lines that start with a semicolon
+ */
+static bool is_text_field_delimiter(const Token &line) {
+    return line.size() > 0 && line.begin[0] == ';';
+}
+
+/*
+ * An unquoted token starting with # starts a comment
+ */
+static bool is_comment(const Token &token, const Token &line) {
+    return token.begin[0] == '#' && (token.begin == line.begin || (token.begin[-1] != '\'' && token.begin[-1] != '"'));
+}
+
+static std::string to_lower(const std::string &str) {
+    std::string result(str);
+    for(unsigned int i=0; i<result.size(); i++) {
+        result[i] = tolower(result[i]);
+    }
+    return result;
+}
+
+/*
+ * Positions of the sites of one element per bin of a grid over the unit
+ * cell, keyed by the index of the bin
+ */
+typedef std::unordered_map<uint64_t, std::vector<unsigned int> > SiteBins;
+
+/*
+ * Whether <positions> holds a site within STRUCTURE_CIF_SITE_TOLERANCE of
+ * the wrapped fractional position <f>. <bins> lists the sites per bin of a
+ * grid of <nr_bins>^3 bins that are at least the tolerance wide, such that
+ * only the bin of <f> and the neighbors within the tolerance of its
+ * boundaries are searched.
+ */
+static bool has_site(const SiteBins &bins, const std::vector<Eigen::Vector3d> &positions,
+                     const Eigen::Vector3d &f, int nr_bins) {
+    int range[3][3];
+    unsigned int nr_range[3];
+    const double m = STRUCTURE_CIF_SITE_TOLERANCE * nr_bins;
+    for(unsigned int k=0; k<3; k++) {
+        const double x = f(k) * nr_bins;
+        const int bin = std::min(nr_bins - 1, (int)x);
+        range[k][0] = bin;
+        nr_range[k] = 1;
+        if(x - bin < m) {
+            range[k][nr_range[k]++] = (bin + nr_bins - 1) % nr_bins;
+        }
+        if(bin + 1 - x < m) {
+            range[k][nr_range[k]++] = (bin + 1) % nr_bins;
+        }
+    }
+
+    for(unsigned int x=0; x<nr_range[0]; x++) {
+        for(unsigned int y=0; y<nr_range[1]; y++) {
+            for(unsigned int z=0; z<nr_range[2]; z++) {
+                const uint64_t key = ((uint64_t)range[0][x] * nr_bins + range[1][y]) * nr_bins + range[2][z];
+                const SiteBins::const_iterator it = bins.find(key);
+                if(it == bins.end()) {
+                    continue;
+                }
+                for(unsigned int i=0; i<it->second.size(); i++) {
+                    Eigen::Vector3d d = f - positions[it->second[i]];
+                    d = d.array() - (d.array() + 0.5).floor();
+                    if(d.cwiseAbs().maxCoeff() < STRUCTURE_CIF_SITE_TOLERANCE) {
+                        return true;
+                    }
+                }
+            }
+        }
+    }
+
+    return false;
+}
+
+/*
+ * Construct the state from atoms that are already grouped per element
+ */
+static State make_state(const Eigen::Matrix3d &lattice, const std::vector<Atom> &atoms,
+                        const std::vector<std::string> &elements, const std::vector<unsigned int> &counts,
+                        const std::string &filename, unsigned int id) {
+    std::vector<Real> dimensions(9);
+    for(unsigned int i=0; i<3; i++) {
+        for(unsigned int j=0; j<3; j++) {
+            dimensions[i*3+j] = lattice(i,j);
+        }
+    }
+
+    std::vector<unsigned int> elements_uint;
+    for(unsigned int i=0; i<elements.size(); i++) {
+        elements_uint.push_back(VaspReader::get_element_number_from_name(elements[i]));
+    }
+
+    return State(0.0, dimensions, atoms, elements, elements_uint, counts, filename, id);
+}
+
+/*
+ * Default constructor
+ */
+StructureReader::StructureReader() {}
+
+/*
+ * Read all structures from a file and append them to <states>. When no
+ * format is given, it is derived from the file name (POSCAR by default).
+ */
+bool StructureReader::read(const std::string &filename, std::vector<State> &states, unsigned int format) const {
+    std::vector<char> buffer;
+    if(!Tokenizer::read_file(filename, buffer)) {
+        std::cerr << "Cannot open " << filename << std::endl;
+        return false;
+    }
+
+    if(format == STRUCTURE_FORMAT_UNKNOWN) {
+        format = detect_format(filename);
+    }
+
+    Tokenizer tokenizer(buffer.data(), buffer.data() + buffer.size());
+    if(format == STRUCTURE_FORMAT_CIF) {
+        return this->parse_cif(tokenizer, filename, states);
+    }
+
+    return this->parse_poscar(tokenizer, filename, states);
+}
+
+/*
+ * Read many files, distributed over the workers of <pool>. The structures
+ * are appended to <states> in the order of the files; files that cannot be
+ * read are skipped. Returns the number of files that have been read.
+ */
+unsigned int StructureReader::read_files(const std::vector<std::string> &filenames, std::vector<State> &states,
+                                         ThreadPool &pool, unsigned int format) const {
+    std::vector<std::vector<State> > results(filenames.size());
+    std::vector<char> success(filenames.size(), 0);
+
+    pool.parallel_for(filenames.size(), [&](size_t i, unsigned int worker) {
+        success[i] = this->read(filenames[i], results[i], format);
+    });
+
+    unsigned int count = 0;
+    for(unsigned int i=0; i<filenames.size(); i++) {
+        if(success[i]) {
+            states.insert(states.end(), results[i].begin(), results[i].end());
+            count++;
+        }
+    }
+
+    return count;
+}
+
+/*
+ * Derive the format from the name of a file: *.cif is a CIF file; POSCAR*,
+ * CONTCAR* and *.vasp are POSCAR files
+ */
+unsigned int StructureReader::detect_format(const std::string &filename) {
+    const size_t slash = filename.find_last_of('/');
+    const std::string base = to_lower(slash == std::string::npos ? filename : filename.substr(slash + 1));
+    const size_t dot = base.find_last_of('.');
+    const std::string extension = dot == std::string::npos ? "" : base.substr(dot + 1);
+
+    if(extension == "cif") {
+        return STRUCTURE_FORMAT_CIF;
+    }
+    if(extension == "vasp" || extension == "poscar" || extension == "contcar" ||
+       base.compare(0, 6, "poscar") == 0 || base.compare(0, 7, "contcar") == 0) {
+        return STRUCTURE_FORMAT_POSCAR;
+    }
+
+    return STRUCTURE_FORMAT_UNKNOWN;
+}
+
+/*
+ * Parse a symmetry operation in the notation of International Tables, such
+ * as "-x+1/2, y, z+1/2", into f' = rotation * f + translation
+ */
+bool StructureReader::parse_symmetry_operation(const std::string &str, Eigen::Matrix3d &rotation,
+                                               Eigen::Vector3d &translation) {
+    rotation.setZero();
+    translation.setZero();
+
+    unsigned int row = 0;
+    double sign = 1.0;
+    double number = 0.0;
+    bool has_number = false;
+
+    for(size_t i=0; i<=str.size(); i++) {
+        const char c = i < str.size() ? tolower(str[i]) : ',';
+
+        if(c == ' ' || c == '\t' || c == '*' || c == '\'' || c == '"') {
+            continue;
+        }
+
+        if(c == 'x' || c == 'y' || c == 'z') {
+            if(row > 2) {
+                return false;
+            }
+            rotation(row, c - 'x') += sign * (has_number ? number : 1.0);
+            sign = 1.0;
+            has_number = false;
+            continue;
+        }
+
+        if(c == '+' || c == '-' || c == ',') {
+            if(has_number) {
+                if(row > 2) {
+                    return false;
+                }
+                translation(row) += sign * number;
+                has_number = false;
+            }
+            sign = c == '-' ? -1.0 : 1.0;
+            if(c == ',') {
+                row++;
+            }
+            continue;
+        }
+
+        if(isdigit((unsigned char)c) || c == '.') {
+            char *stop;
+            number = strtod(str.c_str() + i, &stop);
+            size_t j = stop - str.c_str();
+            if(j < str.size() && str[j] == '/') {
+                const double denominator = strtod(str.c_str() + j + 1, &stop);
+                if(denominator == 0.0) {
+                    return false;
+                }
+                number /= denominator;
+                j = stop - str.c_str();
+            }
+            has_number = true;
+            i = j - 1;
+            continue;
+        }
+
+        return false;
+    }
+
+    return row == 3;
+}
+
+/*
+ * POSCAR/CONTCAR: title, scaling factor, lattice vectors, (VASP5) element
+ * symbols, atom counts, optional "Selective dynamics", coordinate mode and
+ * the coordinates. Velocities and predictor-corrector data that may follow
+ * in a CONTCAR are ignored.
+ */
+bool StructureReader::parse_poscar(Tokenizer &tokenizer, const std::string &filename,
+                                   std::vector<State> &states) const {
+    auto fail = [&](const char *message) {
+        std::cerr << filename << ":" << tokenizer.get_line_number() << ": " << message << std::endl;
+        return false;
+    };
+
+    if(!tokenizer.next_line()) {
+        return fail("empty file");
+    }
+    const Token title = tokenizer.get_line();
+
+    // universal scaling factor, the volume when negative, or one factor per
+    // Cartesian direction
+    Eigen::Vector3d scale;
+    if(!tokenizer.next_line() || !tokenizer.next_double(&scale(0))) {
+        return fail("expected the scaling factor");
+    }
+    const bool per_axis = tokenizer.next_double(&scale(1)) && tokenizer.next_double(&scale(2));
+    if(!per_axis) {
+        scale(1) = scale(2) = scale(0);
+    }
+
+    Eigen::Matrix3d lattice;
+    for(unsigned int i=0; i<3; i++) {
+        if(!tokenizer.next_line() || !tokenizer.next_double(&lattice(i,0)) ||
+           !tokenizer.next_double(&lattice(i,1)) || !tokenizer.next_double(&lattice(i,2))) {
+            return fail("expected a lattice vector");
+        }
+    }
+
+    if(!per_axis && scale(0) < 0.0) {
+        scale.setConstant(std::cbrt(-scale(0) / std::fabs(lattice.determinant())));
+    }
+    for(unsigned int i=0; i<3; i++) {
+        lattice.col(i) *= scale(i);
+    }
+
+    // element symbols (VASP5) and counts
+    std::vector<std::string> elements;
+    std::vector<unsigned int> counts;
+    Token token;
+    long value;
+    if(!tokenizer.next_line() || !tokenizer.peek_token(&token)) {
+        return fail("expected the element symbols or the atom counts");
+    }
+    if(!Tokenizer::to_int(token, &value)) {
+        while(tokenizer.next_token(&token) && token.begin[0] != '#' && token.begin[0] != '!') {
+            elements.push_back(element_from_label(token.str()));
+        }
+        if(!tokenizer.next_line()) {
+            return fail("expected the atom counts");
+        }
+    }
+    while(tokenizer.next_int(&value)) {
+        if(value < 0) {
+            return fail("negative atom count");
+        }
+        counts.push_back(value);
+    }
+    if(counts.empty()) {
+        return fail("expected the atom counts");
+    }
+
+    // VASP4: the symbols may be given on the title line
+    if(elements.empty()) {
+        Tokenizer title_tokenizer(title.begin, title.end);
+        title_tokenizer.next_line();
+        std::vector<std::string> symbols;
+        while(title_tokenizer.next_token(&token)) {
+            const std::string symbol = element_from_label(token.str());
+            if(symbol.empty() || symbol.size() != token.size()) {
+                break;
+            }
+            symbols.push_back(symbol);
+        }
+        if(symbols.size() == counts.size()) {
+            elements = symbols;
+        } else {
+            for(unsigned int i=0; i<counts.size(); i++) {
+                elements.push_back("X" + int2str(i + 1));
+            }
+        }
+    }
+    if(elements.size() != counts.size()) {
+        return fail("the number of element symbols and atom counts differ");
+    }
+
+    if(!tokenizer.next_line() || !tokenizer.peek_token(&token)) {
+        return fail("expected the coordinate mode");
+    }
+    bool selective = false;
+    if(token.begin[0] == 'S' || token.begin[0] == 's') {
+        selective = true;
+        if(!tokenizer.next_line() || !tokenizer.peek_token(&token)) {
+            return fail("expected the coordinate mode");
+        }
+    }
+    const char mode = tolower(token.begin[0]);
+    const bool cartesian = mode == 'c' || mode == 'k';
+
+    std::vector<Atom> atoms;
+    for(unsigned int e=0; e<counts.size(); e++) {
+        const unsigned int elnr = VaspReader::get_element_number_from_name(elements[e]);
+        for(unsigned int j=0; j<counts[e]; j++) {
+            Eigen::Vector3d r;
+            if(!tokenizer.next_line()) {
+                return fail("the file ends before all atoms have been read");
+            }
+            if(!tokenizer.next_double(&r(0)) || !tokenizer.next_double(&r(1)) || !tokenizer.next_double(&r(2))) {
+                return fail("expected atom coordinates");
+            }
+            r = cartesian ? Eigen::Vector3d(r.cwiseProduct(scale)) : Eigen::Vector3d(lattice.transpose() * r);
+
+            Atom atom(elnr, r(0), r(1), r(2));
+            if(selective) {
+                for(unsigned int k=0; k<3; k++) {
+                    if(!tokenizer.next_token(&token)) {
+                        return fail("expected selective dynamics flags");
+                    }
+                    if(token.begin[0] == 'F' || token.begin[0] == 'f') {
+                        atom.selec_mode |= (1 << k);
+                    }
+                }
+            }
+            atoms.push_back(atom);
+        }
+    }
+
+    states.push_back(make_state(lattice, atoms, elements, counts, filename, 1));
+
+    return true;
+}
+
+/*
+ * CIF: every data block yields a state. Only the cell parameters, the
+ * fractional coordinates of the atom sites and the symmetry operations are
+ * used; all other items are skipped.
+ */
+bool StructureReader::parse_cif(Tokenizer &tokenizer, const std::string &filename,
+                                std::vector<State> &states) const {
+    static const char *cell_tags[6] = {
+        "_cell_length_a", "_cell_length_b", "_cell_length_c",
+        "_cell_angle_alpha", "_cell_angle_beta", "_cell_angle_gamma"
+    };
+
+    std::vector<double> cell(6, 0.0);
+    std::vector<std::string> site_elements;
+    std::vector<Eigen::Vector3d> site_positions;
+    std::vector<std::string> operations;
+    unsigned int nr_blocks = 0;
+    bool success = true;
+
+    Token token;
+    bool has_line = tokenizer.next_line();
+    while(has_line) {
+        const bool has_token = tokenizer.peek_token(&token);
+
+        // skip empty lines, comments and text fields
+        if(!has_token || is_comment(token, tokenizer.get_line())) {
+            has_line = tokenizer.next_line();
+            continue;
+        }
+        if(is_text_field_delimiter(tokenizer.get_line())) {
+            while((has_line = tokenizer.next_line()) && !is_text_field_delimiter(tokenizer.get_line())) {}
+            has_line = has_line && tokenizer.next_line();
+            continue;
+        }
+
+        if(token.starts_with_nocase("data_")) {
+            if(nr_blocks > 0) {
+                success &= this->build_cif_state(cell, site_elements, site_positions, operations, filename,
+                                                 nr_blocks, states);
+            }
+            nr_blocks++;
+            cell.assign(6, 0.0);
+            site_elements.clear();
+            site_positions.clear();
+            operations.clear();
+            has_line = tokenizer.next_line();
+            continue;
+        }
+
+        if(token.starts_with_nocase("loop_")) {
+            std::vector<std::string> tags;
+            std::vector<std::string> values;
+
+            tokenizer.next_token(&token);
+            while(tokenizer.next_token(&token)) {
+                tags.push_back(to_lower(token.str()));
+            }
+            while((has_line = tokenizer.next_line()) && tokenizer.peek_token(&token) && token.begin[0] == '_') {
+                tokenizer.next_token(&token);
+                tags.push_back(to_lower(token.str()));
+            }
+
+            // values continue until the next tag, loop or data block
+            while(has_line) {
+                if(is_text_field_delimiter(tokenizer.get_line())) {
+                    std::string text;
+                    while((has_line = tokenizer.next_line()) && !is_text_field_delimiter(tokenizer.get_line())) {
+                        text += tokenizer.get_line().str() + "\n";
+                    }
+                    values.push_back(text);
+                    has_line = has_line && tokenizer.next_line();
+                    continue;
+                }
+                if(tokenizer.peek_token(&token) &&
+                   (token.begin[0] == '_' || token.starts_with_nocase("loop_") || token.starts_with_nocase("data_"))) {
+                    break;
+                }
+                while(tokenizer.next_token(&token)) {
+                    if(is_comment(token, tokenizer.get_line())) {
+                        break;
+                    }
+                    values.push_back(token.str());
+                }
+                has_line = tokenizer.next_line();
+            }
+
+            const size_t nc = tags.size();
+            if(nc == 0) {
+                continue;
+            }
+            if(values.size() % nc != 0) {
+                std::cerr << filename << ":" << tokenizer.get_line_number()
+                          << ": the number of values in a loop is not a multiple of the number of tags" << std::endl;
+            }
+
+            int col_symbol = -1, col_label = -1, col_x = -1, col_y = -1, col_z = -1, col_op = -1;
+            for(unsigned int i=0; i<nc; i++) {
+                if(tags[i] == "_atom_site_type_symbol") col_symbol = i;
+                if(tags[i] == "_atom_site_label") col_label = i;
+                if(tags[i] == "_atom_site_fract_x") col_x = i;
+                if(tags[i] == "_atom_site_fract_y") col_y = i;
+                if(tags[i] == "_atom_site_fract_z") col_z = i;
+                if(tags[i] == "_symmetry_equiv_pos_as_xyz" || tags[i] == "_space_group_symop_operation_xyz") col_op = i;
+            }
+
+            for(size_t row=0; (row + 1) * nc <= values.size(); row++) {
+                const std::string *v = &values[row * nc];
+                if(col_op >= 0) {
+                    operations.push_back(v[col_op]);
+                }
+                if(col_x >= 0 && col_y >= 0 && col_z >= 0 && (col_symbol >= 0 || col_label >= 0)) {
+                    Eigen::Vector3d f;
+                    const std::string element = element_from_label(v[col_symbol >= 0 ? col_symbol : col_label]);
+                    if(element.empty() || !cif_number(v[col_x], &f(0)) || !cif_number(v[col_y], &f(1)) ||
+                       !cif_number(v[col_z], &f(2))) {
+                        std::cerr << filename << ": skipping atom site " << v[0] << std::endl;
+                        continue;
+                    }
+                    site_elements.push_back(element);
+                    site_positions.push_back(f);
+                }
+            }
+            continue;
+        }
+
+        if(token.begin[0] == '_') {
+            tokenizer.next_token(&token);
+            const std::string tag = to_lower(token.str());
+            Token value;
+            if(!tokenizer.next_token(&value) && (has_line = tokenizer.next_line())) {
+                tokenizer.next_token(&value);
+            }
+            for(unsigned int i=0; i<6; i++) {
+                if(tag == cell_tags[i] && !cif_number(value.str(), &cell[i])) {
+                    std::cerr << filename << ":" << tokenizer.get_line_number() << ": invalid " << tag << std::endl;
+                }
+            }
+            if(tag == "_symmetry_equiv_pos_as_xyz" || tag == "_space_group_symop_operation_xyz") {
+                operations.push_back(value.str());
+            }
+        }
+
+        has_line = has_line && tokenizer.next_line();
+    }
+
+    if(nr_blocks == 0) {
+        std::cerr << filename << ": no data block found" << std::endl;
+        return false;
+    }
+
+    return this->build_cif_state(cell, site_elements, site_positions, operations, filename, nr_blocks, states)
+           && success;
+}
+
+/*
+ * Expand the asymmetric unit of a CIF data block and construct the state
+ */
+bool StructureReader::build_cif_state(const std::vector<double> &cell_parameters,
+                                      const std::vector<std::string> &site_elements,
+                                      const std::vector<Eigen::Vector3d> &site_positions,
+                                      const std::vector<std::string> &operations,
+                                      const std::string &filename, unsigned int id,
+                                      std::vector<State> &states) const {
+    const double a = cell_parameters[0], b = cell_parameters[1], c = cell_parameters[2];
+    const double deg = M_PI / 180.0;
+    const double ca = std::cos(cell_parameters[3] * deg);
+    const double cb = std::cos(cell_parameters[4] * deg);
+    const double cg = std::cos(cell_parameters[5] * deg);
+    const double sg = std::sin(cell_parameters[5] * deg);
+
+    if(a <= 0.0 || b <= 0.0 || c <= 0.0 || sg == 0.0) {
+        std::cerr << filename << ": incomplete cell parameters in data block " << id << std::endl;
+        return false;
+    }
+
+    Eigen::Matrix3d lattice;
+    const double cx = c * cb;
+    const double cy = c * (ca - cb * cg) / sg;
+    lattice << a, 0.0, 0.0,
+               b * cg, b * sg, 0.0,
+               cx, cy, std::sqrt(std::max(0.0, c * c - cx * cx - cy * cy));
+
+    std::vector<std::string> ops = operations;
+    if(ops.empty()) {
+        ops.push_back("x,y,z");
+    }
+    std::vector<Eigen::Matrix3d> rotations(ops.size());
+    std::vector<Eigen::Vector3d> translations(ops.size());
+    for(unsigned int i=0; i<ops.size(); i++) {
+        if(!parse_symmetry_operation(ops[i], rotations[i], translations[i])) {
+            std::cerr << filename << ": cannot parse symmetry operation '" << ops[i] << "'" << std::endl;
+            return false;
+        }
+    }
+
+    // apply all operations to every site, merging coinciding images, which
+    // are looked up in a grid of bins; the elements keep the order of their
+    // first appearance. A file in P1 (only the identity) is taken as it is.
+    const bool identity_only = ops.size() == 1 && rotations[0].isIdentity() && translations[0].isZero();
+    const int nr_bins = std::max(1, (int)std::floor(1.0 / STRUCTURE_CIF_SITE_TOLERANCE));
+    std::vector<std::string> elements;
+    std::vector<std::vector<Eigen::Vector3d> > positions;
+    std::vector<SiteBins> bins;
+    for(unsigned int s=0; s<site_positions.size(); s++) {
+        unsigned int e = std::find(elements.begin(), elements.end(), site_elements[s]) - elements.begin();
+        if(e == elements.size()) {
+            elements.push_back(site_elements[s]);
+            positions.push_back(std::vector<Eigen::Vector3d>());
+            bins.push_back(SiteBins());
+        }
+
+        for(unsigned int o=0; o<ops.size(); o++) {
+            Eigen::Vector3d f = rotations[o] * site_positions[s] + translations[o];
+            for(unsigned int k=0; k<3; k++) {
+                f(k) -= std::floor(f(k));
+            }
+
+            if(identity_only) {
+                positions[e].push_back(f);
+                continue;
+            }
+            if(has_site(bins[e], positions[e], f, nr_bins)) {
+                continue;
+            }
+
+            uint64_t key = 0;
+            for(unsigned int k=0; k<3; k++) {
+                key = key * nr_bins + std::min(nr_bins - 1, (int)(f(k) * nr_bins));
+            }
+            bins[e][key].push_back(positions[e].size());
+            positions[e].push_back(f);
+        }
+    }
+
+    std::vector<Atom> atoms;
+    std::vector<unsigned int> counts;
+    for(unsigned int e=0; e<elements.size(); e++) {
+        const unsigned int elnr = VaspReader::get_element_number_from_name(elements[e]);
+        for(unsigned int i=0; i<positions[e].size(); i++) {
+            const Eigen::Vector3d r = lattice.transpose() * positions[e][i];
+            atoms.push_back(Atom(elnr, r(0), r(1), r(2)));
+        }
+        counts.push_back(positions[e].size());
+    }
+
+    states.push_back(make_state(lattice, atoms, elements, counts, filename, id));
+
+    return true;
+}
@@ -0,0 +1,665 @@
+/*************************************************************************
+ *
+ *  This file is part of v2c.
+ *
+ *  Author: Ivo Filot <i.a.w.filot@tue.nl>
+ *
+ *  v2c is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  v2c is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with v2c.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ************************************************************************/
+
+
+#include "symmetry.h"
+
+/*
+ * Number of operations of every rotation type (-6, -4, -3, -2, -1, 1, 2, 3,
+ * 4, 6) of the 32 crystallographic point groups
+ */
+static const struct {
+    const char *name;
+    unsigned int counts[10];
+} POINT_GROUPS[32] = {
+    {"1",     {0,0,0,0,0,1,0,0,0,0}}, {"-1",    {0,0,0,0,1,1,0,0,0,0}},
+    {"2",     {0,0,0,0,0,1,1,0,0,0}}, {"m",     {0,0,0,1,0,1,0,0,0,0}},
+    {"2/m",   {0,0,0,1,1,1,1,0,0,0}}, {"222",   {0,0,0,0,0,1,3,0,0,0}},
+    {"mm2",   {0,0,0,2,0,1,1,0,0,0}}, {"mmm",   {0,0,0,3,1,1,3,0,0,0}},
+    {"4",     {0,0,0,0,0,1,1,0,2,0}}, {"-4",    {0,2,0,0,0,1,1,0,0,0}},
+    {"4/m",   {0,2,0,1,1,1,1,0,2,0}}, {"422",   {0,0,0,0,0,1,5,0,2,0}},
+    {"4mm",   {0,0,0,4,0,1,1,0,2,0}}, {"-42m",  {0,2,0,2,0,1,3,0,0,0}},
+    {"4/mmm", {0,2,0,5,1,1,5,0,2,0}}, {"3",     {0,0,0,0,0,1,0,2,0,0}},
+    {"-3",    {0,0,2,0,1,1,0,2,0,0}}, {"32",    {0,0,0,0,0,1,3,2,0,0}},
+    {"3m",    {0,0,0,3,0,1,0,2,0,0}}, {"-3m",   {0,0,2,3,1,1,3,2,0,0}},
+    {"6",     {0,0,0,0,0,1,1,2,0,2}}, {"-6",    {2,0,0,1,0,1,0,2,0,0}},
+    {"6/m",   {2,0,2,1,1,1,1,2,0,2}}, {"622",   {0,0,0,0,0,1,7,2,0,2}},
+    {"6mm",   {0,0,0,6,0,1,1,2,0,2}}, {"-6m2",  {2,0,0,4,0,1,3,2,0,0}},
+    {"6/mmm", {2,0,2,7,1,1,7,2,0,2}}, {"23",    {0,0,0,0,0,1,3,8,0,0}},
+    {"m-3",   {0,0,8,3,1,1,3,8,0,0}}, {"432",   {0,0,0,0,0,1,9,8,6,0}},
+    {"-43m",  {0,6,0,6,0,1,3,8,0,0}}, {"m-3m",  {0,6,8,9,1,1,9,8,6,0}}
+};
+
+/*
+ * Wrap fractional coordinates into [0, 1)
+ */
+static Eigen::Vector3d wrap(const Eigen::Vector3d &f) {
+    Eigen::Vector3d result = f.array() - f.array().floor();
+    for(unsigned int k=0; k<3; k++) {
+        if(result(k) >= 1.0) {
+            result(k) = 0.0;
+        }
+    }
+    return result;
+}
+
+/*
+ * Constructor; <_tolerance> is the largest displacement [A] of an atom from
+ * its symmetry-equivalent position
+ */
+SymmetryFinder::SymmetryFinder(double _tolerance) {
+    this->tolerance = _tolerance;
+    this->nr_translations = 0;
+    for(unsigned int k=0; k<3; k++) {
+        this->nr_bins[k] = 1;
+    }
+}
+
+/*
+ * Find the symmetry operations and the asymmetric unit of <state>. Returns
+ * false for states without atoms or with a singular cell.
+ */
+bool SymmetryFinder::analyse(const State &state) {
+    this->operations.clear();
+    this->asymmetric_unit.clear();
+    this->translations.clear();
+    this->nr_translations = 0;
+    this->point_group.clear();
+
+    this->lattice = state.dimensions.cast<double>();
+    const unsigned int n = state.atoms.size();
+    if(n == 0 || std::fabs(this->lattice.determinant()) < 1e-6) {
+        return false;
+    }
+
+    const Eigen::Matrix3d to_frac = this->lattice.inverse().transpose();
+    this->frac.resize(n);
+    this->species.resize(n);
+    for(unsigned int i=0; i<n; i++) {
+        this->frac[i] = wrap(to_frac * state.atoms[i].pos.cast<double>());
+    }
+
+    // atoms are stored in blocks per element; blocks of the same element
+    // are of the same species
+    const std::vector<std::string> &elements = state.get_elements();
+    unsigned int atom = 0;
+    for(unsigned int e=0; e<elements.size(); e++) {
+        const unsigned int block = std::find(elements.begin(), elements.end(), elements[e]) - elements.begin();
+        for(unsigned int i=0; i<state.get_atoms_for_element(e) && atom<n; i++, atom++) {
+            this->species[atom] = block;
+        }
+    }
+    if(atom != n) {
+        for(unsigned int i=0; i<n; i++) {
+            this->species[i] = state.atoms[i].elnr;
+        }
+    }
+    this->build_lookup();
+
+    // the translations are tried on the atoms of the least abundant element
+    std::vector<unsigned int> count_per_species;
+    for(unsigned int i=0; i<n; i++) {
+        if(this->species[i] >= count_per_species.size()) {
+            count_per_species.resize(this->species[i] + 1, 0);
+        }
+        count_per_species[this->species[i]]++;
+    }
+    unsigned int reference = 0;
+    for(unsigned int i=1; i<n; i++) {
+        if(count_per_species[this->species[i]] < count_per_species[this->species[reference]]) {
+            reference = i;
+        }
+    }
+    std::vector<unsigned int> candidates;
+    for(unsigned int i=0; i<n; i++) {
+        if(this->species[i] == this->species[reference]) {
+            candidates.push_back(i);
+        }
+    }
+
+    this->find_translations(reference, candidates);
+    this->nr_translations = this->translations.size();
+
+    // one translation per rotation suffices; the others follow from the
+    // pure translations
+    const std::vector<Eigen::Matrix3i> rotations = this->find_lattice_rotations();
+    for(unsigned int r=0; r<rotations.size(); r++) {
+        const Eigen::Matrix3i &rotation = rotations[r];
+        const Eigen::Vector3d image = rotation.cast<double>() * this->frac[reference];
+
+        for(unsigned int c=0; c<candidates.size(); c++) {
+            const Eigen::Vector3d t = wrap(this->frac[candidates[c]] - image);
+            if(rotation.isIdentity() ? c > 0 : !this->is_symmetry(rotation, t)) {
+                continue;
+            }
+
+            for(unsigned int u=0; u<this->translations.size(); u++) {
+                SymmetryOperation op;
+                op.rotation = rotation;
+                op.translation = wrap(t + this->translations[u]);
+                this->operations.push_back(op);
+            }
+            break;
+        }
+    }
+
+    this->find_asymmetric_unit();
+    this->classify_point_group();
+
+    return true;
+}
+
+const std::vector<SymmetryOperation>& SymmetryFinder::get_operations() const {
+    return this->operations;
+}
+
+/*
+ * Returns the indices of one atom of every set of symmetry-equivalent atoms
+ */
+const std::vector<unsigned int>& SymmetryFinder::get_asymmetric_unit() const {
+    return this->asymmetric_unit;
+}
+
+/*
+ * Returns the number of pure translations, including the identity; this is
+ * larger than one for centered cells and supercells
+ */
+unsigned int SymmetryFinder::get_nr_translations() const {
+    return this->nr_translations;
+}
+
+const std::string& SymmetryFinder::get_point_group() const {
+    return this->point_group;
+}
+
+std::string SymmetryFinder::get_crystal_system() const {
+    const std::string &pg = this->point_group;
+    if(pg == "1" || pg == "-1") {
+        return "triclinic";
+    }
+    if(pg == "2" || pg == "m" || pg == "2/m") {
+        return "monoclinic";
+    }
+    if(pg == "222" || pg == "mm2" || pg == "mmm") {
+        return "orthorhombic";
+    }
+    if(pg.find('4') != std::string::npos && pg.find('3') == std::string::npos) {
+        return "tetragonal";
+    }
+    if(pg.find('6') != std::string::npos) {
+        return "hexagonal";
+    }
+    if(pg == "23" || pg == "m-3" || pg == "432" || pg == "-43m" || pg == "m-3m") {
+        return "cubic";
+    }
+    if(pg.find('3') != std::string::npos) {
+        return "trigonal";
+    }
+    return "";
+}
+
+/*
+ * Build the primitive cell of <state>, which must be the state given to
+ * analyse. The fractional coordinates of the N pure translations are
+ * multiples of 1/N, hence the lattice they span together with the lattice
+ * vectors follows exactly from the Hermite normal form of the integer
+ * vectors N * t; the resulting basis is reduced. Of every set of
+ * translation-equivalent atoms the first is kept, such that the atoms remain
+ * in blocks per element. Returns false when the cell is already primitive
+ * or when the translations do not divide the atoms evenly.
+ */
+bool SymmetryFinder::primitive_cell(const State &state, State &primitive) const {
+    const int n = this->nr_translations;
+    if(n < 2 || this->frac.size() != state.atoms.size() || this->frac.size() % n != 0) {
+        return false;
+    }
+
+    // generators of the primitive lattice in units of 1/N of the cell
+    std::vector<Eigen::Vector3i> generators;
+    for(unsigned int k=0; k<3; k++) {
+        generators.push_back(n * Eigen::Vector3i::Unit(k));
+    }
+    for(unsigned int u=0; u<this->translations.size(); u++) {
+        const Eigen::Vector3d t = this->translations[u] * n;
+        generators.push_back(Eigen::Vector3i((int)std::floor(t(0) + 0.5), (int)std::floor(t(1) + 0.5),
+                                             (int)std::floor(t(2) + 0.5)));
+    }
+
+    // Hermite normal form by repeated Euclidean steps per column
+    Eigen::Matrix3i basis = Eigen::Matrix3i::Zero();
+    for(unsigned int k=0; k<3; k++) {
+        Eigen::Vector3i pivot = Eigen::Vector3i::Zero();
+        for(unsigned int g=0; g<generators.size(); g++) {
+            Eigen::Vector3i &v = generators[g];
+            while(v(k) != 0) {
+                pivot -= (pivot(k) / v(k)) * v;
+                std::swap(pivot, v);
+            }
+        }
+        basis.row(k) = pivot;
+    }
+    if(std::llabs((long long)basis(0,0) * basis(1,1) * basis(2,2)) != (long long)n * n) {
+        return false;
+    }
+
+    const Eigen::Matrix3d cell = reduce_lattice(basis.cast<double>() / (double)n * this->lattice);
+
+    std::vector<char> assigned(this->frac.size(), 0);
+    std::vector<Atom> atoms;
+    std::vector<unsigned int> nr_atoms;
+    const std::vector<unsigned int> &blocks = state.get_nr_atoms_per_element();
+    unsigned int start = 0;
+    for(unsigned int b=0; b<blocks.size(); b++) {
+        unsigned int count = 0;
+        for(unsigned int i=start; i<start + blocks[b] && i<this->frac.size(); i++) {
+            if(assigned[i]) {
+                continue;
+            }
+            for(unsigned int u=0; u<this->translations.size(); u++) {
+                const int j = this->find_atom(this->frac[i] + this->translations[u], this->species[i]);
+                if(j >= 0) {
+                    assigned[j] = 1;
+                }
+            }
+            atoms.push_back(state.atoms[i]);
+            count++;
+        }
+        nr_atoms.push_back(count);
+        start += blocks[b];
+    }
+    if(start != this->frac.size() || atoms.size() * n != this->frac.size()) {
+        return false;
+    }
+
+    std::vector<Real> dimensions(9);
+    for(unsigned int i=0; i<3; i++) {
+        for(unsigned int j=0; j<3; j++) {
+            dimensions[i*3+j] = cell(i,j);
+        }
+    }
+    primitive = State(state.get_energy() / n, dimensions, atoms, state.get_elements(),
+                      state.get_elements_uint(), nr_atoms, state.get_filename(), state.get_state_id());
+
+    return true;
+}
+
+/*
+ * Operation in the notation of the International Tables, e.g. "-y, x-y,
+ * z+1/3". Translations are written as fractions with a denominator of at
+ * most 48.
+ */
+std::string SymmetryFinder::format_operation(const SymmetryOperation &op) {
+    static const char axes[3] = {'x', 'y', 'z'};
+    std::string result;
+
+    for(unsigned int r=0; r<3; r++) {
+        std::string term;
+        for(unsigned int c=0; c<3; c++) {
+            const int k = op.rotation(r,c);
+            if(k == 0) {
+                continue;
+            }
+            if(k < 0) {
+                term += "-";
+            } else if(!term.empty()) {
+                term += "+";
+            }
+            if(std::abs(k) != 1) {
+                term += int2str(std::abs(k));
+            }
+            term += axes[c];
+        }
+
+        const double t = op.translation(r);
+        bool found = false;
+        for(int d=1; d<=48 && !found; d++) {
+            const int nom = (int)std::floor(t * d + 0.5);
+            if(std::fabs(t * d - nom) < 1e-3 * d) {
+                found = true;
+                if(nom % d != 0) {
+                    term += "+" + int2str(nom) + "/" + int2str(d);
+                }
+            }
+        }
+        if(!found) {
+            term += "+" + float2str2(t, "%.6f");
+        }
+
+        result += (r > 0 ? ", " : "") + term;
+    }
+
+    return result;
+}
+
+/*
+ * Reduce the lattice (rows) by repeatedly subtracting the nearest integer
+ * multiple of one lattice vector from another, until all vectors are as
+ * short and as orthogonal as this allows
+ */
+Eigen::Matrix3d SymmetryFinder::reduce_lattice(const Eigen::Matrix3d &lattice) {
+    Eigen::Matrix3d reduced = lattice;
+
+    for(unsigned int iter=0; iter<100; iter++) {
+        bool changed = false;
+        for(unsigned int i=0; i<3; i++) {
+            for(unsigned int j=0; j<3; j++) {
+                if(i == j) {
+                    continue;
+                }
+                const double mu = reduced.row(i).dot(reduced.row(j)) / reduced.row(j).squaredNorm();
+                if(std::fabs(mu) > 0.5 + 1e-9) {
+                    reduced.row(i) -= std::floor(mu + 0.5) * reduced.row(j);
+                    changed = true;
+                }
+            }
+        }
+        if(!changed) {
+            break;
+        }
+    }
+
+    return reduced;
+}
+
+/*
+ * Rotations (in the fractional coordinates of the cell) that map the
+ * lattice onto itself. The image of every vector of the reduced basis is a
+ * lattice vector of the same length, which is searched among the short
+ * combinations of the reduced vectors.
+ */
+std::vector<Eigen::Matrix3i> SymmetryFinder::find_lattice_rotations() const {
+    const Eigen::Matrix3d reduced = reduce_lattice(this->lattice);
+    const Eigen::Matrix3d basis = reduced.transpose();               // vectors as columns
+    const Eigen::Matrix3d basis_inverse = basis.inverse();
+    const Eigen::Matrix3d to_frac = this->lattice.inverse().transpose();
+
+    std::vector<Eigen::Vector3d> candidates[3];
+    for(int i=-2; i<=2; i++) {
+        for(int j=-2; j<=2; j++) {
+            for(int k=-2; k<=2; k++) {
+                const Eigen::Vector3d v = basis * Eigen::Vector3d(i, j, k);
+                for(unsigned int b=0; b<3; b++) {
+                    if(std::fabs(v.norm() - basis.col(b).norm()) < this->tolerance) {
+                        candidates[b].push_back(v);
+                    }
+                }
+            }
+        }
+    }
+
+    std::vector<Eigen::Matrix3i> rotations;
+    const double tol01 = this->tolerance * (basis.col(0).norm() + basis.col(1).norm());
+    const double tol02 = this->tolerance * (basis.col(0).norm() + basis.col(2).norm());
+    const double tol12 = this->tolerance * (basis.col(1).norm() + basis.col(2).norm());
+
+    for(unsigned int a=0; a<candidates[0].size(); a++) {
+        const Eigen::Vector3d &v0 = candidates[0][a];
+        for(unsigned int b=0; b<candidates[1].size(); b++) {
+            const Eigen::Vector3d &v1 = candidates[1][b];
+            if(std::fabs(v0.dot(v1) - basis.col(0).dot(basis.col(1))) > tol01) {
+                continue;
+            }
+            for(unsigned int c=0; c<candidates[2].size(); c++) {
+                const Eigen::Vector3d &v2 = candidates[2][c];
+                if(std::fabs(v0.dot(v2) - basis.col(0).dot(basis.col(2))) > tol02 ||
+                   std::fabs(v1.dot(v2) - basis.col(1).dot(basis.col(2))) > tol12) {
+                    continue;
+                }
+
+                Eigen::Matrix3d images;
+                images << v0, v1, v2;
+                const Eigen::Matrix3d cartesian = images * basis_inverse;
+                const Eigen::Matrix3d w = to_frac * cartesian * this->lattice.transpose();
+
+                Eigen::Matrix3i rotation;
+                for(unsigned int i=0; i<3; i++) {
+                    for(unsigned int j=0; j<3; j++) {
+                        rotation(i,j) = (int)std::floor(w(i,j) + 0.5);
+                    }
+                }
+                if(std::abs(rotation.determinant()) == 1) {
+                    rotations.push_back(rotation);
+                }
+            }
+        }
+    }
+
+    return rotations;
+}
+
+/*
+ * Sort the atoms into a grid over the fractional coordinates (a counting
+ * sort over the bins). A bin spans at least the tolerance in every
+ * direction, such that an atom within the tolerance of a position is found
+ * in the bin of that position or in one of its neighbors; the number of
+ * bins is limited to about twice the number of atoms.
+ */
+void SymmetryFinder::build_lookup() {
+    const Eigen::Matrix3d reciprocal = this->lattice.inverse().transpose();   // rows: reciprocal vectors
+    const int limit = std::max(1, (int)std::ceil(std::cbrt(2.0 * this->frac.size())));
+    for(unsigned int k=0; k<3; k++) {
+        this->margin[k] = this->tolerance * reciprocal.row(k).norm();
+        this->nr_bins[k] = std::max(1, std::min(limit, (int)std::floor(1.0 / this->margin[k])));
+    }
+
+    const unsigned int nr_cells = this->nr_bins[0] * this->nr_bins[1] * this->nr_bins[2];
+    std::vector<unsigned int> keys(this->frac.size());
+    this->bin_start.assign(nr_cells + 1, 0);
+    int bin[3];
+    for(unsigned int i=0; i<this->frac.size(); i++) {
+        keys[i] = this->get_bin(this->frac[i], bin);
+        this->bin_start[keys[i] + 1]++;
+    }
+    for(unsigned int b=0; b<nr_cells; b++) {
+        this->bin_start[b + 1] += this->bin_start[b];
+    }
+
+    std::vector<unsigned int> fill(this->bin_start.begin(), this->bin_start.end() - 1);
+    this->bin_atoms.resize(this->frac.size());
+    for(unsigned int i=0; i<this->frac.size(); i++) {
+        this->bin_atoms[fill[keys[i]]++] = i;
+    }
+}
+
+/*
+ * Bin of (wrapped) fractional coordinates <f>; the bin indices are stored
+ * in <bin>
+ */
+unsigned int SymmetryFinder::get_bin(const Eigen::Vector3d &f, int *bin) const {
+    for(unsigned int k=0; k<3; k++) {
+        bin[k] = std::min(this->nr_bins[k] - 1, (int)(f(k) * this->nr_bins[k]));
+    }
+    return (bin[0] * this->nr_bins[1] + bin[1]) * this->nr_bins[2] + bin[2];
+}
+
+/*
+ * Index of the atom of <element> within the tolerance of the fractional
+ * position <f>, or -1 when there is none
+ */
+int SymmetryFinder::find_atom(const Eigen::Vector3d &f, unsigned int element) const {
+    const Eigen::Vector3d g = wrap(f);
+    int bin[3];
+    this->get_bin(g, bin);
+
+    // a neighboring bin is only visited when <g> lies within the tolerance
+    // of its boundary, and no bin is visited twice in narrow grids
+    int range[3][3];
+    unsigned int nr_range[3];
+    for(unsigned int k=0; k<3; k++) {
+        const double x = g(k) * this->nr_bins[k];
+        const double m = this->margin[k] * this->nr_bins[k];
+        range[k][0] = bin[k];
+        nr_range[k] = 1;
+        if(this->nr_bins[k] > 1 && x - bin[k] < m) {
+            range[k][nr_range[k]++] = (bin[k] + this->nr_bins[k] - 1) % this->nr_bins[k];
+        }
+        if(this->nr_bins[k] > 2 && bin[k] + 1 - x < m) {
+            range[k][nr_range[k]++] = (bin[k] + 1) % this->nr_bins[k];
+        } else if(this->nr_bins[k] == 2 && nr_range[k] == 1 && bin[k] + 1 - x < m) {
+            range[k][nr_range[k]++] = 1 - bin[k];
+        }
+    }
+
+    const double tol2 = this->tolerance * this->tolerance;
+    for(unsigned int x=0; x<nr_range[0]; x++) {
+        for(unsigned int y=0; y<nr_range[1]; y++) {
+            for(unsigned int z=0; z<nr_range[2]; z++) {
+                const unsigned int key = (range[0][x] * this->nr_bins[1] + range[1][y]) * this->nr_bins[2] + range[2][z];
+                for(unsigned int p=this->bin_start[key]; p<this->bin_start[key + 1]; p++) {
+                    const unsigned int a = this->bin_atoms[p];
+                    if(this->species[a] != element) {
+                        continue;
+                    }
+                    Eigen::Vector3d d = g - this->frac[a];
+                    d = d.array() - (d.array() + 0.5).floor();
+                    if((this->lattice.transpose() * d).squaredNorm() < tol2) {
+                        return a;
+                    }
+                }
+            }
+        }
+    }
+
+    return -1;
+}
+
+/*
+ * Whether the operation maps every atom onto an atom of the same element
+ */
+bool SymmetryFinder::is_symmetry(const Eigen::Matrix3i &rotation, const Eigen::Vector3d &translation) const {
+    const Eigen::Matrix3d w = rotation.cast<double>();
+    for(unsigned int i=0; i<this->frac.size(); i++) {
+        if(this->find_atom(w * this->frac[i] + translation, this->species[i]) < 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/*
+ * Find the group of pure translations. Every translation maps the reference
+ * atom onto one of the <candidates>; when a new translation is found, the
+ * group is closed by adding its multiples to all translations found so far,
+ * such that only the generators need to be checked against all atoms.
+ */
+void SymmetryFinder::find_translations(unsigned int reference, const std::vector<unsigned int> &candidates) {
+    std::vector<Eigen::Vector3d> &translations = this->translations;
+    const Eigen::Matrix3i identity = Eigen::Matrix3i::Identity();
+    std::vector<char> reached(this->frac.size(), 0);
+
+    translations.assign(1, Eigen::Vector3d::Zero());
+    reached[reference] = 1;
+
+    for(unsigned int c=0; c<candidates.size(); c++) {
+        const unsigned int j = candidates[c];
+        if(reached[j]) {
+            continue;
+        }
+        const Eigen::Vector3d t = wrap(this->frac[j] - this->frac[reference]);
+        if(!this->is_symmetry(identity, t)) {
+            continue;
+        }
+
+        const size_t nr_base = translations.size();
+        for(unsigned int m=1; ; m++) {
+            const int atom = this->find_atom(this->frac[reference] + (double)m * t, this->species[reference]);
+            if(atom < 0 || reached[atom]) {
+                break;
+            }
+            for(size_t u=0; u<nr_base; u++) {
+                const int image = this->find_atom(this->frac[reference] + translations[u] + (double)m * t,
+                                                  this->species[reference]);
+                if(image >= 0 && !reached[image]) {
+                    reached[image] = 1;
+                    translations.push_back(wrap(this->frac[image] - this->frac[reference]));
+                }
+            }
+        }
+    }
+}
+
+/*
+ * Pick one atom of every orbit
+ */
+void SymmetryFinder::find_asymmetric_unit() {
+    std::vector<char> assigned(this->frac.size(), 0);
+
+    for(unsigned int i=0; i<this->frac.size(); i++) {
+        if(assigned[i]) {
+            continue;
+        }
+        this->asymmetric_unit.push_back(i);
+        assigned[i] = 1;
+        for(unsigned int o=0; o<this->operations.size(); o++) {
+            const SymmetryOperation &op = this->operations[o];
+            const int j = this->find_atom(op.rotation.cast<double>() * this->frac[i] + op.translation, this->species[i]);
+            if(j >= 0) {
+                assigned[j] = 1;
+            }
+        }
+    }
+}
+
+/*
+ * Identify the point group from the number of rotations of every type; the
+ * type follows from the determinant and the trace of the rotation
+ */
+void SymmetryFinder::classify_point_group() {
+    std::vector<Eigen::Matrix3i> rotations;
+    unsigned int counts[10] = {0,0,0,0,0,0,0,0,0,0};
+
+    for(unsigned int o=0; o<this->operations.size(); o++) {
+        const Eigen::Matrix3i &w = this->operations[o].rotation;
+        bool seen = false;
+        for(unsigned int r=0; r<rotations.size() && !seen; r++) {
+            seen = rotations[r] == w;
+        }
+        if(seen) {
+            continue;
+        }
+        rotations.push_back(w);
+
+        const int trace = w.trace();
+        int type = -1;
+        if(w.determinant() > 0) {
+            static const int proper[5] = {6, 7, 8, 9, 5};          // trace -1, 0, 1, 2, 3
+            if(trace >= -1 && trace <= 3) {
+                type = proper[trace + 1];
+            }
+        } else {
+            static const int improper[5] = {4, 0, 1, 2, 3};        // trace -3, -2, -1, 0, 1
+            if(trace >= -3 && trace <= 1) {
+                type = improper[trace + 3];
+            }
+        }
+        if(type >= 0) {
+            counts[type]++;
+        }
+    }
+
+    this->point_group = "";
+    for(unsigned int p=0; p<32; p++) {
+        if(std::equal(counts, counts + 10, POINT_GROUPS[p].counts)) {
+            this->point_group = POINT_GROUPS[p].name;
+            break;
+        }
+    }
+}
@@ -0,0 +1,162 @@
+/*************************************************************************
+ *
+ *  This file is part of v2c.
+ *
+ *  Author: Ivo Filot <i.a.w.filot@tue.nl>
+ *
+ *  v2c is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  v2c is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with v2c.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ************************************************************************/
+
+#include "threadpool.h"
+
+#include <atomic>
+#include <algorithm>
+
+/*
+ * Start the worker threads. When nr_threads is zero, one worker per hardware
+ * thread is started.
+ */
+ThreadPool::ThreadPool(unsigned int nr_threads) {
+    if(nr_threads == 0) {
+        nr_threads = std::thread::hardware_concurrency();
+    }
+    if(nr_threads == 0) {
+        nr_threads = 1;
+    }
+
+    this->nr_active = 0;
+    this->stop = false;
+
+    for(unsigned int i=0; i<nr_threads; i++) {
+        this->workers.push_back(std::thread(&ThreadPool::run, this, i));
+    }
+}
+
+/*
+ * Finish all queued tasks and join the worker threads
+ */
+ThreadPool::~ThreadPool() {
+    {
+        std::unique_lock<std::mutex> lock(this->mtx);
+        this->stop = true;
+    }
+    this->cv_task.notify_all();
+
+    for(unsigned int i=0; i<this->workers.size(); i++) {
+        this->workers[i].join();
+    }
+}
+
+unsigned int ThreadPool::get_nr_threads() const {
+    return this->workers.size();
+}
+
+/*
+ * Queue a task. The task is called with the index of the executing worker.
+ */
+void ThreadPool::submit(const std::function<void(unsigned int)> &task) {
+    {
+        std::unique_lock<std::mutex> lock(this->mtx);
+        this->tasks.push(task);
+    }
+    this->cv_task.notify_one();
+}
+
+/*
+ * Block until all queued tasks have been executed
+ */
+void ThreadPool::wait() {
+    std::unique_lock<std::mutex> lock(this->mtx);
+    while(!this->tasks.empty() || this->nr_active > 0) {
+        this->cv_done.wait(lock);
+    }
+}
+
+/*
+ * Block while more than max_pending tasks are waiting in the queue. This is
+ * used by producers (e.g. a parser handing out frames) to bound the memory
+ * held by queued tasks.
+ */
+void ThreadPool::wait_for_slot(size_t max_pending) {
+    std::unique_lock<std::mutex> lock(this->mtx);
+    while(this->tasks.size() > max_pending) {
+        this->cv_done.wait(lock);
+    }
+}
+
+/*
+ * Execute func(i, worker) for all i in [0, n) and wait until all iterations
+ * have finished. Iterations are handed out dynamically, such that unevenly
+ * sized iterations are balanced over the workers. Note that this function
+ * must not be called from within a task of the same pool.
+ */
+void ThreadPool::parallel_for(size_t n, const std::function<void(size_t, unsigned int)> &func) {
+    if(n == 0) {
+        return;
+    }
+
+    std::atomic<size_t> next(0);
+    std::mutex done_mtx;
+    std::condition_variable done_cv;
+    unsigned int nr_tasks = std::min((size_t)this->workers.size(), n);
+    unsigned int nr_finished = 0;
+
+    for(unsigned int t=0; t<nr_tasks; t++) {
+        this->submit([&](unsigned int worker) {
+            for(size_t i = next++; i < n; i = next++) {
+                func(i, worker);
+            }
+
+            std::unique_lock<std::mutex> lock(done_mtx);
+            nr_finished++;
+            done_cv.notify_all();
+        });
+    }
+
+    std::unique_lock<std::mutex> lock(done_mtx);
+    while(nr_finished < nr_tasks) {
+        done_cv.wait(lock);
+    }
+}
+
+/*
+ * Main loop of a worker thread
+ */
+void ThreadPool::run(unsigned int worker) {
+    while(true) {
+        std::function<void(unsigned int)> task;
+
+        {
+            std::unique_lock<std::mutex> lock(this->mtx);
+            while(!this->stop && this->tasks.empty()) {
+                this->cv_task.wait(lock);
+            }
+            if(this->stop && this->tasks.empty()) {
+                return;
+            }
+            task = this->tasks.front();
+            this->tasks.pop();
+            this->nr_active++;
+        }
+
+        task(worker);
+
+        {
+            std::unique_lock<std::mutex> lock(this->mtx);
+            this->nr_active--;
+        }
+        this->cv_done.notify_all();
+    }
+}
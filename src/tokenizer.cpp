@@ -0,0 +1,220 @@
+/*************************************************************************
+ *
+ *  This file is part of v2c.
+ *
+ *  Author: Ivo Filot <i.a.w.filot@tue.nl>
+ *
+ *  v2c is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  v2c is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with v2c.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ************************************************************************/
+
+#include "tokenizer.h"
+
+#include <string.h>
+#include <stdlib.h>
+#include <ctype.h>
+
+bool Token::equals(const char *str) const {
+    const size_t n = strlen(str);
+    return this->size() == n && strncmp(this->begin, str, n) == 0;
+}
+
+bool Token::starts_with_nocase(const char *str) const {
+    const size_t n = strlen(str);
+    return this->size() >= n && strncasecmp(this->begin, str, n) == 0;
+}
+
+/*
+ * Constructor; the tokenizer is positioned before the first line
+ */
+Tokenizer::Tokenizer(const char *_begin, const char *_end) {
+    this->ptr = _begin;
+    this->end = _end;
+    this->line_begin = _begin;
+    this->line_end = _begin;
+    this->cursor = _begin;
+    this->line_number = 0;
+}
+
+/*
+ * Advance to the next line; returns false at the end of the buffer
+ */
+bool Tokenizer::next_line() {
+    if(this->ptr >= this->end) {
+        this->line_begin = this->line_end = this->cursor = this->end;
+        return false;
+    }
+
+    this->line_begin = this->ptr;
+    const char *eol = (const char*)memchr(this->ptr, '\n', this->end - this->ptr);
+    if(eol == NULL) {
+        eol = this->end;
+        this->ptr = this->end;
+    } else {
+        this->ptr = eol + 1;
+    }
+
+    // strip the carriage return of DOS line endings
+    if(eol > this->line_begin && *(eol - 1) == '\r') {
+        eol--;
+    }
+
+    this->line_end = eol;
+    this->cursor = this->line_begin;
+    this->line_number++;
+
+    return true;
+}
+
+/*
+ * Next whitespace separated token on the current line
+ */
+bool Tokenizer::next_token(Token *token) {
+    const char *p = this->cursor;
+    while(p < this->line_end && isspace((unsigned char)*p)) {
+        p++;
+    }
+    if(p >= this->line_end) {
+        this->cursor = this->line_end;
+        return false;
+    }
+
+    // a quote only closes a token when it is followed by whitespace
+    if(*p == '\'' || *p == '"') {
+        const char quote = *p;
+        const char *q = p + 1;
+        while(q < this->line_end && !(*q == quote && (q + 1 == this->line_end || isspace((unsigned char)*(q + 1))))) {
+            q++;
+        }
+        if(q < this->line_end) {
+            token->begin = p + 1;
+            token->end = q;
+            this->cursor = q + 1;
+            return true;
+        }
+    }
+
+    const char *q = p;
+    while(q < this->line_end && !isspace((unsigned char)*q)) {
+        q++;
+    }
+
+    token->begin = p;
+    token->end = q;
+    this->cursor = q;
+
+    return true;
+}
+
+bool Tokenizer::next_double(double *value) {
+    Token token;
+    return this->next_token(&token) && to_double(token, value);
+}
+
+bool Tokenizer::next_int(long *value) {
+    Token token;
+    return this->next_token(&token) && to_int(token, value);
+}
+
+/*
+ * Next token on the current line without consuming it
+ */
+bool Tokenizer::peek_token(Token *token) const {
+    Tokenizer copy = *this;
+    return copy.next_token(token);
+}
+
+/*
+ * Returns the complete current line
+ */
+Token Tokenizer::get_line() const {
+    Token token;
+    token.begin = this->line_begin;
+    token.end = this->line_end;
+    return token;
+}
+
+unsigned int Tokenizer::get_line_number() const {
+    return this->line_number;
+}
+
+bool Tokenizer::at_end() const {
+    return this->ptr >= this->end;
+}
+
+/*
+ * Convert a token to a floating point number; the whole token has to be a
+ * number. Fortran style exponents (1.0D-03) are accepted.
+ */
+bool Tokenizer::to_double(const Token &token, double *value) {
+    char buffer[64];
+    const size_t n = token.size();
+    if(n == 0 || n >= sizeof(buffer)) {
+        return false;
+    }
+    for(size_t i=0; i<n; i++) {
+        const char c = token.begin[i];
+        buffer[i] = (c == 'D' || c == 'd') ? 'e' : c;
+    }
+    buffer[n] = 0;
+
+    char *stop;
+    *value = strtod(buffer, &stop);
+    return stop == buffer + n;
+}
+
+bool Tokenizer::to_int(const Token &token, long *value) {
+    char buffer[32];
+    const size_t n = token.size();
+    if(n == 0 || n >= sizeof(buffer)) {
+        return false;
+    }
+    memcpy(buffer, token.begin, n);
+    buffer[n] = 0;
+
+    char *stop;
+    *value = strtol(buffer, &stop, 10);
+    return stop == buffer + n;
+}
+
+/*
+ * Read a complete file into <buffer>
+ */
+bool Tokenizer::read_file(const std::string &filename, std::vector<char> &buffer) {
+    FILE *f = fopen(filename.c_str(), "rb");
+    if(f == NULL) {
+        return false;
+    }
+
+    long size = -1;
+    if(fseek(f, 0, SEEK_END) == 0) {
+        size = ftell(f);
+        rewind(f);
+    }
+    if(size < 0) {
+        fclose(f);
+        return false;
+    }
+
+    buffer.resize(size);
+    if(size > 0 && fread(buffer.data(), 1, size, f) != (size_t)size) {
+        fclose(f);
+        return false;
+    }
+
+    const bool success = !ferror(f);
+    fclose(f);
+
+    return success;
+}
@@ -0,0 +1,529 @@
+/*************************************************************************
+ *
+ *  This file is part of v2c.
+ *
+ *  Author: Ivo Filot <i.a.w.filot@tue.nl>
+ *
+ *  v2c is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  v2c is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with v2c.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ************************************************************************/
+
+#include "trajectory.h"
+#include "celltransform.h"
+
+#include <limits>
+#include <stdio.h>
+
+/*
+ * Default constructor
+ */
+Trajectory::Trajectory() {
+    this->clear();
+}
+
+/*
+ * Construct a trajectory from a series of states
+ */
+Trajectory::Trajectory(const std::vector<State> &_states) {
+    this->clear();
+
+    if(_states.size() > 0) {
+        const size_t atoms = _states[0].get_total_nr_atoms();
+        this->positions.reserve(_states.size() * atoms * 3);
+        this->forces.reserve(_states.size() * atoms * 3);
+        this->energies.reserve(_states.size());
+        this->cells.reserve(_states.size() * 9);
+    }
+
+    for(unsigned int i=0; i<_states.size(); i++) {
+        this->append(_states[i]);
+    }
+}
+
+/*
+ * Construct a trajectory from the states of a FrameStore; spilled states
+ * are read back one at a time
+ */
+Trajectory::Trajectory(const FrameStore &_states) {
+    this->clear();
+    this->append(_states, 0, _states.size());
+}
+
+/*
+ * Append a state as a new frame. All frames need to hold the same atoms;
+ * returns false when the state does not match the previous frames.
+ */
+bool Trajectory::append(const State &_state) {
+    if(this->nr_frames == 0) {
+        this->nr_atoms = _state.get_total_nr_atoms();
+        this->elements = _state.get_elements();
+        this->nr_atoms_per_elm.clear();
+        for(unsigned int i=0; i<_state.get_nr_elements(); i++) {
+            this->nr_atoms_per_elm.push_back(_state.get_atoms_for_element(i));
+        }
+        this->species.resize(this->nr_atoms);
+        for(unsigned int i=0; i<this->nr_atoms; i++) {
+            this->species[i] = _state.atoms[i].elnr;
+        }
+    } else if(_state.get_total_nr_atoms() != this->nr_atoms) {
+        std::cerr << "Cannot append a state with " << _state.get_total_nr_atoms()
+                  << " atoms to a trajectory of " << this->nr_atoms << " atoms." << std::endl;
+        return false;
+    }
+
+    for(unsigned int i=0; i<this->nr_atoms; i++) {
+        const Atom &atom = _state.atoms[i];
+        for(unsigned int j=0; j<3; j++) {
+            this->positions.push_back(atom.pos(j));
+        }
+        for(unsigned int j=0; j<3; j++) {
+            this->forces.push_back(atom.force(j));
+        }
+    }
+
+    this->energies.push_back(_state.get_energy());
+
+    for(unsigned int i=0; i<3; i++) {
+        for(unsigned int j=0; j<3; j++) {
+            this->cells.push_back(_state.dimensions(i,j));
+        }
+    }
+
+    this->nr_frames++;
+
+    return true;
+}
+
+/*
+ * Append the <count> frames of <_states> starting at <first>; frames in
+ * memory are not copied, spilled frames are read back one at a time
+ */
+bool Trajectory::append(const FrameStore &_states, size_t first, size_t count) {
+    count = std::min(count, _states.size() - std::min(first, _states.size()));
+    if(count == 0) {
+        return true;
+    }
+
+    State buffer(0.0, Matrix3::Zero());
+    const size_t atoms = _states.get(first, buffer).get_total_nr_atoms();
+    const size_t frames = this->nr_frames + count;
+    this->positions.reserve(frames * atoms * 3);
+    this->forces.reserve(frames * atoms * 3);
+    this->energies.reserve(frames);
+    this->cells.reserve(frames * 9);
+
+    bool result = true;
+    for(size_t i=first; i<first+count; i++) {
+        result &= this->append(_states.get(i, buffer));
+    }
+
+    return result;
+}
+
+/*
+ * Remove all frames; the arrays keep their capacity for the next frames
+ */
+void Trajectory::clear() {
+    this->nr_atoms = 0;
+    this->nr_frames = 0;
+    this->positions.clear();
+    this->forces.clear();
+    this->energies.clear();
+    this->cells.clear();
+    this->species.clear();
+    this->elements.clear();
+    this->nr_atoms_per_elm.clear();
+}
+
+unsigned int Trajectory::get_nr_frames() const {
+    return this->nr_frames;
+}
+
+unsigned int Trajectory::get_nr_atoms() const {
+    return this->nr_atoms;
+}
+
+const std::vector<std::string>& Trajectory::get_elements() const {
+    return this->elements;
+}
+
+const std::vector<unsigned int>& Trajectory::get_nr_atoms_per_element() const {
+    return this->nr_atoms_per_elm;
+}
+
+const std::vector<unsigned int>& Trajectory::get_species() const {
+    return this->species;
+}
+
+const float* Trajectory::get_positions() const {
+    return this->positions.data();
+}
+
+const float* Trajectory::get_positions(unsigned int frame) const {
+    return &this->positions[(size_t)frame * this->nr_atoms * 3];
+}
+
+const float* Trajectory::get_forces() const {
+    return this->forces.data();
+}
+
+const float* Trajectory::get_forces(unsigned int frame) const {
+    return &this->forces[(size_t)frame * this->nr_atoms * 3];
+}
+
+const double* Trajectory::get_energies() const {
+    return this->energies.data();
+}
+
+const float* Trajectory::get_cells() const {
+    return this->cells.data();
+}
+
+const float* Trajectory::get_cell(unsigned int frame) const {
+    return &this->cells[(size_t)frame * 9];
+}
+
+/*
+ * Move the atoms of every frame into its unit cell
+ */
+void Trajectory::wrap() {
+    for(unsigned int f=0; f<this->nr_frames; f++) {
+        CellTransform::wrap(&this->positions[(size_t)f * this->nr_atoms * 3], this->nr_atoms,
+                            &this->cells[(size_t)f * 9]);
+    }
+}
+
+/*
+ * Make the positions continuous across the periodic boundaries, such that
+ * the atoms are not folded back into the unit cell (see CellTransform)
+ */
+void Trajectory::unwrap() {
+    CellTransform::unwrap(this->positions.data(), this->cells.data(), this->nr_frames, this->nr_atoms);
+}
+
+/*
+ * Return the positions in atom-major order, i.e. [atoms x frames x 3], such
+ * that the time series of a single atom is contiguous in memory
+ */
+std::vector<float> Trajectory::get_positions_atom_major() const {
+    std::vector<float> result;
+    this->transpose_blocked(this->positions, result);
+    return result;
+}
+
+/*
+ * Return the forces in atom-major order, i.e. [atoms x frames x 3]
+ */
+std::vector<float> Trajectory::get_forces_atom_major() const {
+    std::vector<float> result;
+    this->transpose_blocked(this->forces, result);
+    return result;
+}
+
+/*
+ * Write the trajectory as a set of .npy files sharing a common prefix:
+ *
+ *     <prefix>_positions.npy   [frames x atoms x 3]   float32
+ *     <prefix>_forces.npy      [frames x atoms x 3]   float32
+ *     <prefix>_energies.npy    [frames]               float64
+ *     <prefix>_cells.npy       [frames x 3 x 3]       float32
+ *     <prefix>_species.npy     [atoms]                int32
+ *     <prefix>_elements.npy    [elements]             unicode
+ *     <prefix>_counts.npy      [elements]             int32
+ *
+ * When atom_major is set, the positions and forces are additionally written
+ * in [atoms x frames x 3] order as <prefix>_positions_atom_major.npy and
+ * <prefix>_forces_atom_major.npy.
+ */
+bool Trajectory::save_to_npy(const std::string &prefix, bool atom_major) {
+    NpyWriter writer;
+
+    std::vector<size_t> shape_xyz;
+    shape_xyz.push_back(this->nr_frames);
+    shape_xyz.push_back(this->nr_atoms);
+    shape_xyz.push_back(3);
+
+    std::vector<size_t> shape_energies(1, this->nr_frames);
+
+    std::vector<size_t> shape_cells;
+    shape_cells.push_back(this->nr_frames);
+    shape_cells.push_back(3);
+    shape_cells.push_back(3);
+
+    std::vector<size_t> shape_species(1, this->nr_atoms);
+    std::vector<int32_t> species_int(this->species.begin(), this->species.end());
+    std::vector<size_t> shape_counts(1, this->nr_atoms_per_elm.size());
+    std::vector<int32_t> counts_int(this->nr_atoms_per_elm.begin(), this->nr_atoms_per_elm.end());
+
+    bool result = true;
+    result &= writer.write(prefix + "_positions.npy", this->get_positions(), shape_xyz);
+    result &= writer.write(prefix + "_forces.npy", this->get_forces(), shape_xyz);
+    result &= writer.write(prefix + "_energies.npy", this->get_energies(), shape_energies);
+    result &= writer.write(prefix + "_cells.npy", this->get_cells(), shape_cells);
+    result &= writer.write(prefix + "_species.npy", species_int.data(), shape_species);
+    result &= writer.write(prefix + "_elements.npy", this->elements);
+    result &= writer.write(prefix + "_counts.npy", counts_int.data(), shape_counts);
+
+    if(atom_major) {
+        std::vector<size_t> shape_atom_major;
+        shape_atom_major.push_back(this->nr_atoms);
+        shape_atom_major.push_back(this->nr_frames);
+        shape_atom_major.push_back(3);
+
+        // transpose one array at a time to limit the peak memory usage
+        std::vector<float> buffer;
+        this->transpose_blocked(this->positions, buffer);
+        result &= writer.write(prefix + "_positions_atom_major.npy", buffer.data(), shape_atom_major);
+        this->transpose_blocked(this->forces, buffer);
+        result &= writer.write(prefix + "_forces_atom_major.npy", buffer.data(), shape_atom_major);
+    }
+
+    return result;
+}
+
+/*
+ * Write the frames of <_states> as the same (frame-major) .npy files as
+ * save_to_npy, one block of frames at a time: the trajectory takes every
+ * block in turn, within <memory_budget> (see frames_per_block), and is
+ * wrapped block by block with <wrap>. The trajectory holds the last block
+ * afterwards. The headers state the number of frames up front, hence the
+ * files are removed again when a frame does not match the first one.
+ */
+bool Trajectory::save_to_npy(const FrameStore &_states, const std::string &prefix, size_t memory_budget, bool wrap) {
+    this->clear();
+    if(_states.empty()) {
+        return this->save_to_npy(prefix, false);
+    }
+
+    State buffer(0.0, Matrix3::Zero());
+    const size_t frames = _states.size();
+    const unsigned int atoms = _states.get(0, buffer).get_total_nr_atoms();
+    const size_t block = frames_per_block(memory_budget, atoms);
+
+    std::vector<size_t> shape_xyz;
+    shape_xyz.push_back(frames);
+    shape_xyz.push_back(atoms);
+    shape_xyz.push_back(3);
+
+    std::vector<size_t> shape_energies(1, frames);
+
+    std::vector<size_t> shape_cells;
+    shape_cells.push_back(frames);
+    shape_cells.push_back(3);
+    shape_cells.push_back(3);
+
+    NpyWriter writer;
+    std::ofstream positions_file, forces_file, energies_file, cells_file;
+    if(!writer.open_npy(positions_file, prefix + "_positions.npy", "<f4", shape_xyz) ||
+       !writer.open_npy(forces_file, prefix + "_forces.npy", "<f4", shape_xyz) ||
+       !writer.open_npy(energies_file, prefix + "_energies.npy", "<f8", shape_energies) ||
+       !writer.open_npy(cells_file, prefix + "_cells.npy", "<f4", shape_cells)) {
+        return false;
+    }
+
+    bool result = true;
+    for(size_t first=0; first<frames; first += block) {
+        this->clear();
+        if(!this->append(_states, first, block) || this->nr_atoms != atoms) {
+            positions_file.close();
+            forces_file.close();
+            energies_file.close();
+            cells_file.close();
+            remove((prefix + "_positions.npy").c_str());
+            remove((prefix + "_forces.npy").c_str());
+            remove((prefix + "_energies.npy").c_str());
+            remove((prefix + "_cells.npy").c_str());
+            return false;
+        }
+        if(wrap) {
+            this->wrap();
+        }
+
+        positions_file.write((const char*)this->positions.data(), this->positions.size() * sizeof(float));
+        forces_file.write((const char*)this->forces.data(), this->forces.size() * sizeof(float));
+        energies_file.write((const char*)this->energies.data(), this->energies.size() * sizeof(double));
+        cells_file.write((const char*)this->cells.data(), this->cells.size() * sizeof(float));
+    }
+
+    positions_file.close();
+    forces_file.close();
+    energies_file.close();
+    cells_file.close();
+    result &= !positions_file.fail() && !forces_file.fail() && !energies_file.fail() && !cells_file.fail();
+
+    std::vector<size_t> shape_species(1, this->nr_atoms);
+    std::vector<int32_t> species_int(this->species.begin(), this->species.end());
+    std::vector<size_t> shape_counts(1, this->nr_atoms_per_elm.size());
+    std::vector<int32_t> counts_int(this->nr_atoms_per_elm.begin(), this->nr_atoms_per_elm.end());
+
+    result &= writer.write(prefix + "_species.npy", species_int.data(), shape_species);
+    result &= writer.write(prefix + "_elements.npy", this->elements);
+    result &= writer.write(prefix + "_counts.npy", counts_int.data(), shape_counts);
+
+    return result;
+}
+
+/*
+ * Write the trajectory as a single (uncompressed) .npz archive holding the
+ * same arrays as save_to_npy
+ */
+bool Trajectory::save_to_npz(const std::string &filename, bool atom_major) {
+    NpyWriter writer;
+
+    std::vector<size_t> shape_xyz;
+    shape_xyz.push_back(this->nr_frames);
+    shape_xyz.push_back(this->nr_atoms);
+    shape_xyz.push_back(3);
+
+    std::vector<size_t> shape_energies(1, this->nr_frames);
+
+    std::vector<size_t> shape_cells;
+    shape_cells.push_back(this->nr_frames);
+    shape_cells.push_back(3);
+    shape_cells.push_back(3);
+
+    std::vector<size_t> shape_species(1, this->nr_atoms);
+    std::vector<int32_t> species_int(this->species.begin(), this->species.end());
+    std::vector<size_t> shape_counts(1, this->nr_atoms_per_elm.size());
+    std::vector<int32_t> counts_int(this->nr_atoms_per_elm.begin(), this->nr_atoms_per_elm.end());
+
+    if(!writer.open_npz(filename)) {
+        return false;
+    }
+
+    bool result = true;
+    result &= writer.add_to_npz("positions", this->get_positions(), shape_xyz);
+    result &= writer.add_to_npz("forces", this->get_forces(), shape_xyz);
+    result &= writer.add_to_npz("energies", this->get_energies(), shape_energies);
+    result &= writer.add_to_npz("cells", this->get_cells(), shape_cells);
+    result &= writer.add_to_npz("species", species_int.data(), shape_species);
+    result &= writer.add_to_npz("elements", this->elements);
+    result &= writer.add_to_npz("counts", counts_int.data(), shape_counts);
+
+    if(atom_major) {
+        std::vector<size_t> shape_atom_major;
+        shape_atom_major.push_back(this->nr_atoms);
+        shape_atom_major.push_back(this->nr_frames);
+        shape_atom_major.push_back(3);
+
+        std::vector<float> buffer;
+        this->transpose_blocked(this->positions, buffer);
+        result &= writer.add_to_npz("positions_atom_major", buffer.data(), shape_atom_major);
+        this->transpose_blocked(this->forces, buffer);
+        result &= writer.add_to_npz("forces_atom_major", buffer.data(), shape_atom_major);
+    }
+
+    result &= writer.close_npz();
+
+    return result;
+}
+
+/*
+ * Load a trajectory from the .npy files written by save_to_npy. The forces
+ * are optional; when absent, they are set to zero.
+ */
+bool Trajectory::load_from_npy(const std::string &prefix) {
+    this->clear();
+
+    NpyReader reader;
+    std::vector<int32_t> species_int;
+    std::vector<int32_t> counts_int;
+
+    if(!reader.read(prefix + "_positions.npy") || reader.get_shape().size() != 3 ||
+       reader.get_shape()[2] != 3 || !reader.get(this->positions)) {
+        std::cerr << "Invalid positions array for " << prefix << std::endl;
+        this->clear();
+        return false;
+    }
+    const size_t frames = reader.get_shape()[0];
+    const size_t atoms = reader.get_shape()[1];
+
+    if(!reader.read(prefix + "_energies.npy") || !reader.get(this->energies) ||
+       !reader.read(prefix + "_cells.npy") || !reader.get(this->cells) ||
+       !reader.read(prefix + "_species.npy") || !reader.get(species_int) ||
+       !reader.read(prefix + "_elements.npy") || !reader.get(this->elements) ||
+       !reader.read(prefix + "_counts.npy") || !reader.get(counts_int) ||
+       this->energies.size() != frames || this->cells.size() != frames * 9 ||
+       species_int.size() != atoms || counts_int.size() != this->elements.size()) {
+        std::cerr << "Missing or inconsistent arrays for " << prefix << std::endl;
+        this->clear();
+        return false;
+    }
+
+    bool has_forces = false;
+    std::ifstream forces_file((prefix + "_forces.npy").c_str());
+    if(forces_file.is_open()) {
+        forces_file.close();
+        has_forces = reader.read(prefix + "_forces.npy") && reader.get(this->forces) &&
+                     this->forces.size() == this->positions.size();
+    }
+    if(!has_forces) {
+        this->forces.assign(this->positions.size(), 0.0f);
+    }
+
+    this->species.assign(species_int.begin(), species_int.end());
+    this->nr_atoms_per_elm.assign(counts_int.begin(), counts_int.end());
+    this->nr_frames = frames;
+    this->nr_atoms = atoms;
+
+    return true;
+}
+
+/*
+ * Number of frames of <nr_atoms> atoms whose arrays (positions, forces,
+ * energy and cell) fit in <memory_budget>; at least one, and all frames
+ * without a budget
+ */
+size_t Trajectory::frames_per_block(size_t memory_budget, unsigned int nr_atoms) {
+    if(memory_budget == FRAME_STORE_UNLIMITED) {
+        return std::numeric_limits<unsigned int>::max();
+    }
+
+    const size_t frame_size = (size_t)nr_atoms * 6 * sizeof(float) + 9 * sizeof(float) + sizeof(double);
+    return std::max(memory_budget / frame_size, (size_t)1);
+}
+
+/*
+ * Transpose a [frames x atoms x 3] array into [atoms x frames x 3]. A naive
+ * transpose walks through the destination with a stride of frames * 3
+ * floats, touching a new cache line (and for long trajectories a new page)
+ * for every element. Instead, the array is processed in square tiles of
+ * TRAJECTORY_TRANSPOSE_BLOCK frames by TRAJECTORY_TRANSPOSE_BLOCK atoms,
+ * such that both the source and the destination rows of a tile stay in
+ * cache while the tile is being copied.
+ */
+void Trajectory::transpose_blocked(const std::vector<float> &src, std::vector<float> &dest) const {
+    const size_t frames = this->nr_frames;
+    const size_t atoms = this->nr_atoms;
+
+    dest.resize(frames * atoms * 3);
+
+    for(size_t fb=0; fb<frames; fb += TRAJECTORY_TRANSPOSE_BLOCK) {
+        const size_t fe = std::min(fb + TRAJECTORY_TRANSPOSE_BLOCK, frames);
+        for(size_t ab=0; ab<atoms; ab += TRAJECTORY_TRANSPOSE_BLOCK) {
+            const size_t ae = std::min(ab + TRAJECTORY_TRANSPOSE_BLOCK, atoms);
+            for(size_t a=ab; a<ae; a++) {
+                float *out = &dest[(a * frames + fb) * 3];
+                const float *in = &src[(fb * atoms + a) * 3];
+                for(size_t f=fb; f<fe; f++) {
+                    out[0] = in[0];
+                    out[1] = in[1];
+                    out[2] = in[2];
+                    out += 3;
+                    in += atoms * 3;
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,255 @@
+/*************************************************************************
+ *
+ *  This file is part of v2c.
+ *
+ *  Author: Ivo Filot <i.a.w.filot@tue.nl>
+ *
+ *  v2c is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  v2c is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with v2c.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ************************************************************************/
+
+
+#include "trajectoryreader.h"
+#include "geometry.h"
+
+/*
+ * Constructor; first frames of a piece within <_seam_tolerance> of the
+ * last frame of the previous piece are dropped
+ */
+TrajectoryReader::TrajectoryReader(double _seam_tolerance) {
+    this->seam_tolerance = _seam_tolerance;
+    this->keep_states = true;
+    this->observables_mask = 0;
+    this->memory_budget = FRAME_STORE_UNLIMITED;
+    this->clear();
+}
+
+/*
+ * Read the pieces <files> of a trajectory, in order, using <nr_threads>
+ * threads (0: one per core). Returns false when a piece cannot be read or
+ * holds different atoms than the pieces before it; the frames of the pieces
+ * before it have been handed out by then.
+ */
+bool TrajectoryReader::read(const std::vector<std::string> &files, unsigned int nr_threads) {
+    AtomSelection selection = this->selection;
+    if(nr_threads == 1 || files.size() == 1) {
+        for(unsigned int f=0; f<files.size() && this->consistent; f++) {
+            if(!this->read_piece(files[f], selection)) {
+                return false;
+            }
+        }
+        return this->consistent;
+    }
+
+    // the first piece resolves the selection for all others
+    unsigned int first = 0;
+    if(selection.needs_positions()) {
+        if(!this->read_piece(files[0], selection)) {
+            return false;
+        }
+        first = 1;
+    }
+
+    ThreadPool pool(std::min(nr_threads == 0 ? std::thread::hardware_concurrency() : nr_threads,
+                             (unsigned int)files.size()));
+    const unsigned int batch = pool.get_nr_threads();
+    for(unsigned int start=first; start<files.size() && this->consistent; start += batch) {
+        const unsigned int n = std::min(batch, (unsigned int)files.size() - start);
+        // the pieces of a batch share the memory budget, such that they hold
+        // at most as much as the frames that have been handed out
+        const size_t piece_budget = this->memory_budget == FRAME_STORE_UNLIMITED ?
+                                    FRAME_STORE_UNLIMITED : std::max((size_t)1, this->memory_budget / n);
+        std::vector<std::unique_ptr<VaspReader> > pieces(n);
+        std::vector<char> success(n, 0);
+        pool.parallel_for(n, [&](size_t i, unsigned int worker) {
+            pieces[i].reset(new VaspReader());
+            pieces[i]->set_observables(this->observables_mask);
+            pieces[i]->set_selection(selection);
+            pieces[i]->set_memory_budget(piece_budget, this->spill_directory);
+            success[i] = pieces[i]->read(files[start + i].c_str());
+        });
+
+        State buffer(0.0, Matrix3::Zero());
+        for(unsigned int i=0; i<n && this->consistent; i++) {
+            if(!success[i]) {
+                return false;
+            }
+            for(size_t j=0; j<pieces[i]->states.size() && this->consistent; j++) {
+                this->add_frame(pieces[i]->states.get(j, buffer), j == 0);
+            }
+            pieces[i].reset();
+        }
+    }
+
+    return this->consistent;
+}
+
+/*
+ * Stream the frames of a single piece; a selection that the piece has
+ * resolved is returned in <_selection> for the pieces that follow
+ */
+bool TrajectoryReader::read_piece(const std::string &filename, AtomSelection &_selection) {
+    bool first = true;
+    VaspReader vr;
+    vr.set_observables(this->observables_mask);
+    vr.set_selection(_selection);
+    vr.set_state_callback([&](const State &state) {
+        this->add_frame(state, first);
+        first = false;
+    }, false);
+    if(!vr.read(filename.c_str())) {
+        return false;
+    }
+    _selection = vr.get_selection();
+    return true;
+}
+
+/*
+ * Forget the frames and the atoms of the pieces read so far
+ */
+void TrajectoryReader::clear() {
+    this->states.clear();
+    this->elements.clear();
+    this->nr_atoms_per_elm.clear();
+    this->consistent = true;
+    this->nr_frames = 0;
+    this->nr_seams = 0;
+    this->last_positions.resize(0, 3);
+    this->last_cell = Matrix3::Zero();
+}
+
+/*
+ * Register a function that is called for every frame in order (see
+ * VaspReader::set_state_callback); with <_keep_states>, the frames are
+ * collected in states as well
+ */
+void TrajectoryReader::set_state_callback(const std::function<void(const State&)> &_callback, bool _keep_states) {
+    this->state_callback = _callback;
+    this->keep_states = _keep_states;
+}
+
+/*
+ * Select the optional per-step quantities to collect (see
+ * VaspReader::set_observables)
+ */
+void TrajectoryReader::set_observables(unsigned int _mask) {
+    this->observables_mask = _mask;
+}
+
+/*
+ * Keep only the atoms in <_selection> (see AtomSelection)
+ */
+void TrajectoryReader::set_selection(const AtomSelection &_selection) {
+    this->selection = _selection;
+}
+
+/*
+ * Limit the memory taken by the kept frames, and by the frames of every
+ * piece that is read in parallel, to <_bytes> (see FrameStore)
+ */
+void TrajectoryReader::set_memory_budget(size_t _bytes, const std::string &_directory) {
+    this->memory_budget = _bytes;
+    this->spill_directory = _directory;
+    this->states.set_memory_budget(_bytes, _directory);
+}
+
+unsigned int TrajectoryReader::get_nr_frames() const {
+    return this->nr_frames;
+}
+
+unsigned int TrajectoryReader::get_nr_seams() const {
+    return this->nr_seams;
+}
+
+const std::vector<std::string>& TrajectoryReader::get_elements() const {
+    return this->elements;
+}
+
+/*
+ * Split a command line argument that lists the pieces of a trajectory,
+ * separated by commas (e.g. OUTCAR_1,OUTCAR_2), into the file names
+ */
+std::vector<std::string> TrajectoryReader::split_pieces(const std::string &argument) {
+    std::vector<std::string> files;
+    size_t start = 0;
+    while(start <= argument.size()) {
+        size_t end = argument.find(',', start);
+        if(end == std::string::npos) {
+            end = argument.size();
+        }
+        if(end > start) {
+            files.push_back(argument.substr(start, end - start));
+        }
+        start = end + 1;
+    }
+    return files;
+}
+
+/*
+ * Hand out the next frame of the trajectory, unless it duplicates the last
+ * frame at the start of a piece. The first frame of a piece is checked to
+ * hold the same atoms as the pieces before it.
+ */
+void TrajectoryReader::add_frame(const State &state, bool first_of_piece) {
+    if(first_of_piece) {
+        if(this->nr_frames == 0 && this->elements.empty()) {
+            this->elements = state.get_elements();
+            this->nr_atoms_per_elm = state.get_nr_atoms_per_element();
+        } else if(state.get_elements() != this->elements ||
+                  state.get_nr_atoms_per_element() != this->nr_atoms_per_elm) {
+            std::cerr << state.get_filename() << " holds other elements or numbers of atoms than the "
+                      << "preceding pieces of the trajectory." << std::endl;
+            this->consistent = false;
+        }
+
+        if(this->is_seam(state)) {
+            this->nr_seams++;
+            return;
+        }
+    }
+
+    if(!this->consistent) {
+        return;
+    }
+
+    State frame(state);
+    frame.set_state_id(++this->nr_frames);
+
+    this->last_cell = frame.dimensions;
+    this->last_positions = frame.coordinates.leftCols<3>();
+
+    if(this->state_callback) {
+        this->state_callback(frame);
+    }
+    if(this->keep_states) {
+        this->states.push_back(frame);
+    }
+}
+
+/*
+ * Whether <state> has the cell of the last frame and all its atoms lie
+ * within the seam tolerance of their positions in the last frame, taking
+ * the periodic boundaries into account
+ */
+bool TrajectoryReader::is_seam(const State &state) const {
+    if(this->last_positions.rows() == 0 || this->last_positions.rows() != state.coordinates.rows() ||
+       (state.dimensions - this->last_cell).cwiseAbs().maxCoeff() > this->seam_tolerance) {
+        return false;
+    }
+
+    Eigen::Matrix<Real, Eigen::Dynamic, 1> d2;
+    Geometry::minimum_image_distances(state.dimensions, this->last_positions, state.coordinates.leftCols<3>(), d2);
+
+    return d2.maxCoeff() <= this->seam_tolerance * this->seam_tolerance;
+}
@@ -19,8 +19,1855 @@
  *
  ************************************************************************/
 
+#include <string>
+#include <vector>
+#include <iostream>
+#include <memory>
+#include <unordered_map>
+#include <algorithm>
+#include <chrono>
+#include <stdlib.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
 #include "vaspreader.h"
+#include "trajectory.h"
+#include "threadpool.h"
+#include "rdf.h"
+#include "correlation.h"
+#include "rmsd.h"
+#include "fingerprint.h"
+#include "conversioncache.h"
+#include "prefetchreader.h"
+#include "poscarwriter.h"
+#include "structurereader.h"
+#include "cifwriter.h"
+#include "celltransform.h"
+#include "geometry.h"
+#include "adsorption.h"
+#include "scenewriter.h"
+#include "trajectoryreader.h"
+#include "conversionserver.h"
+
+/*
+ * Print the list of commands and their options
+ */
+void print_usage() {
+    std::cout << "Usage: v2c <command> [options]" << std::endl;
+    std::cout << std::endl;
+    std::cout << "Commands:" << std::endl;
+    std::cout << "  export [--npz] [--atom-major] [--wrap] [--unwrap] [--memory MB] OUTCAR PREFIX" << std::endl;
+    std::cout << "      write positions, forces, energies, cells and species as" << std::endl;
+    std::cout << "      PREFIX_<array>.npy files (or PREFIX.npz with --npz); the positions" << std::endl;
+    std::cout << "      are moved into the cell (--wrap) and/or made continuous across" << std::endl;
+    std::cout << "      the periodic boundaries (--unwrap). With --memory, the .npy files" << std::endl;
+    std::cout << "      are written in blocks of frames that fit in MB megabytes, unless" << std::endl;
+    std::cout << "      --npz, --atom-major or --unwrap need all frames at once" << std::endl;
+    std::cout << "  observables [--stress] [--magnetization] [--md] [--timing] [--forces] OUTCAR OUTPUT" << std::endl;
+    std::cout << "      tabulate the energy and the selected quantities (default: all) of" << std::endl;
+    std::cout << "      every ionic step: stress tensor, total magnetization, kinetic" << std::endl;
+    std::cout << "      energy and temperature, LOOP+ cpu and real time, and the largest" << std::endl;
+    std::cout << "      and RMS force" << std::endl;
+    std::cout << "  converge [--fmax F] [--exclude-fixed] [--threads N] OUTCAR [OUTCAR...] OUTPUT" << std::endl;
+    std::cout << "      energy change and largest, RMS and per-element largest force of" << std::endl;
+    std::cout << "      every ionic step of each OUTCAR, read in parallel; a relaxation has" << std::endl;
+    std::cout << "      converged when the largest final force is at most F (default:" << std::endl;
+    std::cout << "      0.05 eV/A). With --exclude-fixed, the atoms fixed in all directions" << std::endl;
+    std::cout << "      in the POSCAR next to an OUTCAR are left out" << std::endl;
+    std::cout << "  check OUTCAR [OUTCAR...]" << std::endl;
+    std::cout << "      list the truncated or corrupted ionic steps, which are left out" << std::endl;
+    std::cout << "      by all other commands" << std::endl;
+    std::cout << "  rdf [--rmax R] [--bins N] [--threads N] OUTCAR [OUTCAR...] OUTPUT" << std::endl;
+    std::cout << "      accumulate the partial radial distribution functions of all" << std::endl;
+    std::cout << "      frames (default: R = 6.0 A, N = 300 bins)" << std::endl;
+    std::cout << "  sites [--tolerance T] [--threads N] OUTCAR [OUTCAR...] OUTPUT" << std::endl;
+    std::cout << "      adsorption site (top, bridge, fcc, hcp, 4-fold) and coordination" << std::endl;
+    std::cout << "      number of every H, C, N and O atom in every frame; the atoms of a" << std::endl;
+    std::cout << "      site are bonded within a factor 1 + T (default: 0.15) of the" << std::endl;
+    std::cout << "      shortest bond" << std::endl;
+    std::cout << "  msd [--dt FS] [--memory MB] [--threads N] (OUTCAR | --cache PREFIX) OUTPUT" << std::endl;
+    std::cout << "      mean squared displacement, velocity autocorrelation and" << std::endl;
+    std::cout << "      diffusion coefficient per element, from an OUTCAR or from the" << std::endl;
+    std::cout << "      .npy files written by export (default: dt = 1.0 fs). With" << std::endl;
+    std::cout << "      --memory, the time series are gathered for as many atoms at a" << std::endl;
+    std::cout << "      time as fit in MB megabytes; the MSD and VACF still take memory" << std::endl;
+    std::cout << "      in proportion to the number of frames" << std::endl;
+    std::cout << "  rmsd [--ref N] [--ref-file OUTCAR] [--no-pbc] [--no-align] [--memory MB]" << std::endl;
+    std::cout << "       [--threads N] OUTCAR OUTPUT" << std::endl;
+    std::cout << "      RMSD of every frame after Kabsch alignment with respect to frame N" << std::endl;
+    std::cout << "      (default: 1, negative values count from the end) of OUTCAR or of" << std::endl;
+    std::cout << "      the reference OUTCAR, POSCAR or CIF file; with --memory, the frames" << std::endl;
+    std::cout << "      are compared in blocks that fit in MB megabytes. --select is applied" << std::endl;
+    std::cout << "      to the reference file as well, with a z-window taken in frame N" << std::endl;
+    std::cout << "  dedup [--threshold T] [--no-pbc] [--no-align] [--gzip] [--memory MB] [--threads N]" << std::endl;
+    std::cout << "        OUTCAR PREFIX" << std::endl;
+    std::cout << "      write only the frames whose RMSD to all previously written frames" << std::endl;
+    std::cout << "      is at least T (default: 0.1 A) as PREFIX_<frame>.POSCAR; with" << std::endl;
+    std::cout << "      --memory, the frames are compared in blocks that fit in MB" << std::endl;
+    std::cout << "      megabytes, next to the positions of the frames written" << std::endl;
+    std::cout << "  frames [--every N] [--vasp4] [--gzip] [--memory MB] [--threads N] OUTCAR PREFIX" << std::endl;
+    std::cout << "      write every N-th frame (default: every frame) as" << std::endl;
+    std::cout << "      PREFIX_<frame>.POSCAR, in parallel. With --memory, the frames" << std::endl;
+    std::cout << "      beyond MB megabytes are spilled to a file in $TMPDIR (as for" << std::endl;
+    std::cout << "      export, msd, rmsd and dedup, which add at most the same again)" << std::endl;
+    std::cout << "  cif [--frame N] [--gzip] [--threads N] [-o DIR] [--symmetry [--symprec T]]" << std::endl;
+    std::cout << "      INPUT [INPUT...]" << std::endl;
+    std::cout << "      write frame N (default: -1, the last one) of every OUTCAR, POSCAR" << std::endl;
+    std::cout << "      or CIF file as DIR/<name>.cif in space group P1; with --symmetry," << std::endl;
+    std::cout << "      supercells and centered cells are reduced to their primitive cell" << std::endl;
+    std::cout << "      and its asymmetric unit and the symmetry operations found within T" << std::endl;
+    std::cout << "      Angstrom (default: 0.01) are written" << std::endl;
+    std::cout << "  supercell [--frame N] [--wrap] [--threads N] NA NB NC INPUT OUTPUT" << std::endl;
+    std::cout << "      write the NA x NB x NC supercell of frame N (default: -1) of an" << std::endl;
+    std::cout << "      OUTCAR, POSCAR or CIF file as POSCAR (or as CIF when OUTPUT ends" << std::endl;
+    std::cout << "      in .cif or .cif.gz); with --wrap, the atoms are first moved into" << std::endl;
+    std::cout << "      the cell" << std::endl;
+    std::cout << "  benchmark [--frame N] [--repeat N] NA NB NC INPUT" << std::endl;
+    std::cout << "      time the coordinate transform, minimum image distance and centroid" << std::endl;
+    std::cout << "      kernels in single and double precision on the NA x NB x NC" << std::endl;
+    std::cout << "      supercell of frame N (default: -1) of an OUTCAR, POSCAR or CIF file" << std::endl;
+    std::cout << "      and report the deviation of single from double precision" << std::endl;
+    std::cout << "  scene [--frame N | --all [--every N] [--fps F]] [--no-bonds] INPUT OUTPUT" << std::endl;
+    std::cout << "      write frame N (default: -1), or with --all every N-th frame as an" << std::endl;
+    std::cout << "      animation at F frames per second (default: 10), of an OUTCAR," << std::endl;
+    std::cout << "      POSCAR or CIF file as instanced binary glTF (OUTPUT.glb) or as" << std::endl;
+    std::cout << "      PLY point cloud with bonds as edges (OUTPUT.ply, single frame)" << std::endl;
+    std::cout << "  convert [--all] [--index FILE] [--link] [--tolerance T] [--cache FILE] [--gzip]" << std::endl;
+    std::cout << "          [--queue-depth N] [--memory MB] [--threads N] [-o DIR] OUTCAR [OUTCAR...]" << std::endl;
+    std::cout << "      write the final (or, with --all, every) state of each OUTCAR as" << std::endl;
+    std::cout << "      DIR/<path>_<state>.POSCAR, skipping structures whose fingerprint" << std::endl;
+    std::cout << "      (distance tolerance T, default: 0.05 A) is already in the index;" << std::endl;
+    std::cout << "      with --link, duplicates become symbolic links to the first copy." << std::endl;
+    std::cout << "      With --cache, unchanged OUTCARs are skipped and OUTCARs that have" << std::endl;
+    std::cout << "      grown are only parsed from their last converted state onwards." << std::endl;
+    std::cout << "      Up to N - 1 reads (default: N = " << PREFETCH_DEFAULT_QUEUE_DEPTH << ") of the next 1 MiB" << std::endl;
+    std::cout << "      chunks are kept in flight while parsing; --memory limits the" << std::endl;
+    std::cout << "      states held in memory per OUTCAR as for frames" << std::endl;
+    std::cout << "  serve SOCKET" << std::endl;
+    std::cout << "      stay resident and run the commands of clients connecting to the" << std::endl;
+    std::cout << "      local socket SOCKET, one at a time, until the shutdown command" << std::endl;
+    std::cout << "  client SOCKET COMMAND [options]" << std::endl;
+    std::cout << "      run COMMAND (or shutdown) on the server on SOCKET, in the current" << std::endl;
+    std::cout << "      directory, with its output and exit code passed through" << std::endl;
+    std::cout << "Output files whose name ends in .gz are gzip compressed; with --gzip," << std::endl;
+    std::cout << "the POSCAR and CIF files are written as <name>.gz." << std::endl;
+    std::cout << "Except for check, converge and convert, an OUTCAR can be given as the" << std::endl;
+    std::cout << "comma-separated pieces of a restarted run (OUTCAR_1,OUTCAR_2,...), which" << std::endl;
+    std::cout << "are read as one trajectory: the frames are numbered throughout and a" << std::endl;
+    std::cout << "piece that starts with the last frame of the one before skips it." << std::endl;
+    std::cout << "export, observables, rdf, sites, msd, rmsd, dedup and frames take" << std::endl;
+    std::cout << "--select SPEC to keep only some of the atoms while parsing; SPEC lists" << std::endl;
+    std::cout << "elements (O), 1-based index ranges (5-40) and a z-window in A taken in" << std::endl;
+    std::cout << "the first frame (z=LO:HI) or in every frame (zframe=LO:HI), separated" << std::endl;
+    std::cout << "by commas. export, msd, rmsd, dedup and frames need the same atoms in" << std::endl;
+    std::cout << "every frame and do not take zframe=." << std::endl;
+}
+
+/*
+ * Report the duplicated frames that were dropped at the seams between the
+ * pieces of a trajectory
+ */
+void report_seams(const TrajectoryReader &reader) {
+    if(reader.get_nr_seams() > 0) {
+        std::cout << "Dropped " << reader.get_nr_seams() << " duplicated frames at the seams of the trajectory." << std::endl;
+    }
+}
+
+/*
+ * A per-frame z-window changes the number of atoms from frame to frame,
+ * which the commands that build a Trajectory cannot handle
+ */
+bool check_fixed_selection(const AtomSelection &selection, const std::string &command) {
+    if(selection.is_per_frame()) {
+        std::cerr << "The " << command << " command needs the same atoms in every frame;"
+                  << " select with z= instead of zframe=." << std::endl;
+        return false;
+    }
+    return true;
+}
+
+/*
+ * Export an OUTCAR as columnar NumPy arrays
+ */
+int command_export(const std::vector<std::string> &args) {
+    bool npz = false;
+    bool atom_major = false;
+    bool wrap = false;
+    bool unwrap = false;
+    size_t memory_budget = FRAME_STORE_UNLIMITED;
+    AtomSelection selection;
+    std::vector<std::string> files;
+
+    for(unsigned int i=0; i<args.size(); i++) {
+        if(args[i] == "--npz") {
+            npz = true;
+        } else if(args[i] == "--atom-major") {
+            atom_major = true;
+        } else if(args[i] == "--wrap") {
+            wrap = true;
+        } else if(args[i] == "--unwrap") {
+            unwrap = true;
+        } else if(args[i] == "--memory" && i + 1 < args.size()) {
+            memory_budget = (size_t)(atof(args[++i].c_str()) * 1024.0 * 1024.0);
+        } else if(args[i] == "--select" && i + 1 < args.size()) {
+            if(!selection.parse(args[++i])) {
+                return -1;
+            }
+        } else {
+            files.push_back(args[i]);
+        }
+    }
+
+    if(files.size() != 2) {
+        print_usage();
+        return -1;
+    }
+
+    if(!check_fixed_selection(selection, "export")) {
+        return -1;
+    }
+
+    TrajectoryReader tr;
+    tr.set_selection(selection);
+    tr.set_memory_budget(memory_budget);
+    if(!tr.read(TrajectoryReader::split_pieces(files[0]))) {
+        return -1;
+    }
+    report_seams(tr);
+
+    // frame-major .npy files are written block by block; the other outputs
+    // need all frames at once
+    if(memory_budget != FRAME_STORE_UNLIMITED && !npz && !atom_major && !unwrap) {
+        Trajectory block;
+        if(!block.save_to_npy(tr.states, files[1], memory_budget, wrap)) {
+            return -1;
+        }
+        std::cout << "Exported " << tr.states.size() << " frames of "
+                  << block.get_nr_atoms() << " atoms." << std::endl;
+        return 0;
+    }
+
+    Trajectory trajectory;
+    if(!trajectory.append(tr.states, 0, tr.states.size())) {
+        return -1;
+    }
+    tr.clear();
+
+    if(wrap) {
+        trajectory.wrap();
+    }
+    if(unwrap) {
+        trajectory.unwrap();
+    }
+
+    bool result;
+    if(npz) {
+        result = trajectory.save_to_npz(files[1] + ".npz", atom_major);
+    } else {
+        result = trajectory.save_to_npy(files[1], atom_major);
+    }
+
+    std::cout << "Exported " << trajectory.get_nr_frames() << " frames of "
+              << trajectory.get_nr_atoms() << " atoms." << std::endl;
+
+    return result ? 0 : -1;
+}
+
+/*
+ * Tabulate the optional quantities of every ionic step. The steps are
+ * streamed to the output as they are parsed; a quantity that is absent in a
+ * step is written as nan.
+ */
+int command_observables(const std::vector<std::string> &args) {
+    unsigned int mask = 0;
+    AtomSelection selection;
+    std::vector<std::string> files;
+
+    for(unsigned int i=0; i<args.size(); i++) {
+        if(args[i] == "--stress") {
+            mask |= STATE_OBSERVABLE_STRESS;
+        } else if(args[i] == "--magnetization") {
+            mask |= STATE_OBSERVABLE_MAGNETIZATION;
+        } else if(args[i] == "--md") {
+            mask |= STATE_OBSERVABLE_KINETIC;
+        } else if(args[i] == "--timing") {
+            mask |= STATE_OBSERVABLE_TIMING;
+        } else if(args[i] == "--forces") {
+            mask |= STATE_OBSERVABLE_FORCES;
+        } else if(args[i] == "--select" && i + 1 < args.size()) {
+            if(!selection.parse(args[++i])) {
+                return -1;
+            }
+        } else {
+            files.push_back(args[i]);
+        }
+    }
+
+    if(files.size() != 2) {
+        print_usage();
+        return -1;
+    }
+
+    if(mask == 0) {
+        mask = STATE_OBSERVABLE_ALL;
+    }
+
+    std::ofstream outfile(files[1].c_str());
+    if(!outfile.is_open()) {
+        std::cerr << "Cannot open " << files[1] << " for writing." << std::endl;
+        return -1;
+    }
+
+    outfile << "# step  energy[eV]";
+    if(mask & STATE_OBSERVABLE_STRESS) {
+        outfile << "  sxx[kB]  syy[kB]  szz[kB]  sxy[kB]  syz[kB]  szx[kB]";
+    }
+    if(mask & STATE_OBSERVABLE_MAGNETIZATION) {
+        outfile << "  mag[muB]";
+    }
+    if(mask & STATE_OBSERVABLE_KINETIC) {
+        outfile << "  ekin[eV]  T[K]";
+    }
+    if(mask & STATE_OBSERVABLE_TIMING) {
+        outfile << "  cpu[s]  real[s]";
+    }
+    if(mask & STATE_OBSERVABLE_FORCES) {
+        outfile << "  max|F|[eV/A]  rms|F|[eV/A]";
+    }
+    outfile << std::endl;
+
+    unsigned int nr_steps = 0;
+    TrajectoryReader tr;
+    tr.set_selection(selection);
+    tr.set_observables(mask);
+    tr.set_state_callback([&](const State &state) {
+        const StateObservables &obs = state.get_observables();
+        outfile << int2str(state.get_state_id()) << "  " << double2str2(state.get_energy(), "%.8f");
+        if(mask & STATE_OBSERVABLE_STRESS) {
+            for(unsigned int i=0; i<6; i++) {
+                outfile << "  " << (obs.available & STATE_OBSERVABLE_STRESS ? double2str2(obs.stress[i], "%.5f") : "nan");
+            }
+        }
+        if(mask & STATE_OBSERVABLE_MAGNETIZATION) {
+            outfile << "  " << (obs.available & STATE_OBSERVABLE_MAGNETIZATION ? double2str2(obs.magnetization, "%.7f") : "nan");
+        }
+        if(mask & STATE_OBSERVABLE_KINETIC) {
+            if(obs.available & STATE_OBSERVABLE_KINETIC) {
+                outfile << "  " << double2str2(obs.kinetic_energy, "%.6f") << "  " << double2str2(obs.temperature, "%.2f");
+            } else {
+                outfile << "  nan  nan";
+            }
+        }
+        if(mask & STATE_OBSERVABLE_TIMING) {
+            if(obs.available & STATE_OBSERVABLE_TIMING) {
+                outfile << "  " << double2str2(obs.cpu_time, "%.3f") << "  " << double2str2(obs.real_time, "%.3f");
+            } else {
+                outfile << "  nan  nan";
+            }
+        }
+        if(mask & STATE_OBSERVABLE_FORCES) {
+            if(obs.available & STATE_OBSERVABLE_FORCES) {
+                outfile << "  " << double2str2(obs.max_force, "%.6f") << "  " << double2str2(obs.rms_force, "%.6f");
+            } else {
+                outfile << "  nan  nan";
+            }
+        }
+        outfile << std::endl;
+        nr_steps++;
+    }, false);
+
+    if(!tr.read(TrajectoryReader::split_pieces(files[0]), 1)) {
+        return -1;
+    }
+    outfile.close();
+
+    std::cout << "Written the quantities of " << nr_steps << " ionic steps." << std::endl;
+
+    return 0;
+}
+
+/*
+ * Flag the atoms that selective dynamics fixes in all directions in the
+ * POSCAR next to <outcar>; empty when there is no such POSCAR
+ */
+std::vector<char> fixed_atoms(const std::string &outcar) {
+    const size_t slash = outcar.find_last_of('/');
+    const std::string poscar = (slash == std::string::npos ? std::string() : outcar.substr(0, slash + 1)) + "POSCAR";
+
+    std::vector<char> fixed;
+    std::vector<State> states;
+    StructureReader reader;
+    if(access(poscar.c_str(), R_OK) != 0 || !reader.read(poscar, states) || states.empty()) {
+        return fixed;
+    }
+
+    const State &state = states[0];
+    for(unsigned int i=0; i<state.atoms.size(); i++) {
+        fixed.push_back((state.atoms[i].selec_mode & ATOM_SELEC_FIX_ALL) == ATOM_SELEC_FIX_ALL);
+    }
+    return fixed;
+}
+
+/*
+ * Report the convergence of relaxations: the energy change and the force
+ * statistics of every ionic step. The OUTCARs are read in parallel; the
+ * forces are reduced while the POSITION blocks are parsed and the states
+ * are not kept, such that only the report is held in memory.
+ */
+int command_converge(const std::vector<std::string> &args) {
+    double fmax = 0.05;
+    bool exclude_fixed = false;
+    unsigned int nr_threads = 0;
+    std::vector<std::string> files;
+
+    for(unsigned int i=0; i<args.size(); i++) {
+        if(args[i] == "--fmax" && i + 1 < args.size()) {
+            fmax = atof(args[++i].c_str());
+        } else if(args[i] == "--exclude-fixed") {
+            exclude_fixed = true;
+        } else if(args[i] == "--threads" && i + 1 < args.size()) {
+            nr_threads = atoi(args[++i].c_str());
+        } else {
+            files.push_back(args[i]);
+        }
+    }
+
+    if(files.size() < 2 || fmax <= 0.0) {
+        print_usage();
+        return -1;
+    }
+    const std::string output = files.back();
+    files.pop_back();
+
+    ThreadPool pool(nr_threads);
+    std::vector<std::string> reports(files.size());
+    std::vector<std::string> summaries(files.size());
+    std::vector<char> converged(files.size(), 0);
+    pool.parallel_for(files.size(), [&](size_t f, unsigned int worker) {
+        std::string &report = reports[f];
+        unsigned int nr_steps = 0;
+        double previous = 0.0;
+        double delta = 0.0;
+        double last_force = 0.0;
+
+        VaspReader vr;
+        vr.set_observables(STATE_OBSERVABLE_FORCES);
+        std::vector<char> fixed;
+        if(exclude_fixed) {
+            fixed = fixed_atoms(files[f]);
+            vr.set_excluded_atoms(fixed);
+        }
+        vr.set_state_callback([&](const State &state) {
+            const StateObservables &obs = state.get_observables();
+            if(nr_steps == 0) {
+                report += "# " + files[f] + "\n# step  energy[eV]  dE[eV]  max|F|[eV/A]  rms|F|[eV/A]";
+                for(unsigned int i=0; i<state.get_nr_elements(); i++) {
+                    report += "  max|F|(" + state.get_elements()[i] + ")";
+                }
+                report += "\n";
+            }
+
+            delta = nr_steps == 0 ? 0.0 : state.get_energy() - previous;
+            report += int2str(state.get_state_id()) + "  " + double2str2(state.get_energy(), "%.8f") + "  " +
+                      (nr_steps == 0 ? std::string("nan") : double2str2(delta, "%.8f")) + "  " +
+                      double2str2(obs.max_force, "%.6f") + "  " + double2str2(obs.rms_force, "%.6f");
+            for(unsigned int i=0; i<obs.max_force_element.size(); i++) {
+                report += "  " + double2str2(obs.max_force_element[i], "%.6f");
+            }
+            report += "\n";
+
+            previous = state.get_energy();
+            last_force = obs.max_force;
+            nr_steps++;
+        }, false);
+
+        if(!vr.read(files[f].c_str()) || nr_steps == 0) {
+            summaries[f] = files[f] + ": no ionic steps found";
+            return;
+        }
+        report += "\n";
+
+        converged[f] = last_force <= fmax;
+        summaries[f] = files[f] + ": " + int2str(nr_steps) + " steps, max|F| = " + double2str2(last_force, "%.4f") +
+                       " eV/A, dE = " + double2str2(delta, "%.2e") + " eV, " +
+                       (converged[f] ? "converged" : "not converged");
+        if(exclude_fixed) {
+            summaries[f] += fixed.empty() ? " (no POSCAR, all atoms included)" :
+                            " (" + int2str(std::count(fixed.begin(), fixed.end(), 1)) + " fixed atoms excluded)";
+        }
+    });
+
+    std::string buffer;
+    unsigned int nr_converged = 0;
+    for(unsigned int f=0; f<files.size(); f++) {
+        buffer += reports[f];
+        std::cout << summaries[f] << std::endl;
+        nr_converged += converged[f];
+    }
+    if(!OutputSink::write_file(output, buffer)) {
+        return -1;
+    }
+
+    std::cout << nr_converged << " of " << files.size() << " relaxations converged." << std::endl;
+
+    return 0;
+}
+
+/*
+ * Validate OUTCARs: every damaged ionic step is listed as FILE:LINE. The
+ * states are only counted, such that files of any length are checked in
+ * constant memory. Returns non-zero when any file is damaged.
+ */
+int command_check(const std::vector<std::string> &args) {
+    if(args.empty()) {
+        print_usage();
+        return -1;
+    }
+
+    unsigned int nr_damaged = 0;
+    for(unsigned int f=0; f<args.size(); f++) {
+        unsigned int nr_states = 0;
+        VaspReader vr;
+        vr.set_state_callback([&](const State &state) {
+            nr_states++;
+        }, false);
+
+        if(!vr.read(args[f].c_str())) {
+            nr_damaged++;
+            continue;
+        }
+
+        const std::vector<OutcarDiagnostic> &diagnostics = vr.get_diagnostics();
+        for(unsigned int i=0; i<diagnostics.size(); i++) {
+            std::cout << args[f] << ":" << diagnostics[i].line << ": after state "
+                      << diagnostics[i].nr_states << ": " << diagnostics[i].message << std::endl;
+        }
+        std::cout << args[f] << ": " << nr_states << " states, " << diagnostics.size()
+                  << " damaged steps" << std::endl;
+
+        if(!diagnostics.empty()) {
+            nr_damaged++;
+        }
+    }
+
+    return nr_damaged == 0 ? 0 : 1;
+}
+
+/*
+ * Calculate the partial radial distribution functions of one or more
+ * OUTCARs. The frames are streamed: each frame is handed to the thread pool
+ * as soon as it has been parsed, such that parsing and analysis overlap and
+ * only a bounded number of frames is held in memory.
+ */
+int command_rdf(const std::vector<std::string> &args) {
+    double r_max = 6.0;
+    unsigned int nr_bins = 300;
+    unsigned int nr_threads = 0;
+    AtomSelection selection;
+    std::vector<std::string> files;
+
+    for(unsigned int i=0; i<args.size(); i++) {
+        if(args[i] == "--rmax" && i + 1 < args.size()) {
+            r_max = atof(args[++i].c_str());
+        } else if(args[i] == "--bins" && i + 1 < args.size()) {
+            nr_bins = atoi(args[++i].c_str());
+        } else if(args[i] == "--threads" && i + 1 < args.size()) {
+            nr_threads = atoi(args[++i].c_str());
+        } else if(args[i] == "--select" && i + 1 < args.size()) {
+            if(!selection.parse(args[++i])) {
+                return -1;
+            }
+        } else {
+            files.push_back(args[i]);
+        }
+    }
+
+    if(files.size() < 2 || r_max <= 0.0 || nr_bins == 0) {
+        print_usage();
+        return -1;
+    }
+
+    ThreadPool pool(nr_threads);
+    RadialDistribution rdf(r_max, nr_bins, pool.get_nr_threads());
+
+    // every frame is checked on this thread; after a frame with other atoms
+    // than the first, the remaining frames are ignored
+    bool consistent = true;
+    TrajectoryReader tr;
+    tr.set_selection(selection);
+    tr.set_state_callback([&](const State &state) {
+        if(!rdf.is_initialized()) {
+            rdf.initialize(state);
+        }
+        if(!consistent) {
+            return;
+        }
+        if(!rdf.accepts(state)) {
+            std::cerr << "Frame " << state.get_state_id() << " of " << state.get_filename()
+                      << " holds other atoms than the first frame." << std::endl;
+            consistent = false;
+            return;
+        }
+        std::shared_ptr<State> frame(new State(state));
+        pool.wait_for_slot(2 * pool.get_nr_threads());
+        pool.submit([&rdf, frame](unsigned int worker) {
+            rdf.add_frame(*frame, worker);
+        });
+    }, false);
+
+    bool success = true;
+    for(unsigned int i=0; success && i<files.size() - 1; i++) {
+        success = tr.read(TrajectoryReader::split_pieces(files[i]), 1);
+        tr.clear();
+    }
+    pool.wait();
+
+    if(!success) {
+        return -1;
+    }
+
+    if(!rdf.is_initialized()) {
+        std::cerr << "No frames found." << std::endl;
+        return -1;
+    }
+    if(!consistent) {
+        return -1;
+    }
+
+    std::cout << "Accumulated " << rdf.get_nr_frames() << " frames." << std::endl;
+
+    return rdf.write(files.back()) ? 0 : -1;
+}
+
+/*
+ * Classify the adsorption sites of all frames of the OUTCARs. The frames are
+ * analysed in parallel in batches, after which the lines of the batch are
+ * written in order.
+ */
+int command_sites(const std::vector<std::string> &args) {
+    double tolerance = ADSORPTION_DEFAULT_TOLERANCE;
+    unsigned int nr_threads = 0;
+    AtomSelection selection;
+    std::vector<std::string> files;
+
+    for(unsigned int i=0; i<args.size(); i++) {
+        if(args[i] == "--tolerance" && i + 1 < args.size()) {
+            tolerance = atof(args[++i].c_str());
+        } else if(args[i] == "--threads" && i + 1 < args.size()) {
+            nr_threads = atoi(args[++i].c_str());
+        } else if(args[i] == "--select" && i + 1 < args.size()) {
+            if(!selection.parse(args[++i])) {
+                return -1;
+            }
+        } else {
+            files.push_back(args[i]);
+        }
+    }
+
+    if(files.size() < 2 || tolerance < 0.0) {
+        print_usage();
+        return -1;
+    }
+
+    std::ofstream outfile(files.back().c_str());
+    if(!outfile.is_open()) {
+        std::cerr << "Cannot open " << files.back() << " for writing." << std::endl;
+        return -1;
+    }
+    outfile << "# file  frame  atom  element  site  cn  height[A]" << std::endl;
+
+    ThreadPool pool(nr_threads);
+    const AdsorptionAnalysis analysis(tolerance);
+    const size_t batch_size = 16 * pool.get_nr_threads();
+    std::vector<State> batch;
+    std::vector<std::string> labels;
+    std::vector<std::string> buffers;
+    unsigned int nr_frames = 0;
+
+    auto flush = [&]() {
+        buffers.assign(batch.size(), std::string());
+        pool.parallel_for(batch.size(), [&](size_t i, unsigned int worker) {
+            analysis.format(batch[i], labels[i], buffers[i]);
+        });
+        for(unsigned int i=0; i<buffers.size(); i++) {
+            outfile << buffers[i];
+        }
+        nr_frames += batch.size();
+        batch.clear();
+        labels.clear();
+    };
+
+    TrajectoryReader tr;
+    tr.set_selection(selection);
+    for(unsigned int f=0; f<files.size() - 1; f++) {
+        tr.set_state_callback([&](const State &state) {
+            batch.push_back(state);
+            labels.push_back(files[f] + "  " + int2str(state.get_state_id()));
+            if(batch.size() >= batch_size) {
+                flush();
+            }
+        }, false);
+        if(!tr.read(TrajectoryReader::split_pieces(files[f]), 1)) {
+            return -1;
+        }
+        tr.clear();
+    }
+    flush();
+    outfile.close();
+
+    std::cout << "Analysed " << nr_frames << " frames." << std::endl;
+
+    return 0;
+}
+
+/*
+ * Calculate the mean squared displacement and the velocity autocorrelation
+ * function per element. The frames of an OUTCAR are streamed directly into
+ * a Trajectory, such that no States are retained; with a memory budget, the
+ * frames are kept in a FrameStore instead and the time series are gathered
+ * from it per block of atoms.
+ */
+int command_msd(const std::vector<std::string> &args) {
+    double timestep = 1.0;
+    size_t memory_budget = FRAME_STORE_UNLIMITED;
+    unsigned int nr_threads = 0;
+    std::string cache;
+    AtomSelection selection;
+    std::vector<std::string> files;
+
+    for(unsigned int i=0; i<args.size(); i++) {
+        if(args[i] == "--dt" && i + 1 < args.size()) {
+            timestep = atof(args[++i].c_str());
+        } else if(args[i] == "--threads" && i + 1 < args.size()) {
+            nr_threads = atoi(args[++i].c_str());
+        } else if(args[i] == "--cache" && i + 1 < args.size()) {
+            cache = args[++i];
+        } else if(args[i] == "--memory" && i + 1 < args.size()) {
+            memory_budget = (size_t)(atof(args[++i].c_str()) * 1024.0 * 1024.0);
+        } else if(args[i] == "--select" && i + 1 < args.size()) {
+            if(!selection.parse(args[++i])) {
+                return -1;
+            }
+        } else {
+            files.push_back(args[i]);
+        }
+    }
+
+    if(files.size() != (cache.empty() ? 2 : 1) || timestep <= 0.0) {
+        print_usage();
+        return -1;
+    }
+
+    if(!check_fixed_selection(selection, "msd")) {
+        return -1;
+    }
+
+    ThreadPool pool(nr_threads);
+    CorrelationAnalysis analysis(timestep);
+    Trajectory trajectory;
+    TrajectoryReader tr;
+    const bool stored = cache.empty() && memory_budget != FRAME_STORE_UNLIMITED;
+    if(cache.empty()) {
+        bool consistent = true;
+        tr.set_selection(selection);
+        if(stored) {
+            tr.set_memory_budget(memory_budget);
+        } else {
+            tr.set_state_callback([&](const State &state) {
+                consistent = consistent && trajectory.append(state);
+            }, false);
+        }
+        if(!tr.read(TrajectoryReader::split_pieces(files[0]), nr_threads) || !consistent) {
+            return -1;
+        }
+        report_seams(tr);
+    } else if(!trajectory.load_from_npy(cache)) {
+        return -1;
+    }
+
+    if(!(stored ? analysis.calculate(tr.states, memory_budget, pool) : analysis.calculate(trajectory, pool))) {
+        return -1;
+    }
+
+    for(unsigned int e=0; e<analysis.get_nr_elements(); e++) {
+        std::cout << "D(" << analysis.get_elements()[e] << ") = "
+                  << analysis.get_diffusion_coefficient(e) << " cm^2/s" << std::endl;
+    }
+
+    return analysis.write(files.back()) ? 0 : -1;
+}
+
+/*
+ * Convert a 1-based frame number (negative numbers count from the end) into
+ * an index; returns false when the frame does not exist
+ */
+bool frame_index(int frame, unsigned int nr_frames, unsigned int *index) {
+    if(frame > 0 && (unsigned int)frame <= nr_frames) {
+        *index = frame - 1;
+        return true;
+    }
+    if(frame < 0 && (unsigned int)(-frame) <= nr_frames) {
+        *index = nr_frames + frame;
+        return true;
+    }
+    return false;
+}
+
+/*
+ * Read the frames of an OUTCAR (or of the comma-separated pieces of a
+ * trajectory), or the structure of a POSCAR/CONTCAR or CIF file (recognized
+ * by its name)
+ */
+bool load_frames(const std::string &filename, std::vector<State> &states) {
+    if(StructureReader::detect_format(filename) != STRUCTURE_FORMAT_UNKNOWN) {
+        StructureReader reader;
+        return reader.read(filename, states);
+    }
+
+    TrajectoryReader tr;
+    if(!tr.read(TrajectoryReader::split_pieces(filename), 1)) {
+        return false;
+    }
+    for(unsigned int i=0; i<tr.states.size(); i++) {
+        states.push_back(tr.states[i]);
+    }
+    return true;
+}
+
+/*
+ * Keep only the atoms of <state> in <selection>, which is resolved on
+ * <state> itself (a first-frame z-window on its positions); elements left
+ * without atoms are dropped, as in the frames of an OUTCAR that is read
+ * with the selection
+ */
+State select_atoms(const State &state, AtomSelection selection) {
+    if(!selection.is_active()) {
+        return state;
+    }
+    selection.resolve(state.get_elements(), state.get_nr_atoms_per_element(), state.atoms);
+
+    std::vector<Atom> atoms;
+    std::vector<std::string> elements;
+    std::vector<unsigned int> elements_uint;
+    std::vector<unsigned int> counts;
+    unsigned int index = 0;
+    for(unsigned int i=0; i<state.get_nr_elements(); i++) {
+        unsigned int count = 0;
+        for(unsigned int j=0; j<state.get_atoms_for_element(i) && index<state.atoms.size(); j++, index++) {
+            if(selection.is_selected(index)) {
+                atoms.push_back(state.atoms[index]);
+                count++;
+            }
+        }
+        if(count > 0) {
+            elements.push_back(state.get_elements()[i]);
+            elements_uint.push_back(state.get_elements_uint()[i]);
+            counts.push_back(count);
+        }
+    }
+
+    std::vector<Real> dimensions(9);
+    for(unsigned int i=0; i<3; i++) {
+        for(unsigned int j=0; j<3; j++) {
+            dimensions[i*3+j] = state.dimensions(i,j);
+        }
+    }
+
+    return State(state.get_energy(), dimensions, atoms, elements, elements_uint, counts,
+                 state.get_filename(), state.get_state_id());
+}
+
+/*
+ * Calculate the RMSD of all frames with respect to a reference frame. The
+ * frames are taken from the FrameStore of the reader in blocks that fit in
+ * the memory budget, and every block is written before the next is taken.
+ */
+int command_rmsd(const std::vector<std::string> &args) {
+    int ref = 1;
+    std::string ref_file;
+    bool periodic = true;
+    unsigned int align = RMSD_ALIGN_KABSCH;
+    size_t memory_budget = FRAME_STORE_UNLIMITED;
+    unsigned int nr_threads = 0;
+    AtomSelection selection;
+    std::vector<std::string> files;
+
+    for(unsigned int i=0; i<args.size(); i++) {
+        if(args[i] == "--ref" && i + 1 < args.size()) {
+            ref = atoi(args[++i].c_str());
+        } else if(args[i] == "--ref-file" && i + 1 < args.size()) {
+            ref_file = args[++i];
+        } else if(args[i] == "--no-pbc") {
+            periodic = false;
+        } else if(args[i] == "--no-align") {
+            align = RMSD_ALIGN_NONE;
+        } else if(args[i] == "--memory" && i + 1 < args.size()) {
+            memory_budget = (size_t)(atof(args[++i].c_str()) * 1024.0 * 1024.0);
+        } else if(args[i] == "--threads" && i + 1 < args.size()) {
+            nr_threads = atoi(args[++i].c_str());
+        } else if(args[i] == "--select" && i + 1 < args.size()) {
+            if(!selection.parse(args[++i])) {
+                return -1;
+            }
+        } else {
+            files.push_back(args[i]);
+        }
+    }
+
+    if(files.size() != 2) {
+        print_usage();
+        return -1;
+    }
+
+    if(!check_fixed_selection(selection, "rmsd")) {
+        return -1;
+    }
+
+    TrajectoryReader tr;
+    tr.set_selection(selection);
+    tr.set_memory_budget(memory_budget);
+    if(!tr.read(TrajectoryReader::split_pieces(files[0]), nr_threads)) {
+        return -1;
+    }
+    report_seams(tr);
+    const unsigned int nr_frames = tr.states.size();
+
+    // the reference frame, from the reference file or from the trajectory
+    Trajectory reference;
+    unsigned int ref_index = 0;
+    if(!ref_file.empty()) {
+        std::vector<State> ref_states;
+        if(!load_frames(ref_file, ref_states)) {
+            return -1;
+        }
+        // the reference is reduced to the atoms that are kept of the trajectory
+        if(frame_index(ref, ref_states.size(), &ref_index)) {
+            reference.append(select_atoms(ref_states[ref_index], selection));
+        }
+    } else if(frame_index(ref, nr_frames, &ref_index)) {
+        reference.append(tr.states, ref_index, 1);
+    }
+
+    if(reference.get_nr_frames() == 0) {
+        std::cerr << "Reference frame " << ref << " does not exist." << std::endl;
+        return -1;
+    }
+    Trajectory block;
+    block.append(tr.states, 0, 1);
+    if(reference.get_nr_atoms() != block.get_nr_atoms()) {
+        std::cerr << "The reference holds " << reference.get_nr_atoms() << " atoms instead of "
+                  << block.get_nr_atoms() << "." << std::endl;
+        return -1;
+    }
+    // the atoms are compared in order, hence also their elements need to match
+    if(reference.get_elements() != block.get_elements() ||
+       reference.get_nr_atoms_per_element() != block.get_nr_atoms_per_element()) {
+        std::cerr << "The elements of the reference differ from those of " << files[0] << "." << std::endl;
+        return -1;
+    }
+
+    std::ofstream outfile(files[1].c_str());
+    if(!outfile.is_open()) {
+        std::cerr << "Cannot open " << files[1] << " for writing." << std::endl;
+        return -1;
+    }
+    outfile << "# frame  energy[eV]  rmsd[A]" << std::endl;
+
+    ThreadPool pool(nr_threads);
+    RmsdAnalysis analysis(align, periodic);
+    const size_t frames_per_block = Trajectory::frames_per_block(memory_budget, reference.get_nr_atoms());
+    for(size_t first=0; first<nr_frames; first += frames_per_block) {
+        block.clear();
+        if(!block.append(tr.states, first, frames_per_block)) {
+            return -1;
+        }
+        std::vector<double> rmsd = analysis.all_vs_reference(block, reference.get_positions(0), pool);
+
+        for(unsigned int f=0; f<rmsd.size(); f++) {
+            outfile << (first + f + 1) << "  " << double2str2(block.get_energies()[f], "%14.6f")
+                    << "  " << double2str2(rmsd[f], "%10.6f") << std::endl;
+        }
+    }
+    outfile.close();
+
+    return 0;
+}
+
+/*
+ * Write the frames that differ by at least a threshold RMSD from all frames
+ * written before them as POSCAR files. The frames are taken from the
+ * FrameStore of the reader in blocks that fit in the memory budget; the
+ * positions of the retained frames are kept throughout.
+ */
+int command_dedup(const std::vector<std::string> &args) {
+    double threshold = 0.1;
+    bool periodic = true;
+    unsigned int align = RMSD_ALIGN_KABSCH;
+    bool compress = false;
+    size_t memory_budget = FRAME_STORE_UNLIMITED;
+    unsigned int nr_threads = 0;
+    AtomSelection selection;
+    std::vector<std::string> files;
+
+    for(unsigned int i=0; i<args.size(); i++) {
+        if(args[i] == "--threshold" && i + 1 < args.size()) {
+            threshold = atof(args[++i].c_str());
+        } else if(args[i] == "--no-pbc") {
+            periodic = false;
+        } else if(args[i] == "--no-align") {
+            align = RMSD_ALIGN_NONE;
+        } else if(args[i] == "--gzip") {
+            compress = true;
+        } else if(args[i] == "--memory" && i + 1 < args.size()) {
+            memory_budget = (size_t)(atof(args[++i].c_str()) * 1024.0 * 1024.0);
+        } else if(args[i] == "--threads" && i + 1 < args.size()) {
+            nr_threads = atoi(args[++i].c_str());
+        } else if(args[i] == "--select" && i + 1 < args.size()) {
+            if(!selection.parse(args[++i])) {
+                return -1;
+            }
+        } else {
+            files.push_back(args[i]);
+        }
+    }
+
+    if(files.size() != 2) {
+        print_usage();
+        return -1;
+    }
+
+    if(!check_fixed_selection(selection, "dedup")) {
+        return -1;
+    }
+
+    TrajectoryReader tr;
+    tr.set_selection(selection);
+    tr.set_memory_budget(memory_budget);
+    if(!tr.read(TrajectoryReader::split_pieces(files[0]), nr_threads)) {
+        return -1;
+    }
+    report_seams(tr);
+    const unsigned int nr_frames = tr.states.size();
+
+    ThreadPool pool(nr_threads);
+    RmsdAnalysis analysis(align, periodic);
+    std::vector<float> representatives;
+    std::vector<unsigned int> kept;
+    Trajectory block;
+    block.append(tr.states, 0, 1);
+    const size_t frames_per_block = Trajectory::frames_per_block(memory_budget, block.get_nr_atoms());
+    for(size_t first=0; first<nr_frames; first += frames_per_block) {
+        block.clear();
+        if(!block.append(tr.states, first, frames_per_block)) {
+            return -1;
+        }
+        analysis.deduplicate(block, first, threshold, representatives, kept, pool);
+    }
+
+    unsigned int count = 0;
+    if(!kept.empty()) {
+        PoscarWriter writer(tr.states[0]);
+        count = writer.write_frames(tr.states, kept, files[1], files[0], pool, compress);
+    }
+
+    std::cout << "Retained " << kept.size() << " of " << nr_frames << " frames." << std::endl;
+
+    return count == kept.size() ? 0 : -1;
+}
+
+/*
+ * Write the frames of an OUTCAR as POSCAR files
+ */
+int command_frames(const std::vector<std::string> &args) {
+    unsigned int every = 1;
+    bool is_vasp5 = true;
+    bool compress = false;
+    unsigned int nr_threads = 0;
+    size_t memory_budget = FRAME_STORE_UNLIMITED;
+    AtomSelection selection;
+    std::vector<std::string> files;
+
+    for(unsigned int i=0; i<args.size(); i++) {
+        if(args[i] == "--every" && i + 1 < args.size()) {
+            every = atoi(args[++i].c_str());
+        } else if(args[i] == "--vasp4") {
+            is_vasp5 = false;
+        } else if(args[i] == "--gzip") {
+            compress = true;
+        } else if(args[i] == "--memory" && i + 1 < args.size()) {
+            memory_budget = (size_t)(atof(args[++i].c_str()) * 1024.0 * 1024.0);
+        } else if(args[i] == "--threads" && i + 1 < args.size()) {
+            nr_threads = atoi(args[++i].c_str());
+        } else if(args[i] == "--select" && i + 1 < args.size()) {
+            if(!selection.parse(args[++i])) {
+                return -1;
+            }
+        } else {
+            files.push_back(args[i]);
+        }
+    }
+
+    if(files.size() != 2 || every == 0) {
+        print_usage();
+        return -1;
+    }
+
+    if(!check_fixed_selection(selection, "frames")) {
+        return -1;
+    }
+
+    TrajectoryReader tr;
+    tr.set_selection(selection);
+    tr.set_memory_budget(memory_budget);
+    if(!tr.read(TrajectoryReader::split_pieces(files[0]), nr_threads)) {
+        return -1;
+    }
+    report_seams(tr);
+    if(tr.states.empty()) {
+        std::cerr << "No states found in " << files[0] << std::endl;
+        return -1;
+    }
+
+    std::vector<unsigned int> frames;
+    for(unsigned int f=0; f<tr.states.size(); f += every) {
+        frames.push_back(f);
+    }
+
+    ThreadPool pool(nr_threads);
+    PoscarWriter writer(tr.states[0], is_vasp5);
+    const unsigned int count = writer.write_frames(tr.states, frames, files[1], files[0], pool, compress);
+
+    std::cout << "Written " << count << " of " << tr.states.size() << " frames." << std::endl;
+
+    return count == frames.size() ? 0 : -1;
+}
+
+/*
+ * Write a frame of each input file as CIF file; structure files are read,
+ * analysed and written in parallel
+ */
+int command_cif(const std::vector<std::string> &args) {
+    int frame = -1;
+    unsigned int nr_threads = 0;
+    bool symmetry = false;
+    bool compress = false;
+    double tolerance = SYMMETRY_DEFAULT_TOLERANCE;
+    std::string outdir = ".";
+    std::vector<std::string> files;
+
+    for(unsigned int i=0; i<args.size(); i++) {
+        if(args[i] == "--frame" && i + 1 < args.size()) {
+            frame = atoi(args[++i].c_str());
+        } else if(args[i] == "--threads" && i + 1 < args.size()) {
+            nr_threads = atoi(args[++i].c_str());
+        } else if(args[i] == "-o" && i + 1 < args.size()) {
+            outdir = args[++i];
+        } else if(args[i] == "--symmetry") {
+            symmetry = true;
+        } else if(args[i] == "--symprec" && i + 1 < args.size()) {
+            tolerance = atof(args[++i].c_str());
+        } else if(args[i] == "--gzip") {
+            compress = true;
+        } else {
+            files.push_back(args[i]);
+        }
+    }
+
+    if(files.empty() || tolerance <= 0.0) {
+        print_usage();
+        return -1;
+    }
+
+    ThreadPool pool(nr_threads);
+    std::vector<std::vector<State> > frames(files.size());
+    std::vector<char> success(files.size(), 0);
+    std::vector<char> written(files.size(), 0);
+    const CifWriter writer(symmetry, tolerance);
+    pool.parallel_for(files.size(), [&](size_t i, unsigned int worker) {
+        unsigned int index = 0;
+        success[i] = load_frames(files[i], frames[i]) && frame_index(frame, frames[i].size(), &index);
+        if(!success[i]) {
+            return;
+        }
+
+        const size_t slash = files[i].find_last_of('/');
+        const std::string base = slash == std::string::npos ? files[i] : files[i].substr(slash + 1);
+        written[i] = writer.write(frames[i][index], outdir + "/" + base + (compress ? ".cif.gz" : ".cif"), base);
+        frames[i].clear();
+    });
+
+    unsigned int count = 0;
+    for(unsigned int i=0; i<files.size(); i++) {
+        if(!success[i]) {
+            std::cerr << "Skipping " << files[i] << std::endl;
+        } else if(written[i]) {
+            count++;
+        }
+    }
+
+    std::cout << "Written " << count << " of " << files.size() << " files." << std::endl;
+
+    return count == files.size() ? 0 : -1;
+}
+
+/*
+ * Write a supercell of a frame of an OUTCAR, POSCAR or CIF file as POSCAR,
+ * or as CIF when the output file name ends in .cif; names ending in .gz are
+ * compressed using all threads
+ */
+int command_supercell(const std::vector<std::string> &args) {
+    int frame = -1;
+    bool wrap = false;
+    unsigned int nr_threads = 0;
+    std::vector<std::string> files;
+
+    for(unsigned int i=0; i<args.size(); i++) {
+        if(args[i] == "--frame" && i + 1 < args.size()) {
+            frame = atoi(args[++i].c_str());
+        } else if(args[i] == "--wrap") {
+            wrap = true;
+        } else if(args[i] == "--threads" && i + 1 < args.size()) {
+            nr_threads = atoi(args[++i].c_str());
+        } else {
+            files.push_back(args[i]);
+        }
+    }
+
+    if(files.size() != 5) {
+        print_usage();
+        return -1;
+    }
+
+    const int na = atoi(files[0].c_str());
+    const int nb = atoi(files[1].c_str());
+    const int nc = atoi(files[2].c_str());
+    if(na <= 0 || nb <= 0 || nc <= 0) {
+        print_usage();
+        return -1;
+    }
+
+    std::vector<State> states;
+    unsigned int index = 0;
+    if(!load_frames(files[3], states) || !frame_index(frame, states.size(), &index)) {
+        std::cerr << "Cannot read frame " << frame << " of " << files[3] << std::endl;
+        return -1;
+    }
+
+    if(wrap) {
+        CellTransform::wrap(states[index]);
+    }
+    const State supercell = CellTransform::supercell(states[index], na, nb, nc);
+
+    const std::string &output = files[4];
+    const std::string name = files[3] + " " + files[0] + "x" + files[1] + "x" + files[2];
+    const std::string format = OutputSink::is_compressed_name(output) ? output.substr(0, output.size() - 3) : output;
+    bool result;
+    if(format.size() > 4 && format.compare(format.size() - 4, 4, ".cif") == 0) {
+        CifWriter writer;
+        result = writer.write(supercell, output, name, nr_threads);
+    } else {
+        PoscarWriter writer(supercell);
+        result = writer.write(supercell, output, name, nr_threads);
+    }
+
+    if(!result) {
+        std::cerr << "Cannot write " << output << std::endl;
+        return -1;
+    }
+
+    std::cout << "Written a supercell of " << supercell.get_total_nr_atoms() << " atoms." << std::endl;
+
+    return 0;
+}
+
+/*
+ * Results and timings [ms per call] of the geometry kernels in one precision
+ */
+template<typename T>
+struct KernelBenchmark {
+    MatrixX3T<T> frac;
+    Eigen::Matrix<T, Eigen::Dynamic, 1> d2;
+    Vector3T<T> center;
+    double time_frac;
+    double time_distances;
+    double time_center;
+};
+
+/*
+ * Average time [ms] of <repeat> calls of <kernel>
+ */
+template<typename F>
+double time_kernel(unsigned int repeat, F kernel) {
+    const auto start = std::chrono::steady_clock::now();
+    for(unsigned int r=0; r<repeat; r++) {
+        kernel();
+    }
+    const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count() / repeat;
+}
+
+/*
+ * Run the geometry kernels <repeat> times in scalar type T on the positions
+ * <a> and <b> in <cell>
+ */
+template<typename T>
+KernelBenchmark<T> run_kernels(const Eigen::Matrix3d &cell, const MatrixX3T<double> &a, const MatrixX3T<double> &b,
+                               unsigned int repeat) {
+    const Matrix3T<T> lattice = cell.cast<T>();
+    const MatrixX3T<T> pa = a.cast<T>();
+    const MatrixX3T<T> pb = b.cast<T>();
+
+    KernelBenchmark<T> result;
+    result.time_frac = time_kernel(repeat, [&]() {
+        Geometry::to_fractional(lattice, pa, result.frac);
+    });
+    result.time_distances = time_kernel(repeat, [&]() {
+        Geometry::minimum_image_distances(lattice, pa, pb, result.d2);
+    });
+    result.time_center = time_kernel(repeat, [&]() {
+        result.center = Geometry::centroid(pa);
+    });
+
+    return result;
+}
+
+/*
+ * Compare the geometry kernels in single and double precision on a
+ * supercell; the second set of positions is the first one shifted by a
+ * lattice vector and displaced by up to 0.1 A, such that the minimum image
+ * is needed
+ */
+int command_benchmark(const std::vector<std::string> &args) {
+    int frame = -1;
+    unsigned int repeat = 100;
+    std::vector<std::string> files;
+
+    for(unsigned int i=0; i<args.size(); i++) {
+        if(args[i] == "--frame" && i + 1 < args.size()) {
+            frame = atoi(args[++i].c_str());
+        } else if(args[i] == "--repeat" && i + 1 < args.size()) {
+            repeat = std::max(1, atoi(args[++i].c_str()));
+        } else {
+            files.push_back(args[i]);
+        }
+    }
+
+    if(files.size() != 4) {
+        print_usage();
+        return -1;
+    }
+
+    const int na = atoi(files[0].c_str());
+    const int nb = atoi(files[1].c_str());
+    const int nc = atoi(files[2].c_str());
+    if(na <= 0 || nb <= 0 || nc <= 0) {
+        print_usage();
+        return -1;
+    }
+
+    std::vector<State> states;
+    unsigned int index = 0;
+    if(!load_frames(files[3], states) || !frame_index(frame, states.size(), &index)) {
+        std::cerr << "Cannot read frame " << frame << " of " << files[3] << std::endl;
+        return -1;
+    }
+
+    const State supercell = CellTransform::supercell(states[index], na, nb, nc);
+    const unsigned int n = supercell.get_total_nr_atoms();
+    if(n == 0) {
+        std::cerr << files[3] << " holds no atoms." << std::endl;
+        return -1;
+    }
+
+    const Eigen::Matrix3d cell = supercell.dimensions.cast<double>();
+    const MatrixX3T<double> a = supercell.coordinates.leftCols<3>().cast<double>();
+    MatrixX3T<double> b = a.rowwise() + cell.row(0);
+    for(unsigned int i=0; i<n; i++) {
+        for(unsigned int k=0; k<3; k++) {
+            b(i,k) += 0.1 * std::sin(3.0 * i + k);
+        }
+    }
+
+    const KernelBenchmark<float> sp = run_kernels<float>(cell, a, b, repeat);
+    const KernelBenchmark<double> dp = run_kernels<double>(cell, a, b, repeat);
+
+    // deviations in A: fractional coordinates are mapped back onto the cell
+    MatrixX3T<double> dev;
+    Geometry::to_cartesian(cell, (sp.frac.cast<double>() - dp.frac).eval(), dev);
+    const double dev_frac = dev.rowwise().norm().maxCoeff();
+    const double dev_distances = (sp.d2.cast<double>().cwiseSqrt() - dp.d2.cwiseSqrt()).cwiseAbs().maxCoeff();
+    const double dev_center = (sp.center.cast<double>() - dp.center).norm();
+
+    std::cout << "Benchmark on " << n << " atoms (" << na << "x" << nb << "x" << nc << " supercell of "
+              << files[3] << "), " << repeat << " repetitions; this build uses "
+              << (sizeof(Real) == sizeof(float) ? "single" : "double") << " precision." << std::endl;
+    std::cout << "kernel                     float [ms]  double [ms]  speedup  max. deviation [A]" << std::endl;
+    std::cout << "fractional coordinates  " << double2str2(sp.time_frac, "%13.4f") << double2str2(dp.time_frac, "%13.4f")
+              << double2str2(dp.time_frac / sp.time_frac, "%9.2f") << double2str2(dev_frac, "%20.3e") << std::endl;
+    std::cout << "minimum image distances " << double2str2(sp.time_distances, "%13.4f")
+              << double2str2(dp.time_distances, "%13.4f") << double2str2(dp.time_distances / sp.time_distances, "%9.2f")
+              << double2str2(dev_distances, "%20.3e") << std::endl;
+    std::cout << "centroid                " << double2str2(sp.time_center, "%13.4f") << double2str2(dp.time_center, "%13.4f")
+              << double2str2(dp.time_center / sp.time_center, "%9.2f") << double2str2(dev_center, "%20.3e") << std::endl;
+
+    return 0;
+}
+
+/*
+ * Export frames of an OUTCAR, POSCAR or CIF file as binary glTF or PLY
+ * scene, depending on the extension of the output file
+ */
+int command_scene(const std::vector<std::string> &args) {
+    int frame = -1;
+    bool all = false;
+    unsigned int every = 1;
+    bool bonds = true;
+    double fps = SCENE_DEFAULT_FPS;
+    std::vector<std::string> files;
+
+    for(unsigned int i=0; i<args.size(); i++) {
+        if(args[i] == "--frame" && i + 1 < args.size()) {
+            frame = atoi(args[++i].c_str());
+        } else if(args[i] == "--all") {
+            all = true;
+        } else if(args[i] == "--every" && i + 1 < args.size()) {
+            every = atoi(args[++i].c_str());
+        } else if(args[i] == "--fps" && i + 1 < args.size()) {
+            fps = atof(args[++i].c_str());
+        } else if(args[i] == "--no-bonds") {
+            bonds = false;
+        } else {
+            files.push_back(args[i]);
+        }
+    }
+
+    if(files.size() != 2 || every == 0 || fps <= 0.0) {
+        print_usage();
+        return -1;
+    }
+
+    const std::string &output = files[1];
+    const std::string format = OutputSink::is_compressed_name(output) ? output.substr(0, output.size() - 3) : output;
+    const bool is_ply = format.size() > 4 && format.compare(format.size() - 4, 4, ".ply") == 0;
+    const bool is_gltf = format.size() > 4 && format.compare(format.size() - 4, 4, ".glb") == 0;
+    if(!is_ply && !is_gltf) {
+        std::cerr << "The output file should end in .glb or .ply (optionally followed by .gz)" << std::endl;
+        return -1;
+    }
+
+    std::vector<State> states;
+    unsigned int index = 0;
+    if(!load_frames(files[0], states) || states.empty() || (!all && !frame_index(frame, states.size(), &index))) {
+        std::cerr << "Cannot read frame " << frame << " of " << files[0] << std::endl;
+        return -1;
+    }
+
+    std::vector<State> frames;
+    if(all) {
+        for(unsigned int f=0; f<states.size(); f += every) {
+            frames.push_back(states[f]);
+        }
+    } else {
+        frames.push_back(states[index]);
+    }
+    states.clear();
+
+    const SceneWriter writer(bonds, fps);
+    bool result;
+    if(is_ply) {
+        if(frames.size() > 1) {
+            std::cerr << "PLY files hold a single frame; writing the first one." << std::endl;
+        }
+        result = writer.write_ply(frames[0], output);
+    } else {
+        result = writer.write_gltf(frames, output);
+    }
+
+    if(!result) {
+        std::cerr << "Cannot write " << output << std::endl;
+        return -1;
+    }
+
+    std::cout << "Written " << frames.size() << " frame(s) of " << frames[0].get_total_nr_atoms() << " atoms." << std::endl;
 
-int main() {
     return 0;
 }
+
+/*
+ * Output file of a state: the path of the source file with the directory
+ * separators replaced, followed by the state index
+ */
+std::string poscar_name(const std::string &source, unsigned int state_id, bool compress) {
+    std::string name = source;
+    std::replace(name.begin(), name.end(), '/', '_');
+    return name + "_" + int2str(state_id) + (compress ? ".POSCAR.gz" : ".POSCAR");
+}
+
+/*
+ * Make <filename> a symbolic link to <target>, the file written for the
+ * first copy of a structure. The link is relative when both are in the same
+ * directory and absolute otherwise. An existing link is replaced, but a
+ * regular file is never removed.
+ */
+bool link_duplicate(const std::string &filename, const std::string &target) {
+    char resolved[PATH_MAX];
+    if(realpath(target.c_str(), resolved) == NULL) {
+        std::cerr << "Cannot link " << filename << ": " << target << " does not exist." << std::endl;
+        return false;
+    }
+    const std::string absolute_target(resolved);
+
+    const size_t slash = filename.find_last_of('/');
+    const std::string directory = slash == std::string::npos ? "." : filename.substr(0, slash);
+    const std::string name = slash == std::string::npos ? filename : filename.substr(slash + 1);
+    if(realpath(directory.c_str(), resolved) == NULL) {
+        std::cerr << "Cannot link " << filename << ": " << directory << " does not exist." << std::endl;
+        return false;
+    }
+    const std::string absolute_directory = std::string(resolved) + "/";
+    if(absolute_target == absolute_directory + name) {
+        return true;
+    }
+
+    struct stat info;
+    if(lstat(filename.c_str(), &info) == 0) {
+        if(!S_ISLNK(info.st_mode)) {
+            std::cerr << "Not replacing " << filename << " by a link: it is not a link." << std::endl;
+            return false;
+        }
+        unlink(filename.c_str());
+    }
+
+    const bool same_directory = absolute_target.compare(0, absolute_directory.size(), absolute_directory) == 0 &&
+                                absolute_target.find('/', absolute_directory.size()) == std::string::npos;
+    const std::string link_target = same_directory ? absolute_target.substr(absolute_directory.size()) : absolute_target;
+    if(symlink(link_target.c_str(), filename.c_str()) != 0) {
+        std::cerr << "Cannot create link " << filename << std::endl;
+        return false;
+    }
+    return true;
+}
+
+/*
+ * Convert the states of many OUTCARs to POSCAR files, skipping (or linking)
+ * structures that have been converted before according to their fingerprint
+ */
+int command_convert(const std::vector<std::string> &args) {
+    bool all = false;
+    bool link = false;
+    bool compress = false;
+    double tolerance = 0.05;
+    unsigned int nr_threads = 0;
+    unsigned int queue_depth = PREFETCH_DEFAULT_QUEUE_DEPTH;
+    size_t memory_budget = FRAME_STORE_UNLIMITED;
+    std::string index_file;
+    std::string cache_file;
+    std::string outdir = ".";
+    std::vector<std::string> files;
+
+    for(unsigned int i=0; i<args.size(); i++) {
+        if(args[i] == "--all") {
+            all = true;
+        } else if(args[i] == "--link") {
+            link = true;
+        } else if(args[i] == "--gzip") {
+            compress = true;
+        } else if(args[i] == "--index" && i + 1 < args.size()) {
+            index_file = args[++i];
+        } else if(args[i] == "--cache" && i + 1 < args.size()) {
+            cache_file = args[++i];
+        } else if(args[i] == "--tolerance" && i + 1 < args.size()) {
+            tolerance = atof(args[++i].c_str());
+        } else if(args[i] == "--queue-depth" && i + 1 < args.size()) {
+            queue_depth = atoi(args[++i].c_str());
+        } else if(args[i] == "--memory" && i + 1 < args.size()) {
+            memory_budget = (size_t)(atof(args[++i].c_str()) * 1024.0 * 1024.0);
+        } else if(args[i] == "--threads" && i + 1 < args.size()) {
+            nr_threads = atoi(args[++i].c_str());
+        } else if(args[i] == "-o" && i + 1 < args.size()) {
+            outdir = args[++i];
+        } else {
+            files.push_back(args[i]);
+        }
+    }
+
+    if(files.empty() || tolerance <= 0.0) {
+        print_usage();
+        return -1;
+    }
+
+    Fingerprint fingerprint(tolerance);
+    FingerprintIndex index(fingerprint);
+    if(!index_file.empty() && !index.open(index_file)) {
+        return -1;
+    }
+
+    ConversionCache cache;
+    if(!cache_file.empty() && !cache.open(cache_file)) {
+        return -1;
+    }
+
+    ThreadPool pool(nr_threads);
+    unsigned int nr_written = 0;
+    unsigned int nr_duplicates = 0;
+    unsigned int nr_converted = 0;
+    unsigned int nr_unchanged = 0;
+    unsigned int nr_failed = 0;
+
+    // the files that are read from the start are prefetched in order
+    std::vector<unsigned int> status(files.size(), CONVERSION_CACHE_NEW);
+    std::vector<OutcarCheckpoint> checkpoints(files.size());
+    std::vector<std::string> prefetch_files;
+    for(unsigned int f=0; f<files.size(); f++) {
+        if(!cache_file.empty()) {
+            status[f] = cache.check(files[f], &checkpoints[f]);
+        }
+        if(status[f] == CONVERSION_CACHE_NEW) {
+            prefetch_files.push_back(files[f]);
+        }
+    }
+    PrefetchReader prefetch(prefetch_files, queue_depth);
+
+    for(unsigned int f=0; f<files.size(); f++) {
+        VaspReader vr;
+        vr.set_memory_budget(memory_budget);
+        if(status[f] == CONVERSION_CACHE_UNCHANGED) {
+            nr_unchanged++;
+            continue;
+        } else if(status[f] == CONVERSION_CACHE_APPENDED) {
+            vr.resume(files[f].c_str(), checkpoints[f]);
+        } else {
+            prefetch.next_file();
+            PrefetchStreamBuf buffer(&prefetch);
+            std::istream infile(&buffer);
+            vr.read(infile, files[f].c_str());
+        }
+
+        if(!vr.get_diagnostics().empty()) {
+            std::cerr << "Skipped " << vr.get_diagnostics().size() << " damaged steps in " << files[f]
+                      << " (see v2c check)" << std::endl;
+        }
+
+        if(vr.states.empty()) {
+            if(status[f] != CONVERSION_CACHE_APPENDED) {
+                std::cerr << "No states found in " << files[f] << std::endl;
+            }
+            if(!cache_file.empty()) {
+                cache.update(files[f], vr.get_checkpoint());
+            }
+            continue;
+        }
+
+        const unsigned int first = all ? 0 : vr.states.size() - 1;
+        const unsigned int count = vr.states.size() - first;
+        std::vector<uint64_t> fingerprints(count);
+        std::vector<State> buffers(pool.get_nr_threads(), State(0.0, Matrix3::Zero()));
+        pool.parallel_for(count, [&](size_t i, unsigned int worker) {
+            fingerprints[i] = fingerprint.calculate(vr.states.get(first + i, buffers[worker]));
+        });
+
+        // the new structures are determined in order; a structure that occurs
+        // again in this file is linked to its first copy once that is written
+        std::vector<unsigned int> pending;
+        std::vector<std::string> filenames(count);
+        std::unordered_map<uint64_t, unsigned int> pending_index;
+        std::vector<std::pair<unsigned int, unsigned int> > pending_links;
+        for(unsigned int i=0; i<count; i++) {
+            const State &state = vr.states.get(first + i, buffers[0]);
+            filenames[i] = outdir + "/" + poscar_name(files[f], state.get_state_id(), compress);
+
+            const FingerprintEntry *entry = index.find(fingerprints[i]);
+            if(entry != NULL) {
+                // the state itself, converted by an earlier run
+                if(entry->filename == files[f] && entry->state_id == state.get_state_id()) {
+                    nr_converted++;
+                    continue;
+                }
+                nr_duplicates++;
+                if(link) {
+                    // indices written before the output paths were stored
+                    // refer to the output directory of this run
+                    const std::string target = entry->path.empty() ?
+                        outdir + "/" + poscar_name(entry->filename, entry->state_id, compress) : entry->path;
+                    link_duplicate(filenames[i], target);
+                }
+                continue;
+            }
+
+            std::unordered_map<uint64_t, unsigned int>::const_iterator it = pending_index.find(fingerprints[i]);
+            if(it != pending_index.end()) {
+                nr_duplicates++;
+                if(link) {
+                    pending_links.push_back(std::make_pair(i, it->second));
+                }
+                continue;
+            }
+
+            pending_index[fingerprints[i]] = pending.size();
+            pending.push_back(i);
+        }
+
+        std::vector<char> written(pending.size(), 0);
+        pool.parallel_for(pending.size(), [&](size_t i, unsigned int worker) {
+            State state = vr.states[first + pending[i]];
+            const std::string name = files[f] + " state " + int2str(state.get_state_id());
+            written[i] = state.save_to_poscar(filenames[pending[i]].c_str(), name.c_str(), true);
+        });
+
+        // a fingerprint only enters the index once its file is written, such
+        // that an interrupted or failed run converts the structure again
+        bool complete = true;
+        for(unsigned int i=0; i<pending.size(); i++) {
+            if(!written[i]) {
+                complete = false;
+                nr_failed++;
+                continue;
+            }
+            const State &state = vr.states.get(first + pending[i], buffers[0]);
+            index.insert(fingerprints[pending[i]], files[f], state.get_state_id(), filenames[pending[i]]);
+            nr_written++;
+        }
+        for(unsigned int i=0; i<pending_links.size(); i++) {
+            if(written[pending_links[i].second]) {
+                link_duplicate(filenames[pending_links[i].first], filenames[pending[pending_links[i].second]]);
+            }
+        }
+
+        // only now the file counts as converted
+        if(!cache_file.empty() && complete) {
+            cache.update(files[f], vr.get_checkpoint());
+        }
+    }
+
+    std::cout << "Converted " << nr_written << " structures, " << nr_duplicates
+              << " duplicates " << (link ? "linked" : "skipped") << "." << std::endl;
+    if(nr_converted > 0) {
+        std::cout << "Skipped " << nr_converted << " structures converted before." << std::endl;
+    }
+    if(!cache_file.empty()) {
+        std::cout << "Skipped " << nr_unchanged << " unchanged files." << std::endl;
+    }
+
+    return nr_failed == 0 ? 0 : -1;
+}
+
+int run_command(const std::vector<std::string> &argv);
+
+/*
+ * Keep v2c resident and run the commands sent by clients on a local socket
+ */
+int command_serve(const std::vector<std::string> &args) {
+    if(args.size() != 1) {
+        print_usage();
+        return -1;
+    }
+
+    ConversionServer server(run_command);
+    if(!server.open(args[0])) {
+        return -1;
+    }
+    std::cout << "Listening on " << args[0] << std::endl;
+
+    server.run();
+    server.close();
+
+    std::cout << "Handled " << server.get_nr_requests() << " requests." << std::endl;
+
+    return 0;
+}
+
+/*
+ * Run a command on the server listening on a local socket
+ */
+int command_client(const std::vector<std::string> &args) {
+    if(args.size() < 2) {
+        print_usage();
+        return -1;
+    }
+
+    return ConversionServer::request(args[0], std::vector<std::string>(args.begin() + 1, args.end()));
+}
+
+/*
+ * Run the command line <argv> (command first) and return its exit code;
+ * used by main and for the requests to a server
+ */
+int run_command(const std::vector<std::string> &argv) {
+    if(argv.empty()) {
+        print_usage();
+        return -1;
+    }
+
+    const std::string &command = argv[0];
+    const std::vector<std::string> args(argv.begin() + 1, argv.end());
+
+    if((command == "serve" || command == "client") && ConversionServer::is_handling()) {
+        std::cerr << "The " << command << " command cannot be run by the server." << std::endl;
+        return -1;
+    }
+
+    if(command == "export") {
+        return command_export(args);
+    }
+    if(command == "observables") {
+        return command_observables(args);
+    }
+    if(command == "converge") {
+        return command_converge(args);
+    }
+    if(command == "check") {
+        return command_check(args);
+    }
+    if(command == "rdf") {
+        return command_rdf(args);
+    }
+    if(command == "sites") {
+        return command_sites(args);
+    }
+    if(command == "msd") {
+        return command_msd(args);
+    }
+    if(command == "rmsd") {
+        return command_rmsd(args);
+    }
+    if(command == "dedup") {
+        return command_dedup(args);
+    }
+    if(command == "frames") {
+        return command_frames(args);
+    }
+    if(command == "cif") {
+        return command_cif(args);
+    }
+    if(command == "scene") {
+        return command_scene(args);
+    }
+    if(command == "supercell") {
+        return command_supercell(args);
+    }
+    if(command == "benchmark") {
+        return command_benchmark(args);
+    }
+    if(command == "convert") {
+        return command_convert(args);
+    }
+    if(command == "serve") {
+        return command_serve(args);
+    }
+    if(command == "client") {
+        return command_client(args);
+    }
+
+    print_usage();
+    return -1;
+}
+
+int main(int argc, char *argv[]) {
+    if(argc < 2) {
+        print_usage();
+        return -1;
+    }
+
+    return run_command(std::vector<std::string>(argv + 1, argv + argc));
+}
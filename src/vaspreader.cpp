@@ -22,6 +22,8 @@
 
 #include "vaspreader.h"
 
+#include <ctype.h>
+
 /*
  * Default constructor
  *
@@ -29,6 +31,15 @@
  */
 VaspReader::VaspReader() {
   this->state = 0x00000000;
+  this->keep_states = true;
+  this->observables_mask = 0;
+  this->checkpoint_offset = 0;
+  this->checkpoint_nr_states = 0;
+  this->checkpoint_nr_energies = 0;
+  this->line_number = 0;
+  this->vasp_version = 0;
+  this->layout = VASP_OUTCAR_LAYOUT_UNKNOWN;
+  this->ml_ff = false;
 }
 
 /*
@@ -42,86 +53,229 @@ VaspReader::VaspReader() {
  * Dataset class for data handling.
  */
 bool VaspReader::read(const char* filename) {
-  std::ifstream infile(filename);
+  this->state |= (1 << VASP_OUTCAR_READ_STATE_ELEMENTS);
+  this->state |= (1 << VASP_OUTCAR_READ_STATE_IONS_PER_ELEMENT);
+  this->state |= (1 << VASP_OUTCAR_READ_STATE_OPEN);
+
+  this->nr_atoms_total = 0;
+  this->nr_states = 0;
+  this->line_number = 0;
+  this->diagnostics.clear();
+
+  return this->parse(filename, 0);
+}
+
+/*
+ * Resume reading a file at a checkpoint obtained from an earlier read (or
+ * resume) of the same file. Only the states after the checkpoint are
+ * collected; their state ids continue the numbering of the earlier read.
+ */
+bool VaspReader::resume(const char* filename, const OutcarCheckpoint &checkpoint) {
+  this->clear();
+
+  this->vasp_version = checkpoint.vasp_version;
+  this->layout = checkpoint.layout;
+  this->elements = checkpoint.elements;
+  this->nr_atoms_per_elm = checkpoint.nr_atoms_per_elm;
+  this->dimensions = checkpoint.dimensions;
+  this->nr_states = checkpoint.nr_states;
+  for(unsigned int i=0; i<this->elements.size(); i++) {
+    this->elements_uint.push_back(this->get_element_number_from_name(this->elements[i]));
+  }
+  for(unsigned int i=0; i<this->nr_atoms_per_elm.size(); i++) {
+    this->nr_atoms_total += this->nr_atoms_per_elm[i];
+  }
+
+  // the energies of the earlier states are not needed, but the energy of a
+  // state is looked up by its index
+  this->energies.assign(checkpoint.nr_energies, 0.0);
+
+  this->state = (1 << VASP_OUTCAR_READ_STATE_OPEN) | (1 << VASP_OUTCAR_READ_STATE_ATOMS);
+
+  return this->parse(filename, checkpoint.offset);
+}
 
+/*
+ * Returns the checkpoint after the last complete state that has been read
+ */
+OutcarCheckpoint VaspReader::get_checkpoint() const {
+  OutcarCheckpoint checkpoint;
+  checkpoint.offset = this->checkpoint_offset;
+  checkpoint.vasp_version = this->vasp_version;
+  checkpoint.layout = this->layout;
+  checkpoint.elements = this->elements;
+  checkpoint.nr_atoms_per_elm = this->nr_atoms_per_elm;
+  checkpoint.dimensions = this->dimensions;
+  checkpoint.nr_states = this->checkpoint_nr_states;
+  checkpoint.nr_energies = this->checkpoint_nr_energies;
+  return checkpoint;
+}
 
+/*
+ * Read a VASP file from an already opened stream, e.g. one that is fed by
+ * the PrefetchReader; <filename> is only used to label the states
+ */
+bool VaspReader::read(std::istream &infile, const char* filename) {
   this->state |= (1 << VASP_OUTCAR_READ_STATE_ELEMENTS);
   this->state |= (1 << VASP_OUTCAR_READ_STATE_IONS_PER_ELEMENT);
   this->state |= (1 << VASP_OUTCAR_READ_STATE_OPEN);
 
   this->nr_atoms_total = 0;
   this->nr_states = 0;
+  this->line_number = 0;
+  this->diagnostics.clear();
 
-  /*
-   * For each type of regex pattern recognition, a new set of pcre variables
-   * are constructed.
-   */
-  pcre *regex_compiled_vasp_version;
-  pcre_extra *pcre_extra_vasp_version;
-  pcre *regex_compiled_element;
-  pcre_extra *pcre_extra_element;
-  pcre *regex_compiled_ions_per_element;
-  pcre_extra *pcre_extra_ions_per_element;
-  pcre *regex_compiled_lattice_vectors;
-  pcre_extra *pcre_extra_lattice_vectors;
-  pcre *regex_compiled_atoms;
-  pcre_extra *pcre_extra_atoms;
-  pcre *regex_compiled_grab_numbers;
-  pcre_extra *pcre_extra_grab_numbers;
-  pcre *regex_compiled_grab_energy;
-  pcre_extra *pcre_extra_grab_energy;
-
-  const char *pcre_error_string;
-  const char *pcre_substring_match_string;
-  int pcre_error_offset = 0;
-  int pcre_exec_ret = 0;
-  int pcre_substring_vec[30];
-  int pos = 2;
+  return this->parse(infile, filename, 0);
+}
+
+/*
+ * Open the file and parse it from byte <offset> onwards
+ */
+bool VaspReader::parse(const char* filename, std::streamoff offset) {
+  std::ifstream infile(filename);
+
+  if(!infile.is_open()) {
+    std::cerr << "Cannot open " << filename << std::endl;
+    return false;
+  }
+
+  if(offset > 0) {
+    infile.seekg(offset);
+  }
+
+  return this->parse(infile, filename, offset);
+}
+
+/*
+ * Regular expressions for the lines of an OUTCAR; compiled once per parse
+ */
+#define OUTCAR_PATTERN_VASP_VERSION         0
+#define OUTCAR_PATTERN_ELEMENT              1
+#define OUTCAR_PATTERN_IONS_PER_ELEMENT     2
+#define OUTCAR_PATTERN_LATTICE_VECTORS      3
+#define OUTCAR_PATTERN_ML_FF                4
+#define OUTCAR_PATTERN_ATOMS                5
+#define OUTCAR_PATTERN_GRAB_NUMBERS         6
+#define OUTCAR_PATTERN_GRAB_ENERGY          7
+#define OUTCAR_PATTERN_GRAB_ENERGY_ML       8
+#define OUTCAR_PATTERN_STRESS               9
+#define OUTCAR_PATTERN_MAGNETIZATION        10
+#define OUTCAR_PATTERN_KINETIC              11
+#define OUTCAR_PATTERN_LOOP_PLUS            12
+#define OUTCAR_NR_PATTERNS                  13
+
+struct OutcarPatterns {
+  pcre *compiled[OUTCAR_NR_PATTERNS];
+  pcre_extra *extra[OUTCAR_NR_PATTERNS];
+
+  OutcarPatterns() {
+    static const char *patterns[OUTCAR_NR_PATTERNS] = {
+      "^\\s*vasp\\.([0-9]+)\\.[0-9]+\\.[0-9]+.*$",
+      "^\\s*(VRHFIN\\s+=)([A-Za-z]+)\\s*:.*$",
+      "^\\s*(ions per type =\\s+)([0-9 ]+)$",
+      "^\\s*direct lattice vectors.*$",
+      "^\\s*(ML_LMLFF\\s*=\\s*\\.?[Tt]|ML_MODE\\s*=\\s*[A-Za-z]+).*$",
+      "^\\s*POSITION.*$",
+      "^\\s+([0-9.-]+)\\s+([0-9.-]+)\\s+([0-9.-]+)\\s+([0-9.-]+)\\s+([0-9.-]+)\\s+([0-9.-]+).*$",
+      "^\\s+energy  without entropy=\\s+([0-9.-]+)\\s+energy\\(sigma->0\\) =\\s+([0-9.-]+).*$",
+      "^\\s+(?:ML )?energy  without entropy=\\s+([0-9.-]+)\\s+(?:ML )?energy\\(sigma->0\\) =\\s+([0-9.-]+).*$",
+      "^\\s*in kB\\s+([0-9.-]+)\\s+([0-9.-]+)\\s+([0-9.-]+)\\s+([0-9.-]+)\\s+([0-9.-]+)\\s+([0-9.-]+).*$",
+      "^\\s*number of electron\\s+[0-9.-]+\\s+magnetization\\s+([0-9.-]+).*$",
+      "^\\s*kinetic energy EKIN\\s*=\\s*([0-9.-]+)\\s*\\(temperature\\s*([0-9.-]+)\\s*K\\).*$",
+      "^\\s*LOOP\\+:\\s+cpu time\\s+([0-9.-]+):\\s+real time\\s+([0-9.-]+).*$"
+    };
+
+    const char *error_string;
+    int error_offset = 0;
+    for(unsigned int i=0; i<OUTCAR_NR_PATTERNS; i++) {
+      this->compiled[i] = pcre_compile(patterns[i], 0, &error_string, &error_offset, NULL);
+      this->extra[i] = pcre_study(this->compiled[i], 0, &error_string);
+    }
+  }
+
+  ~OutcarPatterns() {
+    for(unsigned int i=0; i<OUTCAR_NR_PATTERNS; i++) {
+      if(this->extra[i] != NULL) {
+        pcre_free(this->extra[i]);
+      }
+      pcre_free(this->compiled[i]);
+    }
+  }
 
   /*
-   * Define all the regex patterns
+   * Returns the number of captured substrings (> 0) when <line> matches;
+   * the offsets of the substrings are stored in <ovector>
    */
-  const char *string_regex_vasp_version = "^\\s*vasp.([0-9]).[0-9]+.[0-9]+.*$";
-  const char *string_regex_element = "^\\s*(VRHFIN\\s+=)([A-Za-z]+)\\s*:.*$";
-  const char *string_regex_ions_per_element = "^\\s*(ions per type =\\s+)([0-9 ]+)$";
-  const char *string_regex_lattice_vectors = "^\\s*direct lattice vectors.*$";
-  const char *string_regex_atoms = "^\\s*POSITION.*$";
-  const char *string_regex_grab_numbers = "^\\s+([0-9.-]+)\\s+([0-9.-]+)\\s+([0-9.-]+)\\s+([0-9.-]+)\\s+([0-9.-]+)\\s+([0-9.-]+).*$";
-  const char *string_regex_grab_energy = "^\\s+energy  without entropy=\\s+([0-9.-]+)\\s+energy\\(sigma->0\\) =\\s+([0-9.-]+).*$";
-
- /*
-  * Compile all the regex patterns
-  */
-  regex_compiled_vasp_version = pcre_compile(string_regex_vasp_version, 0, &pcre_error_string, &pcre_error_offset, NULL);
-  pcre_extra_vasp_version = pcre_study(regex_compiled_vasp_version, 0, &pcre_error_string);
-  regex_compiled_element = pcre_compile(string_regex_element, 0, &pcre_error_string, &pcre_error_offset, NULL);
-  pcre_extra_element = pcre_study(regex_compiled_element, 0, &pcre_error_string);
-  regex_compiled_ions_per_element = pcre_compile(string_regex_ions_per_element, 0, &pcre_error_string, &pcre_error_offset, NULL);
-  pcre_extra_ions_per_element = pcre_study(regex_compiled_ions_per_element, 0, &pcre_error_string);
-  regex_compiled_lattice_vectors = pcre_compile(string_regex_lattice_vectors, 0, &pcre_error_string, &pcre_error_offset, NULL);
-  pcre_extra_lattice_vectors = pcre_study(regex_compiled_lattice_vectors, 0, &pcre_error_string);
-  regex_compiled_atoms = pcre_compile(string_regex_atoms, 0, &pcre_error_string, &pcre_error_offset, NULL);
-  pcre_extra_atoms = pcre_study(regex_compiled_atoms, 0, &pcre_error_string);
-  regex_compiled_grab_numbers = pcre_compile(string_regex_grab_numbers, 0, &pcre_error_string, &pcre_error_offset, NULL);
-  pcre_extra_grab_numbers = pcre_study(regex_compiled_grab_numbers, 0, &pcre_error_string);
-  regex_compiled_grab_energy = pcre_compile(string_regex_grab_energy, 0, &pcre_error_string, &pcre_error_offset, NULL);
-  pcre_extra_grab_energy = pcre_study(regex_compiled_grab_energy, 0, &pcre_error_string);
+  int match(unsigned int pattern, const std::string &line, int *ovector) const {
+    return pcre_exec(this->compiled[pattern], this->extra[pattern], line.c_str(), line.length(), 0, 0, ovector, 30);
+  }
+};
+
+/*
+ * The patterns are compiled once per process and shared by all readers
+ * (matching against a compiled pattern is thread-safe), such that a
+ * resident process does not compile them for every file
+ */
+static const OutcarPatterns& get_outcar_patterns() {
+  static const OutcarPatterns patterns;
+  return patterns;
+}
+
+/*
+ * Layout of the ionic steps in the OUTCAR of each VASP version. The frame
+ * parser is instantiated for every layout, such that these properties are
+ * resolved at compile time instead of being tested for every line. VASP 6
+ * writes its ionic steps exactly as VASP 5 does: VASP_OUTCAR_LAYOUT_VASP6
+ * only records the version and is parsed by the VASP 5 instantiation.
+ *
+ * energy_before_positions  the energy of a step precedes its POSITION block
+ * ml_frames                steps may be computed by the machine-learned
+ *                          force field, whose energies carry an "ML" prefix
+ */
+template<unsigned int layout> struct OutcarLayout;
+
+template<> struct OutcarLayout<VASP_OUTCAR_LAYOUT_VASP4> {
+  static const bool energy_before_positions = true;
+  static const bool ml_frames = false;
+};
 
+template<> struct OutcarLayout<VASP_OUTCAR_LAYOUT_VASP5> {
+  static const bool energy_before_positions = false;
+  static const bool ml_frames = false;
+};
+
+template<> struct OutcarLayout<VASP_OUTCAR_LAYOUT_ML_FF> {
+  static const bool energy_before_positions = false;
+  static const bool ml_frames = true;
+};
+
+/*
+ * Parse the stream (positioned at byte <offset> of the file), continuing
+ * from the current read state. The header (version, elements, ions per
+ * element and unit cell) is read first, after which the ionic steps are
+ * parsed by the frame parser of the layout of this VASP version.
+ */
+bool VaspReader::parse(std::istream &infile, const char* filename, std::streamoff offset) {
+  this->checkpoint_offset = offset;
+  this->checkpoint_nr_states = this->nr_states;
+  this->checkpoint_nr_energies = this->energies.size();
+
+  const OutcarPatterns &patterns = get_outcar_patterns();
+  int ovector[30];
   std::string line;
-  while (std::getline(infile, line)) { // loop over all the lines in the file
+
+  while(!(this->state & (1 << VASP_OUTCAR_READ_STATE_ATOMS)) && this->read_line(infile, line)) {
 
     /*
-     * Collect the vasp version (4 or 5)
+     * Collect the vasp version (4, 5 or 6) and whether the machine-learned
+     * force field is enabled
      */
     if(this->state & (1 << VASP_OUTCAR_READ_STATE_ELEMENTS) ) {
-      // get the elements and put these in an array
-      pos = 1;
-      pcre_exec_ret = pcre_exec(regex_compiled_vasp_version, pcre_extra_vasp_version, line.c_str(), line.length(),
-                           0, 0, pcre_substring_vec, 30);
-      if(pcre_exec_ret > 0) {
-        pcre_get_substring(line.c_str(), pcre_substring_vec, pcre_exec_ret, pos, &(pcre_substring_match_string));
-        this->vasp_version = atoi(pcre_substring_match_string);
-
+      if(patterns.match(OUTCAR_PATTERN_VASP_VERSION, line, ovector) > 0) {
+        this->vasp_version = atoi(line.c_str() + ovector[2]);
+      }
+      if(patterns.match(OUTCAR_PATTERN_ML_FF, line, ovector) > 0) {
+        this->ml_ff = true;
       }
     }
 
@@ -129,13 +283,8 @@ bool VaspReader::read(const char* filename) {
      * Collect the elements
      */
     if(this->state & (1 << VASP_OUTCAR_READ_STATE_ELEMENTS) ) {
-      // get the elements and put these in an array
-      pos = 2;
-      pcre_exec_ret = pcre_exec(regex_compiled_element, pcre_extra_element, line.c_str(), line.length(),
-                           0, 0, pcre_substring_vec, 30);
-      if(pcre_exec_ret > 0) {
-        pcre_get_substring(line.c_str(), pcre_substring_vec, pcre_exec_ret, pos, &(pcre_substring_match_string));
-        this->elements.push_back(pcre_substring_match_string);
+      if(patterns.match(OUTCAR_PATTERN_ELEMENT, line, ovector) > 0) {
+        this->elements.push_back(line.substr(ovector[4], ovector[5] - ovector[4]));
       }
     }
 
@@ -143,13 +292,8 @@ bool VaspReader::read(const char* filename) {
      * Collect the number of ions of each element type
      */
     if(this->state & (1 << VASP_OUTCAR_READ_STATE_IONS_PER_ELEMENT) ) {
-      // get the number of ions per element (type)
-      pos = 2;
-      pcre_exec_ret = pcre_exec(regex_compiled_ions_per_element, pcre_extra_ions_per_element, line.c_str(), line.length(),
-                           0, 0, pcre_substring_vec, 30);
-      if(pcre_exec_ret > 0) {
-        pcre_get_substring(line.c_str(), pcre_substring_vec, pcre_exec_ret, pos, &(pcre_substring_match_string));
-        std::vector<std::string> elements_vector = this->explode(pcre_substring_match_string, " ");
+      if(patterns.match(OUTCAR_PATTERN_IONS_PER_ELEMENT, line, ovector) > 0) {
+        std::vector<std::string> elements_vector = this->explode(line.substr(ovector[4], ovector[5] - ovector[4]), " ");
         for(unsigned int i=0; i<elements_vector.size(); i++) {
           if(elements_vector[i].empty() == false) {
             nr_atoms_per_elm.push_back(atoi(elements_vector[i].c_str() ) );
@@ -175,120 +319,451 @@ bool VaspReader::read(const char* filename) {
      * has the same unit cell. (that means, IBRION != 3 calculations)
      */
     if(this->state & (1 << VASP_OUTCAR_READ_STATE_LATTICE_VECTORS) ) {
-      // get the dimensionality of the unit cell
-      pos = 0;
-      pcre_exec_ret = pcre_exec(regex_compiled_lattice_vectors, pcre_extra_lattice_vectors, line.c_str(), line.length(),
-                           0, 0, pcre_substring_vec, 30);
-      if(pcre_exec_ret > 0) {
-        pcre_get_substring(line.c_str(), pcre_substring_vec, pcre_exec_ret, pos, &(pcre_substring_match_string));
+      if(patterns.match(OUTCAR_PATTERN_LATTICE_VECTORS, line, ovector) > 0) {
         // grab three lines
         for(int i=0; i<3; i++) {
-          std::getline(infile, line);
-          pcre_exec_ret = pcre_exec(regex_compiled_grab_numbers, pcre_extra_grab_numbers, line.c_str(), line.length(),
-                           0, 0, pcre_substring_vec, 30);
-          if(pcre_exec_ret > 0) {
-            pos = 1;
-            pcre_get_substring(line.c_str(), pcre_substring_vec, pcre_exec_ret, pos, &(pcre_substring_match_string));
-            this->dimensions.push_back(atof(pcre_substring_match_string));
-            pos = 2;
-            pcre_get_substring(line.c_str(), pcre_substring_vec, pcre_exec_ret, pos, &(pcre_substring_match_string));
-            this->dimensions.push_back(atof(pcre_substring_match_string));
-            pos = 3;
-            pcre_get_substring(line.c_str(), pcre_substring_vec, pcre_exec_ret, pos, &(pcre_substring_match_string));
-            this->dimensions.push_back(atof(pcre_substring_match_string));
+          this->read_line(infile, line);
+          if(patterns.match(OUTCAR_PATTERN_GRAB_NUMBERS, line, ovector) > 0) {
+            for(int k=1; k<=3; k++) {
+              this->dimensions.push_back(atof(line.c_str() + ovector[2*k]));
+            }
           }
         }
         this->state &= ~(1 << VASP_OUTCAR_READ_STATE_LATTICE_VECTORS);
         this->state |= (1 << VASP_OUTCAR_READ_STATE_ATOMS);
       }
     }
+  }
+
+  /*
+   * Select the frame parser once; when resuming, the layout is known from
+   * the checkpoint
+   */
+  if(this->state & (1 << VASP_OUTCAR_READ_STATE_ATOMS)) {
+    if(this->layout == VASP_OUTCAR_LAYOUT_UNKNOWN) {
+      this->layout = this->select_layout(filename);
+    }
+
+    switch(this->layout) {
+      case VASP_OUTCAR_LAYOUT_VASP4:
+        this->parse_frames<VASP_OUTCAR_LAYOUT_VASP4>(infile, filename, patterns);
+        break;
+      case VASP_OUTCAR_LAYOUT_ML_FF:
+        this->parse_frames<VASP_OUTCAR_LAYOUT_ML_FF>(infile, filename, patterns);
+        break;
+      default:    // VASP 5 and its alias VASP 6
+        this->parse_frames<VASP_OUTCAR_LAYOUT_VASP5>(infile, filename, patterns);
+        break;
+    }
+  }
+
+  this->state = (1 << VASP_OUTCAR_READ_STATE_FINISHED);
+
+  return true;
+}
+
+/*
+ * Layout of the ionic steps, derived from the version and the use of the
+ * machine-learned force field found in the header
+ */
+unsigned int VaspReader::select_layout(const char* filename) const {
+  if(this->ml_ff) {
+    return VASP_OUTCAR_LAYOUT_ML_FF;
+  }
+
+  switch(this->vasp_version) {
+    case 4:
+      return VASP_OUTCAR_LAYOUT_VASP4;
+    case 5:
+      return VASP_OUTCAR_LAYOUT_VASP5;
+    case 6:
+      return VASP_OUTCAR_LAYOUT_VASP6;
+    default:
+      std::cerr << "Unknown VASP version " << this->vasp_version << " in " << filename
+                << "; assuming the layout of VASP 5." << std::endl;
+      return VASP_OUTCAR_LAYOUT_VASP5;
+  }
+}
+
+/*
+ * Collect the energies, atomic positions and forces of all ionic steps.
+ * When the kinetic energy or the timings are requested, which VASP prints
+ * after the positions and the energy, a step is only complete at its LOOP+
+ * line.
+ *
+ * Every step is validated while it is read: a POSITION block needs to hold
+ * as many atoms as given by "ions per type", and positions and energy need
+ * to pair up in the order of the layout. A damaged step is dropped and
+ * reported (see get_diagnostics); a line that breaks off a POSITION block is
+ * examined again, such that parsing resumes at the next step.
+ */
+template<unsigned int layout>
+void VaspReader::parse_frames(std::istream &infile, const char* filename, const OutcarPatterns &patterns) {
+  typedef OutcarLayout<layout> Layout;
+  const unsigned int energy_pattern = Layout::ml_frames ? OUTCAR_PATTERN_GRAB_ENERGY_ML : OUTCAR_PATTERN_GRAB_ENERGY;
+  const bool defer = (this->observables_mask & (STATE_OBSERVABLE_KINETIC | STATE_OBSERVABLE_TIMING)) != 0;
+  bool frame_pending = false;       // complete step, waiting for its LOOP+ line
+  bool positions_pending = false;   // positions read, waiting for the energy
+  bool energy_pending = false;      // energy read, waiting for the positions
+  bool dropped = false;             // the energy to come belongs to a dropped step
+  double energy = 0.0;
+
+  int ovector[30];
+  std::string line;
+  bool reexamine = false;
+  while (reexamine || this->read_line(infile, line)) {
+    reexamine = false;
 
     /*
      * Collect the energy of the state
      */
-    if(this->state & (1 << VASP_OUTCAR_READ_STATE_ATOMS) ) {
-      pos = 2;
-      pcre_exec_ret = pcre_exec(regex_compiled_grab_energy, pcre_extra_grab_energy, line.c_str(), line.length(),
-                           0, 0, pcre_substring_vec, 30);
-      if(pcre_exec_ret > 0) {
-        pcre_get_substring(line.c_str(), pcre_substring_vec, pcre_exec_ret, pos, &(pcre_substring_match_string));
-        //std::cout << atof(pcre_substring_match_string) << std::endl;
-        this->energies.push_back(atof(pcre_substring_match_string));
-
-        if(this->vasp_version == 5) {
-          this->states.push_back(State(this->energies[this->nr_states - 1], this->dimensions, this->atoms, this->elements, this->elements_uint, this->nr_atoms_per_elm, filename, this->nr_states));
-          this->atoms.clear();
+    if(patterns.match(energy_pattern, line, ovector) > 0) {
+      if(frame_pending) {
+        this->store_state(filename);
+        frame_pending = false;
+      }
+
+      if(Layout::energy_before_positions) {
+        if(energy_pending) {
+          this->report(VASP_OUTCAR_DIAGNOSTIC_MISSING_POSITIONS, "energy without positions; step dropped");
+        }
+        energy = atof(line.c_str() + ovector[4]);
+        energy_pending = true;
+      } else if(positions_pending) {
+        positions_pending = false;
+        this->pair_frame(atof(line.c_str() + ovector[4]));
+        if(defer) {
+          frame_pending = true;
+        } else {
+          this->finish_frame(infile, filename);
         }
+      } else if(!dropped) {
+        this->report(VASP_OUTCAR_DIAGNOSTIC_MISSING_POSITIONS, "energy without positions; energy ignored");
       }
+      dropped = false;
+      continue;
     }
 
     /*
      * Collect the atomic positions and forces for this state
      */
-    if(this->state & (1 << VASP_OUTCAR_READ_STATE_ATOMS) ) {
-      // get the atoms per state
-      pos = 0;
-      pcre_exec_ret = pcre_exec(regex_compiled_atoms, pcre_extra_atoms, line.c_str(), line.length(),
-                           0, 0, pcre_substring_vec, 30);
-      if(pcre_exec_ret > 0) {
-        this->nr_states++;
-        pcre_get_substring(line.c_str(), pcre_substring_vec, pcre_exec_ret, pos, &(pcre_substring_match_string));
-        //printf("'%s'\n", pcre_substring_match_string);
-        std::getline(infile, line); // discard this line
-        for(unsigned i=0; i<this->nr_atoms_per_elm.size(); i++) {
-          for(unsigned int j=0; j<this->nr_atoms_per_elm[i]; j++) {
-            std::getline(infile, line);
-            pcre_exec_ret = pcre_exec(regex_compiled_grab_numbers, pcre_extra_grab_numbers, line.c_str(), line.length(),
-                             0, 0, pcre_substring_vec, 30);
-            if(pcre_exec_ret > 0) {
-              //std::cout << "Atom #" << (i+1) << std::endl;
-              float x, y, z, fx, fy, fz;
-              pos = 1;
-              pcre_get_substring(line.c_str(), pcre_substring_vec, pcre_exec_ret, pos, &(pcre_substring_match_string));
-              x = atof(pcre_substring_match_string);
-              pos = 2;
-              pcre_get_substring(line.c_str(), pcre_substring_vec, pcre_exec_ret, pos, &(pcre_substring_match_string));
-              y = atof(pcre_substring_match_string);
-              pos = 3;
-              pcre_get_substring(line.c_str(), pcre_substring_vec, pcre_exec_ret, pos, &(pcre_substring_match_string));
-              z = atof(pcre_substring_match_string);
-              pos = 4;
-              pcre_get_substring(line.c_str(), pcre_substring_vec, pcre_exec_ret, pos, &(pcre_substring_match_string));
-              fx = atof(pcre_substring_match_string);
-              pos = 5;
-              pcre_get_substring(line.c_str(), pcre_substring_vec, pcre_exec_ret, pos, &(pcre_substring_match_string));
-              fy = atof(pcre_substring_match_string);
-              pos = 6;
-              pcre_get_substring(line.c_str(), pcre_substring_vec, pcre_exec_ret, pos, &(pcre_substring_match_string));
-              fz = atof(pcre_substring_match_string);
-              this->atoms.push_back(Atom(
-                  this->get_element_number_from_name(this->elements[i]),
-                  x, y, z, fx, fy, fz
-                ));
-            }
-          }
+    if(patterns.match(OUTCAR_PATTERN_ATOMS, line, ovector) > 0) {
+      // a step without a LOOP+ line ends where the next one starts
+      if(frame_pending) {
+        this->store_state(filename);
+        frame_pending = false;
+      }
+      if(positions_pending) {
+        this->report(VASP_OUTCAR_DIAGNOSTIC_MISSING_ENERGY, "positions without energy; step dropped");
+        this->discard_frame();
+        positions_pending = false;
+      }
+
+      const unsigned int nr_read = this->read_positions(infile, line, patterns, ovector);
+      if(nr_read < this->nr_atoms_total) {
+        this->report(VASP_OUTCAR_DIAGNOSTIC_INCOMPLETE_POSITIONS, "POSITION block holds " + int2str(nr_read) +
+                     " of " + int2str(this->nr_atoms_total) + " atoms; step dropped");
+        this->discard_frame();
+        energy_pending = false;
+        dropped = !Layout::energy_before_positions;
+        reexamine = infile.good();
+        continue;
+      }
+      dropped = false;
+
+      if(!Layout::energy_before_positions) {
+        positions_pending = true;
+      } else if(energy_pending) {
+        energy_pending = false;
+        this->pair_frame(energy);
+        if(defer) {
+          frame_pending = true;
+        } else {
+          this->finish_frame(infile, filename);
         }
+      } else {
+        this->report(VASP_OUTCAR_DIAGNOSTIC_MISSING_ENERGY, "positions without energy; step dropped");
+        this->discard_frame();
+      }
+      continue;
+    }
+
+    /*
+     * Collect the requested optional quantities
+     */
+    if(this->observables_mask != 0) {
+      if(this->match_observables(line, patterns, ovector) && frame_pending) {
+        this->finish_frame(infile, filename);
+        frame_pending = false;
+      }
+    }
+  }
+
+  // the last step of a file that ends before its LOOP+ line
+  if(frame_pending) {
+    this->store_state(filename);
+  }
 
-        if(this->vasp_version == 4) {
-          this->states.push_back(State(this->energies[this->nr_states - 1], this->dimensions, this->atoms, this->elements, this->elements_uint, this->nr_atoms_per_elm, filename, this->nr_states));
-          this->atoms.clear();
+  if(positions_pending || energy_pending) {
+    this->report(VASP_OUTCAR_DIAGNOSTIC_TRUNCATED, "file ends within an ionic step; step dropped");
+    this->discard_frame();
+  }
+}
+
+/*
+ * Cheap check that <line> starts with a number; used instead of the full
+ * pattern for the lines of the atoms that are not selected
+ */
+static bool is_coordinate_line(const std::string &line) {
+  size_t i = line.find_first_not_of(' ');
+  if(i != std::string::npos && line[i] == '-') {
+    i++;
+  }
+  return i < line.size() && (isdigit((unsigned char)line[i]) || line[i] == '.');
+}
+
+/*
+ * Read the POSITION block following the anchor line into the atoms of the
+ * current step. Returns the number of atom lines read; when it is smaller
+ * than the total number of atoms, <line> holds the line that broke off the
+ * block.
+ *
+ * With an atom selection, only the selected atoms are kept, and the element
+ * blocks of the step are reduced to the elements that remain. The lines of
+ * atoms outside the resolved mask are skipped without being converted. The
+ * mask is resolved before the first block, or on the positions of the first
+ * block when the selection holds a first-frame z-window.
+ */
+unsigned int VaspReader::read_positions(std::istream &infile, std::string &line, const OutcarPatterns &patterns, int *ovector) {
+  this->atoms.clear();
+  this->atom_indices.clear();
+  if(!this->read_line(infile, line)) { // discard the separator line
+    return 0;
+  }
+
+  const bool select = this->selection.is_active();
+  if(select && !this->selection.is_resolved() && !this->selection.needs_positions()) {
+    this->selection.resolve(this->elements, this->nr_atoms_per_elm, this->atoms);
+  }
+  const bool skip = select && this->selection.is_resolved();
+  const bool per_frame = skip && this->selection.is_per_frame();
+  this->frame_atoms_per_elm.assign(this->nr_atoms_per_elm.size(), 0);
+
+  unsigned int index = 0;
+  for(unsigned i=0; i<this->nr_atoms_per_elm.size(); i++) {
+    for(unsigned int j=0; j<this->nr_atoms_per_elm[i]; j++, index++) {
+      if(!this->read_line(infile, line)) {
+        return index;
+      }
+      if(skip && !this->selection.is_selected(index)) {
+        if(!is_coordinate_line(line)) {
+          return index;
+        }
+        continue;
+      }
+      if(patterns.match(OUTCAR_PATTERN_GRAB_NUMBERS, line, ovector) <= 0) {
+        return index;
+      }
+      const char *str = line.c_str();
+      const Real z = atof(str + ovector[6]);
+      if(per_frame && !this->selection.in_window(z)) {
+        continue;
+      }
+      this->atoms.push_back(Atom(
+          this->elements_uint[i],
+          atof(str + ovector[2]), atof(str + ovector[4]), z,
+          atof(str + ovector[8]), atof(str + ovector[10]), atof(str + ovector[12])
+        ));
+      this->atom_indices.push_back(index);
+      this->frame_atoms_per_elm[i]++;
+    }
+  }
+
+  if(select) {
+    // the first block resolves a first-frame z-window and is reduced afterwards
+    if(!skip) {
+      this->selection.resolve(this->elements, this->nr_atoms_per_elm, this->atoms);
+      unsigned int k = 0;
+      unsigned int a = 0;
+      for(unsigned int i=0; i<this->nr_atoms_per_elm.size(); i++) {
+        this->frame_atoms_per_elm[i] = 0;
+        for(unsigned int j=0; j<this->nr_atoms_per_elm[i]; j++, a++) {
+          if(this->selection.is_selected(a)) {
+            this->atoms[k] = this->atoms[a];
+            this->atom_indices[k] = a;
+            this->frame_atoms_per_elm[i]++;
+            k++;
+          }
         }
       }
+      this->atoms.resize(k);
+      this->atom_indices.resize(k);
     }
+
+    std::vector<unsigned int> counts;
+    this->frame_elements.clear();
+    this->frame_elements_uint.clear();
+    for(unsigned int i=0; i<this->frame_atoms_per_elm.size(); i++) {
+      if(this->frame_atoms_per_elm[i] > 0) {
+        this->frame_elements.push_back(this->elements[i]);
+        this->frame_elements_uint.push_back(this->elements_uint[i]);
+        counts.push_back(this->frame_atoms_per_elm[i]);
+      }
+    }
+    this->frame_atoms_per_elm.swap(counts);
   }
-  this->state = (1 << VASP_OUTCAR_READ_STATE_FINISHED);
 
-  // output all information
-  std::string elements_string;
-  for(unsigned int i=0; i < this->elements.size(); i++) {
-    elements_string.append(elements[i]);
-    elements_string.append("(");
-    elements_string.append(int2str(nr_atoms_per_elm[i]) );
-    elements_string.append(")");
-    elements_string.append(" ");
+  if(this->observables_mask & STATE_OBSERVABLE_FORCES) {
+    this->reduce_forces();
   }
 
-  return true;
+  return index;
+}
+
+/*
+ * Reduce the forces of the current step to the largest and the root mean
+ * square force norm, over all atoms and per element. The forces are
+ * gathered in a contiguous column per direction, such that the squared
+ * norms are evaluated by Eigen with packed (SIMD) instructions in Real
+ * precision; excluded atoms are masked out by zeroing their forces, which
+ * leaves the maxima unaffected.
+ */
+void VaspReader::reduce_forces() {
+  const unsigned int n = this->atoms.size();
+  StateObservables &obs = this->pending_observables;
+  obs.max_force_element.assign(this->frame_atoms_per_elm.size(), 0.0);
+  obs.max_force = 0.0;
+  obs.rms_force = 0.0;
+  obs.available |= STATE_OBSERVABLE_FORCES;
+  if(n == 0) {
+    return;
+  }
+
+  const bool exclude = this->excluded_atoms.size() == this->nr_atoms_total;
+  unsigned int nr_included = n;
+  this->forces.resize(n, 3);
+  for(unsigned int i=0; i<n; i++) {
+    if(exclude && this->excluded_atoms[this->atom_indices[i]]) {
+      this->forces.row(i).setZero();
+      nr_included--;
+    } else {
+      this->forces.row(i) = this->atoms[i].force.transpose();
+    }
+  }
+
+  this->force_norms = this->forces.col(0).array().square() +
+                      this->forces.col(1).array().square() +
+                      this->forces.col(2).array().square();
+
+  unsigned int offset = 0;
+  for(unsigned int i=0; i<this->frame_atoms_per_elm.size(); i++) {
+    const unsigned int count = this->frame_atoms_per_elm[i];
+    if(count > 0) {
+      obs.max_force_element[i] = std::sqrt((double)this->force_norms.segment(offset, count).maxCoeff());
+      obs.max_force = std::max(obs.max_force, obs.max_force_element[i]);
+    }
+    offset += count;
+  }
+
+  if(nr_included > 0) {
+    obs.rms_force = std::sqrt(this->force_norms.cast<double>().sum() / (double)nr_included);
+  }
+}
+
+/*
+ * Read the next line, keeping track of the line number
+ */
+bool VaspReader::read_line(std::istream &infile, std::string &line) {
+  if(std::getline(infile, line)) {
+    this->line_number++;
+    return true;
+  }
+  return false;
+}
+
+/*
+ * The positions of the current step have been paired with <energy>: the
+ * step becomes a state
+ */
+void VaspReader::pair_frame(double energy) {
+  this->energies.push_back(energy);
+  this->nr_states++;
+}
+
+/*
+ * Drop the atoms and optional quantities collected for the current step
+ */
+void VaspReader::discard_frame() {
+  this->atoms.clear();
+  this->pending_observables = StateObservables();
+}
+
+/*
+ * Record a damaged step
+ */
+void VaspReader::report(unsigned int type, const std::string &message) {
+  OutcarDiagnostic diagnostic;
+  diagnostic.type = type;
+  diagnostic.line = this->line_number;
+  diagnostic.nr_states = this->nr_states;
+  diagnostic.message = message;
+  this->diagnostics.push_back(diagnostic);
+}
+
+/*
+ * Store the state of the current ionic step and move the checkpoint past it
+ */
+void VaspReader::finish_frame(std::istream &infile, const char* filename) {
+  this->store_state(filename);
+  this->checkpoint_offset = infile.tellg();
+  this->checkpoint_nr_states = this->nr_states;
+  this->checkpoint_nr_energies = this->energies.size();
+}
+
+/*
+ * Collect the optional quantities of the current ionic step from <line>;
+ * the magnetization is printed for every electronic step, such that the
+ * last value (the converged one) is kept. Returns true for the LOOP+ line
+ * that ends an ionic step.
+ */
+bool VaspReader::match_observables(const std::string &line, const OutcarPatterns &patterns, int *ovector) {
+  const char *str = line.c_str();
+  StateObservables &obs = this->pending_observables;
+
+  if((this->observables_mask & STATE_OBSERVABLE_STRESS) &&
+     patterns.match(OUTCAR_PATTERN_STRESS, line, ovector) > 0) {
+    for(unsigned int i=0; i<6; i++) {
+      obs.stress[i] = atof(str + ovector[2*(i+1)]);
+    }
+    obs.available |= STATE_OBSERVABLE_STRESS;
+    return false;
+  }
+
+  if((this->observables_mask & STATE_OBSERVABLE_MAGNETIZATION) &&
+     patterns.match(OUTCAR_PATTERN_MAGNETIZATION, line, ovector) > 0) {
+    obs.magnetization = atof(str + ovector[2]);
+    obs.available |= STATE_OBSERVABLE_MAGNETIZATION;
+    return false;
+  }
+
+  if((this->observables_mask & STATE_OBSERVABLE_KINETIC) &&
+     patterns.match(OUTCAR_PATTERN_KINETIC, line, ovector) > 0) {
+    obs.kinetic_energy = atof(str + ovector[2]);
+    obs.temperature = atof(str + ovector[4]);
+    obs.available |= STATE_OBSERVABLE_KINETIC;
+    return false;
+  }
+
+  if(patterns.match(OUTCAR_PATTERN_LOOP_PLUS, line, ovector) > 0) {
+    if(this->observables_mask & STATE_OBSERVABLE_TIMING) {
+      obs.cpu_time = atof(str + ovector[2]);
+      obs.real_time = atof(str + ovector[4]);
+      obs.available |= STATE_OBSERVABLE_TIMING;
+    }
+    return true;
+  }
+
+  return false;
 }
 
 /*
@@ -300,10 +775,105 @@ void VaspReader::clear() {
   this->nr_states = 0;
   this->atoms.clear();
   this->nr_atoms_per_elm.clear();
+  this->elements_uint.clear();
   this->nr_atoms_total = 0;
   this->dimensions.clear();
   this->states.clear();
   this->energies.clear();
+  this->vasp_version = 0;
+  this->layout = VASP_OUTCAR_LAYOUT_UNKNOWN;
+  this->ml_ff = false;
+  this->pending_observables = StateObservables();
+  this->checkpoint_nr_states = 0;
+  this->line_number = 0;
+  this->diagnostics.clear();
+}
+
+/*
+ * Select the optional per-step quantities (STATE_OBSERVABLE_* flags) that
+ * are collected while reading; by default none are collected, which keeps
+ * the scan over the lines of the file at its minimum
+ */
+void VaspReader::set_observables(unsigned int _mask) {
+  this->observables_mask = _mask;
+}
+
+/*
+ * Keep only the atoms in <_selection> in the states (see AtomSelection);
+ * a selection that is resolved already is applied as is
+ */
+void VaspReader::set_selection(const AtomSelection &_selection) {
+  this->selection = _selection;
+}
+
+/*
+ * Returns the atom selection, which has been resolved once the first
+ * POSITION block has been read
+ */
+const AtomSelection& VaspReader::get_selection() const {
+  return this->selection;
+}
+
+/*
+ * Leave the atoms flagged in <_excluded> (e.g. those fixed by selective
+ * dynamics) out of the force statistics; ignored unless there is a flag for
+ * every atom
+ */
+void VaspReader::set_excluded_atoms(const std::vector<char> &_excluded) {
+  this->excluded_atoms = _excluded;
+}
+
+/*
+ * Keep at most (about) <_bytes> of states in memory; older states are
+ * spilled to a file in <_directory> and read back when they are accessed
+ * (see FrameStore)
+ */
+void VaspReader::set_memory_budget(size_t _bytes, const std::string &_directory) {
+  this->states.set_memory_budget(_bytes, _directory);
+}
+
+/*
+ * Register a function that is called for every state as soon as it has been
+ * parsed. This allows states to be processed while the file is still being
+ * read. When <_keep_states> is false, the states are only handed to the
+ * callback and not collected in the states vector, such that files of
+ * arbitrary length can be streamed in constant memory.
+ */
+void VaspReader::set_state_callback(const std::function<void(const State&)> &_callback, bool _keep_states) {
+  this->state_callback = _callback;
+  this->keep_states = _keep_states;
+}
+
+/*
+ * Construct a state from the atoms and energy collected for the current
+ * ionic step, hand it to the callback and/or store it
+ */
+void VaspReader::store_state(const char* filename) {
+  // only steps whose positions and energy have been paired make a state
+  if(this->nr_states == 0 || this->energies.size() < this->nr_states) {
+    this->atoms.clear();
+    return;
+  }
+
+  const bool select = this->selection.is_active();
+  State state(this->energies[this->nr_states - 1], this->dimensions, this->atoms,
+              select ? this->frame_elements : this->elements,
+              select ? this->frame_elements_uint : this->elements_uint,
+              select ? this->frame_atoms_per_elm : this->nr_atoms_per_elm, filename, this->nr_states);
+  if(this->observables_mask != 0) {
+    state.set_observables(this->pending_observables);
+    this->pending_observables = StateObservables();
+  }
+
+  if(this->state_callback) {
+    this->state_callback(state);
+  }
+
+  if(this->keep_states) {
+    this->states.push_back(state);
+  }
+
+  this->atoms.clear();
 }
 
 /*
@@ -320,6 +890,14 @@ const std::vector<std::string>& VaspReader::get_elements() const {
   return this->elements;
 }
 
+/*
+ * Returns the damage found in the file(s) read so far; the line numbers of
+ * a resumed read count from the checkpoint
+ */
+const std::vector<OutcarDiagnostic>& VaspReader::get_diagnostics() const {
+  return this->diagnostics;
+}
+
 /*
  * Returns a vector of strings given a parent string and a delimiter character. This
  * function is inspired on the PHP function "explode"
@@ -0,0 +1,192 @@
+/*************************************************************************
+ *
+ *  This file is part of v2c.
+ *
+ *  Author: Ivo Filot <i.a.w.filot@tue.nl>
+ *
+ *  v2c is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  v2c is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with v2c.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ************************************************************************/
+
+/*
+ * Regression test of the adsorption site classification. Adsorbates are
+ * placed on the top, bridge, fcc and hcp sites of a three layer Rh(111)
+ * slab and on the fourfold hollow of a Rh(100) slab; every site, its
+ * coordination and its height must be recognized, also when the slab is
+ * turned upside down.
+ */
+
+#include <string>
+#include <vector>
+#include <iostream>
+#include <cmath>
+
+#include "adsorption.h"
+#include "test_structures.h"
+
+#define TEST_RH_DISTANCE 2.687      // nearest neighbor distance of Rh [A]
+
+struct Adsorbate {
+  unsigned int elnr;
+  Eigen::Vector3d pos;
+  unsigned int site;
+  unsigned int coordination;
+  double height;
+};
+
+/*
+ * State of the <substrate> Rh atoms and the <adsorbates> in <cell>; with
+ * <flip>, every z coordinate is mirrored in the middle of the cell
+ */
+static State make_slab(const Eigen::Matrix3d &cell, const std::vector<Eigen::Vector3d> &substrate,
+                       const std::vector<Adsorbate> &adsorbates, bool flip) {
+    const double mirror = cell(2,2);
+
+    // the adsorbates are given one per element, in blocks
+    std::vector<Eigen::Vector3d> positions(substrate);
+    std::vector<unsigned int> elnrs(substrate.size(), 45);
+    for(unsigned int i=0; i<adsorbates.size(); i++) {
+        positions.push_back(adsorbates[i].pos);
+        elnrs.push_back(adsorbates[i].elnr);
+    }
+    if(flip) {
+        for(unsigned int i=0; i<positions.size(); i++) {
+            positions[i](2) = mirror - positions[i](2);
+        }
+    }
+
+    return make_state(cell, positions, elnrs);
+}
+
+static bool check(const std::string &label, const State &state, const std::vector<Adsorbate> &adsorbates,
+                  unsigned int first) {
+    const std::vector<AdsorbateSite> sites = AdsorptionAnalysis().analyse(state);
+    if(sites.size() != adsorbates.size()) {
+        std::cerr << label << ": " << sites.size() << " adsorbates instead of " << adsorbates.size() << std::endl;
+        return false;
+    }
+
+    for(unsigned int i=0; i<sites.size(); i++) {
+        if(sites[i].atom != first + i || sites[i].site != adsorbates[i].site ||
+           sites[i].coordination != adsorbates[i].coordination ||
+           std::fabs(sites[i].height - adsorbates[i].height) > 1e-3) {
+            std::cerr << label << ": adsorbate " << i + 1 << " is on a " << AdsorptionAnalysis::get_site_name(sites[i].site)
+                      << " site with coordination " << sites[i].coordination << " at " << sites[i].height
+                      << " A instead of a " << AdsorptionAnalysis::get_site_name(adsorbates[i].site) << " site" << std::endl;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static Adsorbate adsorbate(unsigned int elnr, const Eigen::Vector3d &pos, unsigned int site,
+                           unsigned int coordination, double height) {
+    Adsorbate result;
+    result.elnr = elnr;
+    result.pos = pos;
+    result.site = site;
+    result.coordination = coordination;
+    result.height = height;
+    return result;
+}
+
+/*
+ * 3 x 3 Rh(111) slab in ABC stacking; the threefold hollows above the third
+ * layer are fcc sites, those above the second layer hcp sites
+ */
+static bool test_fcc111(bool flip) {
+    const double d = TEST_RH_DISTANCE;
+    const double spacing = d * std::sqrt(2.0 / 3.0);
+    const Eigen::Vector3d u(d, 0.0, 0.0);
+    const Eigen::Vector3d v(d / 2.0, d * std::sqrt(3.0) / 2.0, 0.0);
+    const Eigen::Vector3d z(0.0, 0.0, 1.0);
+
+    Eigen::Matrix3d cell = Eigen::Matrix3d::Zero();
+    cell.row(0) = 3.0 * u;
+    cell.row(1) = 3.0 * v;
+    cell(2,2) = 20.0;
+
+    // in-plane position of offset (i, j) above layer <layer>
+    auto site = [&](double i, double j, unsigned int layer) {
+        return Eigen::Vector3d((i + layer / 3.0) * u + (j + layer / 3.0) * v + (5.0 + layer * spacing) * z);
+    };
+
+    std::vector<Eigen::Vector3d> substrate;
+    for(unsigned int layer=0; layer<3; layer++) {
+        for(unsigned int i=0; i<3; i++) {
+            for(unsigned int j=0; j<3; j++) {
+                substrate.push_back(site(i, j, layer));
+            }
+        }
+    }
+
+    // the top layer is layer 2: its threefold hollows lie above layer 0
+    // (fcc) and layer 1 (hcp)
+    std::vector<Adsorbate> adsorbates;
+    adsorbates.push_back(adsorbate(1, 0.5 * (site(1, 1, 2) + site(2, 1, 2)) + 0.5 * z,
+                                   ADSORPTION_SITE_BRIDGE, 2, 0.5));
+    adsorbates.push_back(adsorbate(6, site(0, 0, 2) + 1.85 * z, ADSORPTION_SITE_TOP, 1, 1.85));
+    adsorbates.push_back(adsorbate(7, site(2, 0, 1) + (spacing + 1.3) * z, ADSORPTION_SITE_HCP, 3, 1.3));
+    adsorbates.push_back(adsorbate(8, site(0, 0, 2) + 3.0 * z, ADSORPTION_SITE_NONE, 0, 0.0));
+    adsorbates.push_back(adsorbate(8, site(1, 2, 0) + (2.0 * spacing + 1.2) * z, ADSORPTION_SITE_FCC, 3, 1.2));
+
+    return check(flip ? "Rh(111) upside down" : "Rh(111)", make_slab(cell, substrate, adsorbates, flip),
+                 adsorbates, substrate.size());
+}
+
+/*
+ * 2 x 2 Rh(100) slab of two layers with O in a fourfold hollow, above an
+ * atom of the second layer
+ */
+static bool test_fcc100(bool flip) {
+    const double d = TEST_RH_DISTANCE;
+    const double spacing = d / std::sqrt(2.0);
+
+    Eigen::Matrix3d cell = Eigen::Matrix3d::Zero();
+    cell(0,0) = cell(1,1) = 2.0 * d;
+    cell(2,2) = 20.0;
+
+    std::vector<Eigen::Vector3d> substrate;
+    for(unsigned int layer=0; layer<2; layer++) {
+        for(unsigned int i=0; i<2; i++) {
+            for(unsigned int j=0; j<2; j++) {
+                substrate.push_back(Eigen::Vector3d((i + 0.5 * layer) * d, (j + 0.5 * layer) * d, 5.0 + layer * spacing));
+            }
+        }
+    }
+
+    std::vector<Adsorbate> adsorbates;
+    adsorbates.push_back(adsorbate(8, Eigen::Vector3d(d, d, 5.0 + spacing + 0.9),
+                                   ADSORPTION_SITE_FOURFOLD, 4, 0.9));
+
+    return check(flip ? "Rh(100) upside down" : "Rh(100)", make_slab(cell, substrate, adsorbates, flip),
+                 adsorbates, substrate.size());
+}
+
+int main(int argc, char* argv[]) {
+    if(argc != 2) {
+        std::cerr << "Usage: " << argv[0] << " <fixture directory>" << std::endl;
+        return -1;
+    }
+
+    unsigned int nr_failed = 0;
+    for(unsigned int flip=0; flip<2; flip++) {
+        const bool result = test_fcc111(flip) && test_fcc100(flip);
+        std::cout << (result ? "PASS " : "FAIL ") << "adsorption sites" << (flip ? " (upside down)" : "") << std::endl;
+        nr_failed += result ? 0 : 1;
+    }
+
+    return nr_failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,148 @@
+/*************************************************************************
+ *
+ *  This file is part of v2c.
+ *
+ *  Author: Ivo Filot <i.a.w.filot@tue.nl>
+ *
+ *  v2c is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  v2c is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with v2c.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ************************************************************************/
+
+/*
+ * Regression test of the atom selection. OUTCAR_vasp5 is parsed with
+ * selections of elements, index ranges and z-windows, and the frames must
+ * hold exactly the atoms of the full frames that match the selection, in
+ * the same order and with the elements that remain. Invalid selections
+ * must be refused.
+ */
+
+#include <string>
+#include <vector>
+#include <iostream>
+#include <functional>
+
+#include "vaspreader.h"
+
+/*
+ * Whether atom <index> of element <element> at height <z> (<z_first> in the
+ * first frame) is selected
+ */
+typedef std::function<bool(const std::string &element, unsigned int index, float z_first, float z)> Predicate;
+
+static bool test_selection(const std::string &filename, const FrameStore &full, const std::string &spec,
+                           const Predicate &selected) {
+    AtomSelection selection;
+    VaspReader vr;
+    if(!selection.parse(spec)) {
+        return false;
+    }
+    vr.set_selection(selection);
+    if(!vr.read(filename.c_str()) || vr.states.size() != full.size()) {
+        std::cerr << spec << ": " << vr.states.size() << " frames instead of " << full.size() << std::endl;
+        return false;
+    }
+
+    const State first = full[0];
+    for(unsigned int f=0; f<full.size(); f++) {
+        const State expected = full[f];
+        const State state = vr.states[f];
+
+        std::vector<std::string> elements;
+        std::vector<unsigned int> counts;
+        std::vector<unsigned int> atoms;
+        unsigned int index = 0;
+        for(unsigned int e=0; e<expected.get_nr_elements(); e++) {
+            unsigned int count = 0;
+            for(unsigned int j=0; j<expected.get_atoms_for_element(e); j++, index++) {
+                if(selected(expected.get_elements()[e], index + 1, first.atoms[index].pos(2),
+                            expected.atoms[index].pos(2))) {
+                    atoms.push_back(index);
+                    count++;
+                }
+            }
+            if(count > 0) {
+                elements.push_back(expected.get_elements()[e]);
+                counts.push_back(count);
+            }
+        }
+
+        bool result = state.get_elements() == elements && state.get_nr_atoms_per_element() == counts &&
+                      state.atoms.size() == atoms.size() && state.get_total_nr_atoms() == atoms.size();
+        for(unsigned int i=0; result && i<atoms.size(); i++) {
+            result = state.atoms[i].pos == expected.atoms[atoms[i]].pos &&
+                     state.atoms[i].force == expected.atoms[atoms[i]].force;
+        }
+        if(!result) {
+            std::cerr << spec << ": frame " << f + 1 << " holds " << state.atoms.size() << " atoms instead of "
+                      << atoms.size() << ", or other ones" << std::endl;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    if(argc != 2) {
+        std::cerr << "Usage: " << argv[0] << " <fixture directory>" << std::endl;
+        return -1;
+    }
+    const std::string filename = std::string(argv[1]) + "/OUTCAR_vasp5";
+
+    VaspReader full;
+    if(!full.read(filename.c_str()) || full.states.size() < 2) {
+        std::cerr << filename << ": cannot be read" << std::endl;
+        return 1;
+    }
+
+    unsigned int nr_failed = 0;
+
+    // the Rh layers lie near 5, 7.2 and 9.4 A with C and O above them; the
+    // top layer moves across 9.405 A between the frames
+    const struct {
+        const char *spec;
+        Predicate selected;
+    } cases[] = {
+        {"C,O", [](const std::string &el, unsigned int i, float z0, float z) { return el == "C" || el == "O"; }},
+        {"1-3,28", [](const std::string &el, unsigned int i, float z0, float z) { return i <= 3 || i == 28; }},
+        {"Rh,5-9,z=6:30", [](const std::string &el, unsigned int i, float z0, float z) {
+            return el == "Rh" && i >= 5 && i <= 9 && z0 >= 6.0f; }},
+        {"O,C,,z=10:20", [](const std::string &el, unsigned int i, float z0, float z) {
+            return (el == "C" || el == "O") && z0 >= 10.0f && z0 <= 20.0f; }},
+        {"zframe=9.405:12", [](const std::string &el, unsigned int i, float z0, float z) {
+            return z >= 9.405f && z <= 12.0f; }},
+        {"Rh,zframe=9.405:12", [](const std::string &el, unsigned int i, float z0, float z) {
+            return el == "Rh" && z >= 9.405f && z <= 12.0f; }},
+        {"", [](const std::string &el, unsigned int i, float z0, float z) { return true; }},
+    };
+    for(unsigned int i=0; i<sizeof(cases) / sizeof(cases[0]); i++) {
+        const bool result = test_selection(filename, full.states, cases[i].spec, cases[i].selected);
+        std::cout << (result ? "PASS " : "FAIL ") << "selection '" << cases[i].spec << "'" << std::endl;
+        nr_failed += result ? 0 : 1;
+    }
+
+    static const char *invalid[] = {"z=5", "z=5:", "z=6:5", "zframe=a:b", "3-1", "0", "-2", "2-x"};
+    bool result = true;
+    for(unsigned int i=0; i<sizeof(invalid) / sizeof(invalid[0]); i++) {
+        AtomSelection selection;
+        if(selection.parse(invalid[i])) {
+            std::cerr << "invalid selection '" << invalid[i] << "' is accepted" << std::endl;
+            result = false;
+        }
+    }
+    std::cout << (result ? "PASS " : "FAIL ") << "selection invalid terms" << std::endl;
+    nr_failed += result ? 0 : 1;
+
+    return nr_failed == 0 ? 0 : 1;
+}
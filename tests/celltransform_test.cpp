@@ -0,0 +1,170 @@
+/*************************************************************************
+ *
+ *  This file is part of v2c.
+ *
+ *  Author: Ivo Filot <i.a.w.filot@tue.nl>
+ *
+ *  v2c is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  v2c is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with v2c.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ************************************************************************/
+
+/*
+ * Regression test of the periodic transformations. Atoms that move at
+ * constant velocity through a triclinic cell cross its faces several
+ * times; wrapping must bring every atom into the cell by a lattice
+ * translation, and unwrapping the wrapped frames must give back continuous
+ * paths. Wrapping a State must move its atoms along with its coordinates.
+ */
+
+#include <string>
+#include <vector>
+#include <iostream>
+#include <cmath>
+
+#include "celltransform.h"
+#include "test_structures.h"
+
+#define TEST_FRAMES 60
+#define TEST_ATOMS  8
+
+/*
+ * Triclinic cell with lattice vectors as rows
+ */
+static Eigen::Matrix3d make_cell() {
+    Eigen::Matrix3d cell;
+    cell << 7.0, 0.0, 0.0,
+            2.1, 6.5, 0.0,
+            -1.3, 1.7, 9.0;
+    return cell;
+}
+
+/*
+ * Whether <wrapped> lies in <cell> and differs from <position> by a
+ * lattice translation
+ */
+static bool check_wrapped(const Eigen::Matrix3d &cell, const Eigen::Vector3d &position, const Eigen::Vector3d &wrapped) {
+    const Eigen::Matrix3d to_frac = cell.inverse().transpose();
+    const Eigen::Vector3d frac = to_frac * wrapped;
+    const Eigen::Vector3d shift = to_frac * (position - wrapped);
+    return (frac.array() >= -1e-5).all() && (frac.array() < 1.0 + 1e-5).all() &&
+           (shift.array() - shift.array().round()).abs().maxCoeff() < 1e-4;
+}
+
+/*
+ * Wrap and unwrap a trajectory of atoms at constant velocity; the fastest
+ * atoms cross a face every three frames
+ */
+static bool test_trajectory() {
+    const Eigen::Matrix3d cell = make_cell();
+    uint64_t seed = 31;
+
+    std::vector<Eigen::Vector3d> start(TEST_ATOMS), velocity(TEST_ATOMS);
+    for(unsigned int i=0; i<TEST_ATOMS; i++) {
+        for(unsigned int k=0; k<3; k++) {
+            start[i](k) = 6.0 * next_random(seed);
+            velocity[i](k) = (next_random(seed) - 0.5) * 0.8 * (i + 1);
+        }
+    }
+
+    std::vector<float> positions((size_t)TEST_FRAMES * TEST_ATOMS * 3);
+    std::vector<float> cells((size_t)TEST_FRAMES * 9);
+    for(unsigned int f=0; f<TEST_FRAMES; f++) {
+        for(unsigned int i=0; i<TEST_ATOMS; i++) {
+            const Eigen::Vector3d r = start[i] + velocity[i] * f;
+            for(unsigned int k=0; k<3; k++) {
+                positions[((size_t)f * TEST_ATOMS + i) * 3 + k] = r(k);
+            }
+        }
+        for(unsigned int k=0; k<9; k++) {
+            cells[f * 9 + k] = cell(k / 3, k % 3);
+        }
+        CellTransform::wrap(&positions[(size_t)f * TEST_ATOMS * 3], TEST_ATOMS, &cells[f * 9]);
+
+        for(unsigned int i=0; i<TEST_ATOMS; i++) {
+            const float *r = &positions[((size_t)f * TEST_ATOMS + i) * 3];
+            if(!check_wrapped(cell, start[i] + velocity[i] * f, Eigen::Vector3d(r[0], r[1], r[2]))) {
+                std::cerr << "atom " << i << " of frame " << f << " is not wrapped into the cell" << std::endl;
+                return false;
+            }
+        }
+    }
+
+    // the atoms must have crossed the faces of the cell several times
+    const Eigen::Vector3d crossings = cell.inverse().transpose() * velocity[TEST_ATOMS - 1] * (TEST_FRAMES - 1);
+    if(crossings.cwiseAbs().maxCoeff() < 3.0) {
+        std::cerr << "the fastest atom crosses the cell only " << crossings.cwiseAbs().maxCoeff() << " times" << std::endl;
+        return false;
+    }
+
+    // unwrapped, the paths continue from the wrapped first frame
+    CellTransform::unwrap(&positions[0], &cells[0], TEST_FRAMES, TEST_ATOMS);
+    for(unsigned int f=0; f<TEST_FRAMES; f++) {
+        for(unsigned int i=0; i<TEST_ATOMS; i++) {
+            const float *r0 = &positions[(size_t)i * 3];
+            const float *r = &positions[((size_t)f * TEST_ATOMS + i) * 3];
+            const Eigen::Vector3d expected = Eigen::Vector3d(r0[0], r0[1], r0[2]) + velocity[i] * f;
+            if((Eigen::Vector3d(r[0], r[1], r[2]) - expected).norm() > 1e-3) {
+                std::cerr << "atom " << i << " of frame " << f << " is not on its path after unwrapping" << std::endl;
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+/*
+ * Wrap a State with atoms several cells away
+ */
+static bool test_state() {
+    const Eigen::Matrix3d cell = make_cell();
+    std::vector<Eigen::Vector3d> positions;
+    positions.push_back(Eigen::Vector3d(-15.2, 3.1, 4.0));
+    positions.push_back(Eigen::Vector3d(3.0, 22.7, -8.5));
+    positions.push_back(Eigen::Vector3d(1.0, 1.0, 1.0));
+    positions.push_back(Eigen::Vector3d(40.3, -33.1, 27.9));
+    State state = make_state(cell, positions, std::vector<unsigned int>(positions.size(), 45));
+
+    CellTransform::wrap(state);
+    for(unsigned int i=0; i<positions.size(); i++) {
+        const Eigen::Vector3d atom = state.atoms[i].pos.cast<double>();
+        const Eigen::Vector3d row = state.coordinates.row(i).head<3>().transpose().cast<double>();
+        if(!check_wrapped(cell, positions[i], atom) || (atom - row).norm() > 1e-5) {
+            std::cerr << "atom " << i << " of the state is not wrapped into the cell" << std::endl;
+            return false;
+        }
+    }
+
+    // an atom inside the cell stays where it is
+    return (state.atoms[2].pos.cast<double>() - positions[2]).norm() < 1e-5;
+}
+
+int main(int argc, char* argv[]) {
+    if(argc != 2) {
+        std::cerr << "Usage: " << argv[0] << " <fixture directory>" << std::endl;
+        return -1;
+    }
+
+    unsigned int nr_failed = 0;
+
+    bool result = test_trajectory();
+    std::cout << (result ? "PASS " : "FAIL ") << "celltransform wrap and unwrap" << std::endl;
+    nr_failed += result ? 0 : 1;
+
+    result = test_state();
+    std::cout << (result ? "PASS " : "FAIL ") << "celltransform wrap state" << std::endl;
+    nr_failed += result ? 0 : 1;
+
+    return nr_failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,177 @@
+/*************************************************************************
+ *
+ *  This file is part of v2c.
+ *
+ *  Author: Ivo Filot <i.a.w.filot@tue.nl>
+ *
+ *  v2c is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  v2c is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with v2c.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ************************************************************************/
+
+/*
+ * Regression test of the conversion cache. OUTCAR_vasp5 is copied in two
+ * parts, the first of which ends in the middle of an ionic step, as it
+ * would while VASP is running. After the first part is converted, the file
+ * must be reported as unchanged, also by a reopened cache; once the rest is
+ * appended, resuming from the checkpoint must give the remaining frames of
+ * the whole file, and a file that is rewritten must be parsed again.
+ */
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <cmath>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "conversioncache.h"
+#include "trajectory.h"
+
+static bool write_file(const std::string &filename, const std::string &data, bool append) {
+    std::ofstream outfile(filename.c_str(), append ? std::ios::binary | std::ios::app : std::ios::binary);
+    outfile << data;
+    outfile.close();
+    return outfile.good();
+}
+
+/*
+ * Whether frames <first> .. of <expected> equal the frames of <trajectory>
+ */
+static bool same_frames(const Trajectory &trajectory, const Trajectory &expected, unsigned int first) {
+    if(trajectory.get_nr_frames() + first != expected.get_nr_frames() ||
+       trajectory.get_nr_atoms() != expected.get_nr_atoms()) {
+        std::cerr << "resumed " << trajectory.get_nr_frames() << " frames instead of "
+                  << expected.get_nr_frames() - first << std::endl;
+        return false;
+    }
+
+    const size_t nr_values = (size_t)trajectory.get_nr_frames() * trajectory.get_nr_atoms() * 3;
+    for(size_t i=0; i<nr_values; i++) {
+        if(std::fabs(trajectory.get_positions()[i] - expected.get_positions(first)[i]) > 1e-5) {
+            std::cerr << "resumed frames differ from the frames of the whole file" << std::endl;
+            return false;
+        }
+    }
+    for(unsigned int f=0; f<trajectory.get_nr_frames(); f++) {
+        if(std::fabs(trajectory.get_energies()[f] - expected.get_energies()[first + f]) > 1e-8) {
+            std::cerr << "energy of resumed frame " << f << " differs" << std::endl;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static bool test_cache(const std::string &fixture, const std::string &dir) {
+    std::ifstream infile(fixture.c_str(), std::ios::binary);
+    std::stringstream contents;
+    contents << infile.rdbuf();
+    const std::string data = contents.str();
+
+    VaspReader whole;
+    if(!whole.read(fixture.c_str()) || whole.states.size() < 3) {
+        std::cerr << fixture << ": cannot be read" << std::endl;
+        return false;
+    }
+    const Trajectory expected(whole.states);
+
+    // the first part ends halfway the POSITION block of the second step
+    size_t split = data.find(" POSITION");
+    split = data.find(" POSITION", split + 1);
+    split = data.find('\n', data.find('\n', split + 200) + 1) + 20;
+
+    const std::string outcar = dir + "/OUTCAR";
+    const std::string journal = dir + "/cache";
+    if(!write_file(outcar, data.substr(0, split), false)) {
+        std::cerr << "cannot write " << outcar << std::endl;
+        return false;
+    }
+
+    OutcarCheckpoint checkpoint;
+    {
+        ConversionCache cache;
+        if(!cache.open(journal) || cache.check(outcar, &checkpoint) != CONVERSION_CACHE_NEW) {
+            std::cerr << "a file that was never converted is not new" << std::endl;
+            return false;
+        }
+
+        VaspReader vr;
+        vr.read(outcar.c_str());
+        if(vr.states.size() != 1 || !cache.update(outcar, vr.get_checkpoint()) ||
+           cache.check(outcar, &checkpoint) != CONVERSION_CACHE_UNCHANGED) {
+            std::cerr << "the first part gives " << vr.states.size() << " frames and is not cached" << std::endl;
+            return false;
+        }
+    }
+
+    ConversionCache cache;
+    if(!cache.open(journal) || cache.size() != 1 || cache.check(outcar, &checkpoint) != CONVERSION_CACHE_UNCHANGED) {
+        std::cerr << "a reopened cache does not hold the first part" << std::endl;
+        return false;
+    }
+
+    // VASP writes the rest of the file
+    if(!write_file(outcar, data.substr(split), true) ||
+       cache.check(outcar, &checkpoint) != CONVERSION_CACHE_APPENDED) {
+        std::cerr << "appended data is not detected" << std::endl;
+        return false;
+    }
+    VaspReader vr;
+    if(!vr.resume(outcar.c_str(), checkpoint) || !same_frames(Trajectory(vr.states), expected, 1)) {
+        return false;
+    }
+    cache.update(outcar, vr.get_checkpoint());
+
+    // another run of the same size, which starts with the same bytes
+    std::string rewritten = data;
+    rewritten[rewritten.size() / 2] = rewritten[rewritten.size() / 2] == '1' ? '2' : '1';
+    if(!write_file(outcar, rewritten, false) || cache.check(outcar, &checkpoint) != CONVERSION_CACHE_NEW) {
+        std::cerr << "a rewritten file is not new" << std::endl;
+        return false;
+    }
+
+    // the journal holds two entries of the file, which are compacted
+    ConversionCache compacted;
+    if(!compacted.open(journal) || compacted.size() != 1) {
+        std::cerr << "the journal is not compacted" << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    if(argc != 2) {
+        std::cerr << "Usage: " << argv[0] << " <fixture directory>" << std::endl;
+        return -1;
+    }
+
+    char dir[] = "/tmp/v2c_cache_XXXXXX";
+    if(mkdtemp(dir) == NULL) {
+        std::cerr << "cannot create a temporary directory" << std::endl;
+        return 1;
+    }
+
+    const bool result = test_cache(std::string(argv[1]) + "/OUTCAR_vasp5", dir);
+    std::cout << (result ? "PASS " : "FAIL ") << "conversion cache" << std::endl;
+
+    unlink((std::string(dir) + "/OUTCAR").c_str());
+    unlink((std::string(dir) + "/cache").c_str());
+    rmdir(dir);
+
+    return result ? 0 : 1;
+}
@@ -0,0 +1,255 @@
+/*************************************************************************
+ *
+ *  This file is part of v2c.
+ *
+ *  Author: Ivo Filot <i.a.w.filot@tue.nl>
+ *
+ *  v2c is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  v2c is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with v2c.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ************************************************************************/
+
+/*
+ * Regression test of the resident server. A server runs in a thread with a
+ * command handler that writes from several threads; requests are sent in
+ * the wire format by a minimal client in this test, since the client of
+ * the library writes to the standard streams that the server redirects.
+ * The socket must be accessible to its owner only, a command must run in
+ * the directory of the request with its output, errors and exit code
+ * returned, failing and forbidden commands must be reported, and the
+ * shutdown command must stop the server.
+ */
+
+#include <string>
+#include <vector>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "conversionserver.h"
+
+#define TEST_NR_WORKERS 4
+#define TEST_NR_LINES   100
+
+struct Response {
+  std::string output;
+  std::string errors;
+  int32_t code;
+};
+
+static bool read_all(int fd, void *data, size_t length) {
+    char *ptr = (char*)data;
+    while(length > 0) {
+        const ssize_t result = read(fd, ptr, length);
+        if(result <= 0) {
+            return false;
+        }
+        ptr += result;
+        length -= result;
+    }
+    return true;
+}
+
+/*
+ * Send <args> to be run in <directory> and collect the response
+ */
+static bool send_request(const std::string &socket_path, const std::string &directory,
+                         const std::vector<std::string> &args, Response &response) {
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strcpy(address.sun_path, socket_path.c_str());
+    const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if(fd < 0 || connect(fd, (struct sockaddr*)&address, sizeof(address)) != 0) {
+        if(fd >= 0) {
+            close(fd);
+        }
+        return false;
+    }
+
+    std::string message;
+    const uint32_t n = args.size() + 1;
+    message.append((const char*)&n, sizeof(n));
+    message.append(directory.c_str(), directory.size() + 1);
+    for(unsigned int i=0; i<args.size(); i++) {
+        message.append(args[i].c_str(), args[i].size() + 1);
+    }
+
+    response.output.clear();
+    response.errors.clear();
+    bool finished = write(fd, message.data(), message.size()) == (ssize_t)message.size();
+    char channel;
+    uint32_t length;
+    std::vector<char> data;
+    while(finished && read_all(fd, &channel, 1) && read_all(fd, &length, sizeof(length))) {
+        data.resize(length + 1);
+        if(length > 0 && !read_all(fd, data.data(), length)) {
+            finished = false;
+            break;
+        }
+        if(channel == CONVERSION_SERVER_CHANNEL_OUTPUT) {
+            response.output.append(data.data(), length);
+        } else if(channel == CONVERSION_SERVER_CHANNEL_ERROR) {
+            response.errors.append(data.data(), length);
+        } else if(channel == CONVERSION_SERVER_CHANNEL_EXIT && length == sizeof(response.code)) {
+            memcpy(&response.code, data.data(), sizeof(response.code));
+            close(fd);
+            return true;
+        }
+    }
+    close(fd);
+    return false;
+}
+
+/*
+ * Command handler: "echo" prints the working directory and the arguments,
+ * and TEST_NR_LINES lines from each of TEST_NR_WORKERS threads; "throw"
+ * throws an exception; "serve" is refused as by the command dispatcher
+ */
+static int handle(const std::vector<std::string> &args) {
+    if(args[0] == "throw") {
+        throw std::runtime_error("broken command");
+    }
+    if(args[0] == "serve" && ConversionServer::is_handling()) {
+        std::cerr << "The serve command cannot be run by the server." << std::endl;
+        return -1;
+    }
+
+    char cwd[PATH_MAX];
+    std::cout << "cwd " << (getcwd(cwd, sizeof(cwd)) != NULL ? cwd : "") << std::endl;
+    for(unsigned int i=1; i<args.size(); i++) {
+        std::cout << "arg " << args[i] << std::endl;
+    }
+
+    std::vector<std::thread> workers;
+    for(unsigned int w=0; w<TEST_NR_WORKERS; w++) {
+        workers.push_back(std::thread([w]() {
+            for(unsigned int i=0; i<TEST_NR_LINES; i++) {
+                std::cout << "worker " << w << " line " << i << std::endl;
+            }
+        }));
+    }
+    for(unsigned int w=0; w<workers.size(); w++) {
+        workers[w].join();
+    }
+
+    std::cerr << "done";
+    return args.size();
+}
+
+/*
+ * Whether every line of the echo command arrived whole: the worker lines
+ * of every thread in order, after the directory and the arguments
+ */
+static bool check_echo(const Response &response, const std::string &directory) {
+    std::istringstream str(response.output);
+    std::string line;
+    std::vector<unsigned int> next(TEST_NR_WORKERS, 0);
+    bool result = std::getline(str, line) && line == "cwd " + directory &&
+                  std::getline(str, line) && line == "arg a b" &&
+                  std::getline(str, line) && line == "arg c";
+    while(result && std::getline(str, line)) {
+        unsigned int w = TEST_NR_WORKERS;
+        unsigned int i = 0;
+        result = sscanf(line.c_str(), "worker %u line %u", &w, &i) == 2 && w < TEST_NR_WORKERS && i == next[w]++ &&
+                 line == "worker " + std::to_string(w) + " line " + std::to_string(i);
+    }
+    for(unsigned int w=0; w<TEST_NR_WORKERS; w++) {
+        result = result && next[w] == TEST_NR_LINES;
+    }
+
+    return result && response.errors == "done" && response.code == 3;
+}
+
+int main(int argc, char* argv[]) {
+    if(argc != 2) {
+        std::cerr << "Usage: " << argv[0] << " <fixture directory>" << std::endl;
+        return -1;
+    }
+
+    char dir[] = "/tmp/v2c_server_XXXXXX";
+    char directory[PATH_MAX];
+    if(mkdtemp(dir) == NULL || realpath(dir, directory) == NULL) {
+        std::cerr << "cannot create a temporary directory" << std::endl;
+        return 1;
+    }
+    const std::string socket_path = std::string(directory) + "/socket";
+    char cwd[PATH_MAX];
+    if(getcwd(cwd, sizeof(cwd)) == NULL) {
+        return 1;
+    }
+
+    unsigned int nr_failed = 0;
+
+    ConversionServer server(handle);
+    struct stat status;
+    bool result = server.open(socket_path) && stat(socket_path.c_str(), &status) == 0 &&
+                  S_ISSOCK(status.st_mode) && (status.st_mode & 0777) == 0600;
+    std::cout << (result ? "PASS " : "FAIL ") << "server socket mode" << std::endl;
+    nr_failed += result ? 0 : 1;
+    if(!result) {
+        rmdir(directory);
+        return 1;
+    }
+
+    std::thread thread([&server]() {
+        server.run();
+    });
+
+    // a second server on the same socket is refused
+    ConversionServer other(handle);
+    result = !other.open(socket_path);
+    std::cout << (result ? "PASS " : "FAIL ") << "server already listening" << std::endl;
+    nr_failed += result ? 0 : 1;
+
+    std::vector<std::string> args;
+    args.push_back("echo");
+    args.push_back("a b");
+    args.push_back("c");
+    Response response;
+    result = send_request(socket_path, directory, args, response) && check_echo(response, directory);
+    std::cout << (result ? "PASS " : "FAIL ") << "server command output" << std::endl;
+    nr_failed += result ? 0 : 1;
+
+    result = send_request(socket_path, directory, std::vector<std::string>(1, "throw"), response) &&
+             response.code == -1 && response.errors.find("broken command") != std::string::npos &&
+             send_request(socket_path, directory, std::vector<std::string>(1, "serve"), response) &&
+             response.code == -1 && response.errors.find("cannot be run") != std::string::npos &&
+             send_request(socket_path, std::string(directory) + "/missing", args, response) &&
+             response.code == -1 && response.output.empty();
+    std::cout << (result ? "PASS " : "FAIL ") << "server failing commands" << std::endl;
+    nr_failed += result ? 0 : 1;
+
+    // the library client is only used for the shutdown, which prints nothing
+    const int code = ConversionServer::request(socket_path, std::vector<std::string>(1, "shutdown"));
+    thread.join();
+    server.close();
+    char restored[PATH_MAX];
+    result = code == 0 && !ConversionServer::is_handling() && server.get_nr_requests() == 4 && stat(socket_path.c_str(), &status) != 0 &&
+             getcwd(restored, sizeof(restored)) != NULL && std::string(restored) == cwd;
+    std::cout << (result ? "PASS " : "FAIL ") << "server shutdown" << std::endl;
+    nr_failed += result ? 0 : 1;
+
+    rmdir(directory);
+
+    return nr_failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,130 @@
+/*************************************************************************
+ *
+ *  This file is part of v2c.
+ *
+ *  Author: Ivo Filot <i.a.w.filot@tue.nl>
+ *
+ *  v2c is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  v2c is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with v2c.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ************************************************************************/
+
+/*
+ * Regression test of the MSD and VACF. Atoms that move at a constant
+ * velocity v, and are wrapped back into the cell every time they cross a
+ * boundary, must give MSD(t) = |v t|^2 and VACF(t) = |v|^2; atoms at rest
+ * must give zero for both. The frames are analyzed both as a whole
+ * trajectory and from a frame store, one atom at a time.
+ */
+
+#include <string>
+#include <vector>
+#include <iostream>
+#include <cmath>
+
+#include "correlation.h"
+#include "test_structures.h"
+
+#define TEST_FRAMES   100
+#define TEST_TIMESTEP 2.0
+#define TEST_CELL     10.0
+
+/*
+ * Frame <f>: four Ar atoms at constant velocities and two Kr atoms at rest,
+ * all wrapped into a cubic cell
+ */
+static State make_frame(unsigned int f, const double velocity[3]) {
+    std::vector<Eigen::Vector3d> positions;
+    std::vector<unsigned int> elnrs;
+    for(unsigned int i=0; i<6; i++) {
+        Eigen::Vector3d pos;
+        for(unsigned int k=0; k<3; k++) {
+            pos(k) = 1.5 * i + 0.7 * k + (i < 4 ? velocity[k] * TEST_TIMESTEP * f : 0.0);
+            pos(k) -= std::floor(pos(k) / TEST_CELL) * TEST_CELL;
+        }
+        positions.push_back(pos);
+        elnrs.push_back(i < 4 ? 18 : 36);
+    }
+
+    return make_state(TEST_CELL * Eigen::Matrix3d::Identity(), positions, elnrs, f + 1);
+}
+
+static bool check(const std::string &label, const CorrelationAnalysis &analysis, double v2) {
+    if(analysis.get_nr_elements() != 2) {
+        std::cerr << label << ": " << analysis.get_nr_elements() << " elements instead of 2" << std::endl;
+        return false;
+    }
+
+    for(unsigned int m=0; m<TEST_FRAMES; m++) {
+        const double t = m * TEST_TIMESTEP;
+        const double expected[2][2] = {{v2 * t * t, v2}, {0.0, 0.0}};
+        for(unsigned int e=0; e<2; e++) {
+            const double msd = analysis.get_msd(e)[m];
+            const double vacf = analysis.get_vacf(e)[m];
+            if(std::fabs(msd - expected[e][0]) > 1e-3 * (1.0 + expected[e][0]) ||
+               std::fabs(vacf - expected[e][1]) > 1e-3 * (1.0 + expected[e][1])) {
+                std::cerr << label << ": lag " << m << " of " << analysis.get_elements()[e] << " gives MSD "
+                          << msd << " and VACF " << vacf << " instead of " << expected[e][0] << " and "
+                          << expected[e][1] << std::endl;
+                return false;
+            }
+        }
+    }
+
+    if(std::fabs(analysis.get_diffusion_coefficient(1)) > 1e-8) {
+        std::cerr << label << ": atoms at rest diffuse" << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    if(argc != 2) {
+        std::cerr << "Usage: " << argv[0] << " <fixture directory>" << std::endl;
+        return -1;
+    }
+
+    // [A/fs]; crosses the cell boundaries several times in every direction
+    const double velocity[3] = {0.21, -0.13, 0.34};
+    const double v2 = velocity[0] * velocity[0] + velocity[1] * velocity[1] + velocity[2] * velocity[2];
+
+    std::vector<State> states;
+    FrameStore store;
+    for(unsigned int f=0; f<TEST_FRAMES; f++) {
+        states.push_back(make_frame(f, velocity));
+        store.push_back(states.back());
+    }
+
+    ThreadPool pool(2);
+    unsigned int nr_failed = 0;
+
+    CorrelationAnalysis whole(TEST_TIMESTEP);
+    bool result = whole.calculate(Trajectory(states), pool) && check("trajectory", whole, v2);
+    std::cout << (result ? "PASS " : "FAIL ") << "correlation trajectory" << std::endl;
+    nr_failed += result ? 0 : 1;
+
+    // a budget of a single time series gathers one atom at a time
+    CorrelationAnalysis blocked(TEST_TIMESTEP);
+    result = blocked.calculate(store, TEST_FRAMES * 3 * sizeof(float), pool) && check("frame store", blocked, v2);
+    std::cout << (result ? "PASS " : "FAIL ") << "correlation frame store" << std::endl;
+    nr_failed += result ? 0 : 1;
+
+    std::vector<State> short_states(states.begin(), states.begin() + 2);
+    CorrelationAnalysis too_short(TEST_TIMESTEP);
+    result = !too_short.calculate(Trajectory(short_states), pool);
+    std::cout << (result ? "PASS " : "FAIL ") << "correlation two frames" << std::endl;
+    nr_failed += result ? 0 : 1;
+
+    return nr_failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,204 @@
+/*************************************************************************
+ *
+ *  This file is part of v2c.
+ *
+ *  Author: Ivo Filot <i.a.w.filot@tue.nl>
+ *
+ *  v2c is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  v2c is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with v2c.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ************************************************************************/
+
+/*
+ * Regression test of the structure fingerprints and their index. The last
+ * frame of OUTCAR_vasp5 must keep its fingerprint when the atoms are
+ * permuted, when the structure is translated or rotated, and when the cell
+ * is given in another basis; moving a single atom or straining the cell
+ * must change it. The index must return the entries written to it after it
+ * is opened again.
+ */
+
+#include <string>
+#include <vector>
+#include <iostream>
+#include <cmath>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "vaspreader.h"
+#include "fingerprint.h"
+#include "test_structures.h"
+
+/*
+ * Copy of <state> with lattice vectors <cell> (rows) and the atoms at
+ * <positions>; the elements are listed in <order> and the atoms of each
+ * element are stored in reverse when <reverse> is set
+ */
+static State rebuild(const State &state, const Eigen::Matrix3d &cell, const std::vector<Eigen::Vector3d> &positions,
+                     const std::vector<unsigned int> &order, bool reverse) {
+    std::vector<unsigned int> offsets(1, 0);
+    for(unsigned int e=0; e<state.get_nr_elements(); e++) {
+        offsets.push_back(offsets.back() + state.get_atoms_for_element(e));
+    }
+
+    std::vector<Eigen::Vector3d> reordered;
+    std::vector<unsigned int> elnrs;
+    for(unsigned int k=0; k<order.size(); k++) {
+        const unsigned int e = order[k];
+        for(unsigned int a=offsets[e]; a<offsets[e+1]; a++) {
+            const unsigned int i = reverse ? offsets[e] + offsets[e+1] - 1 - a : a;
+            reordered.push_back(positions[i]);
+            elnrs.push_back(state.atoms[i].elnr);
+        }
+    }
+
+    return make_state(cell, reordered, elnrs);
+}
+
+static bool test_invariance(const State &state) {
+    const Fingerprint fingerprint;
+    const uint64_t reference = fingerprint.calculate(state);
+
+    const Eigen::Matrix3d cell = state.dimensions.cast<double>();
+    std::vector<Eigen::Vector3d> positions;
+    for(unsigned int i=0; i<state.atoms.size(); i++) {
+        positions.push_back(state.atoms[i].pos.cast<double>());
+    }
+    std::vector<unsigned int> order;
+    for(unsigned int e=0; e<state.get_nr_elements(); e++) {
+        order.push_back(e);
+    }
+    std::vector<unsigned int> reversed(order.rbegin(), order.rend());
+
+    // translated, and wrapped back into the cell
+    const Eigen::Vector3d shift(1.3, -0.7, 2.9);
+    const Eigen::Matrix3d to_frac = cell.inverse().transpose();
+    std::vector<Eigen::Vector3d> translated;
+    for(unsigned int i=0; i<positions.size(); i++) {
+        Eigen::Vector3d frac = to_frac * (positions[i] + shift);
+        frac = frac.array() - frac.array().floor();
+        translated.push_back(cell.transpose() * frac);
+    }
+
+    // cell and atoms rotated together
+    const Eigen::Matrix3d rotation = Eigen::AngleAxisd(0.7, Eigen::Vector3d(1.0, 2.0, -1.0).normalized()).toRotationMatrix();
+    std::vector<Eigen::Vector3d> rotated;
+    for(unsigned int i=0; i<positions.size(); i++) {
+        rotated.push_back(rotation * positions[i]);
+    }
+
+    // the same lattice spanned by a + b, b and c - 2 a
+    Eigen::Matrix3d basis = cell;
+    basis.row(0) = cell.row(0) + cell.row(1);
+    basis.row(2) = cell.row(2) - 2.0 * cell.row(0);
+
+    const struct {
+        const char *label;
+        State state;
+    } same[] = {
+        {"permuted", rebuild(state, cell, positions, reversed, true)},
+        {"translated", rebuild(state, cell, translated, order, false)},
+        {"rotated", rebuild(state, cell * rotation.transpose(), rotated, order, false)},
+        {"other basis", rebuild(state, basis, positions, order, false)},
+    };
+    for(unsigned int i=0; i<sizeof(same) / sizeof(same[0]); i++) {
+        if(fingerprint.calculate(same[i].state) != reference) {
+            std::cerr << "fingerprint changes when the structure is " << same[i].label << std::endl;
+            return false;
+        }
+    }
+
+    // a displaced atom and a strained cell
+    std::vector<Eigen::Vector3d> displaced = positions;
+    displaced.back() += Eigen::Vector3d(0.0, 0.0, 0.4);
+    const State different[] = {
+        rebuild(state, cell, displaced, order, false),
+        rebuild(state, cell * 1.02, positions, order, false),
+    };
+    for(unsigned int i=0; i<sizeof(different) / sizeof(different[0]); i++) {
+        if(fingerprint.calculate(different[i]) == reference) {
+            std::cerr << "fingerprint of a different structure is the same" << std::endl;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/*
+ * Entries written to an index file are found again after reopening it; an
+ * index written with other tolerances is refused
+ */
+static bool test_index() {
+    char filename[] = "/tmp/v2c_fingerprint_XXXXXX";
+    const int fd = mkstemp(filename);
+    if(fd < 0) {
+        std::cerr << "cannot create a temporary index" << std::endl;
+        return false;
+    }
+    close(fd);
+    unlink(filename);
+
+    const Fingerprint fingerprint;
+    bool result = true;
+    {
+        FingerprintIndex index(fingerprint);
+        result = index.open(filename) &&
+                 index.insert(0x0123456789abcdefULL, "OUTCAR", 3, "out/POSCAR with spaces") &&
+                 index.insert(42, "run 2/OUTCAR", 0, "") &&
+                 !index.insert(42, "OUTCAR", 7, "out/POSCAR_7") &&
+                 index.size() == 2;
+    }
+
+    FingerprintIndex index(fingerprint);
+    const FingerprintEntry *entry = result && index.open(filename) ? index.find(0x0123456789abcdefULL) : NULL;
+    const FingerprintEntry *other = entry != NULL ? index.find(42) : NULL;
+    if(entry == NULL || other == NULL || index.size() != 2 || index.find(43) != NULL ||
+       entry->filename != "OUTCAR" || entry->state_id != 3 || entry->path != "out/POSCAR with spaces" ||
+       other->filename != "run 2/OUTCAR" || other->state_id != 0 || !other->path.empty()) {
+        std::cerr << "index entries are not restored" << std::endl;
+        result = false;
+    }
+
+    FingerprintIndex coarse(Fingerprint(0.1, 0.01));
+    if(result && coarse.open(filename)) {
+        std::cerr << "index with other tolerances is accepted" << std::endl;
+        result = false;
+    }
+
+    unlink(filename);
+    return result;
+}
+
+int main(int argc, char* argv[]) {
+    if(argc != 2) {
+        std::cerr << "Usage: " << argv[0] << " <fixture directory>" << std::endl;
+        return -1;
+    }
+    const std::string dir(argv[1]);
+
+    unsigned int nr_failed = 0;
+
+    VaspReader vr;
+    bool result = vr.read((dir + "/OUTCAR_vasp5").c_str()) && !vr.states.empty() &&
+                  test_invariance(vr.states.back());
+    std::cout << (result ? "PASS " : "FAIL ") << "fingerprint invariance" << std::endl;
+    nr_failed += result ? 0 : 1;
+
+    result = test_index();
+    std::cout << (result ? "PASS " : "FAIL ") << "fingerprint index" << std::endl;
+    nr_failed += result ? 0 : 1;
+
+    return nr_failed == 0 ? 0 : 1;
+}
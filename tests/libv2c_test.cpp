@@ -0,0 +1,136 @@
+/*************************************************************************
+ *
+ *  This file is part of v2c.
+ *
+ *  Author: Ivo Filot <i.a.w.filot@tue.nl>
+ *
+ *  v2c is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  v2c is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with v2c.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ************************************************************************/
+
+/*
+ * Regression test of the C interface. The fixtures are opened through
+ * libv2c and the buffers it hands out are compared with the arrays that were
+ * exported from them (<fixture>_*.npy); the frame views must point into
+ * the same buffers, and a missing file must be reported.
+ */
+
+#include <string>
+#include <iostream>
+#include <cmath>
+
+#include "libv2c.h"
+#include "trajectory.h"
+
+#define TEST_TOLERANCE 1e-4
+
+static bool compare(const std::string &name, const char *label,
+                    const float *values, const float *expected, size_t n) {
+    for(size_t i=0; i<n; i++) {
+        if(std::fabs(values[i] - expected[i]) > TEST_TOLERANCE) {
+            std::cerr << name << ": " << label << "[" << i << "] is " << values[i]
+                      << " instead of " << expected[i] << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+/*
+ * Open <dir>/<name> and compare the buffers with the stored arrays
+ */
+static bool test_fixture(const std::string &dir, const std::string &name) {
+    const std::string filename = dir + "/" + name;
+    v2c_trajectory *trajectory = v2c_open(filename.c_str());
+    if(trajectory == NULL) {
+        std::cerr << name << ": " << v2c_last_error() << std::endl;
+        return false;
+    }
+
+    Trajectory expected;
+    if(!expected.load_from_npy(filename)) {
+        std::cerr << name << ": cannot load the expected arrays" << std::endl;
+        v2c_close(trajectory);
+        return false;
+    }
+
+    const unsigned int nr_frames = v2c_get_nr_frames(trajectory);
+    const unsigned int nr_atoms = v2c_get_nr_atoms(trajectory);
+    bool result = nr_frames == expected.get_nr_frames() && nr_atoms == expected.get_nr_atoms() &&
+                  v2c_get_nr_elements(trajectory) == expected.get_elements().size();
+    if(!result) {
+        std::cerr << name << ": " << nr_frames << " frames of " << nr_atoms << " atoms instead of "
+                  << expected.get_nr_frames() << " frames of " << expected.get_nr_atoms() << " atoms" << std::endl;
+    }
+
+    for(unsigned int i=0; result && i<v2c_get_nr_elements(trajectory); i++) {
+        if(expected.get_elements()[i] != v2c_get_element(trajectory, i) ||
+           expected.get_nr_atoms_per_element()[i] != v2c_get_atoms_for_element(trajectory, i)) {
+            std::cerr << name << ": elements differ" << std::endl;
+            result = false;
+        }
+    }
+
+    const size_t nr_values = (size_t)nr_frames * nr_atoms * 3;
+    result = result &&
+             compare(name, "positions", v2c_get_positions(trajectory), expected.get_positions(), nr_values) &&
+             compare(name, "forces", v2c_get_forces(trajectory), expected.get_forces(), nr_values) &&
+             compare(name, "cells", v2c_get_cells(trajectory), expected.get_cells(), nr_frames * 9);
+
+    // the frame views point into the buffers of the whole trajectory
+    v2c_frame frame;
+    unsigned int index = 0;
+    while(result && v2c_next_frame(trajectory, &frame)) {
+        if(frame.index != index ||
+           frame.positions != v2c_get_positions(trajectory) + (size_t)index * nr_atoms * 3 ||
+           frame.forces != v2c_get_forces(trajectory) + (size_t)index * nr_atoms * 3 ||
+           frame.cell != v2c_get_cells(trajectory) + (size_t)index * 9 ||
+           frame.energy != v2c_get_energies(trajectory)[index] ||
+           std::fabs(frame.energy - expected.get_energies()[index]) > 1e-8) {
+            std::cerr << name << ": frame " << index << " is not a view on the trajectory" << std::endl;
+            result = false;
+        }
+        index++;
+    }
+    if(result && index != nr_frames) {
+        std::cerr << name << ": iterated " << index << " of " << nr_frames << " frames" << std::endl;
+        result = false;
+    }
+
+    v2c_close(trajectory);
+    return result;
+}
+
+int main(int argc, char* argv[]) {
+    if(argc != 2) {
+        std::cerr << "Usage: " << argv[0] << " <fixture directory>" << std::endl;
+        return -1;
+    }
+    const std::string dir(argv[1]);
+
+    static const char* fixtures[] = {"OUTCAR_vasp5", "OUTCAR_vasp6", "OUTCAR_mlff"};
+    unsigned int nr_failed = 0;
+    for(unsigned int i=0; i<sizeof(fixtures) / sizeof(fixtures[0]); i++) {
+        const bool result = test_fixture(dir, fixtures[i]);
+        std::cout << (result ? "PASS " : "FAIL ") << "libv2c " << fixtures[i] << std::endl;
+        nr_failed += result ? 0 : 1;
+    }
+
+    const bool missing = v2c_open((dir + "/OUTCAR_missing").c_str()) == NULL &&
+                         std::string(v2c_last_error()).find("OUTCAR_missing") != std::string::npos;
+    std::cout << (missing ? "PASS " : "FAIL ") << "libv2c missing file" << std::endl;
+    nr_failed += missing ? 0 : 1;
+
+    return nr_failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,226 @@
+/*************************************************************************
+ *
+ *  This file is part of v2c.
+ *
+ *  Author: Ivo Filot <i.a.w.filot@tue.nl>
+ *
+ *  v2c is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  v2c is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with v2c.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ************************************************************************/
+
+/*
+ * Regression test of the .npy writer. Arrays of every supported type and of
+ * one to three dimensions are written and the files are checked byte by
+ * byte: the magic string and version 1.0, the header length, the
+ * dictionary with the type, C order and the shape as a Python tuple, the
+ * padding that aligns the data to 64 bytes and the data itself. An array
+ * of Real must be stored as <f4 or <f8 to match the build, and the files
+ * must be read back by the NpyReader.
+ */
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "npywriter.h"
+#include "npyreader.h"
+#include "mathfunc.h"
+
+static std::string read_file(const std::string &filename) {
+    std::ifstream infile(filename.c_str(), std::ios::binary);
+    std::stringstream contents;
+    contents << infile.rdbuf();
+    return contents.str();
+}
+
+/*
+ * Check the header of the .npy file in <buffer> against <dict> (without
+ * padding) and the data block against the <size> bytes at <data>
+ */
+static bool check_file(const std::string &label, const std::string &buffer, const std::string &dict,
+                       const void *data, size_t size) {
+    if(buffer.size() < 10 || buffer.compare(0, 8, std::string("\x93NUMPY\x01\x00", 8)) != 0) {
+        std::cerr << label << ": no .npy version 1.0 magic string" << std::endl;
+        return false;
+    }
+
+    const size_t length = (unsigned char)buffer[8] | ((unsigned char)buffer[9] << 8);
+    const size_t offset = 10 + length;
+    if(offset % NPY_HEADER_ALIGNMENT != 0 || buffer.size() != offset + size) {
+        std::cerr << label << ": data at " << offset << " in " << buffer.size() << " bytes" << std::endl;
+        return false;
+    }
+
+    const std::string header = buffer.substr(10, length);
+    const size_t end = header.find_last_not_of(' ', length - 2);
+    if(header.compare(0, dict.size(), dict) != 0 || end + 1 != dict.size() || header[length - 1] != '\n') {
+        std::cerr << label << ": header is \"" << header << "\" instead of \"" << dict << "\"" << std::endl;
+        return false;
+    }
+
+    if(size > 0 && buffer.compare(offset, size, (const char*)data, size) != 0) {
+        std::cerr << label << ": data differ" << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+static bool test_arrays(const std::string &filename) {
+    NpyWriter writer;
+    NpyReader reader;
+
+    std::vector<float> floats(12);
+    std::vector<double> doubles(5);
+    std::vector<int32_t> ints(12);
+    std::vector<Real> reals(12);
+    for(unsigned int i=0; i<12; i++) {
+        floats[i] = 0.25f * i - 1.0f;
+        ints[i] = (int32_t)i * 1000 - 5000;
+        reals[i] = Real(1.0) / (i + 1);
+        if(i < doubles.size()) {
+            doubles[i] = 1e300 / (i + 1);
+        }
+    }
+
+    std::vector<size_t> shape;
+    shape.push_back(3);
+    shape.push_back(4);
+    std::vector<float> result;
+    bool ok = writer.write(filename, &floats[0], shape) &&
+              check_file("float [3, 4]", read_file(filename), "{'descr': '<f4', 'fortran_order': False, 'shape': (3, 4), }",
+                         &floats[0], floats.size() * sizeof(float)) &&
+              reader.read(filename) && reader.get(result) && result == floats && reader.get_shape() == shape;
+    if(!ok) {
+        return false;
+    }
+
+    std::vector<double> result_doubles;
+    ok = writer.write(filename, &doubles[0], std::vector<size_t>(1, doubles.size())) &&
+         check_file("double [5]", read_file(filename), "{'descr': '<f8', 'fortran_order': False, 'shape': (5,), }",
+                    &doubles[0], doubles.size() * sizeof(double)) &&
+         reader.read(filename) && reader.get(result_doubles) && result_doubles == doubles;
+    if(!ok) {
+        return false;
+    }
+
+    shape.assign(1, 2);
+    shape.push_back(3);
+    shape.push_back(2);
+    std::vector<int32_t> result_ints;
+    ok = writer.write(filename, &ints[0], shape) &&
+         check_file("int [2, 3, 2]", read_file(filename), "{'descr': '<i4', 'fortran_order': False, 'shape': (2, 3, 2), }",
+                    &ints[0], ints.size() * sizeof(int32_t)) &&
+         reader.read(filename) && reader.get(result_ints) && result_ints == ints && reader.get_shape() == shape;
+    if(!ok) {
+        return false;
+    }
+
+    // an array of Real follows the precision of the build
+    shape.assign(1, 4);
+    shape.push_back(3);
+    const std::string descr = sizeof(Real) == sizeof(float) ? "<f4" : "<f8";
+    ok = writer.write(filename, &reals[0], shape) &&
+         check_file("Real [4, 3]", read_file(filename), "{'descr': '" + descr + "', 'fortran_order': False, 'shape': (4, 3), }",
+                    &reals[0], reals.size() * sizeof(Real)) &&
+         reader.read(filename) && reader.get_descr() == descr;
+    if(!ok) {
+        return false;
+    }
+
+    // strings are stored as UTF-32 of the width of the longest string
+    std::vector<std::string> strings;
+    strings.push_back("H");
+    strings.push_back("Rh");
+    strings.push_back("CO2");
+    std::vector<uint32_t> chars(9, 0);
+    for(unsigned int i=0; i<strings.size(); i++) {
+        for(unsigned int j=0; j<strings[i].size(); j++) {
+            chars[i * 3 + j] = strings[i][j];
+        }
+    }
+    std::vector<std::string> result_strings;
+    ok = writer.write(filename, strings) &&
+         check_file("strings", read_file(filename), "{'descr': '<U3', 'fortran_order': False, 'shape': (3,), }",
+                    &chars[0], chars.size() * sizeof(uint32_t)) &&
+         reader.read(filename) && reader.get(result_strings) && result_strings == strings;
+    if(!ok) {
+        return false;
+    }
+
+    // an empty array
+    shape.assign(1, 0);
+    shape.push_back(3);
+    return writer.write(filename, &floats[0], shape) &&
+           check_file("float [0, 3]", read_file(filename), "{'descr': '<f4', 'fortran_order': False, 'shape': (0, 3), }",
+                      NULL, 0);
+}
+
+/*
+ * An array that is opened with its shape and written in two parts
+ */
+static bool test_open(const std::string &filename) {
+    std::vector<float> data(200 * 3);
+    for(unsigned int i=0; i<data.size(); i++) {
+        data[i] = i * 0.5f;
+    }
+
+    std::vector<size_t> shape;
+    shape.push_back(200);
+    shape.push_back(3);
+    std::ofstream outfile;
+    if(!NpyWriter().open_npy(outfile, filename, "<f4", shape)) {
+        return false;
+    }
+    outfile.write((const char*)&data[0], 100 * 3 * sizeof(float));
+    outfile.write((const char*)&data[300], 100 * 3 * sizeof(float));
+    outfile.close();
+
+    return check_file("open_npy [200, 3]", read_file(filename), "{'descr': '<f4', 'fortran_order': False, 'shape': (200, 3), }",
+                      &data[0], data.size() * sizeof(float));
+}
+
+int main(int argc, char* argv[]) {
+    if(argc != 2) {
+        std::cerr << "Usage: " << argv[0] << " <fixture directory>" << std::endl;
+        return -1;
+    }
+
+    char filename[] = "/tmp/v2c_npy_XXXXXX";
+    const int fd = mkstemp(filename);
+    if(fd < 0) {
+        std::cerr << "cannot create a temporary file" << std::endl;
+        return 1;
+    }
+    close(fd);
+
+    unsigned int nr_failed = 0;
+
+    bool result = test_arrays(filename);
+    std::cout << (result ? "PASS " : "FAIL ") << "npy arrays" << std::endl;
+    nr_failed += result ? 0 : 1;
+
+    result = test_open(filename);
+    std::cout << (result ? "PASS " : "FAIL ") << "npy written in parts" << std::endl;
+    nr_failed += result ? 0 : 1;
+
+    unlink(filename);
+
+    return nr_failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,170 @@
+/*************************************************************************
+ *
+ *  This file is part of v2c.
+ *
+ *  Author: Ivo Filot <i.a.w.filot@tue.nl>
+ *
+ *  v2c is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  v2c is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with v2c.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ************************************************************************/
+
+/*
+ * Regression test of the output sink. Text spanning many compression blocks
+ * is written in pieces of varying size, with one and with several threads;
+ * every .gz file must be a single gzip member that inflates to the same
+ * text, and a file without the .gz suffix must hold the text as is.
+ */
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "outputsink.h"
+
+/*
+ * Reproducible POSCAR-like lines of about <size> bytes
+ */
+static std::string make_text(size_t size) {
+    std::string text;
+    uint64_t seed = 2024;
+    char line[64];
+    while(text.size() < size) {
+        seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+        snprintf(line, sizeof(line), "%8.5f  %8.5f  %8.5f\n", (seed >> 40) / 16777216.0,
+                 ((seed >> 20) & 0xFFFFF) / 1048576.0, (seed & 0xFFFFF) / 1048576.0);
+        text += line;
+    }
+    return text;
+}
+
+static std::string read_file(const std::string &filename) {
+    std::ifstream infile(filename.c_str(), std::ios::binary);
+    std::stringstream contents;
+    contents << infile.rdbuf();
+    return contents.str();
+}
+
+/*
+ * Inflate <data>, which must hold exactly one gzip member
+ */
+static bool inflate_member(const std::string &data, std::string &result) {
+    z_stream stream;
+    stream.zalloc = Z_NULL;
+    stream.zfree = Z_NULL;
+    stream.opaque = Z_NULL;
+    if(inflateInit2(&stream, 15 + 16) != Z_OK) {
+        return false;
+    }
+
+    std::vector<char> buffer(65536);
+    stream.next_in = (Bytef*)data.data();
+    stream.avail_in = data.size();
+    int status = Z_OK;
+    result.clear();
+    while(status == Z_OK) {
+        stream.next_out = (Bytef*)&buffer[0];
+        stream.avail_out = buffer.size();
+        status = inflate(&stream, Z_NO_FLUSH);
+        result.append(&buffer[0], buffer.size() - stream.avail_out);
+    }
+    const bool complete = status == Z_STREAM_END && stream.avail_in == 0;
+    inflateEnd(&stream);
+
+    return complete;
+}
+
+/*
+ * Write <text> to <filename> in pieces of growing size with <nr_threads>
+ */
+static bool test_sink(const std::string &text, const std::string &filename, unsigned int nr_threads) {
+    OutputSink sink;
+    bool result = sink.open(filename, nr_threads);
+    size_t pos = 0;
+    for(size_t piece=1; result && pos < text.size(); piece = piece * 3 + 7) {
+        const size_t length = std::min(piece, text.size() - pos);
+        result = sink.write(text.data() + pos, length);
+        pos += length;
+    }
+    result = sink.close() && result;
+
+    const std::string data = read_file(filename);
+    unlink(filename.c_str());
+    if(!result) {
+        std::cerr << filename << ": cannot be written" << std::endl;
+        return false;
+    }
+
+    if(!OutputSink::is_compressed_name(filename)) {
+        return data == text;
+    }
+
+    std::string inflated;
+    if(!inflate_member(data, inflated) || inflated != text) {
+        std::cerr << filename << " (" << nr_threads << " threads): does not inflate to the text" << std::endl;
+        return false;
+    }
+    if(text.size() > OUTPUT_SINK_BLOCK_SIZE && data.size() * 2 > text.size()) {
+        std::cerr << filename << " (" << nr_threads << " threads): " << data.size()
+                  << " bytes for " << text.size() << " bytes of text" << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    if(argc != 2) {
+        std::cerr << "Usage: " << argv[0] << " <fixture directory>" << std::endl;
+        return -1;
+    }
+
+    char dir[] = "/tmp/v2c_sink_XXXXXX";
+    if(mkdtemp(dir) == NULL) {
+        std::cerr << "cannot create a temporary directory" << std::endl;
+        return 1;
+    }
+    const std::string prefix = std::string(dir) + "/output";
+
+    // an empty file, a single partial block and many blocks
+    const size_t sizes[] = {0, 1000, 10 * OUTPUT_SINK_BLOCK_SIZE + 12345};
+    const unsigned int threads[] = {1, 4};
+    unsigned int nr_failed = 0;
+    for(unsigned int s=0; s<sizeof(sizes) / sizeof(sizes[0]); s++) {
+        const std::string text = make_text(sizes[s]);
+        bool result = test_sink(text, prefix, 1);
+        for(unsigned int t=0; t<sizeof(threads) / sizeof(threads[0]); t++) {
+            result = test_sink(text, prefix + ".gz", threads[t]) && result;
+        }
+        std::cout << (result ? "PASS " : "FAIL ") << "output sink " << text.size() << " bytes" << std::endl;
+        nr_failed += result ? 0 : 1;
+    }
+
+    // the writers of the formats go through write_file
+    const std::string text = make_text(3 * OUTPUT_SINK_BLOCK_SIZE);
+    std::string inflated;
+    const bool result = OutputSink::write_file(prefix + ".gz", text, 3) &&
+                        inflate_member(read_file(prefix + ".gz"), inflated) && inflated == text;
+    unlink((prefix + ".gz").c_str());
+    std::cout << (result ? "PASS " : "FAIL ") << "output sink write_file" << std::endl;
+    nr_failed += result ? 0 : 1;
+
+    rmdir(dir);
+
+    return nr_failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,218 @@
+/*************************************************************************
+ *
+ *  This file is part of v2c.
+ *
+ *  Author: Ivo Filot <i.a.w.filot@tue.nl>
+ *
+ *  v2c is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  v2c is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with v2c.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ************************************************************************/
+
+/*
+ * Regression test of the prefetching reader. A list of fixtures, including
+ * a missing file, is read with chunk sizes that do and do not divide the
+ * files and with short and long queues, through io_uring (when available)
+ * and through the fadvise fallback; the chunks must join to what a plain
+ * ifstream reads. A file that is left early must not disturb the next one,
+ * and a file that shrinks after it has been scheduled must be reported.
+ */
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "prefetchreader.h"
+
+static std::string read_file(const std::string &filename) {
+    std::ifstream infile(filename.c_str(), std::ios::binary);
+    std::stringstream contents;
+    contents << infile.rdbuf();
+    return contents.str();
+}
+
+/*
+ * Join the chunks of the current file of <reader>; the chunks must follow
+ * each other and be at most <chunk_size> long
+ */
+static bool read_chunks(PrefetchReader &reader, size_t chunk_size, std::string &contents) {
+    const char *data;
+    size_t length;
+    uint64_t offset;
+    contents.clear();
+    while(reader.get_chunk(&data, &length, &offset)) {
+        if(offset != contents.size() || length == 0 || length > chunk_size) {
+            std::cerr << reader.get_filename() << ": chunk of " << length << " bytes at " << offset
+                      << " after " << contents.size() << " bytes" << std::endl;
+            return false;
+        }
+        contents.append(data, length);
+    }
+    return true;
+}
+
+/*
+ * Read all <filenames> from <dir> with one reader and compare every file
+ */
+static bool test_files(const std::string &dir, const std::vector<std::string> &filenames,
+                       size_t chunk_size, unsigned int queue_depth, bool allow_io_uring) {
+    std::vector<std::string> paths;
+    for(unsigned int i=0; i<filenames.size(); i++) {
+        paths.push_back(dir + "/" + filenames[i]);
+    }
+
+    PrefetchReader reader(paths, queue_depth, chunk_size, allow_io_uring);
+    if(reader.is_using_io_uring() && !allow_io_uring) {
+        std::cerr << "io_uring is used although it was not allowed" << std::endl;
+        return false;
+    }
+
+    std::string contents;
+    for(unsigned int i=0; i<paths.size(); i++) {
+        if(!reader.next_file() || reader.get_filename() != paths[i] ||
+           !read_chunks(reader, chunk_size, contents)) {
+            std::cerr << "cannot read " << paths[i] << std::endl;
+            return false;
+        }
+        if(contents != read_file(paths[i])) {
+            std::cerr << paths[i] << ": contents differ (chunks of " << chunk_size << " bytes, "
+                      << queue_depth << " buffers)" << std::endl;
+            return false;
+        }
+    }
+
+    return !reader.next_file();
+}
+
+/*
+ * Leave every other file after its first chunk; the following file must be
+ * read in full, also through the stream buffer
+ */
+static bool test_skip(const std::string &dir, bool allow_io_uring) {
+    std::vector<std::string> paths;
+    paths.push_back(dir + "/OUTCAR_vasp5");
+    paths.push_back(dir + "/OUTCAR_mlff");
+    paths.push_back(dir + "/OUTCAR_md");
+    paths.push_back(dir + "/OUTCAR_vasp6");
+
+    PrefetchReader reader(paths, 4, 1000, allow_io_uring);
+    for(unsigned int i=0; i<paths.size(); i++) {
+        if(!reader.next_file()) {
+            return false;
+        }
+        if(i % 2 == 0) {
+            const char *data;
+            size_t length;
+            uint64_t offset;
+            if(!reader.get_chunk(&data, &length, &offset) || offset != 0 ||
+               read_file(paths[i]).compare(0, length, data, length) != 0) {
+                std::cerr << paths[i] << ": first chunk differs" << std::endl;
+                return false;
+            }
+            continue;
+        }
+
+        PrefetchStreamBuf buffer(&reader);
+        std::istream stream(&buffer);
+        std::istringstream expected(read_file(paths[i]));
+        std::string line;
+        std::string expected_line;
+        while(std::getline(expected, expected_line)) {
+            if(!std::getline(stream, line) || line != expected_line ||
+               (long)stream.tellg() != (long)expected.tellg()) {
+                std::cerr << paths[i] << ": stream differs at \"" << expected_line << "\"" << std::endl;
+                return false;
+            }
+        }
+        if(std::getline(stream, line)) {
+            std::cerr << paths[i] << ": stream is too long" << std::endl;
+            return false;
+        }
+    }
+
+    return !reader.next_file();
+}
+
+/*
+ * A file that is shortened after the reader has cut it into chunks gives
+ * short reads: the chunks before the cut are handed out, after which the
+ * file must be reported as unreadable
+ */
+static bool test_truncated(const std::string &dir, bool allow_io_uring) {
+    const std::string original = read_file(dir + "/OUTCAR_vasp5");
+    char filename[] = "/tmp/v2c_prefetch_XXXXXX";
+    const int fd = mkstemp(filename);
+    if(fd < 0 || write(fd, original.data(), original.size()) != (ssize_t)original.size()) {
+        std::cerr << "cannot create a temporary file" << std::endl;
+        return false;
+    }
+    close(fd);
+
+    bool result = true;
+    {
+        PrefetchReader reader(std::vector<std::string>(1, filename), 4, 1000, allow_io_uring);
+        result = truncate(filename, 4500) == 0 && reader.next_file();
+
+        std::string contents;
+        result = result && read_chunks(reader, 1000, contents) && contents == original.substr(0, 4000);
+    }
+    unlink(filename);
+
+    return result;
+}
+
+int main(int argc, char* argv[]) {
+    if(argc != 2) {
+        std::cerr << "Usage: " << argv[0] << " <fixture directory>" << std::endl;
+        return -1;
+    }
+    const std::string dir(argv[1]);
+
+    std::vector<std::string> filenames;
+    filenames.push_back("OUTCAR_vasp5");
+    filenames.push_back("OUTCAR_mlff");
+    filenames.push_back("OUTCAR_missing");
+    filenames.push_back("CO_Rh.CONTCAR");
+    filenames.push_back("OUTCAR_md");
+
+    // 8626 bytes is the size of OUTCAR_vasp5
+    static const size_t chunk_sizes[] = {1, 100, 4096, 8626, PREFETCH_DEFAULT_CHUNK_SIZE};
+
+    unsigned int nr_failed = 0;
+    for(unsigned int mode=0; mode<2; mode++) {
+        const bool allow_io_uring = mode == 0;
+        const std::string label = allow_io_uring ? " (io_uring when available)" : " (fadvise)";
+
+        bool result = true;
+        for(unsigned int i=0; i<sizeof(chunk_sizes) / sizeof(chunk_sizes[0]); i++) {
+            result = result && test_files(dir, filenames, chunk_sizes[i], 2, allow_io_uring) &&
+                               test_files(dir, filenames, chunk_sizes[i], 8, allow_io_uring);
+        }
+        std::cout << (result ? "PASS " : "FAIL ") << "prefetch chunks" << label << std::endl;
+        nr_failed += result ? 0 : 1;
+
+        result = test_skip(dir, allow_io_uring);
+        std::cout << (result ? "PASS " : "FAIL ") << "prefetch skipped files" << label << std::endl;
+        nr_failed += result ? 0 : 1;
+
+        result = test_truncated(dir, allow_io_uring);
+        std::cout << (result ? "PASS " : "FAIL ") << "prefetch truncated file" << label << std::endl;
+        nr_failed += result ? 0 : 1;
+    }
+
+    return nr_failed == 0 ? 0 : 1;
+}
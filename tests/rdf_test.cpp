@@ -0,0 +1,159 @@
+/*************************************************************************
+ *
+ *  This file is part of v2c.
+ *
+ *  Author: Ivo Filot <i.a.w.filot@tue.nl>
+ *
+ *  v2c is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  v2c is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with v2c.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ************************************************************************/
+
+/*
+ * Regression test of the partial radial distribution functions. An ideal
+ * gas of two elements must give g(r) = 1 for every pair, both in a cell that
+ * is searched with a cell list and in one that is searched over the
+ * periodic images; a simple cubic lattice must give six nearest neighbors.
+ * Frames with other atoms than the first must be refused.
+ */
+
+#include <string>
+#include <vector>
+#include <iostream>
+#include <cmath>
+
+#include "rdf.h"
+#include "test_structures.h"
+
+/*
+ * Cubic cell of edge <a> with <na> atoms of element A and <nb> of element B
+ * at <positions>
+ */
+static State make_mixture(double a, unsigned int na, unsigned int nb, const std::vector<Eigen::Vector3d> &positions) {
+    std::vector<unsigned int> elnrs(na, 18);
+    elnrs.insert(elnrs.end(), nb, 36);
+    return make_state(a * Eigen::Matrix3d::Identity(), positions, elnrs);
+}
+
+/*
+ * Uncorrelated positions in a cell of edge <a>; g(r) of every pair, averaged
+ * between 1 A and r_max, must be 1 within 3%
+ */
+static bool test_ideal_gas(double a, double r_max) {
+    const unsigned int na = 40;
+    const unsigned int nb = 24;
+    const unsigned int nr_frames = 200;
+    uint64_t seed = 12345;
+
+    ThreadPool pool(2);
+    RadialDistribution rdf(r_max, 50, pool.get_nr_threads());
+    std::vector<State> states;
+    for(unsigned int f=0; f<nr_frames; f++) {
+        std::vector<Eigen::Vector3d> positions(na + nb);
+        for(unsigned int i=0; i<positions.size(); i++) {
+            for(unsigned int k=0; k<3; k++) {
+                positions[i](k) = next_random(seed) * a;
+            }
+        }
+        states.push_back(make_mixture(a, na, nb, positions));
+    }
+    if(!rdf.add_frames(states, pool) || rdf.get_nr_frames() != nr_frames || rdf.get_nr_pairs() != 3) {
+        std::cerr << "ideal gas: frames were not accumulated" << std::endl;
+        return false;
+    }
+
+    for(unsigned int p=0; p<rdf.get_nr_pairs(); p++) {
+        const std::vector<double> g = rdf.get_rdf(p);
+        double sum = 0.0;
+        unsigned int n = 0;
+        for(unsigned int k=0; k<g.size(); k++) {
+            if((k + 0.5) * r_max / g.size() > 1.0) {
+                sum += g[k];
+                n++;
+            }
+        }
+        if(std::fabs(sum / n - 1.0) > 0.03) {
+            std::cerr << "ideal gas (a = " << a << "): average g of " << rdf.get_pair_name(p)
+                      << " is " << sum / n << std::endl;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/*
+ * Simple cubic lattice of 4 x 4 x 4 atoms with spacing 3 A: six neighbors
+ * per atom within 3.2 A, i.e. 64 * 6 / 2 pairs, and none closer
+ */
+static bool test_coordination() {
+    std::vector<Eigen::Vector3d> positions;
+    for(unsigned int i=0; i<4; i++) {
+        for(unsigned int j=0; j<4; j++) {
+            for(unsigned int k=0; k<4; k++) {
+                positions.push_back(Eigen::Vector3d(3.0 * i + 0.1, 3.0 * j + 0.1, 3.0 * k + 0.1));
+            }
+        }
+    }
+
+    ThreadPool pool(1);
+    RadialDistribution rdf(3.2, 32, pool.get_nr_threads());
+    std::vector<State> states(1, make_mixture(12.0, 64, 0, positions));
+    rdf.add_frames(states, pool);
+
+    const std::vector<double> counts = rdf.get_histogram(0);
+    double first_shell = 0.0;
+    for(unsigned int k=0; k<counts.size(); k++) {
+        if(k < 29 && counts[k] != 0.0) {
+            std::cerr << "simple cubic: pairs closer than 2.9 A" << std::endl;
+            return false;
+        }
+        first_shell += counts[k];
+    }
+    if(std::fabs(first_shell - 64 * 6 / 2) > 1e-9) {
+        std::cerr << "simple cubic: " << first_shell << " pairs in the first shell instead of 192" << std::endl;
+        return false;
+    }
+
+    // a frame with the elements in other numbers is refused
+    std::vector<State> other(1, make_mixture(12.0, 63, 1, positions));
+    if(rdf.accepts(other[0]) || rdf.add_frames(other, pool) || rdf.get_nr_frames() != 1) {
+        std::cerr << "simple cubic: a frame with other atoms was accepted" << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    if(argc != 2) {
+        std::cerr << "Usage: " << argv[0] << " <fixture directory>" << std::endl;
+        return -1;
+    }
+
+    unsigned int nr_failed = 0;
+
+    bool result = test_ideal_gas(20.0, 5.0);
+    std::cout << (result ? "PASS " : "FAIL ") << "rdf ideal gas (cell list)" << std::endl;
+    nr_failed += result ? 0 : 1;
+
+    result = test_ideal_gas(9.0, 4.0);
+    std::cout << (result ? "PASS " : "FAIL ") << "rdf ideal gas (periodic images)" << std::endl;
+    nr_failed += result ? 0 : 1;
+
+    result = test_coordination();
+    std::cout << (result ? "PASS " : "FAIL ") << "rdf simple cubic" << std::endl;
+    nr_failed += result ? 0 : 1;
+
+    return nr_failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,190 @@
+/*************************************************************************
+ *
+ *  This file is part of v2c.
+ *
+ *  Author: Ivo Filot <i.a.w.filot@tue.nl>
+ *
+ *  v2c is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  v2c is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with v2c.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ************************************************************************/
+
+/*
+ * Regression test of the RMSD analysis and the deduplication of frames. A
+ * rotated and translated copy of a frame must superimpose onto it, an atom
+ * moved by a lattice vector must only count without periodic images, and
+ * the greedy deduplication must retain the first frame of every distinct
+ * structure, also when the trajectory is handed over in parts.
+ */
+
+#include <string>
+#include <vector>
+#include <iostream>
+#include <cmath>
+
+#include "rmsd.h"
+#include "test_structures.h"
+
+#define TEST_ATOMS 12
+#define TEST_CELL  30.0
+
+/*
+ * Random cluster of TEST_ATOMS atoms around the center of a cubic cell
+ */
+static std::vector<Eigen::Vector3d> make_cluster(uint64_t seed) {
+    std::vector<Eigen::Vector3d> cluster;
+    for(unsigned int i=0; i<TEST_ATOMS; i++) {
+        Eigen::Vector3d pos;
+        for(unsigned int k=0; k<3; k++) {
+            pos(k) = TEST_CELL / 2.0 + 6.0 * (next_random(seed) - 0.5);
+        }
+        cluster.push_back(pos);
+    }
+    return cluster;
+}
+
+/*
+ * Rotate <cluster> by <angle> around <axis> through its first atom and move
+ * it by <shift>
+ */
+static std::vector<Eigen::Vector3d> move(const std::vector<Eigen::Vector3d> &cluster, double angle,
+                                         const Eigen::Vector3d &axis, const Eigen::Vector3d &shift) {
+    const Eigen::Matrix3d rotation = Eigen::AngleAxisd(angle, axis.normalized()).toRotationMatrix();
+    std::vector<Eigen::Vector3d> result;
+    for(unsigned int i=0; i<cluster.size(); i++) {
+        result.push_back(rotation * (cluster[i] - cluster[0]) + cluster[0] + shift);
+    }
+    return result;
+}
+
+static State make_cluster_state(const std::vector<Eigen::Vector3d> &cluster) {
+    return make_state(TEST_CELL * Eigen::Matrix3d::Identity(), cluster, std::vector<unsigned int>(cluster.size(), 6));
+}
+
+/*
+ * Superposition of a rotated and translated copy, and periodic images
+ */
+static bool test_superposition() {
+    const std::vector<Eigen::Vector3d> cluster = make_cluster(7);
+    std::vector<State> states;
+    states.push_back(make_cluster_state(cluster));
+    states.push_back(make_cluster_state(move(cluster, 1.1, Eigen::Vector3d(1.0, -2.0, 0.5), Eigen::Vector3d(0.8, -1.2, 2.0))));
+    const Trajectory trajectory(states);
+    const float *ref = trajectory.get_positions(0);
+    const float *pos = trajectory.get_positions(1);
+
+    Eigen::Matrix3d rotation;
+    const double kabsch = RmsdAnalysis(RMSD_ALIGN_KABSCH, true).rmsd(ref, pos, TEST_ATOMS, trajectory.get_cell(1), &rotation);
+    const double translated = RmsdAnalysis(RMSD_ALIGN_TRANSLATION, true).rmsd(ref, pos, TEST_ATOMS, trajectory.get_cell(1));
+    if(kabsch > 1e-4 || translated < 0.5) {
+        std::cerr << "superposition: RMSD is " << kabsch << " after rotation and " << translated
+                  << " after translation only" << std::endl;
+        return false;
+    }
+    if(std::fabs(rotation.determinant() - 1.0) > 1e-8 ||
+       std::fabs(Eigen::AngleAxisd(rotation).angle() - 1.1) > 1e-4) {
+        std::cerr << "superposition: the rotation is not the inverse of the applied one" << std::endl;
+        return false;
+    }
+
+    // one atom moved by a lattice vector, and one moved by 1 A
+    std::vector<Eigen::Vector3d> images = cluster;
+    images[3](1) += TEST_CELL;
+    std::vector<Eigen::Vector3d> displaced = cluster;
+    displaced[5](0) += 1.0;
+    states.clear();
+    states.push_back(make_cluster_state(cluster));
+    states.push_back(make_cluster_state(images));
+    states.push_back(make_cluster_state(displaced));
+    const Trajectory moved(states);
+
+    ThreadPool pool(1);
+    const std::vector<double> periodic = RmsdAnalysis(RMSD_ALIGN_NONE, true).all_vs_reference(moved, moved.get_positions(0), pool);
+    const double plain = RmsdAnalysis(RMSD_ALIGN_NONE, false).rmsd(moved.get_positions(0), moved.get_positions(1), TEST_ATOMS, moved.get_cell(1));
+    if(periodic[0] != 0.0 || periodic[1] > 1e-5 || std::fabs(periodic[2] - std::sqrt(1.0 / TEST_ATOMS)) > 1e-5 ||
+       std::fabs(plain - TEST_CELL * std::sqrt(1.0 / TEST_ATOMS)) > 1e-4) {
+        std::cerr << "periodic images: RMSD of " << periodic[1] << " and " << periodic[2]
+                  << " with images, " << plain << " without" << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+/*
+ * Three distinct clusters, each repeated in rotated and translated copies
+ */
+static bool test_deduplication() {
+    std::vector<std::vector<Eigen::Vector3d> > clusters;
+    clusters.push_back(make_cluster(11));
+    clusters.push_back(make_cluster(12));
+    clusters.push_back(make_cluster(13));
+
+    // cluster of every frame; the copies are spread over several blocks and
+    // rotated by less than a radian, such that no atom moves by half a cell
+    const unsigned int sequence[] = {0, 0, 1, 0, 1, 1, 0, 0, 0, 1, 0, 1, 0, 0, 1, 1, 0, 2, 1, 2, 0, 2, 1, 0};
+    const unsigned int nr_frames = sizeof(sequence) / sizeof(sequence[0]);
+    std::vector<State> states;
+    for(unsigned int f=0; f<nr_frames; f++) {
+        states.push_back(make_cluster_state(move(clusters[sequence[f]], 0.04 * f, Eigen::Vector3d(f, 1.0, -2.0),
+                                         Eigen::Vector3d(0.1 * f, 0.0, -0.05 * f))));
+    }
+    const Trajectory trajectory(states);
+
+    std::vector<unsigned int> expected;
+    expected.push_back(0);
+    expected.push_back(2);
+    expected.push_back(17);
+
+    ThreadPool pool(2);
+    const RmsdAnalysis analysis(RMSD_ALIGN_KABSCH, true);
+    const std::vector<unsigned int> kept = analysis.deduplicate(trajectory, 0.1, pool);
+    if(kept != expected) {
+        std::cerr << "deduplication: retained " << kept.size() << " instead of 3 frames" << std::endl;
+        return false;
+    }
+
+    // the same in two parts
+    std::vector<float> representatives;
+    std::vector<unsigned int> parts;
+    const unsigned int half = nr_frames / 2;
+    analysis.deduplicate(Trajectory(std::vector<State>(states.begin(), states.begin() + half)), 0, 0.1,
+                         representatives, parts, pool);
+    analysis.deduplicate(Trajectory(std::vector<State>(states.begin() + half, states.end())), half, 0.1,
+                         representatives, parts, pool);
+    if(parts != expected || representatives.size() != expected.size() * TEST_ATOMS * 3) {
+        std::cerr << "deduplication: retained " << parts.size() << " instead of 3 frames in two parts" << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    if(argc != 2) {
+        std::cerr << "Usage: " << argv[0] << " <fixture directory>" << std::endl;
+        return -1;
+    }
+
+    unsigned int nr_failed = 0;
+
+    bool result = test_superposition();
+    std::cout << (result ? "PASS " : "FAIL ") << "rmsd superposition" << std::endl;
+    nr_failed += result ? 0 : 1;
+
+    result = test_deduplication();
+    std::cout << (result ? "PASS " : "FAIL ") << "rmsd deduplication" << std::endl;
+    nr_failed += result ? 0 : 1;
+
+    return nr_failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,365 @@
+/*************************************************************************
+ *
+ *  This file is part of v2c.
+ *
+ *  Author: Ivo Filot <i.a.w.filot@tue.nl>
+ *
+ *  v2c is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  v2c is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with v2c.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ************************************************************************/
+
+/*
+ * Regression test of the scene export. The frames of OUTCAR_vasp5 and a
+ * CO molecule that straddles the cell boundary are written as PLY and as
+ * glTF and read back: every atom must be at its position with the color
+ * and radius of its element, the bonds must be those found by a search
+ * over the periodic images (whole within the cell between atoms of one
+ * species, in halves otherwise, and left out of the PLY when they cross
+ * the boundary), and the glTF must draw the twelve edges of every cell.
+ */
+
+#include <string>
+#include <vector>
+#include <set>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <cmath>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "vaspreader.h"
+#include "scenewriter.h"
+#include "test_structures.h"
+
+#define TEST_TOLERANCE 1e-5
+
+struct Bond {
+  unsigned int i;
+  unsigned int j;
+  bool periodic;
+};
+
+static std::string read_file(const std::string &filename) {
+    std::ifstream infile(filename.c_str(), std::ios::binary);
+    std::stringstream contents;
+    contents << infile.rdbuf();
+    return contents.str();
+}
+
+static uint32_t get_uint32(const std::string &buffer, size_t pos) {
+    uint32_t val = 0;
+    memcpy(&val, buffer.data() + pos, sizeof(val));
+    return val;
+}
+
+/*
+ * Bonds of <state>, searched over the 27 nearest images of every atom
+ */
+static std::vector<Bond> find_bonds(const State &state) {
+    std::vector<Bond> bonds;
+    const Eigen::Matrix3d cell = state.dimensions.cast<double>();
+    for(unsigned int i=0; i<state.atoms.size(); i++) {
+        for(unsigned int j=i+1; j<state.atoms.size(); j++) {
+            const double cutoff = get_bond_cutoff(state.atoms[i].elnr, state.atoms[j].elnr);
+            const Eigen::Vector3d d = (state.atoms[j].pos - state.atoms[i].pos).cast<double>();
+            double nearest = d.norm();
+            bool periodic = false;
+            for(int n=0; n<27; n++) {
+                const Eigen::Vector3d image = d + cell.transpose() * Eigen::Vector3d(n % 3 - 1, (n / 3) % 3 - 1, n / 9 - 1);
+                if(image.norm() < nearest - 1e-6) {
+                    nearest = image.norm();
+                    periodic = true;
+                }
+            }
+            if(nearest < cutoff) {
+                Bond bond = {i, j, periodic};
+                bonds.push_back(bond);
+            }
+        }
+    }
+    return bonds;
+}
+
+/*
+ * Write <state> as PLY and compare the vertices and edges
+ */
+static bool test_ply(const State &state, const std::string &label) {
+    char filename[] = "/tmp/v2c_scene_XXXXXX";
+    const int fd = mkstemp(filename);
+    if(fd < 0) {
+        return false;
+    }
+    close(fd);
+    const bool written = SceneWriter().write_ply(state, filename);
+    const std::string buffer = read_file(filename);
+    unlink(filename);
+
+    const size_t end = buffer.find("end_header\n");
+    if(!written || end == std::string::npos) {
+        std::cerr << label << ": no PLY header" << std::endl;
+        return false;
+    }
+    const std::string header = buffer.substr(0, end);
+    unsigned int nr_vertices = 0;
+    unsigned int nr_edges = 0;
+    sscanf(header.c_str() + header.find("element vertex"), "element vertex %u", &nr_vertices);
+    sscanf(header.c_str() + header.find("element edge"), "element edge %u", &nr_edges);
+
+    std::set<std::pair<unsigned int, unsigned int> > expected;
+    const std::vector<Bond> bonds = find_bonds(state);
+    for(unsigned int b=0; b<bonds.size(); b++) {
+        if(!bonds[b].periodic) {
+            expected.insert(std::make_pair(bonds[b].i, bonds[b].j));
+        }
+    }
+
+    const size_t data = end + 11;
+    if(nr_vertices != state.atoms.size() || nr_edges != expected.size() ||
+       buffer.size() != data + nr_vertices * 19 + nr_edges * 8) {
+        std::cerr << label << ": " << nr_vertices << " vertices and " << nr_edges << " edges instead of "
+                  << state.atoms.size() << " and " << expected.size() << std::endl;
+        return false;
+    }
+
+    for(unsigned int i=0; i<nr_vertices; i++) {
+        const char *vertex = buffer.data() + data + i * 19;
+        float x[4];
+        memcpy(x, vertex, 3 * sizeof(float));
+        memcpy(x + 3, vertex + 15, sizeof(float));
+        const Color color = SceneWriter::get_atom_color(state.atoms[i].elnr);
+        const unsigned char rgb[3] = {(unsigned char)std::floor(color.r * 255.0f + 0.5f),
+                                      (unsigned char)std::floor(color.g * 255.0f + 0.5f),
+                                      (unsigned char)std::floor(color.b * 255.0f + 0.5f)};
+        if((Eigen::Vector3f(x[0], x[1], x[2]) - state.atoms[i].pos.cast<float>()).norm() > TEST_TOLERANCE ||
+           memcmp(vertex + 12, rgb, 3) != 0 || x[3] != SceneWriter::get_atom_radius(state.atoms[i].elnr)) {
+            std::cerr << label << ": vertex " << i << " differs from its atom" << std::endl;
+            return false;
+        }
+    }
+
+    for(unsigned int e=0; e<nr_edges; e++) {
+        const size_t pos = data + nr_vertices * 19 + e * 8;
+        if(expected.erase(std::make_pair(get_uint32(buffer, pos), get_uint32(buffer, pos + 4))) != 1) {
+            std::cerr << label << ": edge " << get_uint32(buffer, pos) << "-" << get_uint32(buffer, pos + 4)
+                      << " is not a bond within the cell" << std::endl;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/*
+ * Minimal access to the JSON of a glTF file: the array <key> of <object>,
+ * the objects of an array and the numbers and names of an object
+ */
+static std::string get_array(const std::string &object, const std::string &key) {
+    const std::string tag = "\"" + key + "\":[";
+    int depth = 0;
+    size_t begin = std::string::npos;
+    for(size_t i=0; i<object.size(); i++) {
+        if(begin == std::string::npos && depth == 1 && object.compare(i, tag.size(), tag) == 0) {
+            begin = i + tag.size();
+            i = begin - 1;
+            depth = 2;
+        } else if(object[i] == '[' || object[i] == '{') {
+            depth++;
+        } else if((object[i] == ']' || object[i] == '}') && --depth == 1 && begin != std::string::npos) {
+            return object.substr(begin, i - begin);
+        }
+    }
+    return "";
+}
+
+static std::vector<std::string> get_objects(const std::string &array) {
+    std::vector<std::string> objects;
+    int depth = 0;
+    size_t begin = 0;
+    for(size_t i=0; i<array.size(); i++) {
+        if(array[i] == '{' || array[i] == '[') {
+            if(depth++ == 0) {
+                begin = i;
+            }
+        } else if(array[i] == '}' || array[i] == ']') {
+            if(--depth == 0) {
+                objects.push_back(array.substr(begin, i - begin + 1));
+            }
+        }
+    }
+    return objects;
+}
+
+static long get_number(const std::string &object, const std::string &key) {
+    const size_t pos = object.find("\"" + key + "\":");
+    return pos == std::string::npos ? -1 : atol(object.c_str() + pos + key.size() + 3);
+}
+
+static std::string get_name(const std::string &object) {
+    const size_t pos = object.find("\"name\":\"");
+    return pos == std::string::npos ? "" : object.substr(pos + 8, object.find('"', pos + 8) - pos - 8);
+}
+
+/*
+ * Floats of an accessor
+ */
+static std::vector<float> get_floats(const std::string &json, const std::string &bin, long accessor) {
+    const std::vector<std::string> accessors = get_objects(get_array(json, "accessors"));
+    const std::vector<std::string> views = get_objects(get_array(json, "bufferViews"));
+    if(accessor < 0 || accessor >= (long)accessors.size()) {
+        return std::vector<float>();
+    }
+    const long view = get_number(accessors[accessor], "bufferView");
+    const long count = get_number(accessors[accessor], "count");
+    const unsigned int nr_components = accessors[accessor].find("\"VEC3\"") != std::string::npos ? 3 : 1;
+    std::vector<float> values(count * nr_components);
+    memcpy(values.data(), bin.data() + get_number(views[view], "byteOffset"), values.size() * sizeof(float));
+    return values;
+}
+
+/*
+ * Write <frames> as glTF and compare the atoms, the number of bond halves
+ * and the cell of every frame
+ */
+static bool test_gltf(const std::vector<State> &frames, const std::string &label) {
+    char filename[] = "/tmp/v2c_scene_XXXXXX";
+    const int fd = mkstemp(filename);
+    if(fd < 0) {
+        return false;
+    }
+    close(fd);
+    const bool written = SceneWriter().write_gltf(frames, filename);
+    const std::string buffer = read_file(filename);
+    unlink(filename);
+
+    if(!written || buffer.size() < 28 || get_uint32(buffer, 0) != 0x46546C67 || get_uint32(buffer, 4) != 2 ||
+       get_uint32(buffer, 8) != buffer.size() || get_uint32(buffer, 16) != 0x4E4F534A) {
+        std::cerr << label << ": no glTF header" << std::endl;
+        return false;
+    }
+    const size_t json_length = get_uint32(buffer, 12);
+    const std::string json = buffer.substr(20, json_length);
+    const std::string bin = buffer.substr(28 + json_length);
+    if(get_uint32(buffer, 24 + json_length) != 0x004E4942 || get_uint32(buffer, 20 + json_length) != bin.size()) {
+        std::cerr << label << ": no binary chunk" << std::endl;
+        return false;
+    }
+
+    const std::vector<std::string> nodes = get_objects(get_array(json, "nodes"));
+    const std::vector<std::string> meshes = get_objects(get_array(json, "meshes"));
+    const std::vector<std::string> accessors = get_objects(get_array(json, "accessors"));
+    std::istringstream scene(get_array(get_array(json, "scenes"), "nodes"));
+    for(unsigned int f=0; f<frames.size(); f++) {
+        const State &state = frames[f];
+        unsigned int node = 0;
+        char comma;
+        if(!(scene >> node) || (f + 1 < frames.size() && !(scene >> comma)) || node >= nodes.size() ||
+           get_name(nodes[node]) != "frame " + int2str(f + 1)) {
+            std::cerr << label << ": frame " << f + 1 << " not found" << std::endl;
+            return false;
+        }
+
+        // the atoms of every species, the bond halves and the cell
+        unsigned int nr_atoms = 0;
+        unsigned int nr_halves = 0;
+        bool cell_found = false;
+        std::istringstream children(get_array(nodes[node], "children"));
+        unsigned int child;
+        while(children >> child) {
+            children >> comma;
+            const std::string name = get_name(nodes[child]);
+            if(name == "cell") {
+                const std::string &mesh = meshes[get_number(nodes[child], "mesh")];
+                const std::vector<float> corners = get_floats(json, bin, get_number(mesh, "POSITION"));
+                cell_found = get_number(mesh, "mode") == 1 && corners.size() == 24 &&
+                             get_number(accessors[get_number(mesh, "indices")], "count") == 24;
+                for(unsigned int c=0; cell_found && c<8; c++) {
+                    const Vector3 corner = (Real)(c & 1) * state.dimensions.row(0) + (Real)((c >> 1) & 1) * state.dimensions.row(1) +
+                                           (Real)((c >> 2) & 1) * state.dimensions.row(2);
+                    cell_found = (Eigen::Vector3f(corners[c*3], corners[c*3+1], corners[c*3+2]) - corner.cast<float>()).norm() < 1e-4;
+                }
+            } else if(name.size() > 6 && name.compare(name.size() - 6, 6, " bonds") == 0) {
+                nr_halves += get_number(accessors[get_number(nodes[child], "SCALE")], "count");
+            } else {
+                const std::vector<float> translations = get_floats(json, bin, get_number(nodes[child], "TRANSLATION"));
+                unsigned int k = 0;
+                for(unsigned int i=0; i<state.atoms.size(); i++) {
+                    if(get_element_symbol(state.atoms[i].elnr) != name) {
+                        continue;
+                    }
+                    if(k + 3 > translations.size() ||
+                       (Eigen::Vector3f(translations[k], translations[k+1], translations[k+2]) - state.atoms[i].pos.cast<float>()).norm() > TEST_TOLERANCE) {
+                        std::cerr << label << ": atom " << i << " of frame " << f + 1 << " is not at its position" << std::endl;
+                        return false;
+                    }
+                    k += 3;
+                }
+                nr_atoms += translations.size() / 3;
+            }
+        }
+
+        const std::vector<Bond> bonds = find_bonds(state);
+        unsigned int expected_halves = 0;
+        for(unsigned int b=0; b<bonds.size(); b++) {
+            const bool whole = !bonds[b].periodic && state.atoms[bonds[b].i].elnr == state.atoms[bonds[b].j].elnr;
+            expected_halves += whole ? 1 : 2;
+        }
+        if(nr_atoms != state.atoms.size() || nr_halves != expected_halves || !cell_found) {
+            std::cerr << label << ": frame " << f + 1 << " has " << nr_atoms << " atoms and " << nr_halves
+                      << " bond cylinders instead of " << state.atoms.size() << " and " << expected_halves
+                      << (cell_found ? "" : ", and no cell") << std::endl;
+            return false;
+        }
+    }
+
+    return frames.size() == 1 || json.find("\"animations\"") != std::string::npos;
+}
+
+int main(int argc, char* argv[]) {
+    if(argc != 2) {
+        std::cerr << "Usage: " << argv[0] << " <fixture directory>" << std::endl;
+        return -1;
+    }
+    const std::string dir(argv[1]);
+
+    unsigned int nr_failed = 0;
+
+    VaspReader vr;
+    bool result = vr.read((dir + "/OUTCAR_vasp5").c_str()) && !vr.states.empty();
+    std::vector<State> frames;
+    for(unsigned int f=0; result && f<vr.states.size(); f++) {
+        frames.push_back(vr.states[f]);
+    }
+    result = result && test_ply(frames.back(), "OUTCAR_vasp5") && test_gltf(frames, "OUTCAR_vasp5");
+    std::cout << (result ? "PASS " : "FAIL ") << "scene OUTCAR_vasp5" << std::endl;
+    nr_failed += result ? 0 : 1;
+
+    // CO across the boundary of a cell with a C2 molecule inside
+    std::vector<Eigen::Vector3d> positions;
+    positions.push_back(Eigen::Vector3d(0.5, 3.0, 3.0));
+    positions.push_back(Eigen::Vector3d(2.5, 3.0, 3.0));
+    positions.push_back(Eigen::Vector3d(3.8, 3.0, 3.0));
+    positions.push_back(Eigen::Vector3d(5.35, 3.0, 3.0));
+    std::vector<unsigned int> elnrs(3, 6);
+    elnrs.push_back(8);
+    const State molecule = make_state(6.0 * Eigen::Matrix3d::Identity(), positions, elnrs);
+    const std::vector<Bond> bonds = find_bonds(molecule);
+    result = bonds.size() == 2 && bonds[0].periodic != bonds[1].periodic &&
+             test_ply(molecule, "boundary") && test_gltf(std::vector<State>(1, molecule), "boundary");
+    std::cout << (result ? "PASS " : "FAIL ") << "scene bonds across the boundary" << std::endl;
+    nr_failed += result ? 0 : 1;
+
+    return nr_failed == 0 ? 0 : 1;
+}
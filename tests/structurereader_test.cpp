@@ -0,0 +1,222 @@
+/*************************************************************************
+ *
+ *  This file is part of v2c.
+ *
+ *  Author: Ivo Filot <i.a.w.filot@tue.nl>
+ *
+ *  v2c is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  v2c is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with v2c.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ************************************************************************/
+
+/*
+ * Regression test of the POSCAR and CIF readers by a round trip through the
+ * writers. The frames of OUTCAR_vasp5 are exported as POSCAR files and read
+ * back, after which their RMSD to the original frames (as used by rmsd
+ * --ref-file) must vanish; a frame written as CIF must give the same cell
+ * parameters and fractional coordinates, in the orientation of the CIF
+ * convention. A VASP4 CONTCAR in Cartesian coordinates, with a volume as
+ * scaling factor, selective dynamics and velocities, must be read as well.
+ */
+
+#include <string>
+#include <vector>
+#include <iostream>
+#include <cmath>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "vaspreader.h"
+#include "structurereader.h"
+#include "poscarwriter.h"
+#include "cifwriter.h"
+#include "rmsd.h"
+
+/*
+ * Whether both states hold the same elements with the same number of atoms
+ */
+static bool same_species(const State &state, const State &expected) {
+    return state.get_elements() == expected.get_elements() &&
+           state.get_nr_atoms_per_element() == expected.get_nr_atoms_per_element() &&
+           state.get_total_nr_atoms() == expected.get_total_nr_atoms();
+}
+
+static bool test_poscar(const FrameStore &frames, const std::string &dir) {
+    ThreadPool pool(2);
+    std::vector<unsigned int> indices;
+    std::vector<std::string> filenames;
+    for(unsigned int f=0; f<frames.size(); f++) {
+        indices.push_back(f);
+        filenames.push_back(PoscarWriter::get_frame_filename(dir + "/frame", f));
+    }
+
+    const PoscarWriter writer(frames[0], true);
+    std::vector<State> states;
+    const unsigned int nr_written = writer.write_frames(frames, indices, dir + "/frame", "OUTCAR_vasp5", pool);
+    const unsigned int nr_read = StructureReader().read_files(filenames, states, pool);
+    for(unsigned int f=0; f<filenames.size(); f++) {
+        unlink(filenames[f].c_str());
+    }
+    if(nr_written != frames.size() || nr_read != frames.size() || states.size() != frames.size()) {
+        std::cerr << "POSCAR: wrote " << nr_written << " and read " << nr_read << " of "
+                  << frames.size() << " frames" << std::endl;
+        return false;
+    }
+
+    const Trajectory expected(frames);
+    const RmsdAnalysis analysis(RMSD_ALIGN_NONE, true);
+    for(unsigned int f=0; f<states.size(); f++) {
+        if(!same_species(states[f], frames[f])) {
+            std::cerr << "POSCAR: elements of frame " << f + 1 << " differ" << std::endl;
+            return false;
+        }
+        if((states[f].dimensions - frames[f].dimensions).cwiseAbs().maxCoeff() > 1e-5) {
+            std::cerr << "POSCAR: cell of frame " << f + 1 << " differs" << std::endl;
+            return false;
+        }
+
+        const Trajectory trajectory(std::vector<State>(1, states[f]));
+        // the fractional coordinates are written with five decimals
+        const std::vector<double> rmsd = analysis.all_vs_reference(trajectory, expected.get_positions(f), pool);
+        if(rmsd[0] > 5e-4) {
+            std::cerr << "POSCAR: RMSD of frame " << f + 1 << " is " << rmsd[0] << std::endl;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/*
+ * Lengths and angles of the lattice vectors (rows) of <cell>
+ */
+static Eigen::VectorXd cell_parameters(const Matrix3 &dimensions) {
+    const Eigen::Matrix3d cell = dimensions.cast<double>();
+    Eigen::VectorXd result(6);
+    for(unsigned int i=0; i<3; i++) {
+        const Eigen::Vector3d a = cell.row((i + 1) % 3);
+        const Eigen::Vector3d b = cell.row((i + 2) % 3);
+        result(i) = cell.row(i).norm();
+        result(3 + i) = std::acos(a.dot(b) / (a.norm() * b.norm())) * 180.0 / M_PI;
+    }
+    return result;
+}
+
+static bool test_cif(const State &frame, const std::string &dir) {
+    const std::string filename = dir + "/frame.cif";
+    std::vector<State> states;
+    const bool written = CifWriter().write(frame, filename, "OUTCAR_vasp5 frame 1");
+    const bool read = StructureReader().read(filename, states);
+    unlink(filename.c_str());
+    if(!written || !read || states.size() != 1 || !same_species(states[0], frame)) {
+        std::cerr << "CIF: the frame does not survive the round trip" << std::endl;
+        return false;
+    }
+    const State &state = states[0];
+
+    // first lattice vector along x, second in the xy plane
+    if(std::fabs(state.dimensions(0,1)) > 1e-5 || std::fabs(state.dimensions(0,2)) > 1e-5 ||
+       std::fabs(state.dimensions(1,2)) > 1e-5) {
+        std::cerr << "CIF: the cell is not in the standard orientation" << std::endl;
+        return false;
+    }
+    if((cell_parameters(state.dimensions) - cell_parameters(frame.dimensions)).cwiseAbs().maxCoeff() > 1e-3) {
+        std::cerr << "CIF: the cell parameters differ" << std::endl;
+        return false;
+    }
+
+    const Eigen::Matrix3d to_frac = state.dimensions.cast<double>().inverse().transpose();
+    const Eigen::Matrix3d to_frac_expected = frame.dimensions.cast<double>().inverse().transpose();
+    for(unsigned int i=0; i<frame.atoms.size(); i++) {
+        Eigen::Vector3d d = to_frac * state.atoms[i].pos.cast<double>() -
+                            to_frac_expected * frame.atoms[i].pos.cast<double>();
+        d = d.array() - (d.array() + 0.5).floor();
+        if(d.cwiseAbs().maxCoeff() > 1e-5) {
+            std::cerr << "CIF: fractional coordinates of atom " << i + 1 << " differ" << std::endl;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/*
+ * CO on a single Rh atom; the cell is scaled to a volume of 128 A^3, i.e. by
+ * a factor two, and the element symbols are taken from the title line
+ */
+static bool test_contcar(const std::string &filename) {
+    std::vector<State> states;
+    if(!StructureReader().read(filename, states) || states.size() != 1) {
+        std::cerr << "CONTCAR: cannot be read" << std::endl;
+        return false;
+    }
+    const State &state = states[0];
+
+    std::vector<std::string> elements;
+    elements.push_back("Rh");
+    elements.push_back("C");
+    elements.push_back("O");
+    if(state.get_elements() != elements || state.get_total_nr_atoms() != 3 || state.atoms.size() != 3) {
+        std::cerr << "CONTCAR: the elements are not taken from the title" << std::endl;
+        return false;
+    }
+
+    const double cell[3] = {4.0, 4.0, 8.0};
+    const double heights[3] = {0.0, 2.0, 3.15};
+    const int modes[3] = {ATOM_SELEC_FIX_ALL, 0, ATOM_SELEC_FIX_X};
+    for(unsigned int i=0; i<3; i++) {
+        if(std::fabs(state.dimensions(i,i) - cell[i]) > 1e-5 ||
+           std::fabs(state.atoms[i].pos(2) - heights[i]) > 1e-5 ||
+           std::fabs(state.atoms[i].pos(0)) > 1e-5 || state.atoms[i].selec_mode != modes[i]) {
+            std::cerr << "CONTCAR: atom " << i + 1 << " or the cell differs" << std::endl;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    if(argc != 2) {
+        std::cerr << "Usage: " << argv[0] << " <fixture directory>" << std::endl;
+        return -1;
+    }
+
+    char dir[] = "/tmp/v2c_structure_XXXXXX";
+    if(mkdtemp(dir) == NULL) {
+        std::cerr << "cannot create a temporary directory" << std::endl;
+        return 1;
+    }
+
+    unsigned int nr_failed = 0;
+
+    VaspReader vr;
+    const bool loaded = vr.read((std::string(argv[1]) + "/OUTCAR_vasp5").c_str()) && !vr.states.empty();
+
+    bool result = loaded && test_poscar(vr.states, dir);
+    std::cout << (result ? "PASS " : "FAIL ") << "structure POSCAR round trip" << std::endl;
+    nr_failed += result ? 0 : 1;
+
+    result = loaded && test_cif(vr.states[0], dir);
+    std::cout << (result ? "PASS " : "FAIL ") << "structure CIF round trip" << std::endl;
+    nr_failed += result ? 0 : 1;
+
+    result = test_contcar(std::string(argv[1]) + "/CO_Rh.CONTCAR");
+    std::cout << (result ? "PASS " : "FAIL ") << "structure VASP4 CONTCAR" << std::endl;
+    nr_failed += result ? 0 : 1;
+
+    rmdir(dir);
+
+    return nr_failed == 0 ? 0 : 1;
+}
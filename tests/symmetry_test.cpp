@@ -0,0 +1,116 @@
+/*************************************************************************
+ *
+ *  This file is part of v2c.
+ *
+ *  Author: Ivo Filot <i.a.w.filot@tue.nl>
+ *
+ *  v2c is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  v2c is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with v2c.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ************************************************************************/
+
+/*
+ * Regression test of the symmetry reduction of CIF files. The conventional
+ * cells of fcc Cu and rock salt NaCl in the fixture directory, and
+ * supercells of them, must be written as their primitive cell with the 48
+ * operations of point group m-3m and one atom per element.
+ */
+
+#include <string>
+#include <vector>
+#include <iostream>
+
+#include "structurereader.h"
+#include "celltransform.h"
+#include "cifwriter.h"
+
+/*
+ * Count the lines of <buffer> that start with <prefix>
+ */
+static unsigned int count_lines(const std::string &buffer, const std::string &prefix) {
+    unsigned int count = 0;
+    size_t pos = 0;
+    while(pos < buffer.size()) {
+        if(buffer.compare(pos, prefix.size(), prefix) == 0) {
+            count++;
+        }
+        pos = buffer.find('\n', pos);
+        pos = pos == std::string::npos ? buffer.size() : pos + 1;
+    }
+    return count;
+}
+
+/*
+ * Write the n x n x n supercell of <dir>/<name> as symmetry-reduced CIF;
+ * a single site of each of the <elements> must be listed
+ */
+static bool test_reduction(const std::string &dir, const std::string &name, unsigned int n,
+                           const std::vector<std::string> &elements) {
+    std::vector<State> states;
+    StructureReader reader;
+    if(!reader.read(dir + "/" + name, states) || states.size() != 1) {
+        std::cerr << name << ": cannot be read" << std::endl;
+        return false;
+    }
+    const State supercell = CellTransform::supercell(states[0], n, n, n);
+
+    std::string buffer;
+    const CifWriter writer(true);
+    writer.format(supercell, name, buffer);
+
+    if(buffer.find("_space_group_point_group_H-M     'm-3m'") == std::string::npos) {
+        std::cerr << name << " (" << n << "x" << n << "x" << n << "): point group m-3m not found" << std::endl;
+        return false;
+    }
+
+    const unsigned int nr_operations = count_lines(buffer, "  '");
+    if(nr_operations != 48) {
+        std::cerr << name << " (" << n << "x" << n << "x" << n << "): " << nr_operations
+                  << " operations instead of 48" << std::endl;
+        return false;
+    }
+
+    for(unsigned int e=0; e<elements.size(); e++) {
+        const unsigned int nr_sites = count_lines(buffer, "  " + elements[e]);
+        if(nr_sites != 1) {
+            std::cerr << name << " (" << n << "x" << n << "x" << n << "): " << nr_sites
+                      << " sites of " << elements[e] << " instead of 1" << std::endl;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    if(argc != 2) {
+        std::cerr << "Usage: " << argv[0] << " <fixture directory>" << std::endl;
+        return -1;
+    }
+    const std::string dir(argv[1]);
+
+    std::vector<std::string> copper(1, "Cu");
+    std::vector<std::string> rock_salt;
+    rock_salt.push_back("Na");
+    rock_salt.push_back("Cl");
+
+    unsigned int nr_failed = 0;
+    for(unsigned int n=1; n<=5; n+=2) {
+        const bool result = test_reduction(dir, "Cu_fcc.POSCAR", n, copper) &&
+                            test_reduction(dir, "NaCl.POSCAR", n, rock_salt);
+        std::cout << (result ? "PASS " : "FAIL ") << "symmetry " << n << "x" << n << "x" << n << std::endl;
+        nr_failed += result ? 0 : 1;
+    }
+
+    return nr_failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,93 @@
+/*************************************************************************
+ *
+ *  This file is part of v2c.
+ *
+ *  Author: Ivo Filot <i.a.w.filot@tue.nl>
+ *
+ *  v2c is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  v2c is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with v2c.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ************************************************************************/
+
+/*
+ * Helpers shared by the regression tests that build their structures in
+ * code: reproducible random numbers and States assembled from a cell and
+ * a list of atoms.
+ */
+
+#ifndef _TEST_STRUCTURES_H
+#define _TEST_STRUCTURES_H
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+#include "state.h"
+
+/*
+ * Reproducible uniform numbers in [0, 1)
+ */
+static inline double next_random(uint64_t &seed) {
+    seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+    return (double)(seed >> 11) / 9007199254740992.0;
+}
+
+/*
+ * Symbol of the elements that occur in the tests
+ */
+static inline std::string get_element_symbol(unsigned int elnr) {
+    switch(elnr) {
+        case 1:  return "H";
+        case 6:  return "C";
+        case 7:  return "N";
+        case 8:  return "O";
+        case 18: return "Ar";
+        case 36: return "Kr";
+        case 45: return "Rh";
+        default: return "X";
+    }
+}
+
+/*
+ * State with lattice vectors <cell> (rows) and atoms of atomic numbers
+ * <elnrs> at the Cartesian <positions>; every run of atoms of the same
+ * element becomes an element block
+ */
+static inline State make_state(const Eigen::Matrix3d &cell, const std::vector<Eigen::Vector3d> &positions,
+                               const std::vector<unsigned int> &elnrs, unsigned int id = 1) {
+    std::vector<Real> dimensions(9);
+    for(unsigned int i=0; i<3; i++) {
+        for(unsigned int j=0; j<3; j++) {
+            dimensions[i*3+j] = cell(i,j);
+        }
+    }
+
+    std::vector<Atom> atoms;
+    std::vector<std::string> elements;
+    std::vector<unsigned int> elements_uint;
+    std::vector<unsigned int> counts;
+    for(unsigned int i=0; i<positions.size(); i++) {
+        atoms.push_back(Atom(elnrs[i], positions[i](0), positions[i](1), positions[i](2)));
+        if(i > 0 && elnrs[i] == elnrs[i-1]) {
+            counts.back()++;
+        } else {
+            elements.push_back(get_element_symbol(elnrs[i]));
+            elements_uint.push_back(elnrs[i]);
+            counts.push_back(1);
+        }
+    }
+
+    return State(0.0, dimensions, atoms, elements, elements_uint, counts, "test", id);
+}
+
+#endif // _TEST_STRUCTURES_H
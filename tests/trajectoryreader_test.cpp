@@ -0,0 +1,213 @@
+/*************************************************************************
+ *
+ *  This file is part of v2c.
+ *
+ *  Author: Ivo Filot <i.a.w.filot@tue.nl>
+ *
+ *  v2c is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  v2c is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with v2c.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ************************************************************************/
+
+/*
+ * Regression test of reading a trajectory in pieces. OUTCAR_vasp5 is split
+ * into the pieces of a restarted run: the second piece starts with the last
+ * frame of the first, with one atom moved by a lattice vector as after
+ * wrapping. The pieces must give the frames of the whole file with the seam
+ * frame dropped, sequentially, in parallel and with a small memory budget;
+ * a piece that does not repeat the last frame keeps all its frames, and a
+ * piece with other elements is refused.
+ */
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <cmath>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "trajectoryreader.h"
+#include "trajectory.h"
+
+/*
+ * The header of an OUTCAR and its ionic steps, each from its POSITION line
+ * up to and including its LOOP+ line
+ */
+static bool split_steps(const std::string &filename, std::string &header, std::vector<std::string> &steps) {
+    std::ifstream infile(filename.c_str());
+    std::string line;
+    std::string *current = &header;
+    while(std::getline(infile, line)) {
+        if(line.find(" POSITION ") == 0) {
+            steps.push_back("");
+            current = &steps.back();
+        }
+        *current += line + "\n";
+    }
+    return steps.size() >= 3;
+}
+
+static bool write_piece(const std::string &filename, const std::string &header,
+                        const std::vector<std::string> &steps) {
+    std::ofstream outfile(filename.c_str());
+    outfile << header;
+    for(unsigned int i=0; i<steps.size(); i++) {
+        outfile << steps[i];
+    }
+    outfile.close();
+    return outfile.good();
+}
+
+/*
+ * Move the first atom of <step> by <shift> along x
+ */
+static std::string shift_first_atom(const std::string &step, double shift) {
+    const size_t start = step.find('\n', step.find('\n') + 1) + 1;
+    const size_t end = step.find('\n', start);
+    std::istringstream str(step.substr(start, end - start));
+    double values[6];
+    for(unsigned int k=0; k<6; k++) {
+        str >> values[k];
+    }
+    char line[128];
+    snprintf(line, sizeof(line), "%15.5f%11.5f%11.5f%16.6f%11.6f%11.6f",
+             values[0] + shift, values[1], values[2], values[3], values[4], values[5]);
+    return step.substr(0, start) + line + step.substr(end);
+}
+
+/*
+ * Read <pieces> with <nr_threads> threads and <budget> bytes of memory; the
+ * frames must equal <expected> with <nr_seams> seam frames dropped
+ */
+static bool test_pieces(const std::string &label, const std::vector<std::string> &pieces,
+                        const Trajectory &expected, unsigned int nr_seams, unsigned int nr_threads,
+                        size_t budget) {
+    TrajectoryReader tr;
+    tr.set_memory_budget(budget);
+    unsigned int nr_called = 0;
+    bool ordered = true;
+    tr.set_state_callback([&](const State &state) {
+        ordered = ordered && state.get_state_id() == ++nr_called;
+    }, true);
+
+    if(!tr.read(pieces, nr_threads)) {
+        std::cerr << label << ": cannot be read" << std::endl;
+        return false;
+    }
+    if(tr.get_nr_frames() != expected.get_nr_frames() || tr.states.size() != expected.get_nr_frames() ||
+       tr.get_nr_seams() != nr_seams || nr_called != expected.get_nr_frames() || !ordered) {
+        std::cerr << label << ": " << tr.get_nr_frames() << " frames and " << tr.get_nr_seams()
+                  << " seams instead of " << expected.get_nr_frames() << " and " << nr_seams << std::endl;
+        return false;
+    }
+
+    const Trajectory trajectory(tr.states);
+    for(unsigned int f=0; f<trajectory.get_nr_frames(); f++) {
+        if(std::fabs(trajectory.get_energies()[f] - expected.get_energies()[f]) > 1e-8) {
+            std::cerr << label << ": frame " << f + 1 << " differs" << std::endl;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static bool test_restart(const std::string &fixture, const std::string &dir) {
+    std::string header;
+    std::vector<std::string> steps;
+    if(!split_steps(fixture, header, steps)) {
+        std::cerr << fixture << ": cannot be split into steps" << std::endl;
+        return false;
+    }
+
+    VaspReader vr;
+    vr.read(fixture.c_str());
+    const Trajectory expected(vr.states);
+
+    // the first lattice vector of OUTCAR_vasp5 is (8.082230509, 0, 0)
+    std::vector<std::string> first(steps.begin(), steps.end() - 1);
+    std::vector<std::string> restart(steps.end() - 2, steps.end());
+    restart[0] = shift_first_atom(restart[0], 8.082230509);
+    std::vector<std::string> last(steps.end() - 1, steps.end());
+    std::string other = header;
+    other.replace(other.find("VRHFIN =O: s2p4"), 15, "VRHFIN =N: s2p3");
+
+    std::vector<std::string> pieces;
+    pieces.push_back(dir + "/OUTCAR_1");
+    pieces.push_back(dir + "/OUTCAR_2");
+    const std::string continued = dir + "/OUTCAR_3";
+    const std::string nitrogen = dir + "/OUTCAR_N";
+    bool result = write_piece(pieces[0], header, first) && write_piece(pieces[1], header, restart) &&
+                  write_piece(continued, header, last) && write_piece(nitrogen, other, last);
+
+    // a budget of a few hundred bytes spills every frame but the last
+    result = result &&
+             test_pieces("restart", pieces, expected, 1, 1, FRAME_STORE_UNLIMITED) &&
+             test_pieces("restart (parallel)", pieces, expected, 1, 2, FRAME_STORE_UNLIMITED) &&
+             test_pieces("restart (parallel, spilled)", pieces, expected, 1, 2, 512);
+
+    pieces[1] = continued;
+    result = result &&
+             test_pieces("continued", pieces, expected, 0, 1, FRAME_STORE_UNLIMITED) &&
+             test_pieces("continued (parallel)", pieces, expected, 0, 2, FRAME_STORE_UNLIMITED);
+
+    pieces[1] = nitrogen;
+    for(unsigned int nr_threads=1; result && nr_threads<=2; nr_threads++) {
+        TrajectoryReader tr;
+        tr.set_state_callback(std::function<void(const State&)>(), true);
+        if(tr.read(pieces, nr_threads) || tr.get_nr_frames() != 2) {
+            std::cerr << "a piece with other elements is accepted" << std::endl;
+            result = false;
+        }
+    }
+
+    unlink(pieces[0].c_str());
+    unlink((dir + "/OUTCAR_2").c_str());
+    unlink(continued.c_str());
+    unlink(nitrogen.c_str());
+
+    return result;
+}
+
+int main(int argc, char* argv[]) {
+    if(argc != 2) {
+        std::cerr << "Usage: " << argv[0] << " <fixture directory>" << std::endl;
+        return -1;
+    }
+
+    char dir[] = "/tmp/v2c_pieces_XXXXXX";
+    if(mkdtemp(dir) == NULL) {
+        std::cerr << "cannot create a temporary directory" << std::endl;
+        return 1;
+    }
+
+    unsigned int nr_failed = 0;
+
+    bool result = test_restart(std::string(argv[1]) + "/OUTCAR_vasp5", dir);
+    std::cout << (result ? "PASS " : "FAIL ") << "trajectory pieces" << std::endl;
+    nr_failed += result ? 0 : 1;
+
+    std::vector<std::string> expected;
+    expected.push_back("OUTCAR_1");
+    expected.push_back("run 2/OUTCAR");
+    result = TrajectoryReader::split_pieces("OUTCAR_1,,run 2/OUTCAR,") == expected;
+    std::cout << (result ? "PASS " : "FAIL ") << "trajectory split pieces" << std::endl;
+    nr_failed += result ? 0 : 1;
+
+    rmdir(dir);
+
+    return nr_failed == 0 ? 0 : 1;
+}
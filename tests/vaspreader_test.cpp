@@ -0,0 +1,209 @@
+/*************************************************************************
+ *
+ *  This file is part of v2c.
+ *
+ *  Author: Ivo Filot <i.a.w.filot@tue.nl>
+ *
+ *  v2c is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  v2c is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with v2c.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ************************************************************************/
+
+/*
+ * Regression test of the OUTCAR frame parsers. Every fixture in the
+ * directory given on the command line is parsed and compared with the arrays
+ * that were exported from it (<fixture>_*.npy); the damaged fixture must
+ * also give the expected diagnostics. OUTCAR_md holds the frames of
+ * OUTCAR_vasp5 with the stress, magnetization, kinetic energy and timing
+ * lines of a molecular dynamics run, which must be collected per step.
+ */
+
+#include <string>
+#include <vector>
+#include <iostream>
+#include <cmath>
+
+#include "vaspreader.h"
+#include "trajectory.h"
+
+// positions, forces and cells are stored in single precision
+#define TEST_TOLERANCE 1e-4
+
+static bool compare(const std::string &name, const char *label,
+                    const float *values, const float *expected, size_t n) {
+    for(size_t i=0; i<n; i++) {
+        if(std::fabs(values[i] - expected[i]) > TEST_TOLERANCE) {
+            std::cerr << name << ": " << label << "[" << i << "] is " << values[i]
+                      << " instead of " << expected[i] << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+/*
+ * Parse <dir>/<name> and compare the trajectory with the stored arrays
+ */
+static bool test_fixture(const std::string &dir, const std::string &name, VaspReader &vr) {
+    const std::string filename = dir + "/" + name;
+    if(!vr.read(filename.c_str())) {
+        std::cerr << name << ": cannot be read" << std::endl;
+        return false;
+    }
+
+    Trajectory trajectory(vr.states);
+    Trajectory expected;
+    if(!expected.load_from_npy(filename)) {
+        std::cerr << name << ": cannot load the expected arrays" << std::endl;
+        return false;
+    }
+
+    if(trajectory.get_nr_frames() != expected.get_nr_frames() ||
+       trajectory.get_nr_atoms() != expected.get_nr_atoms()) {
+        std::cerr << name << ": " << trajectory.get_nr_frames() << " frames of "
+                  << trajectory.get_nr_atoms() << " atoms instead of "
+                  << expected.get_nr_frames() << " frames of "
+                  << expected.get_nr_atoms() << " atoms" << std::endl;
+        return false;
+    }
+
+    if(trajectory.get_elements() != expected.get_elements() ||
+       trajectory.get_nr_atoms_per_element() != expected.get_nr_atoms_per_element() ||
+       trajectory.get_species() != expected.get_species()) {
+        std::cerr << name << ": elements differ" << std::endl;
+        return false;
+    }
+
+    const size_t nr_frames = trajectory.get_nr_frames();
+    const size_t nr_values = nr_frames * trajectory.get_nr_atoms() * 3;
+    for(size_t i=0; i<nr_frames; i++) {
+        if(std::fabs(trajectory.get_energies()[i] - expected.get_energies()[i]) > 1e-8) {
+            std::cerr << name << ": energy of frame " << i << " differs" << std::endl;
+            return false;
+        }
+    }
+
+    return compare(name, "positions", trajectory.get_positions(), expected.get_positions(), nr_values) &&
+           compare(name, "forces", trajectory.get_forces(), expected.get_forces(), nr_values) &&
+           compare(name, "cells", trajectory.get_cells(), expected.get_cells(), nr_frames * 9);
+}
+
+/*
+ * The damaged fixture lacks an atom in the POSITION block of its second
+ * step and ends before the energy of its fourth step
+ */
+static bool test_diagnostics(const VaspReader &vr) {
+    const std::vector<OutcarDiagnostic> &diagnostics = vr.get_diagnostics();
+    if(diagnostics.size() != 2 ||
+       diagnostics[0].type != VASP_OUTCAR_DIAGNOSTIC_INCOMPLETE_POSITIONS ||
+       diagnostics[0].line != 80 || diagnostics[0].nr_states != 1 ||
+       diagnostics[1].type != VASP_OUTCAR_DIAGNOSTIC_TRUNCATED ||
+       diagnostics[1].line != 153 || diagnostics[1].nr_states != 2) {
+        std::cerr << "OUTCAR_damaged: unexpected diagnostics" << std::endl;
+        for(unsigned int i=0; i<diagnostics.size(); i++) {
+            std::cerr << "  line " << diagnostics[i].line << ": "
+                      << diagnostics[i].message << std::endl;
+        }
+        return false;
+    }
+    return true;
+}
+
+/*
+ * The quantities of step k in OUTCAR_md: stress (-4.1 - k, -4.2, -4.3, 0.1,
+ * 0.2 + 0.01 k, -0.3) kB, magnetization 1.5 + 0.1 k after an unconverged
+ * 0.25, EKIN 0.3 + 0.01 k eV at 250 + 10 k K and cpu time 10 + k s
+ */
+static bool test_observables(const std::string &dir) {
+    VaspReader vr;
+    vr.set_observables(STATE_OBSERVABLE_ALL);
+    VaspReader plain;
+    if(!vr.read((dir + "/OUTCAR_md").c_str()) || !plain.read((dir + "/OUTCAR_vasp5").c_str()) ||
+       vr.states.size() != 3 || plain.states.size() != 3) {
+        std::cerr << "OUTCAR_md: cannot be read" << std::endl;
+        return false;
+    }
+
+    for(unsigned int k=0; k<vr.states.size(); k++) {
+        const State state = vr.states[k];
+        const StateObservables &obs = state.get_observables();
+        const double stress[6] = {-4.1 - k, -4.2, -4.3, 0.1, 0.2 + 0.01 * k, -0.3};
+        bool result = obs.available == STATE_OBSERVABLE_ALL &&
+                      std::fabs(obs.magnetization - (1.5 + 0.1 * k)) < 1e-8 &&
+                      std::fabs(obs.kinetic_energy - (0.3 + 0.01 * k)) < 1e-8 &&
+                      std::fabs(obs.temperature - (250.0 + 10.0 * k)) < 1e-8 &&
+                      std::fabs(obs.cpu_time - (10.0 + k)) < 1e-8 &&
+                      std::fabs(obs.real_time - (10.5 + k)) < 1e-8;
+        for(unsigned int i=0; i<6; i++) {
+            result = result && std::fabs(obs.stress[i] - stress[i]) < 1e-8;
+        }
+
+        // the force statistics follow from the forces of the step
+        double max_force = 0.0;
+        double sum = 0.0;
+        for(unsigned int i=0; i<state.atoms.size(); i++) {
+            const double norm = state.atoms[i].force.cast<double>().norm();
+            max_force = std::max(max_force, norm);
+            sum += norm * norm;
+        }
+        result = result && std::fabs(obs.max_force - max_force) < TEST_TOLERANCE &&
+                 std::fabs(obs.rms_force - std::sqrt(sum / state.atoms.size())) < TEST_TOLERANCE;
+
+        // the frames do not depend on the quantities in between
+        const State expected = plain.states[k];
+        for(unsigned int i=0; result && i<state.atoms.size(); i++) {
+            result = (state.atoms[i].pos - expected.atoms[i].pos).norm() < TEST_TOLERANCE;
+        }
+        result = result && state.get_energy() == expected.get_energy();
+
+        if(!result) {
+            std::cerr << "OUTCAR_md: the quantities of step " << k + 1 << " differ" << std::endl;
+            return false;
+        }
+    }
+
+    // nothing is collected unless asked for
+    if(plain.states[0].get_observables().available != 0) {
+        std::cerr << "OUTCAR_vasp5: quantities are collected by default" << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    if(argc != 2) {
+        std::cerr << "Usage: " << argv[0] << " <fixture directory>" << std::endl;
+        return -1;
+    }
+    const std::string dir(argv[1]);
+
+    static const char* fixtures[] = {"OUTCAR_vasp4", "OUTCAR_vasp5", "OUTCAR_vasp6",
+                                     "OUTCAR_mlff", "OUTCAR_damaged"};
+    unsigned int nr_failed = 0;
+    for(unsigned int i=0; i<sizeof(fixtures) / sizeof(fixtures[0]); i++) {
+        VaspReader vr;
+        bool result = test_fixture(dir, fixtures[i], vr);
+        if(result && std::string(fixtures[i]) == "OUTCAR_damaged") {
+            result = test_diagnostics(vr);
+        }
+        std::cout << (result ? "PASS " : "FAIL ") << fixtures[i] << std::endl;
+        nr_failed += result ? 0 : 1;
+    }
+
+    const bool result = test_observables(dir);
+    std::cout << (result ? "PASS " : "FAIL ") << "OUTCAR_md" << std::endl;
+    nr_failed += result ? 0 : 1;
+
+    return nr_failed == 0 ? 0 : 1;
+}